@@ -35,13 +35,17 @@ namespace CGLA
         MT A = Ap;
         unsigned int n = min(MT::get_v_dim(), max_sol);
         
-        gel_srand(0);
+        // The seeds are the sequence gel_rand produces after gel_srand(0), but the generator is
+        // local, so the function can be called from several threads at once.
+        unsigned int rand_state = 0;
         for(unsigned int i=0;i<n;++i)
         {
             // Seed the eigenvector estimate
             VT q;
-            for (unsigned int j=0; j<MT::get_v_dim(); ++j)
-                q[j] = gel_rand()/static_cast<double>(GEL_RAND_MAX);
+            for (unsigned int j=0; j<MT::get_v_dim(); ++j) {
+                rand_state = rand_state * 3125 + 49;
+                q[j] = rand_state/static_cast<double>(GEL_RAND_MAX);
+            }
             
             q.normalize();
             double l=123,l_old;
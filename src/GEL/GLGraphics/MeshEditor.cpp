@@ -462,14 +462,14 @@ namespace GLGraphics {
                 return;
             }
             vector<VertexID> loop0;
-			circulate_face_ccw(m, f0, std::function<void(VertexID)>([&](VertexID v){
+			circulate_face_ccw(m, f0, [&](VertexID v){
                 loop0.push_back(v);
-            }) );
+            });
             
             vector<VertexID> loop1;
-			circulate_face_ccw(m, f1, std::function<void(VertexID)>( [&](VertexID v) {
+			circulate_face_ccw(m, f1, [&](VertexID v) {
                 loop1.push_back(v);
-            }) );
+            });
             
             vector<pair<VertexID, VertexID> > connections;
             
@@ -539,7 +539,7 @@ namespace GLGraphics {
                 if(m.in_use(f))
                 {
                     VertexID v0=InvalidVertexID,v1=InvalidVertexID;
-					circulate_face_ccw(m, f, std::function<void(VertexID)>( [&](VertexID v){
+					circulate_face_ccw(m, f, [&](VertexID v){
                         if(vsel.count(v))
                         {
                             if(v0==InvalidVertexID)
@@ -549,7 +549,7 @@ namespace GLGraphics {
                         
                         }
                     
-                    }) );
+                    });
                     m.split_face_by_edge(f, v0, v1);
                 }
         }
@@ -1051,7 +1051,7 @@ namespace GLGraphics {
                 ++val_hist[val];
                 
                 if(val != 4)
-                    circulate_vertex_ccw(m, v, static_cast<std::function<void(HalfEdgeID)>>([&](HalfEdgeID h){
+                    circulate_vertex_ccw(m, v, [&](HalfEdgeID h){
                         Walker w = m.walker(h);
                         DebugRenderer::edge_colors[h] = Vec3f(1);
                         DebugRenderer::edge_colors[w.opp().halfedge()] = Vec3f(1);
@@ -1060,7 +1060,7 @@ namespace GLGraphics {
                             DebugRenderer::edge_colors[w.halfedge()] = Vec3f(1);
                             DebugRenderer::edge_colors[w.opp().halfedge()] = Vec3f(1);
                         }
-                    }));
+                    });
             }
             map<int, int> ngon_hist;
             for(FaceID f: m.faces()) {
@@ -1745,9 +1745,9 @@ namespace GLGraphics {
             else if(!fset.empty())
                 for(auto f: fset)
                 {
-					circulate_face_ccw(m, f, std::function<void(VertexID)>( [&](VertexID vid){
+					circulate_face_ccw(m, f, [&](VertexID vid){
                         m.pos(vid) = active_visobj().mesh_old().pos(vid) + v;
-                    }) );
+                    });
                 }
             else {
                 if(string(brush_type) == "smooth")
@@ -328,9 +328,9 @@ void VisObj::draw_selection()
         if(mani.in_use(fid))
         {
             glBegin(GL_POLYGON);
-            circulate_face_ccw(mani, fid, std::function<void(VertexID)>([&](VertexID v){
+            circulate_face_ccw(mani, fid, [&](VertexID v){
                 glVertex3dv(mani.pos(v).get());
-            }) );
+            });
             glEnd();
         }
     }
@@ -4,6 +4,8 @@
  * For license and list of authors, see ../../doc/intro.pdf
  * ----------------------------------------------------------------------- */
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include "QEM.h"
@@ -14,38 +16,146 @@ using namespace std;
 
 namespace Geometry
 {
-	Vec3d QEM::opt_pos(double sv_thresh, const CGLA::Vec3d& p0) const
-	{
-        // Compute eigensolution of the symmetric matrix A. This
-        // allows us to factorize it into A = U L U^T and compute
-        // the pseudoinverse.
-        Mat3x3d U(0),L(0);
-        int n = power_eigensolution(A, U, L);
-        
-        // Unfortunately, eigendecomposition does not find the basis
-        // vectors of the 0-space, so we compute either one or two
-        // vectors below that span the 0-space.
-        switch(n) {
-            case 0:
-                return p0;
-            case 1:
-                orthogonal(U[0], U[1], U[2]);
-                break;
-            case 2:
-                U[2] = cross(U[0],U[1]);
-                break;
+    namespace
+    {
+        /** The solution of Ax = -b/2 (the point where the gradient is zero) as the least norm
+         solution relative to p0 when the small eigenvalues are truncated. This is the general
+         method, and it uses an iterative eigensolution. */
+        Vec3d opt_pos_eigensolution(const Mat3x3d& A, const Vec3d& b, double sv_thresh, const Vec3d& p0)
+        {
+            // Compute eigensolution of the symmetric matrix A. This
+            // allows us to factorize it into A = U L U^T and compute
+            // the pseudoinverse.
+            Mat3x3d U(0),L(0);
+            int n = power_eigensolution(A, U, L);
+
+            // Unfortunately, eigendecomposition does not find the basis
+            // vectors of the 0-space, so we compute either one or two
+            // vectors below that span the 0-space.
+            switch(n) {
+                case 0:
+                    return p0;
+                case 1:
+                    orthogonal(U[0], U[1], U[2]);
+                    break;
+                case 2:
+                    U[2] = cross(U[0],U[1]);
+                    break;
+            }
+
+            // For each eigenvalue, we compute the corresponding component
+            // of either the least squares or least norm solution.
+            double limit = abs(sv_thresh * L[0][0]);
+            Vec3d x(0);
+            for(int i=0;i<3;++i) {
+                if(abs(L[i][i])<limit)
+                    x += U[i] * dot(U[i], p0);
+                else
+                    x -= U[i] * dot(U[i], 0.5*b)/L[i][i];
+            }
+            return x;
+        }
+
+        /** The eigenvalues of the symmetric matrix A in closed form (O. K. Smith, 1961), sorted
+         by decreasing absolute value. */
+        Vec3d symmetric_eigenvalues(const Mat3x3d& A)
+        {
+            const double p1 = sqr(A[0][1]) + sqr(A[0][2]) + sqr(A[1][2]);
+            const double q = (A[0][0] + A[1][1] + A[2][2]) / 3.0;
+            const double p2 = sqr(A[0][0]-q) + sqr(A[1][1]-q) + sqr(A[2][2]-q) + 2*p1;
+            const double p = sqrt(p2 / 6.0);
+            if(p == 0)
+                return Vec3d(q);
+            const Mat3x3d B = (A - identity_Mat3x3d() * q) * (1.0 / p);
+            const double r = max(-1.0, min(1.0, determinant(B) / 2.0));
+            const double phi = acos(r) / 3.0;
+            double l[3];
+            l[0] = q + 2*p*cos(phi);
+            l[2] = q + 2*p*cos(phi + 2.0*M_PI/3.0);
+            l[1] = 3*q - l[0] - l[2];
+            if(abs(l[1]) > abs(l[0])) swap(l[0], l[1]);
+            if(abs(l[2]) > abs(l[1])) swap(l[1], l[2]);
+            if(abs(l[1]) > abs(l[0])) swap(l[0], l[1]);
+            return Vec3d(l[0], l[1], l[2]);
         }
-        
-        // For each eigenvalue, we compute the corresponding component
-        // of either the least squares or least norm solution.
-        double limit = abs(sv_thresh * L[0][0]);
-        Vec3d x(0);
-        for(int i=0;i<3;++i) {
-            if(abs(L[i][i])<limit)
-                x += U[i] * dot(U[i], p0);
-            else
-                x -= U[i] * dot(U[i], 0.5*b)/L[i][i];
+
+        /// Solve Mx = v for the symmetric matrix M by Cramer's rule. Returns false if M is singular.
+        bool solve_symmetric(const Mat3x3d& M, const Vec3d& v, Vec3d& x)
+        {
+            const double c00 = M[1][1]*M[2][2] - M[1][2]*M[1][2];
+            const double c01 = M[0][2]*M[1][2] - M[0][1]*M[2][2];
+            const double c02 = M[0][1]*M[1][2] - M[0][2]*M[1][1];
+            const double c11 = M[0][0]*M[2][2] - M[0][2]*M[0][2];
+            const double c12 = M[0][1]*M[0][2] - M[0][0]*M[1][2];
+            const double c22 = M[0][0]*M[1][1] - M[0][1]*M[0][1];
+            const double det = M[0][0]*c00 + M[0][1]*c01 + M[0][2]*c02;
+            if(det == 0)
+                return false;
+            x = Vec3d(c00*v[0] + c01*v[1] + c02*v[2],
+                      c01*v[0] + c11*v[1] + c12*v[2],
+                      c02*v[0] + c12*v[1] + c22*v[2]) / det;
+            return true;
+        }
+
+        /** Find the unit eigenvector u of the symmetric matrix A for the eigenvalue l as the
+         largest cross product of two rows of A - lI. Returns false if the eigenvalue is too
+         close to another one for the eigenvector to be well defined, relative to the scale,
+         which is the greatest absolute eigenvalue. */
+        bool symmetric_eigenvector(const Mat3x3d& A, double l, double scale, Vec3d& u)
+        {
+            const Mat3x3d M = A - identity_Mat3x3d() * l;
+            const Vec3d c[3] = {cross(M[0], M[1]), cross(M[0], M[2]), cross(M[1], M[2])};
+            int best = 0;
+            for(int i=1;i<3;++i)
+                if(sqr_length(c[i]) > sqr_length(c[best]))
+                    best = i;
+            const double len = length(c[best]);
+            if(!(len > 1e-6 * scale * scale))
+                return false;
+            u = c[best] / len;
+            return true;
         }
-        return x;
-	}
+    }
+
+    template<typename T>
+    Vec3d QEMT<T>::opt_pos(double sv_thresh, const CGLA::Vec3d& p0) const
+    {
+        // The point sought solves Ax = -b/2 in the least squares sense. The eigenvalues decide
+        // which eigenvectors of A are kept. Along the others, x is as close to p0 as possible.
+        const Mat3x3d M = A();
+        const Vec3d hb = 0.5 * Vec3d(b[0], b[1], b[2]);
+        const Vec3d l = symmetric_eigenvalues(M);
+        const double limit = abs(sv_thresh * l[0]);
+        if(l[0] == 0)
+            return p0;
+
+        Vec3d x;
+        if(abs(l[2]) >= limit) {
+            // All eigenvalues are kept, so A is invertible and the solution is unique.
+            if(solve_symmetric(M, -hb, x))
+                return x;
+        }
+        else if(abs(l[1]) < limit) {
+            // Only the greatest eigenvalue is kept. The solution is the point closest to p0 on
+            // the plane where the component along its eigenvector is right.
+            Vec3d u;
+            if(symmetric_eigenvector(M, l[0], abs(l[0]), u))
+                return p0 - u * (dot(u, p0) + dot(u, hb) / l[0]);
+        }
+        else {
+            // The smallest eigenvalue is dropped. Moving it up to the greatest gives a well
+            // conditioned matrix which acts as A on the other eigenvectors, and the component
+            // of b along the dropped eigenvector is replaced by that of p0.
+            Vec3d u;
+            if(symmetric_eigenvector(M, l[2], abs(l[0]), u)) {
+                const Mat3x3d B = M + outer_product(u, u) * l[0];
+                if(solve_symmetric(B, u * dot(u, hb) - hb, x))
+                    return x + u * dot(u, p0);
+            }
+        }
+        return opt_pos_eigensolution(M, Vec3d(b[0], b[1], b[2]), sv_thresh, p0);
+    }
+
+    template class QEMT<double>;
+    template class QEMT<float>;
 }
@@ -17,60 +17,100 @@
 #include "../CGLA/Mat3x3d.h"
 
 
-namespace
-{
-	inline const CGLA::Mat3x3d direct_product(const CGLA::Vec3d& v0, const CGLA::Vec3d& v1)
-		{
-			CGLA::Mat3x3d m;
-			for(int i=0;i<3;++i)
-				for(int j=0;j<3;++j)
-					m[i][j] = v0[i]*v1[j];
-			return m;
-		}
-}
-
 namespace Geometry
 {
-	class QEM
+	/** A quadric error metric, i.e. the function E(p) = p^T A p + b^T p + c where A is a
+	 symmetric 3x3 matrix. Since A is symmetric, only its upper triangle is stored, so a
+	 quadric is ten numbers of type T. QEM (double) is the default. QEMf (float) takes
+	 up half the memory, but c is the square of the distance from the origin to the planes, so
+	 the coordinates should be centred near the origin when single precision is used. Both are
+	 instantiated in QEM.cpp, where opt_pos is defined, so other element types will not link.
+	 The library itself only uses QEM; QEMf is for callers who keep a quadric per vertex of
+	 large meshes. */
+	template<typename T>
+	class QEMT
 		{
-			CGLA::Mat3x3d A;
-			CGLA::Vec3d   b;
-			double   c;
+			// The upper triangle of A row by row: A00 A01 A02 A11 A12 A22.
+			T a[6];
+			T b[3];
+			T c;
 		public:
-			
-			QEM(): A(0), b(0), c(0) {}
-			
-			QEM(const CGLA::Vec3d& p0, const CGLA::Vec3d& n0, double w=1.0f):
-				A(direct_product(n0,n0) * w), 
-				b(-2*n0*dot(n0,p0) * w), 
-				c(dot(p0,n0)*dot(p0,n0) * w) {}
-
-			
-			void operator+=(const QEM& q)
+
+			QEMT(): a{0,0,0,0,0,0}, b{0,0,0}, c(0) {}
+
+			/// The squared distance to the plane through p0 with normal n0 times w.
+			QEMT(const CGLA::Vec3d& p0, const CGLA::Vec3d& n0, double w=1.0f)
 				{
-					A += q.A;
-					b += q.b;
+					const double d = dot(n0,p0);
+					a[0] = T(n0[0]*n0[0]*w); a[1] = T(n0[0]*n0[1]*w); a[2] = T(n0[0]*n0[2]*w);
+					a[3] = T(n0[1]*n0[1]*w); a[4] = T(n0[1]*n0[2]*w); a[5] = T(n0[2]*n0[2]*w);
+					for(int i=0;i<3;++i)
+						b[i] = T(-2*n0[i]*d * w);
+					c = T(d*d * w);
+				}
+
+			void operator+=(const QEMT& q)
+				{
+					for(int i=0;i<6;++i)
+						a[i] += q.a[i];
+					for(int i=0;i<3;++i)
+						b[i] += q.b[i];
 					c += q.c;
 				}
-			
-			float error(const CGLA::Vec3d& p) const
+
+			QEMT operator+(const QEMT& q) const
 				{
-					return dot(p,A*p) + dot(b,p)+ c;
+					QEMT r = *this;
+					r += q;
+					return r;
+				}
+
+			/// The matrix A.
+			const CGLA::Mat3x3d A() const
+				{
+					return CGLA::Mat3x3d(CGLA::Vec3d(a[0], a[1], a[2]),
+										 CGLA::Vec3d(a[1], a[3], a[4]),
+										 CGLA::Vec3d(a[2], a[4], a[5]));
+				}
+
+			/// Returns A p.
+			const CGLA::Vec3d A_times(const CGLA::Vec3d& p) const
+				{
+					return CGLA::Vec3d(a[0]*p[0] + a[1]*p[1] + a[2]*p[2],
+									   a[1]*p[0] + a[3]*p[1] + a[4]*p[2],
+									   a[2]*p[0] + a[4]*p[1] + a[5]*p[2]);
+				}
+
+			T error(const CGLA::Vec3d& p) const
+				{
+					const CGLA::Vec3d Ap = A_times(p);
+					return T(dot(p,Ap) + (b[0]*p[0] + b[1]*p[1] + b[2]*p[2]) + c);
 				}
 
 			double determinant() const
 				{
-					return CGLA::determinant(A);
+					return double(a[0])*(double(a[3])*a[5] - double(a[4])*a[4])
+						- double(a[1])*(double(a[1])*a[5] - double(a[4])*a[2])
+						+ double(a[2])*(double(a[1])*a[4] - double(a[3])*a[2]);
 				}
-			
+
 			const CGLA::Vec3d grad(const CGLA::Vec3d& p) const
 				{
-					return CGLA::Vec3d(2*A*p+b);
+					return CGLA::Vec3d(2*A_times(p) + CGLA::Vec3d(b[0], b[1], b[2]));
 				}
-			
+
+			/** The point which minimizes the error. Eigenvalues of A smaller than QEM_thresh times
+			 the greatest are treated as zero, and along the corresponding eigenvectors, the point
+			 is as close to p0 as possible. When no eigenvalue is that small, the point is found by
+			 a closed form solution of the 3x3 system. Otherwise, the eigenvalues which are kept
+			 decide how the system is reduced to a solvable one, and only if the eigenvalues are
+			 too close to tell apart is a full eigensolution computed. */
 			CGLA::Vec3d opt_pos(double QEM_thresh = 0.5, const CGLA::Vec3d& p0 = CGLA::Vec3d(0.0)) const;
-			
+
 		};
+
+	typedef QEMT<double> QEM;
+	typedef QEMT<float> QEMf;
 }
 
 namespace GEO = Geometry;
@@ -98,7 +98,7 @@ pair<Vec3d, double> bounding_sphere(const vector<Vec3d>& _pts) {
     
     vector<Vec3d> pts;
     for(const Vec3d& p: _pts)
-        if(!(isnan(p[0])||isnan(p[1])||isnan(p[2])))
+        if(!(std::isnan(p[0])||std::isnan(p[1])||std::isnan(p[2])))
            pts.push_back(p);
            
     return Welzl(pts, {});
@@ -107,7 +107,7 @@ pair<Vec3d, double> bounding_sphere(const vector<Vec3d>& _pts) {
 pair<Vec3d, double> approximate_bounding_sphere(const vector<Vec3d>& _pts) {
     vector<Vec3d> pts;
     for(const Vec3d& p: _pts)
-        if(!(isnan(p[0])||isnan(p[1])||isnan(p[2])))
+        if(!(std::isnan(p[0])||std::isnan(p[1])||std::isnan(p[2])))
            pts.push_back(p);
     if(pts.size()>1000) {
         shuffle(pts.begin(), pts.end(), default_random_engine(0));
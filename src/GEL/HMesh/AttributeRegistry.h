@@ -0,0 +1,362 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file AttributeRegistry.h
+ * @brief Named attribute layers owned by a Manifold.
+ *
+ * A layer is an ordinary attribute vector (VertexAttributeVector etc.) which the Manifold keeps
+ * in sync with the kernel: it always holds a value for every allocated entity, it grows when
+ * entities are added, it is compacted when the mesh is cleaned up, and it is saved and loaded
+ * with the mesh in the .gel format.
+ */
+
+#ifndef __HMESH_ATTRIBUTEREGISTRY_H__
+#define __HMESH_ATTRIBUTEREGISTRY_H__
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "ConnectivityKernel.h"
+#include "AttributeVector.h"
+#include "gel_format.h"
+
+namespace HMesh
+{
+    /// The attribute vector type, kind, and part of an IDRemap which go with a type of ID.
+    template<typename ITEMID> struct AttributeLayerTraits;
+
+    template<> struct AttributeLayerTraits<VertexID>
+    {
+        template<typename T> using Vector = VertexAttributeVector<T>;
+        static constexpr GELAttribute::Kind kind = GELAttribute::VERTEX;
+        static const VertexIDRemap& remap(const IDRemap& map) { return map.vmap; }
+    };
+
+    template<> struct AttributeLayerTraits<FaceID>
+    {
+        template<typename T> using Vector = FaceAttributeVector<T>;
+        static constexpr GELAttribute::Kind kind = GELAttribute::FACE;
+        static const FaceIDRemap& remap(const IDRemap& map) { return map.fmap; }
+    };
+
+    template<> struct AttributeLayerTraits<HalfEdgeID>
+    {
+        template<typename T> using Vector = HalfEdgeAttributeVector<T>;
+        static constexpr GELAttribute::Kind kind = GELAttribute::HALFEDGE;
+        static const HalfEdgeIDRemap& remap(const IDRemap& map) { return map.hmap; }
+    };
+
+    /// Abstract base class of attribute layers.
+    class AttributeLayer
+    {
+    public:
+        virtual ~AttributeLayer() {}
+
+        /// Returns a copy of the layer.
+        virtual std::unique_ptr<AttributeLayer> clone() const = 0;
+
+        /// Size in bytes of a single value.
+        virtual size_t item_size() const = 0;
+
+        /// Make the layer hold at least n values. Added values are default values.
+        virtual void grow(size_t n) = 0;
+
+        /// Set value i, which must be held by the layer, to the default value.
+        virtual void reset(size_t i) = 0;
+
+        /// Remove all values.
+        virtual void clear() = 0;
+
+        /// Compact the layer in the same way as the kernel.
+        virtual void cleanup(const IDRemap& map) = 0;
+
+        /** Append a descriptor of the layer to attribs for saving it. Layers of types that are
+         not trivially copyable cannot be stored in the .gel format and are skipped. */
+        virtual void describe(const std::string& name, std::vector<GELAttribute>& attribs) const = 0;
+
+        /** Replace the values with n values of item_size() bytes copied from src. Returns false,
+         and leaves the layer alone, if its type cannot be stored in the .gel format. */
+        virtual bool assign(const char* src, size_t n) = 0;
+    };
+
+    /// Layer holding an attribute vector of T for the entities identified by ITEMID.
+    template<typename T, typename ITEMID>
+    class TypedAttributeLayer: public AttributeLayer
+    {
+    public:
+        typedef typename AttributeLayerTraits<ITEMID>::template Vector<T> VectorType;
+
+        TypedAttributeLayer(const T& _default_value):
+        av(_default_value), default_value(_default_value) {}
+
+        std::unique_ptr<AttributeLayer> clone() const
+        { return std::unique_ptr<AttributeLayer>(new TypedAttributeLayer(*this)); }
+
+        size_t item_size() const { return sizeof(T); }
+
+        void grow(size_t n)
+        {
+            if(av.size() < n)
+                av.resize(n, default_value);
+        }
+
+        void reset(size_t i) { av[ITEMID(i)] = default_value; }
+
+        void clear() { av.clear(); }
+
+        void cleanup(const IDRemap& map) { av.cleanup(AttributeLayerTraits<ITEMID>::remap(map)); }
+
+        void describe(const std::string& name, std::vector<GELAttribute>& attribs) const
+        {
+            if constexpr (std::is_trivially_copyable<T>::value)
+                attribs.push_back(GELAttribute(name, av));
+        }
+
+        bool assign(const char* src, size_t n)
+        {
+            if constexpr (std::is_trivially_copyable<T>::value) {
+                GELAttribute(std::string(), av).assign(src, n);
+                return true;
+            }
+            return false;
+        }
+
+        VectorType av;
+        T default_value;
+    };
+
+    /** Layer holding the raw bytes of an attribute which was loaded from a file. It becomes a
+     typed layer the first time it is accessed as an attribute of a type with the same size.
+     Values added before that are zero. */
+    class RawAttributeLayer: public AttributeLayer
+    {
+    public:
+        RawAttributeLayer(GELAttribute::Kind _kind, size_t _item_size):
+        kind(_kind), isize(_item_size) {}
+
+        std::unique_ptr<AttributeLayer> clone() const
+        { return std::unique_ptr<AttributeLayer>(new RawAttributeLayer(*this)); }
+
+        size_t item_size() const { return isize; }
+
+        /// Number of values in the layer.
+        size_t size() const { return isize == 0 ? 0 : bytes.size() / isize; }
+
+        /// Pointer to the first byte of the values.
+        const char* data() const { return bytes.data(); }
+
+        void grow(size_t n)
+        {
+            if(bytes.size() < n * isize)
+                bytes.resize(n * isize, 0);
+        }
+
+        void reset(size_t i) { memset(&bytes[i * isize], 0, isize); }
+
+        void clear() { bytes.clear(); }
+
+        void cleanup(const IDRemap& map)
+        {
+            switch(kind) {
+                case GELAttribute::VERTEX: compact(map.vmap); break;
+                case GELAttribute::FACE: compact(map.fmap); break;
+                case GELAttribute::HALFEDGE: compact(map.hmap); break;
+            }
+        }
+
+        void describe(const std::string& name, std::vector<GELAttribute>& attribs) const
+        {
+            GELAttribute a(name, kind, isize);
+            const RawAttributeLayer* layer = this;
+            a.size = [layer]() { return layer->size(); };
+            a.data = [layer]() { return layer->data(); };
+            attribs.push_back(a);
+        }
+
+        bool assign(const char* src, size_t n)
+        {
+            bytes.assign(src, src + n * isize);
+            return true;
+        }
+
+    private:
+        template<typename ITEM>
+        void compact(const IDRemapTable<ITEM>& remap)
+        {
+            std::vector<char> new_bytes(remap.new_size() * isize, 0);
+            const size_t n = std::min(size(), remap.size());
+            for(size_t i = 0; i < n; ++i) {
+                ItemID<ITEM> id_new = remap[ItemID<ITEM>(i)];
+                if(id_new != ItemID<ITEM>())
+                    memcpy(&new_bytes[id_new.index * isize], &bytes[i * isize], isize);
+            }
+            std::swap(bytes, new_bytes);
+        }
+
+        GELAttribute::Kind kind;
+        size_t isize;
+        std::vector<char> bytes;
+    };
+
+    /** The named attribute layers of a Manifold. There is a separate name space for each kind of
+     entity. Copying the registry copies the layers. */
+    class AttributeRegistry
+    {
+    public:
+        AttributeRegistry() {}
+
+        AttributeRegistry(const AttributeRegistry& r) { *this = r; }
+
+        AttributeRegistry& operator=(const AttributeRegistry& r)
+        {
+            if(this != &r)
+                for(int k = 0; k < 3; ++k) {
+                    layers[k].clear();
+                    for(auto& l: r.layers[k])
+                        layers[k][l.first] = l.second->clone();
+                    capacity[k] = r.capacity[k];
+                }
+            return *this;
+        }
+
+        /** Returns the layer with the given name, adding it first if there is no layer of that
+         name and type. A layer of the same name but a different type is replaced. n is the
+         number of allocated entities. */
+        template<typename T, typename ITEMID>
+        typename TypedAttributeLayer<T, ITEMID>::VectorType& add(const std::string& name, const T& default_value, size_t n)
+        {
+            if(auto av = find<T, ITEMID>(name))
+                return *av;
+            const int k = AttributeLayerTraits<ITEMID>::kind;
+            capacity[k] = std::max(capacity[k], n);
+            TypedAttributeLayer<T, ITEMID>* layer = new TypedAttributeLayer<T, ITEMID>(default_value);
+            layer->grow(capacity[k]);
+            layers[k][name] = std::unique_ptr<AttributeLayer>(layer);
+            return layer->av;
+        }
+
+        /// Returns the layer with the given name and type or nullptr if there is none.
+        template<typename T, typename ITEMID>
+        typename TypedAttributeLayer<T, ITEMID>::VectorType* find(const std::string& name)
+        {
+            auto& kind_layers = layers[AttributeLayerTraits<ITEMID>::kind];
+            auto l = kind_layers.find(name);
+            if(l == kind_layers.end())
+                return nullptr;
+            if(auto typed = dynamic_cast<TypedAttributeLayer<T, ITEMID>*>(l->second.get()))
+                return &typed->av;
+            if constexpr (std::is_trivially_copyable<T>::value) {
+                RawAttributeLayer* raw = dynamic_cast<RawAttributeLayer*>(l->second.get());
+                if(raw && raw->item_size() == sizeof(T)) {
+                    TypedAttributeLayer<T, ITEMID>* layer = new TypedAttributeLayer<T, ITEMID>(T());
+                    const size_t n = raw->size();
+                    layer->grow(n);
+                    if(n > 0)
+                        memcpy(reinterpret_cast<char*>(&layer->av[ITEMID(0)]), raw->data(), n * sizeof(T));
+                    l->second.reset(layer);
+                    return &layer->av;
+                }
+            }
+            return nullptr;
+        }
+
+        /** Const version of find. Turning a raw layer into a typed layer does not change the
+         values, so it is also done here. */
+        template<typename T, typename ITEMID>
+        const typename TypedAttributeLayer<T, ITEMID>::VectorType* find(const std::string& name) const
+        { return const_cast<AttributeRegistry*>(this)->find<T, ITEMID>(name); }
+
+        /// Remove a layer. Returns false if there is no layer of that name.
+        bool remove(GELAttribute::Kind kind, const std::string& name)
+        { return layers[kind].erase(name) > 0; }
+
+        /// Names of the layers of the given kind.
+        std::vector<std::string> names(GELAttribute::Kind kind) const
+        {
+            std::vector<std::string> v;
+            for(auto& l: layers[kind])
+                v.push_back(l.first);
+            return v;
+        }
+
+        /** Make sure the layers of the given kind hold at least n values. The layers grow
+         geometrically, so calling this each time an entity is added is cheap. */
+        void make_room(GELAttribute::Kind kind, size_t n)
+        {
+            if(n > capacity[kind]) {
+                capacity[kind] = std::max(n, 2 * capacity[kind]);
+                for(auto& l: layers[kind])
+                    l.second->grow(capacity[kind]);
+            }
+        }
+
+        /** Set value i of the layers of the given kind to the default value. This is used when
+         the slot of a removed entity is reused. i must be less than the number of values held. */
+        void reset(GELAttribute::Kind kind, size_t i)
+        {
+            for(auto& l: layers[kind])
+                l.second->reset(i);
+        }
+
+        /// Remove the values of all layers. The layers themselves remain.
+        void clear()
+        {
+            for(int k = 0; k < 3; ++k) {
+                for(auto& l: layers[k])
+                    l.second->clear();
+                capacity[k] = 0;
+            }
+        }
+
+        /** Compact all layers. Afterwards the layers hold exactly one value per entity in the
+         compacted mesh. */
+        void cleanup(const IDRemap& map)
+        {
+            const size_t n[3] = {map.vmap.new_size(), map.fmap.new_size(), map.hmap.new_size()};
+            for(int k = 0; k < 3; ++k) {
+                for(auto& l: layers[k]) {
+                    l.second->cleanup(map);
+                    l.second->grow(n[k]);
+                }
+                capacity[k] = n[k];
+            }
+        }
+
+        /// Append descriptors of all layers that can be saved in the .gel format to attribs.
+        void describe(std::vector<GELAttribute>& attribs) const
+        {
+            for(int k = 0; k < 3; ++k)
+                for(auto& l: layers[k])
+                    l.second->describe(l.first, attribs);
+        }
+
+        /** Store a loaded attribute in the layer of that name. If there is a layer of the same
+         name and item size, its values are replaced. Otherwise, the attribute becomes a raw
+         layer which takes on a type when it is first accessed. */
+        void load(const std::string& name, GELAttribute::Kind kind, size_t item_size,
+                  const char* data, size_t n)
+        {
+            auto l = layers[kind].find(name);
+            if(l == layers[kind].end() || l->second->item_size() != item_size || !l->second->assign(data, n)) {
+                std::unique_ptr<AttributeLayer> raw(new RawAttributeLayer(kind, item_size));
+                raw->assign(data, n);
+                l = layers[kind].insert_or_assign(name, std::move(raw)).first;
+            }
+            l->second->grow(capacity[kind]);
+        }
+
+    private:
+        std::map<std::string, std::unique_ptr<AttributeLayer>> layers[3];
+        size_t capacity[3] = {0, 0, 0};
+    };
+}
+
+#endif
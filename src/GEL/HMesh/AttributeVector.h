@@ -14,8 +14,10 @@
 #define __HMESH_ATTRIBUTEVECTOR_H__
 
 #include <cassert>
+#include <type_traits>
 #include <vector>
-#include <map>
+#include "ItemVector.h"
+#include "../Util/Parallel.h"
 
 namespace HMesh 
 {
@@ -50,6 +52,13 @@ namespace HMesh
         }
 
 
+        /** reference to item given by ID. Unlike get, this never grows the vector, so the ID must
+         be less than size(). That always holds for the attribute layers owned by a Manifold. */
+        ITEM& unchecked(ITEMID id) {
+            assert(id.index < items.size());
+            return items[id.index];
+        }
+
         /// const reference to item given by ID
         const ITEM& operator [](ITEMID id) const {
             return get(id);
@@ -79,14 +88,21 @@ namespace HMesh
             items.clear();
         }
 
-        /// cleanup unused items from the vector, given by remap from associated container
-        void cleanup(const std::map<ITEMID, ITEMID>& remap) {
-            std::vector<ITEM> new_items(remap.size());
-            for(const auto& mapping : remap){
-                assert(mapping.second.index < remap.size());
-                if(mapping.first.index < items.size())
-                    new_items[mapping.second.index] = items[mapping.first.index];
-            }
+        /** cleanup unused items from the vector, given by remap from associated container. Items
+         of entities which were not in use are dropped and the rest are moved to their new IDs. Items
+         missing for entities in use get the default value. Large vectors are compacted in parallel. */
+        void cleanup(const IDRemapTable<typename ITEMID::EntityType>& remap) {
+            std::vector<ITEM> new_items(remap.new_size(), default_value);
+            const size_t n = std::min(items.size(), remap.size());
+            // the bits of a std::vector<bool> cannot be written from several threads
+            const size_t min_units = std::is_same<ITEM, bool>::value ? n+1 : 1 << 16;
+            Util::parallel_for_ranges(n, [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i) {
+                    ITEMID id_new = remap[ITEMID(i)];
+                    if(id_new != ITEMID())
+                        new_items[id_new.index] = items[i];
+                }
+            }, min_units);
             std::swap(items, new_items);
         }
 
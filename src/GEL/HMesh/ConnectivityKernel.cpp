@@ -5,45 +5,78 @@
  * ----------------------------------------------------------------------- */
 
 #include "ConnectivityKernel.h"
+#include "../Util/Parallel.h"
 
 namespace HMesh
 {
     using namespace std;
 
-    void ConnectivityKernel::cleanup(IDRemap& map)
+    namespace
     {
-        VertexID::IndexType vid = 0;
-        for(VertexID v = vertices.index_begin(); v != vertices.index_end(); v = vertices.index_next(v), ++vid)
-            map.vmap[v] = VertexID(vid);
-
-        FaceID::IndexType fid = 0;
-        for(FaceID f = faces.index_begin(); f != faces.index_end(); f = faces.index_next(f), ++fid)
-            map.fmap[f] = FaceID(fid);
+        /// Entities per task below which the kernel is not worth updating in parallel.
+        const size_t MIN_ENTITIES_PER_TASK = 1 << 16;
 
-        HalfEdgeID::IndexType hid = 0;
-        for(HalfEdgeID h = halfedges.index_begin(); h != halfedges.index_end(); h = halfedges.index_next(h), ++hid){
-            map.hmap[h] = HalfEdgeID(hid);
+#ifdef HMESH_COMPACT_KERNEL
+        /// Gather the entries of the entities in use into a new array, mapping each entry.
+        template<typename ITEM, typename T, typename Remap>
+        void compact_array(vector<T>& array, const IDRemapTable<ITEM>& hmap, const Remap& remap)
+        {
+            vector<T> new_array(hmap.new_size());
+            Util::parallel_for_ranges(array.size(), [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i) {
+                    ItemID<ITEM> h_new = hmap[ItemID<ITEM>(i)];
+                    if(h_new != ItemID<ITEM>())
+                        new_array[h_new.index] = remap[array[i]];
+                }
+            }, MIN_ENTITIES_PER_TASK);
+            swap(array, new_array);
         }
+#endif
+    }
+
+    void ConnectivityKernel::cleanup(IDRemap& map)
+    {
+        //1. compute the new IDs of the entities in use
+        vertices.cleanup_map(map.vmap);
+        faces.cleanup_map(map.fmap);
+        halfedges.cleanup_map(map.hmap);
 
         //2. update the connectivity kernel connectivity with the new locations
-        for(VertexID v = vertices.index_begin(); v != vertices.index_end(); v = vertices.index_next(v))
-            set_out(v, map.hmap[out(v)]);
-
-        for(FaceID f = faces.index_begin(); f != faces.index_end(); f = faces.index_next(f))
-            set_last(f, map.hmap[last(f)]);
-
-        for(HalfEdgeID h = halfedges.index_begin(); h != halfedges.index_end(); h = halfedges.index_next(h)){ 
-            // do not update holes
-            if(face(h) != InvalidFaceID)
-                set_face(h, map.fmap[face(h)]);
-            set_next(h, map.hmap[next(h)]);
-            set_prev(h, map.hmap[prev(h)]);
-            set_opp(h, map.hmap[opp(h)]);
-            set_vert(h, map.vmap[vert(h)]);
-        }
+        Util::parallel_for_ranges(vertices.allocated_size(), [&](size_t b, size_t e) {
+            for(VertexID v(b); v.index < e; ++v.index)
+                if(vertices.in_use(v))
+                    set_out(v, map.hmap[out(v)]);
+        }, MIN_ENTITIES_PER_TASK);
+
+        Util::parallel_for_ranges(faces.allocated_size(), [&](size_t b, size_t e) {
+            for(FaceID f(b); f.index < e; ++f.index)
+                if(faces.in_use(f))
+                    set_last(f, map.hmap[last(f)]);
+        }, MIN_ENTITIES_PER_TASK);
+
+#ifdef HMESH_COMPACT_KERNEL
+        //3. in the compact kernel, the halfedge arrays are remapped and compacted in one go
+        compact_array(he_next, map.hmap, map.hmap);
+        compact_array(he_prev, map.hmap, map.hmap);
+        compact_array(he_opp, map.hmap, map.hmap);
+        compact_array(he_vert, map.hmap, map.vmap);
+        compact_array(he_face, map.hmap, map.fmap);
+#else
+        // holes (invalid faces) map to invalid faces
+        Util::parallel_for_ranges(halfedges.allocated_size(), [&](size_t b, size_t e) {
+            for(HalfEdgeID h(b); h.index < e; ++h.index)
+                if(halfedges.in_use(h)) {
+                    set_face(h, map.fmap[face(h)]);
+                    set_next(h, map.hmap[next(h)]);
+                    set_prev(h, map.hmap[prev(h)]);
+                    set_opp(h, map.hmap[opp(h)]);
+                    set_vert(h, map.vmap[vert(h)]);
+                }
+        }, MIN_ENTITIES_PER_TASK);
+#endif
 
         vertices.cleanup();
         faces.cleanup();
         halfedges.cleanup();
     }
-}
\ No newline at end of file
+}
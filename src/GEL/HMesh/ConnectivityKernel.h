@@ -41,6 +41,11 @@ namespace HMesh
         HalfEdgeID last; 
     };
 
+#ifdef HMESH_COMPACT_KERNEL
+    /** The halfedge struct. In the compact kernel the IDs of next, previous, and opposite edges as well
+     as incident face and vertex are stored in separate arrays by the ConnectivityKernel. */
+    struct HalfEdge {};
+#else
     /// The halfedge struct. Contains IDs of next, previous, and opposite edges as well as incident face and vertex.
     struct HalfEdge
     {
@@ -50,6 +55,7 @@ namespace HMesh
         VertexID vert;
         FaceID face;
     };
+#endif
     
     
     typedef IDIterator<Vertex> VertexIDIterator;
@@ -60,11 +66,12 @@ namespace HMesh
     static const FaceID InvalidFaceID;
     static const HalfEdgeID InvalidHalfEdgeID;
     
-    typedef std::map<VertexID, VertexID> VertexIDRemap;
-    typedef std::map<FaceID, FaceID> FaceIDRemap;
-    typedef std::map<HalfEdgeID, HalfEdgeID> HalfEdgeIDRemap;
+    typedef IDRemapTable<Vertex> VertexIDRemap;
+    typedef IDRemapTable<Face> FaceIDRemap;
+    typedef IDRemapTable<HalfEdge> HalfEdgeIDRemap;
   
-    /// The IDRemap struct is just used for garbage collection.
+    /** The IDRemap struct is just used for garbage collection. It maps the IDs of vertices,
+     faces, and halfedges before a cleanup to their IDs after. */
     struct IDRemap
     {
         VertexIDRemap vmap;
@@ -103,7 +110,12 @@ namespace HMesh
 
     /** The connectivity kernel is basically an aggregate of ItemVectors for vertices, faces, and halfedges.
      This class contains no geometry information - only information about connectivitiy. Arguably it abstracts
-     away the implementation from the ConnectivityKernel class making it possible, for instance, to use a different kernel. */
+     away the implementation from the ConnectivityKernel class making it possible, for instance, to use a different kernel.
+
+     If HMESH_COMPACT_KERNEL is defined (the CMake option Use_compact_HMesh_kernel), IDs are 32 bit and the
+     halfedge connectivity is stored as a structure of arrays: one array each for next, prev, opp, vert,
+     and face. A halfedge then takes 20 bytes instead of 40, and a traversal such as circulation around a
+     vertex only pulls the fields it actually reads into the cache. */
     class ConnectivityKernel
     {
     public:
@@ -192,12 +204,29 @@ namespace HMesh
 
         /// clear the kernel
         void clear();
+
+        /// reserve space for the given total numbers of vertices, faces, and halfedges
+        void reserve(size_t nv, size_t nf, size_t nh);
+
+        /// turn reuse of the IDs of removed vertices, faces, and halfedges on or off
+        void set_slot_reuse(bool b);
+
+        /// returns true if the IDs of removed entities are reused
+        bool slot_reuse() const;
         
     private:
 
         ItemVector<Vertex> vertices;
         ItemVector<Face> faces;
         ItemVector<HalfEdge> halfedges;
+
+#ifdef HMESH_COMPACT_KERNEL
+        std::vector<HalfEdgeID> he_next;
+        std::vector<HalfEdgeID> he_prev;
+        std::vector<HalfEdgeID> he_opp;
+        std::vector<VertexID> he_vert;
+        std::vector<FaceID> he_face;
+#endif
     };
 
     inline VertexID ConnectivityKernel::add_vertex()
@@ -206,8 +235,31 @@ namespace HMesh
     inline FaceID ConnectivityKernel::add_face()
     { return faces.add(Face()); }
 
+#ifdef HMESH_COMPACT_KERNEL
+    inline HalfEdgeID ConnectivityKernel::add_halfedge()
+    {
+        HalfEdgeID h = halfedges.add(HalfEdge());
+        if(h.index == he_next.size()) {
+            he_next.push_back(InvalidHalfEdgeID);
+            he_prev.push_back(InvalidHalfEdgeID);
+            he_opp.push_back(InvalidHalfEdgeID);
+            he_vert.push_back(InvalidVertexID);
+            he_face.push_back(InvalidFaceID);
+        }
+        else {
+            // a reused slot
+            he_next[h.index] = InvalidHalfEdgeID;
+            he_prev[h.index] = InvalidHalfEdgeID;
+            he_opp[h.index] = InvalidHalfEdgeID;
+            he_vert[h.index] = InvalidVertexID;
+            he_face[h.index] = InvalidFaceID;
+        }
+        return h;
+    }
+#else
     inline HalfEdgeID ConnectivityKernel::add_halfedge()
     { return halfedges.add(HalfEdge()); }
+#endif
 
     inline void ConnectivityKernel::remove_vertex(VertexID id)
     { vertices.remove(id); }
@@ -219,6 +271,37 @@ namespace HMesh
     { halfedges.remove(id); }
 
 
+#ifdef HMESH_COMPACT_KERNEL
+    inline HalfEdgeID ConnectivityKernel::next(HalfEdgeID id) const
+    { assert(id.index < he_next.size()); return he_next[id.index]; }
+
+    inline HalfEdgeID ConnectivityKernel::prev(HalfEdgeID id) const
+    { assert(id.index < he_prev.size()); return he_prev[id.index]; }
+
+    inline HalfEdgeID ConnectivityKernel::opp(HalfEdgeID id) const
+    { assert(id.index < he_opp.size()); return he_opp[id.index]; }
+
+    inline VertexID ConnectivityKernel::vert(HalfEdgeID id) const
+    { assert(id.index < he_vert.size()); return he_vert[id.index]; }
+
+    inline FaceID ConnectivityKernel::face(HalfEdgeID id) const
+    { assert(id.index < he_face.size()); return he_face[id.index]; }
+
+    inline void ConnectivityKernel::set_next(HalfEdgeID id, HalfEdgeID next)
+    { assert(id.index < he_next.size()); he_next[id.index] = next; }
+
+    inline void ConnectivityKernel::set_prev(HalfEdgeID id, HalfEdgeID prev)
+    { assert(id.index < he_prev.size()); he_prev[id.index] = prev; }
+
+    inline void ConnectivityKernel::set_opp(HalfEdgeID id, HalfEdgeID opp)
+    { assert(id.index < he_opp.size()); he_opp[id.index] = opp; }
+
+    inline void ConnectivityKernel::set_vert(HalfEdgeID id, VertexID vert)
+    { assert(id.index < he_vert.size()); he_vert[id.index] = vert; }
+
+    inline void ConnectivityKernel::set_face(HalfEdgeID id, FaceID face)
+    { assert(id.index < he_face.size()); he_face[id.index] = face; }
+#else
     inline HalfEdgeID ConnectivityKernel::next(HalfEdgeID id) const
     { return halfedges[id].next; }
 
@@ -228,12 +311,6 @@ namespace HMesh
     inline HalfEdgeID ConnectivityKernel::opp(HalfEdgeID id) const
     { return halfedges[id].opp; }
 
-    inline HalfEdgeID ConnectivityKernel::out(VertexID id) const
-    { return vertices[id].out; }
-
-    inline HalfEdgeID ConnectivityKernel::last(FaceID id) const
-    { return faces[id].last; }
-
     inline VertexID ConnectivityKernel::vert(HalfEdgeID id) const
     { return halfedges[id].vert; }
 
@@ -249,17 +326,24 @@ namespace HMesh
     inline void ConnectivityKernel::set_opp(HalfEdgeID id, HalfEdgeID opp)
     {halfedges[id].opp = opp; }
 
-    inline void ConnectivityKernel::set_out(VertexID id, HalfEdgeID out)
-    { vertices[id].out = out; }
-
-    inline void ConnectivityKernel::set_last(FaceID id, HalfEdgeID last)
-    { faces[id].last = last; }
-
     inline void ConnectivityKernel::set_vert(HalfEdgeID id, VertexID vert)
     { halfedges[id].vert = vert; }
 
     inline void ConnectivityKernel::set_face(HalfEdgeID id, FaceID face)
     { halfedges[id].face = face; }
+#endif
+
+    inline HalfEdgeID ConnectivityKernel::out(VertexID id) const
+    { return vertices[id].out; }
+
+    inline HalfEdgeID ConnectivityKernel::last(FaceID id) const
+    { return faces[id].last; }
+
+    inline void ConnectivityKernel::set_out(VertexID id, HalfEdgeID out)
+    { vertices[id].out = out; }
+
+    inline void ConnectivityKernel::set_last(FaceID id, HalfEdgeID last)
+    { faces[id].last = last; }
 
 
 
@@ -315,7 +399,38 @@ namespace HMesh
         vertices.clear();
         faces.clear();
         halfedges.clear();
+#ifdef HMESH_COMPACT_KERNEL
+        he_next.clear();
+        he_prev.clear();
+        he_opp.clear();
+        he_vert.clear();
+        he_face.clear();
+#endif
     }
+
+    inline void ConnectivityKernel::reserve(size_t nv, size_t nf, size_t nh)
+    {
+        vertices.reserve(nv);
+        faces.reserve(nf);
+        halfedges.reserve(nh);
+#ifdef HMESH_COMPACT_KERNEL
+        he_next.reserve(nh);
+        he_prev.reserve(nh);
+        he_opp.reserve(nh);
+        he_vert.reserve(nh);
+        he_face.reserve(nh);
+#endif
+    }
+
+    inline void ConnectivityKernel::set_slot_reuse(bool b)
+    {
+        vertices.set_slot_reuse(b);
+        faces.set_slot_reuse(b);
+        halfedges.set_slot_reuse(b);
+    }
+
+    inline bool ConnectivityKernel::slot_reuse() const
+    { return halfedges.slot_reuse(); }
 }
 
 #endif
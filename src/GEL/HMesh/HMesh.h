@@ -8,14 +8,21 @@
 #include "cleanup.h"
 #include "curvature.h"
 #include "dual.h"
+#include "gel_load.h"
+#include "gel_save.h"
+#include "geodesics.h"
+#include "implicit_fairing.h"
+#include "isotropic_remesh.h"
 #include "load.h"
 #include "mesh_optimization.h"
 #include "obj_load.h"
 #include "obj_save.h"
 #include "off_load.h"
 #include "off_save.h"
+#include "parallel_for.h"
 #include "ply_load.h"
 #include "polygonize.h"
+#include "progressive_mesh.h"
 #include "quadric_simplify.h"
 #include "refine_edges.h"
 #include "smooth.h"
@@ -13,17 +13,25 @@
 #ifndef __HMESH_ITEMID_H__
 #define __HMESH_ITEMID_H__
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 
 namespace HMesh
 {
     /** The ItemID class is simply a wrapper around an index. This class associates a type
-     with the index. */
+     with the index. If GEL is compiled with HMESH_COMPACT_KERNEL defined, the index is 32 bit
+     which halves the size of the connectivity kernel, but limits a mesh to 2^32-1 entities of
+     each kind. */
     template<typename T>
     class ItemID
     {
     public:
+#ifdef HMESH_COMPACT_KERNEL
+        typedef uint32_t IndexType;
+#else
         typedef size_t IndexType;
+#endif
         typedef T EntityType;
 
         ItemID(): index(INVALID_INDEX){}
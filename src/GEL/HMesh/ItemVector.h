@@ -11,16 +11,99 @@
 #ifndef __HMESH_ITEMVECTOR_H__
 #define __HMESH_ITEMVECTOR_H__
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 #include "ItemID.h"
+#include "../Util/Parallel.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace HMesh
 {
+    /// Index of the lowest set bit of a non-zero word.
+    inline int lowest_bit(uint64_t w)
+    {
+        assert(w != 0);
+#ifdef _MSC_VER
+        unsigned long i;
+        _BitScanForward64(&i, w);
+        return int(i);
+#else
+        return __builtin_ctzll(w);
+#endif
+    }
+
+    /// Index of the highest set bit of a non-zero word.
+    inline int highest_bit(uint64_t w)
+    {
+        assert(w != 0);
+#ifdef _MSC_VER
+        unsigned long i;
+        _BitScanReverse64(&i, w);
+        return int(i);
+#else
+        return 63 - __builtin_clzll(w);
+#endif
+    }
+
+    /// Number of set bits in a word.
+    inline int count_bits(uint64_t w)
+    {
+#ifdef _MSC_VER
+        return int(__popcnt64(w));
+#else
+        return __builtin_popcountll(w);
+#endif
+    }
+
+    template<typename ITEM> class ItemVector;
+
+    /** Maps the IDs that entities had before a cleanup to the IDs they have after. The map is
+     a dense array indexed by the old ID, so a lookup is a single load. Removed entities, and
+     invalid IDs, map to an invalid ID. */
+    template<typename ITEM>
+    class IDRemapTable
+    {
+    public:
+        typedef ItemID<ITEM> IDType;
+
+        /// The ID after cleanup of the entity which had the ID id before.
+        IDType operator[](IDType id) const
+        { return id.index < new_ids.size() ? new_ids[id.index] : IDType(); }
+
+        /// Number of IDs before cleanup, i.e. the number of entities allocated at the time.
+        size_t size() const { return new_ids.size(); }
+
+        /// Number of entities after cleanup.
+        size_t new_size() const { return no_new_ids; }
+
+    private:
+        friend class ItemVector<ITEM>;
+        std::vector<IDType> new_ids;
+        size_t no_new_ids = 0;
+    };
+
     /** The ItemVector is a vector of mesh entities.
         An ItemVector is a layer on top of the regular vector class which keeps
         track of the unused elements in a vector. This allows for garbage collection.
         ItemVector is used for storing vectors of Face, HalfEdge, and Vertex type.
+        If ITEM is an empty type, nothing is stored apart from the record of which entities
+        are in use. The data is then kept elsewhere, indexed by the IDs handed out by the
+        ItemVector.
+
+        Whether an entity is in use is recorded in a bitmap of 64 bit words. Skipping unused
+        entities thus costs a single instruction per word, and iterating over the entities
+        in use after most have been removed takes time proportional to the number in use
+        plus the number of words.
+
+        By default, add always appends. If slot reuse is turned on, the slots of removed
+        entities are kept on a free list, and add fills the most recently freed slot before
+        growing the vector. Repeated removal and addition then no longer makes the vector grow.
      */
     template<typename ITEM>
     class ItemVector
@@ -47,9 +130,13 @@ namespace HMesh
         /// remove an entity from kernel - entity is NOT erased!
         void remove(IDType i);
 
-        /// erase unused entities from the kernel
+        /** Erase unused entities from the kernel. The entities in use keep their order and are
+         numbered consecutively from zero. Large vectors are compacted in parallel. */
         void cleanup();
 
+        /// Compute the map from the current IDs to the IDs which cleanup will assign.
+        void cleanup_map(IDRemapTable<ITEM>& map) const;
+
         /// active size of vector
         size_t size() const;
 
@@ -59,6 +146,16 @@ namespace HMesh
         /// Clear the kernel
         void clear();
 
+        /// Reserve space for n entities in total without changing the size
+        void reserve(size_t n);
+
+        /** Turn reuse of the slots of removed entities on or off. Turning it on puts all
+         slots that are currently unused on the free list. */
+        void set_slot_reuse(bool b);
+
+        /// Returns true if the slots of removed entities are reused.
+        bool slot_reuse() const { return reuse_slots; }
+
         /// Check if entity i is used
         bool in_use(IDType i) const;
 
@@ -74,20 +171,63 @@ namespace HMesh
         /// get the previous index (default: skip to first active index)
         IDType index_prev(IDType index, bool skip = true) const;
 
+        /** Call f with the ID of every entity in use, in order. This visits a whole word of
+         the bitmap at a time and is the fastest way to go through all entities. */
+        template<typename Func>
+        void for_each_active(Func&& f) const;
+
+        /** Call f(begin, end) for every maximal range [begin, end) of consecutive indices of
+         entities in use, in order. Useful for handing out blocks of work or bulk copying. */
+        template<typename Func>
+        void for_each_active_range(Func&& f) const;
+
     private:
 
+        /// True if the items carry no data and only the active flags need to be stored.
+        static constexpr bool liveness_only = std::is_empty<ITEM>::value;
+
+        /// Index of the first entity in use at or after i. Returns size_allocated if none.
+        size_t find_active(size_t i) const;
+
+        /// Index of the last entity in use at or before i. Returns size_allocated if none.
+        size_t find_active_backwards(size_t i) const;
+
+        /// Set the bits of the entities [0, n) and clear the rest.
+        void set_all_active(size_t n);
+
+        /** Split the bitmap into T tasks of consecutive words and return the number of entities
+         in use before the first word of each task. The last of the T+1 entries is size(). */
+        std::vector<size_t> task_offsets(size_t T) const;
+
+        /// number of entities below which cleanup does not bother with threads
+        static const size_t PARALLEL_CLEANUP_SIZE = 1 << 16;
+
+        /// number of entities in use - the population count of the bitmap
         size_t size_active;
+
+        /// number of entities including those that are not in use
+        size_t size_allocated;
+
         std::vector<ITEM> items;
 
-        /// Memory consideration - objects flagged as unused should be remembered for future use (unless purged)
-        std::vector<bool> active_items;
+        /** One bit per entity which is set if the entity is in use. Memory consideration -
+         objects flagged as unused should be remembered for future use (unless purged). Bits
+         past size_allocated are always zero. */
+        std::vector<uint64_t> active_words;
+
+        /// whether add takes slots from the free list
+        bool reuse_slots = false;
+
+        /// unused slots in the order they were freed. Only maintained if reuse_slots is true.
+        std::vector<typename IDType::IndexType> free_slots;
     };
 
     template<typename ITEM>
     inline ItemVector<ITEM>::ItemVector(size_t _size, ITEM i) 
         :   size_active(_size), 
-            items(_size, i), 
-            active_items(_size, true){}
+            size_allocated(_size),
+            items(liveness_only ? 0 : _size, i)
+    { set_all_active(_size); }
 
     template<typename ITEM>
     inline ITEM& ItemVector<ITEM>::get(IDType id)
@@ -120,32 +260,91 @@ namespace HMesh
     template<typename ITEM>
     inline typename ItemVector<ITEM>::IDType ItemVector<ITEM>::add(const ITEM& item)
     {
-        items.push_back(item);
-        active_items.push_back(true);
+        size_t i;
+        if(!free_slots.empty()) {
+            i = free_slots.back();
+            free_slots.pop_back();
+            if constexpr(!liveness_only)
+                items[i] = item;
+        }
+        else {
+            assert(size_allocated < size_t(IDType::INVALID_INDEX));
+            if constexpr(!liveness_only)
+                items.push_back(item);
+            i = size_allocated++;
+            if(i % 64 == 0)
+                active_words.push_back(0);
+        }
+        active_words[i/64] |= uint64_t(1) << (i%64);
         ++size_active;
-        return IDType(items.size() - 1);
+        return IDType(i);
     }
 
     template<typename ITEM>
     inline void ItemVector<ITEM>::remove(typename ItemVector<ITEM>::IDType id)
     {
-        if(active_items[id.index]){
+        assert(id.index < size_allocated);
+        const uint64_t bit = uint64_t(1) << (id.index%64);
+        uint64_t& w = active_words[id.index/64];
+        if(w & bit){
             --size_active;
-            active_items[id.index] = false;
+            w &= ~bit;
+            if(reuse_slots)
+                free_slots.push_back(id.index);
         }
     }
 
     template<typename ITEM>
     inline void ItemVector<ITEM>::cleanup()
     {
-        std::vector<ITEM> new_items;
-        for(size_t i = 0; i < items.size(); ++i){
-            if(active_items[i]) 
-                new_items.push_back(items[i]);          
+        if constexpr(!liveness_only) {
+            const size_t W = active_words.size();
+            const size_t T = Util::no_tasks(size_allocated, PARALLEL_CLEANUP_SIZE);
+            const std::vector<size_t> offsets = task_offsets(T);
+            std::vector<ITEM> new_items(size_active);
+            Util::parallel_tasks(T, [&](size_t t) {
+                size_t j = offsets[t];
+                for(size_t wi = Util::task_begin(t, T, W); wi < Util::task_begin(t+1, T, W); ++wi)
+                    for(uint64_t w = active_words[wi]; w != 0; w &= w - 1)
+                        new_items[j++] = items[wi*64 + lowest_bit(w)];
+            });
+            std::swap(items, new_items);
         }
-        std::swap(items, new_items);
-        active_items = std::vector<bool>(items.size(), true);
-        size_active = items.size();
+        size_allocated = size_active;
+        set_all_active(size_active);
+        free_slots.clear();
+    }
+
+    template<typename ITEM>
+    inline std::vector<size_t> ItemVector<ITEM>::task_offsets(size_t T) const
+    {
+        const size_t W = active_words.size();
+        std::vector<size_t> offsets(T+1, 0);
+        Util::parallel_tasks(T, [&](size_t t) {
+            size_t cnt = 0;
+            for(size_t wi = Util::task_begin(t, T, W); wi < Util::task_begin(t+1, T, W); ++wi)
+                cnt += count_bits(active_words[wi]);
+            offsets[t+1] = cnt;
+        });
+        for(size_t t = 0; t < T; ++t)
+            offsets[t+1] += offsets[t];
+        return offsets;
+    }
+
+    template<typename ITEM>
+    inline void ItemVector<ITEM>::cleanup_map(IDRemapTable<ITEM>& map) const
+    {
+        const size_t W = active_words.size();
+        const size_t T = Util::no_tasks(size_allocated, PARALLEL_CLEANUP_SIZE);
+        const std::vector<size_t> offsets = task_offsets(T);
+        map.new_ids.assign(size_allocated, IDType());
+        map.no_new_ids = size_active;
+        Util::parallel_tasks(T, [&](size_t t) {
+            size_t j = offsets[t];
+            for(size_t wi = Util::task_begin(t, T, W); wi < Util::task_begin(t+1, T, W); ++wi)
+                for(uint64_t w = active_words[wi]; w != 0; w &= w - 1)
+                    map.new_ids[wi*64 + lowest_bit(w)] = IDType(j++);
+        });
     }
 
     template<typename ITEM>
@@ -154,56 +353,111 @@ namespace HMesh
 
     template<typename ITEM>
     inline size_t ItemVector<ITEM>::allocated_size() const
-    { return items.size(); }
+    { return size_allocated; }
 
     template<typename ITEM>
     inline void ItemVector<ITEM>::clear()
     {
         items.clear();
-        active_items.clear();
+        active_words.clear();
+        free_slots.clear();
         size_active = 0;
+        size_allocated = 0;
+    }
+
+    template<typename ITEM>
+    inline void ItemVector<ITEM>::reserve(size_t n)
+    {
+        if constexpr(!liveness_only)
+            items.reserve(n);
+        active_words.reserve((n+63)/64);
+    }
+
+    template<typename ITEM>
+    inline void ItemVector<ITEM>::set_slot_reuse(bool b)
+    {
+        reuse_slots = b;
+        free_slots.clear();
+        if(!b)
+            return;
+        // Push the unused slots from the back, so the lowest index is handed out first.
+        for(size_t wi = active_words.size(); wi-- > 0;) {
+            uint64_t w = ~active_words[wi];
+            if(wi == active_words.size()-1 && size_allocated%64)
+                w &= ~uint64_t(0) >> (64 - size_allocated%64);
+            for(; w != 0; w &= ~(uint64_t(1) << highest_bit(w)))
+                free_slots.push_back(typename IDType::IndexType(wi*64 + highest_bit(w)));
+        }
     }
 
     template<typename ITEM>
     inline bool ItemVector<ITEM>::in_use(typename ItemVector<ITEM>::IDType id) const
     {
-        if(id.index < active_items.size())
-			return active_items[id.index];
-		return false;
+        if(id.index < size_allocated)
+            return (active_words[id.index/64] >> (id.index%64)) & 1;
+        return false;
     }
 
     template<typename ITEM>
-    inline typename ItemVector<ITEM>::IDType ItemVector<ITEM>::index_begin(bool skip) const
+    inline size_t ItemVector<ITEM>::find_active(size_t i) const
     {
-        size_t i = 0;
+        if(i >= size_allocated)
+            return size_allocated;
+        size_t wi = i/64;
+        uint64_t w = active_words[wi] & (~uint64_t(0) << (i%64));
+        while(w == 0) {
+            if(++wi == active_words.size())
+                return size_allocated;
+            w = active_words[wi];
+        }
+        return wi*64 + lowest_bit(w);
+    }
 
-        if(!skip)
-            return IDType(i);
-        
-        while(i < active_items.size() && !active_items[i])
-            ++i;
+    template<typename ITEM>
+    inline size_t ItemVector<ITEM>::find_active_backwards(size_t i) const
+    {
+        if(i >= size_allocated)
+            return size_allocated;
+        size_t wi = i/64;
+        uint64_t w = active_words[wi] & (~uint64_t(0) >> (63 - i%64));
+        while(w == 0) {
+            if(wi-- == 0)
+                return size_allocated;
+            w = active_words[wi];
+        }
+        return wi*64 + highest_bit(w);
+    }
 
+    template<typename ITEM>
+    inline void ItemVector<ITEM>::set_all_active(size_t n)
+    {
+        active_words.assign((n+63)/64, ~uint64_t(0));
+        if(n%64)
+            active_words.back() = ~uint64_t(0) >> (64 - n%64);
+    }
 
-        return IDType(i);
+    template<typename ITEM>
+    inline typename ItemVector<ITEM>::IDType ItemVector<ITEM>::index_begin(bool skip) const
+    {
+        if(!skip)
+            return IDType(0);
+        return IDType(find_active(0));
     }
 
     template<typename ITEM>
     inline typename ItemVector<ITEM>::IDType ItemVector<ITEM>::index_end() const
-    { return IDType(items.size()); }
+    { return IDType(size_allocated); }
 
     template<typename ITEM>
     inline typename ItemVector<ITEM>::IDType ItemVector<ITEM>::index_next(typename ItemVector<ITEM>::IDType id, bool skip) const
     {
-        if(id.index < items.size())
+        if(id.index < size_allocated)
             ++id.index;
 
         if(!skip)
-            return IDType(id);
-
-        while(id.index < items.size() && !active_items[id.index])
-           ++id.index;
+            return id;
 
-        return id;
+        return IDType(find_active(id.index));
     }
 
     template<typename ITEM>
@@ -215,12 +469,37 @@ namespace HMesh
         if(!skip)
             return id;
 
-        while(!active_items[id.index] && id.index > 0)
-            --id.index;
+        // as always, we stop at the first index if no entity before id is in use
+        size_t i = find_active_backwards(id.index);
+        return IDType(i < size_allocated ? i : 0);
+    }
+
+    template<typename ITEM>
+    template<typename Func>
+    inline void ItemVector<ITEM>::for_each_active(Func&& f) const
+    {
+        for(size_t wi = 0; wi < active_words.size(); ++wi)
+            for(uint64_t w = active_words[wi]; w != 0; w &= w - 1)
+                f(IDType(wi*64 + lowest_bit(w)));
+    }
 
-        return id;
+    template<typename ITEM>
+    template<typename Func>
+    inline void ItemVector<ITEM>::for_each_active_range(Func&& f) const
+    {
+        size_t b = find_active(0);
+        while(b < size_allocated) {
+            // the range ends at the first unused entity after b
+            size_t wi = b/64;
+            uint64_t w = ~active_words[wi] & (~uint64_t(0) << (b%64));
+            while(w == 0 && ++wi < active_words.size())
+                w = ~active_words[wi];
+            const size_t e = w == 0 ? size_allocated : std::min(size_allocated, wi*64 + lowest_bit(w));
+            f(b, e);
+            b = find_active(e);
+        }
     }
 
 }
 
-#endif 
+#endif
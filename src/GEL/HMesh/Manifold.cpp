@@ -12,7 +12,6 @@
 #include "../Geometry/TriMesh.h"
 #include "../Geometry/bounding_sphere.h"
 #include "Manifold.h"
-#include "cleanup.h"
 
 namespace HMesh
 {
@@ -38,7 +37,7 @@ namespace HMesh
         int N = points.size();
         vector<VertexID> vertices(N);
         for(size_t i=0;i<points.size(); ++i) {
-            vertices[i]=kernel.add_vertex();
+            vertices[i]=new_vertex();
             pos(vertices[i]) = points[i];
         }
         vector<Edge> edges(N);
@@ -47,8 +46,8 @@ namespace HMesh
             VertexID v1 = vertices[(i+1)%points.size()];
 
             Edge& e = edges[i];
-            e.h0 = kernel.add_halfedge();
-            e.h1 = kernel.add_halfedge();
+            e.h0 = new_halfedge();
+            e.h1 = new_halfedge();
             e.count = 1;
             
             // glue operation: 1 edge = 2 glued halfedges
@@ -61,7 +60,7 @@ namespace HMesh
             kernel.set_out(vertices[(i+1)%N], edges[i].h1);
         }
 
-        FaceID fid = kernel.add_face();
+        FaceID fid = new_face();
         for(size_t i=0;i<N; ++i) {
             kernel.set_face(edges[i].h0, fid);
             kernel.set_face(edges[i].h1, InvalidFaceID);
@@ -149,9 +148,9 @@ namespace HMesh
             return false;
     
         vector<FaceID> faces;
-        int N = circulate_vertex_ccw(*this, vid, static_cast<std::function<void(FaceID)>>([&](FaceID f) {
+        int N = circulate_vertex_ccw(*this, vid, [&](FaceID f) {
             faces.push_back(f);
-        }));
+        });
         for(size_t i=0;i<N;++i)
             remove_face(faces[i]);
             
@@ -243,7 +242,7 @@ namespace HMesh
 		
         // create a new halfedge ha which connects v1 and v0 closing the first loop.
         HalfEdgeID h1 = kernel.next(h);
-        HalfEdgeID ha = kernel.add_halfedge();
+        HalfEdgeID ha = new_halfedge();
         link(h, ha);
         link(ha, h0);
         kernel.set_face(ha, f);
@@ -252,7 +251,7 @@ namespace HMesh
 		
         // create a new face, f2, and set all halfedges in the remaining part of the polygon to point to this face.
         h = h1;
-        FaceID f2 = kernel.add_face();
+        FaceID f2 = new_face();
         while(kernel.vert(h) != v0){
             kernel.set_face(h, f2);
             h = kernel.next(h);
@@ -261,7 +260,7 @@ namespace HMesh
         assert(h != h1);
 		
         // create a new halfedge hb to connect v0 and v1.
-        HalfEdgeID hb = kernel.add_halfedge();
+        HalfEdgeID hb = new_halfedge();
         link(h, hb);
         link(hb, h1);
         kernel.set_face(hb, f2);
@@ -298,7 +297,7 @@ namespace HMesh
 		
         p /= steps;
 		
-        VertexID v = kernel.add_vertex();
+        VertexID v = new_vertex();
         positions[v]  = p;
 		
         //circulate the face, create halfedges and connect to vertex
@@ -310,10 +309,10 @@ namespace HMesh
         do{
             HalfEdgeID hn = kernel.next(he);
 			
-            HalfEdgeID ho = kernel.add_halfedge();
-            HalfEdgeID hi = kernel.add_halfedge();
+            HalfEdgeID ho = new_halfedge();
+            HalfEdgeID hi = new_halfedge();
 			
-            FaceID fn = kernel.add_face();
+            FaceID fn = new_face();
             kernel.set_face(hi, fn);
             kernel.set_vert(hi, v);
             kernel.set_face(ho, fn);
@@ -351,13 +350,13 @@ namespace HMesh
         VertexID vo = kernel.vert(ho);
 		
         //create the new vertex with middle of edge as position and update connectivity
-        VertexID vn = kernel.add_vertex();
+        VertexID vn = new_vertex();
         positions[vn] = .5f * (positions[v] + positions[vo]);
         kernel.set_out(vn, h);
 		
         //create two necessary halfedges, and update connectivity
-        HalfEdgeID hn = kernel.add_halfedge();
-        HalfEdgeID hno = kernel.add_halfedge();
+        HalfEdgeID hn = new_halfedge();
+        HalfEdgeID hno = new_halfedge();
 		
         kernel.set_out(vo, hn);
         kernel.set_out(v, hno);
@@ -391,15 +390,15 @@ namespace HMesh
     {
         // get the one-ring of v0
         vector<VertexID> link0;
-        circulate_vertex_ccw(m, v0, static_cast<std::function<void(VertexID)>>([&](VertexID vn) {
+        circulate_vertex_ccw(m, v0, [&](VertexID vn) {
             link0.emplace_back(vn);
-        }));
+        });
 		
         // get the one-ring of v1
         vector<VertexID> link1;
-        circulate_vertex_ccw(m, v1, static_cast<std::function<void(VertexID)>>([&](VertexID vn) {
+        circulate_vertex_ccw(m, v1, [&](VertexID vn) {
             link1.emplace_back(vn);
-        }));
+        });
 		
         // sort the vertices of the two rings
         sort(link0.begin(), link0.end());
@@ -457,14 +456,14 @@ namespace HMesh
             
             
             if(v0b != v0a)
-                circulate_vertex_ccw(*this, v0b, static_cast<std::function<void(Walker&)>>([&](Walker& hew) {
+                circulate_vertex_ccw(*this, v0b, [&](Walker& hew) {
                     kernel.set_vert(hew.opp().halfedge(), v0a);
-                }));
+                });
             
             if(v1b != v1a)
-                circulate_vertex_ccw(*this, v1b, static_cast<std::function<void(Walker&)>>([&](Walker& hew) {
+                circulate_vertex_ccw(*this, v1b, [&](Walker& hew) {
                     kernel.set_vert(hew.opp().halfedge(), v1a);
-                }));
+                });
             
             if(v0a != v0b)
             {
@@ -664,7 +663,7 @@ namespace HMesh
         
         // Create a new face for the merged one ring and link up all the halfedges
         // in the loop
-        FaceID f = kernel.add_face();
+        FaceID f = new_face();
         kernel.set_last(f,loop[0]);
         for(size_t i=0;i<loop.size(); ++i)
         {
@@ -729,7 +728,7 @@ namespace HMesh
     {
         // invalid face is a hole
         if(kernel.face(h) == InvalidFaceID){
-            FaceID f = kernel.add_face();
+            FaceID f = new_face();
             kernel.set_last(f, h);
             do{
                 kernel.set_face(h, f);
@@ -757,7 +756,7 @@ namespace HMesh
             return InvalidVertexID;
         
         // Slitting always creates a new vertex.
-        VertexID v_new = kernel.add_vertex();
+        VertexID v_new = new_vertex();
         pos(v_new) = pos(v);
         
         // Go counter clockwise from h_out to h_in. Set all
@@ -775,11 +774,11 @@ namespace HMesh
         {
             // Create two boundary edges that form a wedge between
             // h_in and h_in_opp -- if h_in_opp is not boundary
-            h_new_in = kernel.add_halfedge();
+            h_new_in = new_halfedge();
             kernel.set_face(h_new_in, InvalidFaceID);
             glue(h_in_opp, h_new_in);
             
-            h_new_in_opp = kernel.add_halfedge();
+            h_new_in_opp = new_halfedge();
             kernel.set_face(h_new_in_opp, InvalidFaceID);
             glue(h_in, h_new_in_opp);
             
@@ -802,11 +801,11 @@ namespace HMesh
         {
             // Create two boundary edges that for a wedge between
             // h_out and h_out_opp -- if h_out_opp is not boundary
-            h_new_out = kernel.add_halfedge();
+            h_new_out = new_halfedge();
             kernel.set_face(h_new_out, InvalidFaceID);
             glue(h_out_opp, h_new_out);
             
-            h_new_out_opp = kernel.add_halfedge();
+            h_new_out_opp = new_halfedge();
             kernel.set_face(h_new_out_opp, InvalidFaceID);
             glue(h_out, h_new_out_opp);
 
@@ -940,11 +939,11 @@ namespace HMesh
         map<VertexID,VertexID> vmap;
         
         for(auto v: mergee.vertices())
-            vmap[v] = kernel.add_vertex();
+            vmap[v] = new_vertex();
         for(auto h: mergee.halfedges())
-            hmap[h] = kernel.add_halfedge();
+            hmap[h] = new_halfedge();
         for(auto f: mergee.faces())
-            fmap[f] = kernel.add_face();
+            fmap[f] = new_face();
  
         for(auto f: mergee.faces()) {
             auto f_new = fmap[f];
@@ -1014,8 +1013,8 @@ namespace HMesh
         vector<HalfEdgeID> new_halfedges_opp(N);
         for(size_t i=0;i<N; ++i)
         {
-            new_halfedges[i] = kernel.add_halfedge();
-            new_halfedges_opp[i] = kernel.add_halfedge();
+            new_halfedges[i] = new_halfedge();
+            new_halfedges_opp[i] = new_halfedge();
             glue(new_halfedges[i], new_halfedges_opp[i]);
             kernel.set_vert(new_halfedges[i], pairs[i].second);
             kernel.set_vert(new_halfedges_opp[i], pairs[i].first);
@@ -1052,7 +1051,7 @@ namespace HMesh
         for(size_t i=0;i<N; ++i)
         {
             HalfEdgeID last = new_halfedges[i];
-            FaceID f = kernel.add_face();
+            FaceID f = new_face();
             kernel.set_last(f, last);
             HalfEdgeID h = last;
             do
@@ -1074,33 +1073,174 @@ namespace HMesh
      * Namespace functions
      ***************************************************/
         
-    template<typename size_type, typename float_type, typename int_type>
-    VertexAttributeVector<int_type> build_template(Manifold& m, size_type no_vertices,
+    template<typename float_type, typename int_type>
+    VertexAttributeVector<int> build_template(Manifold& m, size_t no_vertices,
                                   const float_type* vertvec,
-                                  size_type no_faces,
+                                  size_t no_faces,
                                   const int_type* facevec,
-                                  const int_type* indices)
+                                  const int_type* indices,
+                                  vector<HalfEdgeID>& non_manifold_halfedges)
     {
-        int k=0;
-        VertexAttributeVector<int> cluster_id;
-        for(int i=0;i<no_faces;++i) {
-            vector<Vec3d> pts(facevec[i]);
-            for(int j=0;j<facevec[i]; ++j) {
-                const float_type* v = &vertvec[3*indices[j+k]];
-                pts[j] = Vec3d(v[0],v[1],v[2]);
+        ConnectivityKernel& kernel = m.kernel;
+        non_manifold_halfedges.clear();
+        
+        // Nothing is added to m if a face size is negative or an index does not refer to
+        // one of the no_vertices points. An empty map is returned instead.
+        size_t no_indices = 0;
+        for(size_t i=0;i<no_faces;++i) {
+            if(facevec[i] < 0)
+                return VertexAttributeVector<int>(-1);
+            no_indices += facevec[i];
+        }
+        for(size_t k=0;k<no_indices;++k)
+            if(indices[k] < 0 || size_t(indices[k]) >= no_vertices)
+                return VertexAttributeVector<int>(-1);
+        
+        // Every face corner becomes the halfedge leaving that corner. face_start[i] is the
+        // index of the first corner of face i and also the offset of its first halfedge.
+        vector<size_t> face_start(no_faces+1, 0);
+        for(size_t i=0;i<no_faces;++i)
+            face_start[i+1] = face_start[i] + facevec[i];
+        const size_t no_corners = face_start[no_faces];
+        
+        // New entities are appended, so the IDs created here are offset by what is already there.
+        // The slots of removed entities are not reused while building for that reason.
+        const bool reuse = m.id_reuse();
+        m.set_id_reuse(false);
+        const size_t h_off = kernel.allocated_halfedges();
+        kernel.reserve(kernel.allocated_vertices() + no_vertices,
+                       kernel.allocated_faces() + no_faces,
+                       h_off + 2 * no_corners);
+        auto hid = [h_off](size_t k) {return HalfEdgeID(h_off + k);};
+        
+        // Create faces and the face loops of halfedges. The vertex of each halfedge is
+        // assigned later since a point may become several vertices.
+        for(size_t k=0;k<no_corners;++k)
+            kernel.add_halfedge();
+        for(size_t i=0;i<no_faces;++i) {
+            size_t n = facevec[i];
+            if(n == 0) continue;
+            FaceID f = kernel.add_face();
+            size_t k0 = face_start[i];
+            for(size_t j=0;j<n;++j) {
+                HalfEdgeID h = hid(k0+j);
+                kernel.set_face(h, f);
+                m.link(h, hid(k0 + (j+1)%n));
             }
-            FaceID f = m.add_face(pts);
-            int j=0;
-            circulate_face_ccw(m, f, [&](VertexID v){
-                cluster_id[v] = indices[j+k];
-                ++j;
-            });
-            k += facevec[i];
+            kernel.set_last(f, hid(k0+n-1));
+        }
+        
+        // The table of outgoing halfedges per point (in compressed row form) is all we need
+        // to pair halfedges: the opposite of a->b is found among the halfedges leaving b.
+        auto source = [&](size_t k) -> int_type {return indices[k];};
+        auto target = [&](size_t k) -> int_type {return indices[kernel.next(hid(k)).index - h_off];};
+        vector<size_t> out_start(no_vertices+1, 0);
+        for(size_t k=0;k<no_corners;++k)
+            ++out_start[source(k)+1];
+        for(size_t p=0;p<no_vertices;++p)
+            out_start[p+1] += out_start[p];
+        vector<size_t> out_corners(no_corners);
+        {
+            vector<size_t> fill(out_start.begin(), out_start.end()-1);
+            for(size_t k=0;k<no_corners;++k)
+                out_corners[fill[source(k)]++] = k;
         }
-        stitch_mesh(m, cluster_id);
-        IDRemap remap;
-        m.cleanup(remap);
-        cluster_id.cleanup(remap.vmap);
+        
+        // Glue each halfedge to the first unglued halfedge going the opposite way. Halfedges
+        // that follow each other in a face are never glued since that would leave a vertex of
+        // valency one.
+        for(size_t k=0;k<no_corners;++k) {
+            HalfEdgeID h = hid(k);
+            if(kernel.opp(h) != InvalidHalfEdgeID)
+                continue;
+            int_type a = source(k);
+            int_type b = target(k);
+            for(size_t i=out_start[b];i<out_start[b+1];++i) {
+                size_t l = out_corners[i];
+                HalfEdgeID g = hid(l);
+                if(l != k && target(l) == a && kernel.opp(g) == InvalidHalfEdgeID &&
+                   kernel.next(h) != g && kernel.next(g) != h) {
+                    m.glue(h, g);
+                    break;
+                }
+            }
+        }
+        
+        // The remaining halfedges are boundary halfedges. They get an opposite halfedge without
+        // a face. If some other halfedge shares the end points, the edge is non-manifold or
+        // inconsistently oriented, and that is reported.
+        for(size_t k=0;k<no_corners;++k) {
+            HalfEdgeID h = hid(k);
+            if(kernel.opp(h) != InvalidHalfEdgeID)
+                continue;
+            int_type a = source(k);
+            int_type b = target(k);
+            bool shared = false;
+            for(size_t i=out_start[b];i<out_start[b+1] && !shared;++i)
+                shared = out_corners[i] != k && target(out_corners[i]) == a;
+            for(size_t i=out_start[a];i<out_start[a+1] && !shared;++i)
+                shared = out_corners[i] != k && target(out_corners[i]) == b;
+            if(shared)
+                non_manifold_halfedges.push_back(h);
+            
+            HalfEdgeID hb = kernel.add_halfedge();
+            kernel.set_face(hb, InvalidFaceID);
+            m.glue(h, hb);
+        }
+        
+        // Create a vertex for each fan of halfedges leaving a point. The vertex of halfedge h
+        // is the vertex from which next(h) leaves, so a halfedge leaving a point has been
+        // assigned a vertex precisely when its previous halfedge has.
+        VertexAttributeVector<int> cluster_id(kernel.allocated_vertices(), -1);
+        cluster_id.resize(kernel.allocated_vertices() + no_vertices, -1);
+        for(size_t p=0;p<no_vertices;++p)
+            for(size_t i=out_start[p];i<out_start[p+1];++i) {
+                HalfEdgeID h = hid(out_corners[i]);
+                if(kernel.vert(kernel.prev(h)) != InvalidVertexID)
+                    continue;
+                
+                // Rotate clockwise to the first halfedge of the fan, unless the fan is closed.
+                HalfEdgeID h_first = h;
+                while(kernel.face(kernel.opp(h_first)) != InvalidFaceID) {
+                    HalfEdgeID h_cw = kernel.next(kernel.opp(h_first));
+                    if(h_cw == h)
+                        break;
+                    h_first = h_cw;
+                }
+                
+                VertexID v = kernel.add_vertex();
+                const float_type* pv = &vertvec[3*p];
+                m.pos(v) = Manifold::Vec(pv[0], pv[1], pv[2]);
+                cluster_id[v] = int(p);
+                
+                // Rotate counter clockwise assigning v until we come full circle or
+                // reach the boundary halfedge leaving the fan.
+                HalfEdgeID h_out_boundary = InvalidHalfEdgeID;
+                HalfEdgeID hc = h_first;
+                do {
+                    HalfEdgeID hp = kernel.prev(hc);
+                    kernel.set_vert(hp, v);
+                    HalfEdgeID hpo = kernel.opp(hp);
+                    if(kernel.face(hpo) == InvalidFaceID) {
+                        h_out_boundary = hpo;
+                        break;
+                    }
+                    hc = hpo;
+                }
+                while(hc != h_first);
+                
+                if(h_out_boundary != InvalidHalfEdgeID) {
+                    HalfEdgeID h_in_boundary = kernel.opp(h_first);
+                    kernel.set_vert(h_in_boundary, v);
+                    m.link(h_in_boundary, h_out_boundary);
+                    kernel.set_out(v, h_out_boundary);
+                }
+                else
+                    kernel.set_out(v, h_first);
+            }
+        cluster_id.resize(kernel.allocated_vertices(), -1);
+        m.grow_attributes();
+        m.set_id_reuse(reuse);
         return cluster_id;
     }
     
@@ -1108,12 +1248,13 @@ namespace HMesh
     {
         // A vector of 3's - used to tell build how many indices each face consists of
         vector<int> faces(mesh.geometry.no_faces(), 3);
-        
+        vector<HalfEdgeID> non_manifold_halfedges;
         return build_template(m, static_cast<size_t>(mesh.geometry.no_vertices()),
                        reinterpret_cast<const float*>(&mesh.geometry.vertex(0)),
                        static_cast<size_t>(faces.size()),
                        static_cast<const int*>(&faces[0]),
-                       reinterpret_cast<const int*>(&mesh.geometry.face(0)));
+                       reinterpret_cast<const int*>(&mesh.geometry.face(0)),
+                       non_manifold_halfedges);
     }
     
     VertexAttributeVector<int> build(Manifold& m, size_t no_vertices,
@@ -1122,7 +1263,18 @@ namespace HMesh
                          const int* facevec,
                          const int* indices)
     {
-        return build_template(m, no_vertices, vertvec, no_faces, facevec, indices);
+        vector<HalfEdgeID> non_manifold_halfedges;
+        return build_template(m, no_vertices, vertvec, no_faces, facevec, indices, non_manifold_halfedges);
+    }
+    
+    VertexAttributeVector<int> build(Manifold& m, size_t no_vertices,
+                         const float* vertvec,
+                         size_t no_faces,
+                         const int* facevec,
+                         const int* indices,
+                         vector<HalfEdgeID>& non_manifold_halfedges)
+    {
+        return build_template(m, no_vertices, vertvec, no_faces, facevec, indices, non_manifold_halfedges);
     }
     
     VertexAttributeVector<int> build(Manifold& m, size_t no_vertices,
@@ -1131,7 +1283,18 @@ namespace HMesh
                          const int* facevec,
                          const int* indices)
     {
-        return build_template(m, no_vertices, vertvec, no_faces, facevec, indices);
+        vector<HalfEdgeID> non_manifold_halfedges;
+        return build_template(m, no_vertices, vertvec, no_faces, facevec, indices, non_manifold_halfedges);
+    }
+
+    VertexAttributeVector<int> build(Manifold& m, size_t no_vertices,
+                         const double* vertvec,
+                         size_t no_faces,
+                         const int* facevec,
+                         const int* indices,
+                         vector<HalfEdgeID>& non_manifold_halfedges)
+    {
+        return build_template(m, no_vertices, vertvec, no_faces, facevec, indices, non_manifold_halfedges);
     }
 
     
@@ -1454,7 +1617,7 @@ namespace HMesh
     HalfEdgeID boundary_edge(const Manifold& m, VertexID v)
     {
         HalfEdgeID h = InvalidHalfEdgeID;
-        circulate_vertex_ccw(m, v, static_cast<std::function<void(Walker&)>>([&](Walker& w){if(w.face()==InvalidFaceID) h = w.halfedge();}));
+        circulate_vertex_ccw(m, v, [&](Walker& w){if(w.face()==InvalidFaceID) h = w.halfedge();});
         return h;
     }
     
@@ -1466,7 +1629,7 @@ namespace HMesh
 
     int valency(const Manifold& m, VertexID v)
     {
-        return circulate_vertex_ccw(m,v, static_cast<std::function<void(Walker&)>>([](Walker&){}));
+        return circulate_vertex_ccw(m,v, [](Walker&){});
     }
     
     Manifold::Vec normal(const Manifold& m, VertexID v)
@@ -1488,14 +1651,14 @@ namespace HMesh
     bool connected(const Manifold& m, VertexID v0, VertexID v1)
     {
         bool c=false;
-        circulate_vertex_ccw(m, v0, static_cast<std::function<void(VertexID)>>([&](VertexID v){ c |= (v==v1);}));
+        circulate_vertex_ccw(m, v0, [&](VertexID v){ c |= (v==v1);});
         return c;
     }
 
     
     int no_edges(const Manifold& m, FaceID f)
     {
-        return circulate_face_ccw(m, f, static_cast<std::function<void(Walker&)>>([](Walker& w){}));
+        return circulate_face_ccw(m, f, [](Walker&){});
     }
     
     Manifold::Vec area_normal(const Manifold& m, FaceID f)
@@ -1503,11 +1666,11 @@ namespace HMesh
         using Vec = Manifold::Vec;
         vector<Vec> v;
         Vec c(0.0);
-        int k= circulate_face_ccw(m, f, static_cast<std::function<void(VertexID)>>([&](VertexID vid) {
+        int k= circulate_face_ccw(m, f, [&](VertexID vid) {
             Vec p = m.pos(vid);
             c += p;
             v.push_back(p);
-        }));
+        });
         c /= k;
         Manifold::Vec norm(0);
         for(int i=0;i<k;++i)
@@ -1526,9 +1689,9 @@ namespace HMesh
     {
         // Get all projected vertices
         vector<Manifold::Vec> vertices;
-        int N = circulate_face_ccw(m, fid, static_cast<std::function<void(VertexID)>>([&](VertexID vid) {
+        int N = circulate_face_ccw(m, fid, [&](VertexID vid) {
             vertices.push_back(m.pos(vid));
-        }));
+        });
 
         
         double area = 0;
@@ -1541,14 +1704,14 @@ namespace HMesh
     Manifold::Vec centre(const Manifold& m, FaceID f)
     {
         Manifold::Vec c(0);
-        int n = circulate_face_ccw(m, f, static_cast<std::function<void(VertexID)>>([&](VertexID v) {c+=m.pos(v);}));
+        int n = circulate_face_ccw(m, f, [&](VertexID v) {c+=m.pos(v);});
         return c / n;
     }
     
     double perimeter(const Manifold& m, FaceID f)
     {
         double l=0.0;
-        circulate_face_ccw(m, f, static_cast<std::function<void(HalfEdgeID)>>([&](HalfEdgeID h) { l+= length(m, h);}));
+        circulate_face_ccw(m, f, [&](HalfEdgeID h) { l+= length(m, h);});
         return l;
     }
     
@@ -13,12 +13,15 @@
 
 #include <set>
 #include <algorithm>
+#include <functional>
+#include <type_traits>
 #include "../CGLA/Vec3d.h"
 
 #include "ConnectivityKernel.h"
 #include "Iterators.h"
 #include "Walker.h"
 #include "AttributeVector.h"
+#include "AttributeRegistry.h"
 
 
 namespace Geometry
@@ -30,7 +33,10 @@ namespace Geometry
 
 namespace HMesh
 {
-    
+    // forward declarations of the enums of subdivision.h and triangulate.h
+    enum Subd : int;
+    enum TriangulationMethod : int;
+
     /** The Manifold class represents a halfedge based mesh. Since meshes based on the halfedge
      representation must be manifold (although exceptions could be made) the class is thus named.
      Manifold contains many functions for mesh manipulation and associated the position attribute
@@ -230,6 +236,92 @@ namespace HMesh
         void cleanup(IDRemap& map);
         /// Remove unused items from Mesh
         void cleanup();
+
+        /** Turn reuse of the IDs of removed entities on or off. Removing an entity normally
+         only marks it as unused, and new entities are always appended, so a long sequence of
+         edits makes the mesh grow until cleanup is called. With reuse turned on, new entities
+         take the place of removed ones instead. Note that the ID of a new entity may then be
+         smaller than that of existing entities, and that attribute vectors still hold the
+         values of the removed entity for a recycled ID. The attribute layers of the mesh are
+         reset to their default value for a recycled ID, though. Also, a loop over the entities which
+         adds entities may visit the new ones. Off by default. */
+        void set_id_reuse(bool b) { kernel.set_slot_reuse(b); }
+
+        /// Returns true if the IDs of removed entities are reused.
+        bool id_reuse() const { return kernel.slot_reuse(); }
+
+        /** Set the policy for cleanup_if_needed. A cleanup is deemed necessary when, for vertices,
+         faces, or halfedges, the unused entities make up more than max_unused_fraction of all
+         allocated entities and number at least min_unused. The defaults are 0.5 and 1024. */
+        void set_cleanup_policy(double max_unused_fraction, size_t min_unused = 1024);
+
+        /** Call cleanup if the cleanup policy says so. Since cleanup changes IDs, this should only be
+         called where no IDs are kept, e.g. between the passes of an iterative algorithm. Returns true
+         if cleanup was performed, in which case map can be used to update attribute vectors. */
+        bool cleanup_if_needed(IDRemap& map);
+
+        /// Call cleanup if the cleanup policy says so. Returns true if cleanup was performed.
+        bool cleanup_if_needed();
+
+        /** Add a named vertex attribute layer owned by the mesh, or return the existing layer if
+         there is one of the same name and type. A layer of the same name and another type is
+         replaced. The mesh keeps a layer in sync: it always has a value for every allocated
+         vertex, so the unchecked accessor can be used; new vertices get the default value; it is
+         compacted by cleanup; and it is saved and loaded along with the mesh by gel_save and
+         gel_load provided that T is trivially copyable. The reference stays valid until the
+         layer is removed or the mesh destroyed. */
+        template<typename T>
+        VertexAttributeVector<T>& add_vertex_attribute(const std::string& name, const T& default_value = T())
+        { return attributes.add<T, VertexID>(name, default_value, allocated_vertices()); }
+
+        /// Add a named face attribute layer. See the vertex attribute version.
+        template<typename T>
+        FaceAttributeVector<T>& add_face_attribute(const std::string& name, const T& default_value = T())
+        { return attributes.add<T, FaceID>(name, default_value, allocated_faces()); }
+
+        /// Add a named halfedge attribute layer. See the vertex attribute version.
+        template<typename T>
+        HalfEdgeAttributeVector<T>& add_halfedge_attribute(const std::string& name, const T& default_value = T())
+        { return attributes.add<T, HalfEdgeID>(name, default_value, allocated_halfedges()); }
+
+        /** Returns the vertex attribute layer of the given name and type or nullptr if there is
+         none. A layer loaded from a file takes on the type T if the size matches. */
+        template<typename T>
+        VertexAttributeVector<T>* vertex_attribute(const std::string& name)
+        { return attributes.find<T, VertexID>(name); }
+        template<typename T>
+        const VertexAttributeVector<T>* vertex_attribute(const std::string& name) const
+        { return attributes.find<T, VertexID>(name); }
+
+        /// Returns the face attribute layer of the given name and type or nullptr.
+        template<typename T>
+        FaceAttributeVector<T>* face_attribute(const std::string& name)
+        { return attributes.find<T, FaceID>(name); }
+        template<typename T>
+        const FaceAttributeVector<T>* face_attribute(const std::string& name) const
+        { return attributes.find<T, FaceID>(name); }
+
+        /// Returns the halfedge attribute layer of the given name and type or nullptr.
+        template<typename T>
+        HalfEdgeAttributeVector<T>* halfedge_attribute(const std::string& name)
+        { return attributes.find<T, HalfEdgeID>(name); }
+        template<typename T>
+        const HalfEdgeAttributeVector<T>* halfedge_attribute(const std::string& name) const
+        { return attributes.find<T, HalfEdgeID>(name); }
+
+        /// Remove a vertex attribute layer. Returns false if there is none of that name.
+        bool remove_vertex_attribute(const std::string& name)
+        { return attributes.remove(GELAttribute::VERTEX, name); }
+        /// Remove a face attribute layer. Returns false if there is none of that name.
+        bool remove_face_attribute(const std::string& name)
+        { return attributes.remove(GELAttribute::FACE, name); }
+        /// Remove a halfedge attribute layer. Returns false if there is none of that name.
+        bool remove_halfedge_attribute(const std::string& name)
+        { return attributes.remove(GELAttribute::HALFEDGE, name); }
+
+        /// Names of the vertex, face, or halfedge attribute layers according to kind.
+        std::vector<std::string> attribute_names(GELAttribute::Kind kind) const
+        { return attributes.names(kind); }
         
         /// Returns a Walker to the out halfedge of vertex given by VertexID
         Walker walker(VertexID id) const;
@@ -245,13 +337,43 @@ namespace HMesh
         
         VertexAttributeVector<Vec> positions;
 
-        // private template for building the manifold from various types
-        template<typename size_type, typename float_type, typename int_type>
-        VertexAttributeVector<int_type> build_template(size_type no_vertices,
+        /// Named attribute layers owned by the mesh.
+        AttributeRegistry attributes;
+
+        /// cleanup policy used by cleanup_if_needed
+        double cleanup_max_unused_fraction = 0.5;
+        size_t cleanup_min_unused = 1024;
+
+        // template for building the manifold from various types directly in the kernel
+        template<typename float_type, typename int_type>
+        friend VertexAttributeVector<int> build_template(Manifold& m, size_t no_vertices,
                             const float_type* vertvec,
-                            size_type no_faces,
+                            size_t no_faces,
                             const int_type* facevec,
-                            const int_type* indices);
+                            const int_type* indices,
+                            std::vector<HalfEdgeID>& non_manifold_halfedges);
+
+        // the native binary format stores and restores the kernel directly
+        friend bool gel_save(const std::string&, const Manifold& m, const std::vector<GELAttribute>& attribs);
+        friend bool gel_load(const std::string&, Manifold& m, const std::vector<GELAttribute>& attribs);
+
+        // subdivision writes the connectivity of the refined mesh directly
+        friend void subdivide(const Manifold& m_in, Manifold& m_out, Subd method, int levels);
+
+        // triangulation splits all faces in one batch
+        friend void triangulate(Manifold& m, TriangulationMethod policy);
+
+        /** Add a vertex to the kernel and give it the default values of the attribute layers,
+         also if it takes the slot of a removed vertex. */
+        VertexID new_vertex();
+        /// Add a face to the kernel and give it the default values of the attribute layers.
+        FaceID new_face();
+        /// Add a halfedge to the kernel and give it the default values of the attribute layers.
+        HalfEdgeID new_halfedge();
+
+        /** Make room in the attribute layers for all entities after adding many directly to the
+         kernel. Reused slots are not reset, so this is only for entities which were appended. */
+        void grow_attributes();
 
         /// Set the next and prev indices of the first and second argument respectively.
         void link(HalfEdgeID h0, HalfEdgeID h1);
@@ -269,8 +391,10 @@ namespace HMesh
      of indices (indices). The build function returns an attribute vector containing a mapping from
      vertex ids to the original point indices.
      Note that each vertex is three floating point numbers. The indices vector is one long list of
-     all vertex indices. Note also that this function call assumes that the mesh is manifold. Failing
-     that the results are undefined but usually a crash due to a failed assertion.
+     all vertex indices. Edges shared by more than two faces are glued only once and otherwise left
+     as boundary edges; use the overload below to find out which.
+     If a face size is negative or an index is not less than no_vertices or negative, nothing is
+     added to m and the returned attribute vector is empty. This holds for all build functions.
      Finally, we should consider the option to build a manifold with single precision floating point
      values deprecated. Hence, safe_build exists only as double precision.
      */
@@ -280,6 +404,14 @@ namespace HMesh
                const int* facevec,
                const int* indices);
     
+    /// As above, but the halfedges left on the boundary of non-manifold edges are stored as explained below.
+    VertexAttributeVector<int> build(Manifold& m, size_t no_vertices,
+               const float* vertvec,
+               size_t no_faces,
+               const int* facevec,
+               const int* indices,
+               std::vector<HalfEdgeID>& non_manifold_halfedges);
+    
     /** \brief Build a manifold.
      The arguments are the number of vertices (no_vertices),  the vector of vertices (vertvec),
      the number of faces (no_faces), a pointer to an array of double values (vert_vec) and an array
@@ -287,15 +419,32 @@ namespace HMesh
      vertex ids to the original point indices.
 
      Note that each vertex is three double precision floating point numbers.
-     The indices vector is one long list of all vertex indices. Note also that this function
-     assumes that the mesh is manifold. Failing that the results are undefined but usually a
-     crash due to a failed assertion. */
+     The indices vector is one long list of all vertex indices. Edges shared by more than two
+     faces are glued only once and otherwise left as boundary edges. */
     VertexAttributeVector<int> build(Manifold& m, size_t no_vertices,
                const double* vertvec,
                size_t no_faces,
                const int* facevec,
                const int* indices);
     
+    /** \brief Build a manifold and report the edges that could not be glued.
+     This is the same as the double precision build function above, but every face halfedge that
+     shares its end points with two or more other face halfedges (an edge shared by more than
+     two faces) or only with halfedges of the same orientation (inconsistently oriented faces)
+     and for that reason was left as a boundary halfedge is stored in non_manifold_halfedges.
+     
+     The connectivity is computed directly from the indices: halfedges are paired through a
+     table of the halfedges leaving each point, and the vertices are created per fan of faces
+     around each point. Consequently, a point where the surface is not locally a disk becomes
+     several vertices, but the result is always a valid Manifold. If all points are referenced
+     and the mesh is manifold, the VertexID of a vertex is the index of its point. */
+    VertexAttributeVector<int> build(Manifold& m, size_t no_vertices,
+               const double* vertvec,
+               size_t no_faces,
+               const int* facevec,
+               const int* indices,
+               std::vector<HalfEdgeID>& non_manifold_halfedges);
+    
     /// Build a manifold from a TriMesh
     VertexAttributeVector<int> build(Manifold& m, const Geometry::TriMesh& mesh);
 
@@ -418,6 +567,47 @@ namespace HMesh
     { 
         kernel.clear();
         positions.clear();
+        attributes.clear();
+    }
+
+    inline VertexID Manifold::new_vertex()
+    {
+        const size_t n = allocated_vertices();
+        VertexID v = kernel.add_vertex();
+        if(v.index < n)
+            attributes.reset(GELAttribute::VERTEX, v.index);
+        else
+            attributes.make_room(GELAttribute::VERTEX, v.index + 1);
+        return v;
+    }
+
+    inline FaceID Manifold::new_face()
+    {
+        const size_t n = allocated_faces();
+        FaceID f = kernel.add_face();
+        if(f.index < n)
+            attributes.reset(GELAttribute::FACE, f.index);
+        else
+            attributes.make_room(GELAttribute::FACE, f.index + 1);
+        return f;
+    }
+
+    inline HalfEdgeID Manifold::new_halfedge()
+    {
+        const size_t n = allocated_halfedges();
+        HalfEdgeID h = kernel.add_halfedge();
+        if(h.index < n)
+            attributes.reset(GELAttribute::HALFEDGE, h.index);
+        else
+            attributes.make_room(GELAttribute::HALFEDGE, h.index + 1);
+        return h;
+    }
+
+    inline void Manifold::grow_attributes()
+    {
+        attributes.make_room(GELAttribute::VERTEX, allocated_vertices());
+        attributes.make_room(GELAttribute::FACE, allocated_faces());
+        attributes.make_room(GELAttribute::HALFEDGE, allocated_halfedges());
     }
 
     inline Walker Manifold::walker(VertexID id) const
@@ -432,88 +622,167 @@ namespace HMesh
     {   
         kernel.cleanup(map);
         positions.cleanup(map.vmap);
+        attributes.cleanup(map);
     }
     
+    inline void Manifold::set_cleanup_policy(double max_unused_fraction, size_t min_unused)
+    {
+        cleanup_max_unused_fraction = max_unused_fraction;
+        cleanup_min_unused = min_unused;
+    }
+
+    inline bool Manifold::cleanup_if_needed(IDRemap& map)
+    {
+        auto too_many_unused = [this](size_t allocated, size_t used) {
+            const size_t unused = allocated - used;
+            return unused >= cleanup_min_unused && unused > cleanup_max_unused_fraction * allocated;
+        };
+        if(too_many_unused(allocated_vertices(), no_vertices()) ||
+           too_many_unused(allocated_faces(), no_faces()) ||
+           too_many_unused(allocated_halfedges(), no_halfedges())) {
+            cleanup(map);
+            return true;
+        }
+        return false;
+    }
+
+    inline bool Manifold::cleanup_if_needed()
+    {
+        IDRemap map;
+        return cleanup_if_needed(map);
+    }
+
     inline void Manifold::cleanup()
     {
         IDRemap map;
         Manifold::cleanup(map);
     }
     
-    inline int circulate_vertex_ccw(const Manifold& m, VertexID v, std::function<void(Walker&)> f)
+    /** Call f with the entity that a walker circulating a vertex or a face points to. f may take
+     the Walker itself or the VertexID, FaceID, or HalfEdgeID. When circulating a face, the FaceID
+     is that of the face on the other side of the edge. */
+    template<bool FACE_CIRCULATION, typename Func>
+    inline void circulation_visit(Func& f, Walker& w)
+    {
+        if constexpr (std::is_invocable<Func&, Walker&>::value)
+            f(w);
+        else if constexpr (std::is_invocable<Func&, VertexID>::value)
+            f(w.vertex());
+        else if constexpr (std::is_invocable<Func&, FaceID>::value)
+            f(FACE_CIRCULATION ? w.opp().face() : w.face());
+        else {
+            static_assert(std::is_invocable<Func&, HalfEdgeID>::value,
+                          "Circulation callbacks must take a Walker, VertexID, FaceID, or HalfEdgeID");
+            f(w.halfedge());
+        }
+    }
+
+    /** Circulate the vertex v counter clockwise, calling f for each outgoing halfedge. f is a
+     function object that takes a Walker&, VertexID, FaceID, or HalfEdgeID. This template is
+     inlined, so passing a lambda costs nothing compared to writing out the loop. Returns the
+     number of steps, i.e. the valency. */
+    template<typename Func>
+    inline int circulate_vertex_ccw(const Manifold& m, VertexID v, Func f)
     {
         Walker w = m.walker(v);
-        for(; !w.full_circle(); w = w.circulate_vertex_ccw()) f(w);
+        for(; !w.full_circle(); w = w.circulate_vertex_ccw()) circulation_visit<false>(f, w);
         return w.no_steps();
     }
+
+    /// Circulate the vertex v clockwise, calling f for each outgoing halfedge. See circulate_vertex_ccw.
+    template<typename Func>
+    inline int circulate_vertex_cw(const Manifold& m, VertexID v, Func f)
+    {
+        Walker w = m.walker(v);
+        for(; !w.full_circle(); w = w.circulate_vertex_cw()) circulation_visit<false>(f, w);
+        return w.no_steps();
+    }
+
+    /** Circulate the face f counter clockwise, calling g for each halfedge. See circulate_vertex_ccw,
+     but note that a FaceID passed to g is that of the neighbouring face. */
+    template<typename Func>
+    inline int circulate_face_ccw(const Manifold& m, FaceID f, Func g)
+    {
+        Walker w = m.walker(f);
+        for(; !w.full_circle(); w = w.circulate_face_ccw()) circulation_visit<true>(g, w);
+        return w.no_steps();
+    }
+
+    /// Circulate the face f clockwise, calling g for each halfedge. See circulate_face_ccw.
+    template<typename Func>
+    inline int circulate_face_cw(const Manifold& m, FaceID f, Func g)
+    {
+        Walker w = m.walker(f);
+        for(; !w.full_circle(); w = w.circulate_face_cw()) circulation_visit<true>(g, w);
+        return w.no_steps();
+    }
+
+    inline int circulate_vertex_ccw(const Manifold& m, VertexID v, std::function<void(Walker&)> f)
+    {
+        return circulate_vertex_ccw<std::function<void(Walker&)>&>(m, v, f);
+    }
     inline int circulate_vertex_ccw(const Manifold& m, VertexID v, std::function<void(VertexID)> f)
     {
-        return circulate_vertex_ccw(m, v, static_cast<std::function<void(Walker&)>>([&](Walker& w){f(w.vertex());}));
+        return circulate_vertex_ccw<std::function<void(VertexID)>&>(m, v, f);
     }
     inline int circulate_vertex_ccw(const Manifold& m, VertexID v, std::function<void(FaceID)> f)
     {
-        return circulate_vertex_ccw(m, v, static_cast<std::function<void(Walker&)>>([&](Walker& w){f(w.face());}));
+        return circulate_vertex_ccw<std::function<void(FaceID)>&>(m, v, f);
     }
     inline int circulate_vertex_ccw(const Manifold& m, VertexID v, std::function<void(HalfEdgeID)> f)
     {
-        return circulate_vertex_ccw(m, v, static_cast<std::function<void(Walker&)>>([&](Walker& w){f(w.halfedge());}));
+        return circulate_vertex_ccw<std::function<void(HalfEdgeID)>&>(m, v, f);
     }
     
     inline int circulate_vertex_cw(const Manifold& m, VertexID v, std::function<void(Walker&)> f)
     {
-        Walker w = m.walker(v);
-        for(; !w.full_circle(); w = w.circulate_vertex_cw()) f(w);
-        return w.no_steps();
+        return circulate_vertex_cw<std::function<void(Walker&)>&>(m, v, f);
     }
     inline int circulate_vertex_cw(const Manifold& m, VertexID v, std::function<void(VertexID)> f)
     {
-        return circulate_vertex_cw(m, v, static_cast<std::function<void(Walker&)>>([&](Walker& w){f(w.vertex());}));
+        return circulate_vertex_cw<std::function<void(VertexID)>&>(m, v, f);
     }
     inline int circulate_vertex_cw(const Manifold& m, VertexID v, std::function<void(FaceID)> f)
     {
-        return circulate_vertex_cw(m, v, static_cast<std::function<void(Walker&)>>([&](Walker& w){f(w.face());}));
+        return circulate_vertex_cw<std::function<void(FaceID)>&>(m, v, f);
     }
     inline int circulate_vertex_cw(const Manifold& m, VertexID v, std::function<void(HalfEdgeID)> f)
     {
-        return circulate_vertex_cw(m, v, static_cast<std::function<void(Walker&)>>([&](Walker& w){f(w.halfedge());}));
+        return circulate_vertex_cw<std::function<void(HalfEdgeID)>&>(m, v, f);
     }
     
     inline int circulate_face_ccw(const Manifold& m, FaceID f, std::function<void(Walker&)> g)
     {
-        Walker w = m.walker(f);
-        for(; !w.full_circle(); w = w.circulate_face_ccw()) g(w);
-        return w.no_steps();
+        return circulate_face_ccw<std::function<void(Walker&)>&>(m, f, g);
     }
     inline int circulate_face_ccw(const Manifold& m, FaceID f, std::function<void(VertexID)> g)
     {
-        return circulate_face_ccw(m, f, static_cast<std::function<void(Walker&)>>([&](Walker& w){g(w.vertex());}));
+        return circulate_face_ccw<std::function<void(VertexID)>&>(m, f, g);
     }
     inline int circulate_face_ccw(const Manifold& m, FaceID f, std::function<void(FaceID)> g)
     {
-        return circulate_face_ccw(m, f, static_cast<std::function<void(Walker&)>>([&](Walker& w){g(w.opp().face());}));
+        return circulate_face_ccw<std::function<void(FaceID)>&>(m, f, g);
     }
     inline int circulate_face_ccw(const Manifold& m, FaceID f, std::function<void(HalfEdgeID)> g)
     {
-        return circulate_face_ccw(m, f, static_cast<std::function<void(Walker&)>>([&](Walker& w){g(w.halfedge());}));
+        return circulate_face_ccw<std::function<void(HalfEdgeID)>&>(m, f, g);
     }
     
     inline int circulate_face_cw(const Manifold& m, FaceID f, std::function<void(Walker&)> g)
     {
-        Walker w = m.walker(f);
-        for(; !w.full_circle(); w = w.circulate_face_cw()) g(w);
-        return w.no_steps();
+        return circulate_face_cw<std::function<void(Walker&)>&>(m, f, g);
     }
     inline int circulate_face_cw(const Manifold& m, FaceID f, std::function<void(VertexID)> g)
     {
-        return circulate_face_cw(m, f, static_cast<std::function<void(Walker&)>>([&](Walker& w){g(w.vertex());}));
+        return circulate_face_cw<std::function<void(VertexID)>&>(m, f, g);
     }
     inline int circulate_face_cw(const Manifold& m, FaceID f, std::function<void(FaceID)> g)
     {
-        return circulate_face_cw(m, f, static_cast<std::function<void(Walker&)>>([&](Walker& w){g(w.opp().face());}));
+        return circulate_face_cw<std::function<void(FaceID)>&>(m, f, g);
     }
     inline int circulate_face_cw(const Manifold& m, FaceID f, std::function<void(HalfEdgeID)> g)
     {
-        return circulate_face_cw(m, f, static_cast<std::function<void(Walker&)>>([&](Walker& w){g(w.halfedge());}));
+        return circulate_face_cw<std::function<void(HalfEdgeID)>&>(m, f, g);
     }
    
 }
@@ -56,8 +56,10 @@ namespace HMesh
         /// Get ID of either halfedge or ID - whichever has the smaller index.
         HalfEdgeID hmin() const;
         
+        /// copy constructor
+        Walker(const Walker&) = default;
         /// assignment operator
-        Walker operator =(const Walker& w);
+        Walker& operator =(const Walker&) = default;
 
     private:
         const ConnectivityKernel* ck;
@@ -115,15 +117,6 @@ namespace HMesh
     { return (current<ck->opp(current))?current:ck->opp(current); }
 
     
-
-    inline Walker Walker::operator =(const Walker& w)
-    { 
-        current = w.current;
-        counter = w.counter;
-        ck = w.ck;
-        last = w.last;
-        return *this;
-    }
     
  
 
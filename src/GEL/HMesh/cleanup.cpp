@@ -4,7 +4,10 @@
  * For license and list of authors, see ../../doc/intro.pdf
  * ----------------------------------------------------------------------- */
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
 #include "cleanup.h"
 
 #include "../CGLA/Vec3f.h"
@@ -12,8 +15,11 @@
 #include "../Geometry/QEM.h"
 #include "../Geometry/KDTree.h"
 
+#include "../Util/Parallel.h"
+
 #include "refine_edges.h"
 #include "Manifold.h"
+#include "parallel_for.h"
 
 namespace HMesh
 {
@@ -147,30 +153,156 @@ namespace HMesh
     
  
     
-    VertexAttributeVector<int> cluster_vertices(Manifold& m, double rad) {
+    namespace
+    {
+        /// Hash of the grid cell with integer coordinates c.
+        inline uint64_t cell_hash(const int64_t c[3])
+        {
+            uint64_t h = uint64_t(c[0]) * 0x9E3779B97F4A7C15ull;
+            h ^= uint64_t(c[1]) * 0xC2B2AE3D27D4EB4Full;
+            h ^= uint64_t(c[2]) * 0x165667B19E3779F9ull;
+            return h ^ (h >> 29);
+        }
 
-        KDTree<Vec3d, VertexID> vtree;
-        
-        for(auto v : m.vertices())
-            if(boundary(m, v))
-                vtree.insert(m.pos(v), v);
-        vtree.build();
-        
-        VertexAttributeVector<int> cluster_id(m.allocated_vertices(),-1);
-        
-        int cluster_ctr=0;
-        for(auto v: m.vertices())
-            if(boundary(m, v) && cluster_id[v] == -1)
+        /** Disjoint sets of 0..n-1 which may be joined from several threads at once. A root is
+         only ever linked below a smaller root, so the links cannot form a cycle whatever order
+         the joins are made in, and the sets found do not depend on the number of threads. */
+        class ConcurrentDisjointSets
+        {
+            vector<atomic<int>> parent;
+
+        public:
+            explicit ConcurrentDisjointSets(int n): parent(n)
             {
-                vector<Vec3d> keys;
-                vector<VertexID> vals;
-                int n = vtree.in_sphere(m.pos(v), rad, keys, vals);
-                
-                for(int i=0;i<n;++i)
-                    cluster_id[vals[i]] = cluster_ctr;
-                ++cluster_ctr;
+                for(int i = 0; i < n; ++i)
+                    parent[i].store(i, memory_order_relaxed);
             }
-        
+
+            /// The least element of the set containing x.
+            int find(int x)
+            {
+                for(;;) {
+                    int p = parent[x].load(memory_order_relaxed);
+                    if(p == x)
+                        return x;
+                    const int gp = parent[p].load(memory_order_relaxed);
+                    if(gp != p)
+                        parent[x].compare_exchange_weak(p, gp, memory_order_relaxed);
+                    x = gp;
+                }
+            }
+
+            void join(int a, int b)
+            {
+                for(;;) {
+                    a = find(a);
+                    b = find(b);
+                    if(a == b)
+                        return;
+                    if(a < b)
+                        swap(a, b);
+                    int expected = a;
+                    if(parent[a].compare_exchange_strong(expected, b, memory_order_relaxed))
+                        return;
+                }
+            }
+        };
+    }
+
+    VertexAttributeVector<int> cluster_vertices(Manifold& m, double rad)
+    {
+        VertexAttributeVector<int> cluster_id(m.allocated_vertices(), -1);
+        VertexAttributeVector<int> on_boundary(m.allocated_vertices(), 0);
+        for_each_vertex_parallel(m, [&](VertexID v) { on_boundary.unchecked(v) = boundary(m, v); });
+        vector<VertexID> verts;
+        double extent = 0;
+        for(auto v: m.vertices())
+            if(on_boundary[v]) {
+                verts.push_back(v);
+                for(int i = 0; i < 3; ++i)
+                    extent = max(extent, abs(m.pos(v)[i]));
+            }
+        const int n = verts.size();
+        if(n == 0)
+            return cluster_id;
+
+        // The vertices are hashed into a uniform grid with cells of side 2 rad. Along each axis,
+        // the vertices within rad of a point are then in its own cell or in the neighbouring
+        // cell on the side of the nearer face, so only eight cells need to be searched. The
+        // cells must not be so small that their coordinates overflow, but larger cells only
+        // cost time.
+        double cell = max(2 * rad, 1e-12 * extent);
+        if(cell == 0)
+            cell = 1;
+
+        // Sort the vertices by bucket with a counting sort. There are at least twice as many
+        // buckets as vertices, and the cells that share a bucket are told apart by the distance
+        // test. The positions are copied in sorted order, so a bucket is read in one sweep.
+        size_t no_buckets = 1;
+        while(no_buckets < 2 * size_t(n))
+            no_buckets *= 2;
+        const uint64_t mask = no_buckets - 1;
+        vector<int> bucket(n);
+        Util::parallel_for_chunks(n, [&](size_t b, size_t e) {
+            int64_t c[3];
+            for(size_t i = b; i < e; ++i) {
+                const Vec3d& p = m.pos(verts[i]);
+                for(int k = 0; k < 3; ++k)
+                    c[k] = int64_t(floor(p[k] / cell));
+                bucket[i] = cell_hash(c) & mask;
+            }
+        }, 1 << 14);
+        vector<int> bucket_start(no_buckets + 1, 0);
+        for(int i = 0; i < n; ++i)
+            ++bucket_start[bucket[i] + 1];
+        for(size_t b = 0; b < no_buckets; ++b)
+            bucket_start[b + 1] += bucket_start[b];
+        vector<int> sorted(n);
+        {
+            vector<int> fill(bucket_start.begin(), bucket_start.end() - 1);
+            for(int i = 0; i < n; ++i)
+                sorted[fill[bucket[i]]++] = i;
+        }
+        vector<Vec3d> pts(n);
+        Util::parallel_for_chunks(n, [&](size_t b, size_t e) {
+            for(size_t i = b; i < e; ++i)
+                pts[i] = m.pos(verts[sorted[i]]);
+        }, 1 << 14);
+
+        // Join each vertex with the vertices within rad which come before it in sorted order.
+        ConcurrentDisjointSets sets(n);
+        const double sq_rad = sqr(rad);
+        Util::parallel_for_chunks(n, [&](size_t b, size_t e) {
+            int64_t c[3], side[3], nc[3];
+            uint64_t visited[8];
+            for(size_t i = b; i < e; ++i) {
+                const Vec3d& p = pts[i];
+                for(int k = 0; k < 3; ++k) {
+                    const double x = p[k] / cell;
+                    c[k] = int64_t(floor(x));
+                    side[k] = x - floor(x) < 0.5 ? -1 : 1;
+                }
+                int no_visited = 0;
+                for(int corner = 0; corner < 8; ++corner) {
+                    for(int k = 0; k < 3; ++k)
+                        nc[k] = c[k] + ((corner >> k) & 1) * side[k];
+                    const uint64_t bkt = cell_hash(nc) & mask;
+                    if(find(visited, visited + no_visited, bkt) != visited + no_visited)
+                        continue;
+                    visited[no_visited++] = bkt;
+                    const size_t end = min(size_t(bucket_start[bkt + 1]), i);
+                    for(size_t j = bucket_start[bkt]; j < end; ++j)
+                        if(sqr_length(pts[j] - p) <= sq_rad)
+                            sets.join(i, j);
+                }
+            }
+        }, 1 << 12);
+
+        // A cluster is named by the index of one of its vertices.
+        Util::parallel_for_chunks(n, [&](size_t b, size_t e) {
+            for(size_t i = b; i < e; ++i)
+                cluster_id.unchecked(verts[sorted[i]]) = verts[sorted[sets.find(i)]].get_index();
+        }, 1 << 14);
         return cluster_id;
     }
     
@@ -178,12 +310,42 @@ namespace HMesh
     
     int stitch_mesh(Manifold& m, const VertexAttributeVector<int>& cluster_id)
     {
-        map<int, vector<HalfEdgeID>> clustered_halfedges;
-        for(auto v: m.vertices()) {
-            HalfEdgeID h = boundary_edge(m, v);
-            if(cluster_id[v] != -1 && h != InvalidHalfEdgeID)
-                clustered_halfedges[cluster_id[v]].push_back(h);
+        // Find a boundary halfedge out of each clustered vertex and group them by cluster. The
+        // clusters are numbered densely first unless their IDs already are small.
+        VertexAttributeVector<HalfEdgeID> out_boundary(m.allocated_vertices(), InvalidHalfEdgeID);
+        for_each_vertex_parallel(m, [&](VertexID v) {
+            if(cluster_id[v] != -1)
+                out_boundary.unchecked(v) = boundary_edge(m, v);
+        });
+        int max_id = -1;
+        for(auto v: m.vertices())
+            max_id = max(max_id, cluster_id[v]);
+        vector<int> ids;
+        if(max_id >= 0 && size_t(max_id) >= 2 * m.allocated_vertices()) {
+            for(auto v: m.vertices())
+                if(cluster_id[v] != -1)
+                    ids.push_back(cluster_id[v]);
+            sort(ids.begin(), ids.end());
+            ids.erase(unique(ids.begin(), ids.end()), ids.end());
         }
+        auto slot = [&](int cid) {
+            return ids.empty() ? cid : int(lower_bound(ids.begin(), ids.end(), cid) - ids.begin());
+        };
+        const size_t no_slots = ids.empty() ? max_id + 1 : ids.size();
+        vector<int> slot_start(no_slots + 1, 0);
+        for(auto v: m.vertices())
+            if(out_boundary[v] != InvalidHalfEdgeID)
+                ++slot_start[slot(cluster_id[v]) + 1];
+        for(size_t s = 0; s < no_slots; ++s)
+            slot_start[s + 1] += slot_start[s];
+        vector<HalfEdgeID> clustered_halfedges(slot_start[no_slots]);
+        {
+            vector<int> fill(slot_start.begin(), slot_start.end() - 1);
+            for(auto v: m.vertices())
+                if(out_boundary[v] != InvalidHalfEdgeID)
+                    clustered_halfedges[fill[slot(cluster_id[v])]++] = out_boundary[v];
+        }
+
         int unstitched=0;
         for(auto h0 : m.halfedges())
         {
@@ -199,11 +361,15 @@ namespace HMesh
 //                    cout << "Warning: edge endpoints in same cluster while stitching, ignoring " << endl;
                     continue;
                 }
-                vector<HalfEdgeID>& stitch_candidates = clustered_halfedges[cid];
-                size_t i=0;
-                for(;i<stitch_candidates.size(); ++i)
+                if(cid == -1) {
+                    ++unstitched;
+                    continue;
+                }
+                const int s = slot(cid);
+                int i=slot_start[s];
+                for(;i<slot_start[s+1]; ++i)
                 {
-                    HalfEdgeID h1 = stitch_candidates[i];
+                    HalfEdgeID h1 = clustered_halfedges[i];
                     if(m.in_use(h1))
                     {
                         Walker w = m.walker(h1);
@@ -214,7 +380,7 @@ namespace HMesh
                     }
                     
                 }
-                if(i == stitch_candidates.size())
+                if(i == slot_start[s+1])
                     ++unstitched;
             }
         }
@@ -240,10 +406,9 @@ namespace HMesh
     
     void stitch_more(Manifold& mani, double rad)
     {
-        int unstitched, iter;
-        for(iter=0;iter<2;++iter)
+        for(int iter=0;iter<2;++iter)
         {
-            unstitched = stitch_mesh(mani, rad);
+            stitch_mesh(mani, rad);
             vector<HalfEdgeID> hvec;
             for(HalfEdgeIDIterator h = mani.halfedges_begin(); h != mani.halfedges_end();++h)
                 if(mani.walker(*h).face() == InvalidFaceID)
@@ -288,9 +453,9 @@ namespace HMesh
         vector<int> faces;
         for(FaceID f: m.faces()) {
             faces.push_back(no_edges(m, f));
-			circulate_face_cw(m, f, static_cast<std::function<void(VertexID)>>([&](VertexID v){
+			circulate_face_cw(m, f, [&](VertexID v){
                 indices.push_back(idvec[v]);
-            }));
+            });
         }
         m.clear();
         build(m, vertices.size(), vertices[0].get(), faces.size(), &faces[0], &indices[0]);
@@ -32,8 +32,16 @@ namespace HMesh
      This function allows you to create a mesh as a bunch of faces and then stitch these together
      to form a coherent whole. What this function adds is a spatial data structure to find out
      which vertices coincide. The return value is the number of edges that could not be stitched. 
-     Often this is because it would introduce a non-manifold situation.*/
+     Often this is because it would introduce a non-manifold situation.
+     Boundary vertices no further than rad apart, directly or through other boundary vertices,
+     are put in the same cluster. The clusters are found in parallel in expected linear time
+     by hashing the vertices into a uniform grid with cells of side 2 rad. Only the eight cells
+     nearest to a vertex, its own and its neighbours on the sides of the nearer faces, are searched
+     for vertices within rad of it. */
     int stitch_mesh(Manifold& m, double rad);
+
+    /** \brief Stitch together boundary edges whose endpoints are in the same clusters.
+     A vertex with cluster ID -1 is in no cluster. The return value is as above. */
     int stitch_mesh(Manifold& m, const VertexAttributeVector<int>& cluster_id);
 
     /** \brief Stitches the mesh together, splits edges that could not be stitched and goes again.
@@ -15,6 +15,8 @@
 #include "x3d_load.h"
 #include "obj_load.h"
 #include "mesh_optimization.h"
+#include "parallel_for.h"
+#include "../Util/Parallel.h"
 
 using namespace std;
 using namespace CGLA;
@@ -27,21 +29,80 @@ namespace HMesh
         //double scal = 0.001;
         //double vector_scal = 0.001;
 
+        /// Make sure vec has an entry for every vertex of m, so that it can be written in parallel.
+        template<class T>
+        void reserve_vertices(const Manifold& m, VertexAttributeVector<T>& vec)
+        {
+            if(vec.size() < m.allocated_vertices())
+                vec[VertexID(VertexID::IndexType(m.allocated_vertices() - 1))];
+        }
+
+        /// The average of vec over v and its neighbours.
+        template<class T>
+        T smoothed_value(const Manifold& m, const VertexAttributeVector<T>& vec, VertexID v)
+        {
+            T x = vec[v];
+            for(Walker w = m.walker(v); !w.full_circle(); w = w.circulate_vertex_cw())
+                x += vec[w.vertex()];
+            x /= (valency(m, v) + 1.0);
+            return x;
+        }
+
         template<class T> 
         void smooth_something_on_mesh(const Manifold& m, VertexAttributeVector<T>& vec, int smooth_steps)
         {
             for(int iter=0;iter<smooth_steps;++iter){
-                VertexAttributeVector<T> new_vec(m.allocated_vertices());
-                for(VertexIDIterator v = m.vertices_begin(); v != m.vertices_end(); ++v){
-                    new_vec[*v] = vec[*v];
-                    for(Walker w = m.walker(*v); !w.full_circle(); w = w.circulate_vertex_cw()){
-                        new_vec[*v] += vec[w.vertex()];
-                    }
-                    new_vec[*v] /= (valency(m, *v) + 1.0);
-                }
+                VertexAttributeVector<T> new_vec(m.allocated_vertices(), T());
+                for_each_vertex_parallel(m, [&](VertexID v) {
+                    new_vec.unchecked(v) = smoothed_value(m, vec, v);
+                });
                 swap(vec,new_vec);
             }		
         }
+
+        /// Mean curvature of a vertex which is not on the boundary, signed by the vertex normal.
+        double signed_mean_curvature(const Manifold& m, VertexID v)
+        {
+            Vec3d N = -mean_curvature_normal(m, v);
+            return length(N) * sign(dot(N,Vec3d(normal(m, v))));
+        }
+
+        /** Principal curvatures and directions of a vertex from a paraboloid fitted to its
+         neighbourhood. They are zero on the boundary. */
+        void principal_curvatures_paraboloid(const Manifold& m, VertexID v, Vec3d& min_curv_direction,
+                                             Vec3d& max_curv_direction, Vec2d& curvature)
+        {
+            if(boundary(m, v)) {
+                min_curv_direction = max_curv_direction = Vec3d(0);
+                curvature = Vec2d(0);
+                return;
+            }
+            Mat2x2d tensor;
+            Mat3x3d frame;
+            curvature_tensor_paraboloid(m, v, tensor, frame);
+
+            // The eigenvectors which are not found for a zero eigenvalue complete the basis.
+            Mat2x2d Q(0),L(0);
+            int s = power_eigensolution(tensor, Q, L);
+            if(s == 0)
+                Q = Mat2x2d(1, 0, 0, 1);
+            else if(s == 1)
+                Q[1] = Vec2d(-Q[0][1], Q[0][0]);
+
+            int max_idx = 0;
+            int min_idx = 1;
+
+            if(abs(L[max_idx][max_idx])<abs(L[min_idx][min_idx])) swap(max_idx, min_idx);
+
+            Mat3x3d frame_t = transpose(frame);
+
+            max_curv_direction = cond_normalize(frame_t * Vec3d(Q[max_idx][0], Q[max_idx][1], 0));
+
+            min_curv_direction = cond_normalize(frame_t * Vec3d(Q[min_idx][0], Q[min_idx][1], 0));
+
+            curvature[0] = L[min_idx][min_idx];
+            curvature[1] = L[max_idx][max_idx];
+        }
     }
 
     double mixed_area(const Manifold& m, VertexID v)
@@ -202,8 +263,11 @@ namespace HMesh
     
     void curvature_tensor_paraboloid(const Manifold& m, VertexID v, Mat2x2d& curv_tensor, Mat3x3d& frame)
     {
-        if(boundary(m, v))
+        if(boundary(m, v)) {
+            curv_tensor = Mat2x2d(0);
+            frame = identity_Mat3x3d();
             return;
+        }
         // First estimate the normal and compute a transformation matrix
         // which takes us into tangent plane coordinates.
         Vec3d Norm = Vec3d(normal(m, v));
@@ -265,20 +329,21 @@ namespace HMesh
 
     void gaussian_curvature_angle_defects(const Manifold& m, VertexAttributeVector<double>& curvature, int smooth_steps)
     {
-        for(VertexIDIterator v = m.vertices_begin(); v != m.vertices_end(); ++v)
-            curvature[*v] = gaussian_curvature_angle_defect(m, *v);
+        reserve_vertices(m, curvature);
+        for_each_vertex_parallel(m, [&](VertexID v) {
+            curvature.unchecked(v) = gaussian_curvature_angle_defect(m, v);
+        });
 
         smooth_something_on_mesh(m, curvature, smooth_steps);
     }
 
     void mean_curvatures(const Manifold& m, VertexAttributeVector<double>& curvature, int smooth_steps)
     {
-        for(VertexIDIterator v = m.vertices_begin(); v != m.vertices_end(); ++v)
-			if(!boundary(m,*v))
-			{
-				Vec3d N = -mean_curvature_normal(m, *v);
-				curvature[*v] = length(N) * sign(dot(N,Vec3d(normal(m, *v))));
-			}	
+        reserve_vertices(m, curvature);
+        for_each_vertex_parallel(m, [&](VertexID v) {
+            if(!boundary(m, v))
+                curvature.unchecked(v) = signed_mean_curvature(m, v);
+        });
         smooth_something_on_mesh(m, curvature, smooth_steps);	
     }
 
@@ -289,31 +354,13 @@ namespace HMesh
                                 VertexAttributeVector<Vec2d>& curvature)
     {
 
-        for(VertexIDIterator v = m.vertices_begin(); v != m.vertices_end(); ++v){
-            Mat2x2d tensor;
-            Mat3x3d frame;
-            curvature_tensor_paraboloid(m, *v, tensor, frame);
-
-            Mat2x2d Q,L;
-            int s = power_eigensolution(tensor, Q, L);
-
-            if(s < 2)	
-                cout << tensor << Q << L << endl;
-
-            int max_idx = 0;
-            int min_idx = 1;
-
-            if(abs(L[max_idx][max_idx])<abs(L[min_idx][min_idx])) swap(max_idx, min_idx);
-
-            Mat3x3d frame_t = transpose(frame);
-
-            max_curv_direction[*v] = cond_normalize(frame_t * Vec3d(Q[max_idx][0], Q[max_idx][1], 0));
-
-            min_curv_direction[*v] = cond_normalize(frame_t * Vec3d(Q[min_idx][0], Q[min_idx][1], 0));
-
-            curvature[*v][0] = L[min_idx][min_idx];
-            curvature[*v][1] = L[max_idx][max_idx];
-        }
+        reserve_vertices(m, min_curv_direction);
+        reserve_vertices(m, max_curv_direction);
+        reserve_vertices(m, curvature);
+        for_each_vertex_parallel(m, [&](VertexID v) {
+            principal_curvatures_paraboloid(m, v, min_curv_direction.unchecked(v), max_curv_direction.unchecked(v),
+                                            curvature.unchecked(v));
+        });
     }
 
 
@@ -371,5 +418,186 @@ namespace HMesh
         }
         //scal = 1.0/max_val;
     }
-}
 
+    CurvatureCache::CurvatureCache(Manifold& _m, int _quantities, int _smooth_steps):
+    m(_m), quantities(_quantities), smooth_steps(max(0, _smooth_steps)), all_dirty(true),
+    mean(quantities & MEAN ? smooth_steps + 1 : 0), gauss(quantities & GAUSSIAN ? smooth_steps + 1 : 0),
+    visited(0), search(0)
+    {}
+
+    void CurvatureCache::set_pos(VertexID v, const Vec3d& p)
+    {
+        m.pos(v) = p;
+        mark_dirty(v);
+    }
+
+    void CurvatureCache::flip_edge(HalfEdgeID h)
+    {
+        // The flip changes the one rings of the four vertices of the two triangles.
+        Walker w = m.walker(h);
+        const VertexID verts[4] = {w.vertex(), w.next().vertex(), w.opp().vertex(), w.opp().next().vertex()};
+        m.flip_edge(h);
+        for(VertexID v: verts)
+            mark_dirty(v);
+    }
+
+    void CurvatureCache::collapse_edge(HalfEdgeID h, bool avg_vertices)
+    {
+        // The remaining vertex inherits the one ring of the removed one, whose vertices all get a
+        // new neighbour.
+        const VertexID v = m.walker(h).vertex();
+        m.collapse_edge(h, avg_vertices);
+        mark_dirty(v);
+        circulate_vertex_ccw(m, v, [&](VertexID vn) { mark_dirty(vn); });
+    }
+
+    VertexID CurvatureCache::split_edge(HalfEdgeID h)
+    {
+        Walker w = m.walker(h);
+        const VertexID v0 = w.vertex(), v1 = w.opp().vertex();
+        const VertexID v = m.split_edge(h);
+        mark_dirty(v0);
+        mark_dirty(v1);
+        mark_dirty(v);
+        return v;
+    }
+
+    void CurvatureCache::mark_dirty(VertexID v)
+    {
+        if(all_dirty)
+            return;
+        // A long list of edits is cheaper to handle by recomputing everything.
+        if(dirty.size() >= m.no_vertices()) {
+            mark_all_dirty();
+            return;
+        }
+        dirty.push_back(v);
+    }
+
+    void CurvatureCache::mark_all_dirty()
+    {
+        all_dirty = true;
+        dirty.clear();
+    }
+
+    void CurvatureCache::recompute(const vector<VertexID>& verts, const vector<size_t>& ends)
+    {
+        for(auto& level: mean)
+            reserve_vertices(m, level);
+        for(auto& level: gauss)
+            reserve_vertices(m, level);
+        if(quantities & PRINCIPAL) {
+            reserve_vertices(m, principal);
+            reserve_vertices(m, min_dir);
+            reserve_vertices(m, max_dir);
+        }
+
+        // The curvature of a vertex only depends on the mesh, and the smoothed values of a vertex
+        // only depend on the previous level, so all the vertices of a level are done in parallel.
+        const size_t n_scalar = ends[min(size_t(1), ends.size()-1)];
+        const size_t n_principal = ends[min(size_t(2), ends.size()-1)];
+        Util::parallel_for_chunks(max(n_scalar, n_principal), [&](size_t b, size_t e) {
+            for(size_t i = b; i < e; ++i) {
+                const VertexID v = verts[i];
+                const bool bdry = boundary(m, v);
+                if(i < n_scalar && !mean.empty())
+                    mean[0].unchecked(v) = bdry ? 0.0 : signed_mean_curvature(m, v);
+                if(i < n_scalar && !gauss.empty())
+                    gauss[0].unchecked(v) = gaussian_curvature_angle_defect(m, v);
+                if(i < n_principal && (quantities & PRINCIPAL))
+                    principal_curvatures_paraboloid(m, v, min_dir.unchecked(v), max_dir.unchecked(v), principal.unchecked(v));
+            }
+        }, 256);
+        for(int level = 1; level <= smooth_steps; ++level) {
+            const size_t n_level = ends[min(size_t(1 + level), ends.size()-1)];
+            Util::parallel_for_chunks(n_level, [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i) {
+                    if(!mean.empty())
+                        mean[level].unchecked(verts[i]) = smoothed_value(m, mean[level-1], verts[i]);
+                    if(!gauss.empty())
+                        gauss[level].unchecked(verts[i]) = smoothed_value(m, gauss[level-1], verts[i]);
+                }
+            }, 256);
+        }
+    }
+
+    void CurvatureCache::update()
+    {
+        if(!all_dirty && dirty.empty())
+            return;
+
+        vector<VertexID> verts;
+        vector<size_t> ends;
+        if(all_dirty) {
+            verts.assign(m.vertices().begin(), m.vertices().end());
+            ends.push_back(verts.size());
+        }
+        else {
+            // Breadth first search from the dirty vertices out to the distance at which the
+            // curvature can have changed.
+            const int max_dist = max(quantities & (MEAN | GAUSSIAN) ? 1 + smooth_steps : 0,
+                                     quantities & PRINCIPAL ? 2 : 0);
+            if(visited.size() < m.allocated_vertices())
+                visited.resize(m.allocated_vertices(), 0);
+            if(++search == 0) {
+                visited.resize(0);
+                visited.resize(m.allocated_vertices(), 0);
+                search = 1;
+            }
+            for(VertexID v: dirty)
+                if(m.in_use(v) && visited[v] != search) {
+                    visited[v] = search;
+                    verts.push_back(v);
+                }
+            ends.push_back(verts.size());
+            for(int d = 1; d <= max_dist; ++d) {
+                for(size_t i = d > 1 ? ends[d-2] : 0; i < ends[d-1]; ++i)
+                    circulate_vertex_ccw(m, verts[i], [&](VertexID vn) {
+                        if(visited[vn] != search) {
+                            visited[vn] = search;
+                            verts.push_back(vn);
+                        }
+                    });
+                ends.push_back(verts.size());
+            }
+        }
+        recompute(verts, ends);
+        all_dirty = false;
+        dirty.clear();
+    }
+
+    const VertexAttributeVector<double>& CurvatureCache::mean_curvatures()
+    {
+        assert(quantities & MEAN);
+        update();
+        return mean.back();
+    }
+
+    const VertexAttributeVector<double>& CurvatureCache::gaussian_curvatures()
+    {
+        assert(quantities & GAUSSIAN);
+        update();
+        return gauss.back();
+    }
+
+    const VertexAttributeVector<Vec2d>& CurvatureCache::principal_curvatures()
+    {
+        assert(quantities & PRINCIPAL);
+        update();
+        return principal;
+    }
+
+    const VertexAttributeVector<Vec3d>& CurvatureCache::min_curvature_directions()
+    {
+        assert(quantities & PRINCIPAL);
+        update();
+        return min_dir;
+    }
+
+    const VertexAttributeVector<Vec3d>& CurvatureCache::max_curvature_directions()
+    {
+        assert(quantities & PRINCIPAL);
+        update();
+        return max_dir;
+    }
+}
@@ -13,7 +13,10 @@
 #define __MESHEDIT_CURVATURE_H__
 
 #include <vector>
+#include "../CGLA/Vec2d.h"
+#include "../CGLA/Vec3d.h"
 #include "Manifold.h"
+#include "AttributeVector.h"
 
 namespace CGLA
 {
@@ -57,7 +60,8 @@ namespace HMesh
     CGLA::Mat3x3d curvature_tensor_from_edge( const Manifold& m, 
                                               HalfEdgeID h);
 
-
+    /** Curvature tensor of v in the tangent frame from a paraboloid fitted to the one ring. On the
+     boundary, the tensor is zero and the frame the identity. */
     void curvature_tensor_paraboloid(   const Manifold& m, 
                                         VertexID v,
                                         CGLA::Mat2x2d& curv_tensor, 
@@ -77,7 +81,9 @@ namespace HMesh
                             VertexAttributeVector<double>& curvature,
                             int smooth_steps=0);
 
-
+    /** Principal curvatures and directions from a paraboloid fitted to the neighbourhood of each
+     vertex. The vertices are done in parallel. The curvatures and directions are zero on the
+     boundary, where the one ring does not surround the vertex. */
     void curvature_paraboloids( const Manifold& m, 
                                 VertexAttributeVector<CGLA::Vec3d>& min_curv_direction, 
                                 VertexAttributeVector<CGLA::Vec3d>& max_curv_direction, 
@@ -91,6 +97,91 @@ namespace HMesh
                                 VertexAttributeVector<CGLA::Vec2d>& curvature);
 
 
+    /** \brief Curvature of a mesh which is kept up to date while the mesh is edited.
+
+     The cache holds the mean curvature and the Gaussian curvature of every vertex, as computed
+     by mean_curvatures and gaussian_curvature_angle_defects with smooth_steps smoothing steps,
+     and the principal curvatures and directions as computed by curvature_paraboloids. The
+     quantities are zero on the boundary.
+
+     Edits are made through the cache, or the vertices whose position or one ring was changed
+     otherwise are marked with mark_dirty. When a curvature is requested, only the curvature of
+     the vertices near the marked ones is recomputed. The mean and Gaussian curvatures depend on
+     the one ring, so the neighbours of a marked vertex are recomputed as well. The principal
+     curvatures depend on the two ring, and each smoothing step adds a ring. If the whole mesh
+     must be recomputed, it is done in parallel. After Manifold::cleanup, or any other edit which
+     renumbers the vertices, call mark_all_dirty. */
+    class CurvatureCache
+    {
+    public:
+        /// The quantities which the cache can hold.
+        enum Quantity { MEAN = 1, GAUSSIAN = 2, PRINCIPAL = 4, ALL = 7 };
+
+        /** Cache the curvature of m. quantities says which of the quantities in Quantity are kept,
+         and smooth_steps is the number of times the mean and Gaussian curvatures are smoothed. */
+        CurvatureCache(Manifold& m, int quantities = ALL, int smooth_steps = 0);
+
+        /// Move v to p.
+        void set_pos(VertexID v, const CGLA::Vec3d& p);
+
+        /// Flip h as Manifold::flip_edge.
+        void flip_edge(HalfEdgeID h);
+
+        /// Collapse h as Manifold::collapse_edge. The caller must check precond_collapse_edge.
+        void collapse_edge(HalfEdgeID h, bool avg_vertices = false);
+
+        /// Split h as Manifold::split_edge and return the new vertex.
+        VertexID split_edge(HalfEdgeID h);
+
+        /// Mark v after it was moved or its one ring was changed without going through the cache.
+        void mark_dirty(VertexID v);
+
+        /// Recompute everything on the next request.
+        void mark_all_dirty();
+
+        /// Bring the curvatures up to date. The accessors below do this when necessary.
+        void update();
+
+        /// Mean curvature of every vertex.
+        const VertexAttributeVector<double>& mean_curvatures();
+
+        /// Gaussian curvature of every vertex.
+        const VertexAttributeVector<double>& gaussian_curvatures();
+
+        /// Minimum and maximum principal curvature of every vertex.
+        const VertexAttributeVector<CGLA::Vec2d>& principal_curvatures();
+
+        /// Direction of minimum principal curvature of every vertex.
+        const VertexAttributeVector<CGLA::Vec3d>& min_curvature_directions();
+
+        /// Direction of maximum principal curvature of every vertex.
+        const VertexAttributeVector<CGLA::Vec3d>& max_curvature_directions();
+
+        double mean_curvature(VertexID v) { return mean_curvatures()[v]; }
+        double gaussian_curvature(VertexID v) { return gaussian_curvatures()[v]; }
+
+    private:
+        /** Recompute the curvature of the vertices in verts, which are sorted by their distance in
+         edges to the nearest dirty vertex. ends[d] is the number of vertices at distance at most d. */
+        void recompute(const std::vector<VertexID>& verts, const std::vector<size_t>& ends);
+
+        Manifold& m;
+        int quantities;
+        int smooth_steps;
+        bool all_dirty;
+        std::vector<VertexID> dirty;
+
+        /// The scalar curvatures before smoothing and after each smoothing step.
+        std::vector<VertexAttributeVector<double>> mean;
+        std::vector<VertexAttributeVector<double>> gauss;
+        VertexAttributeVector<CGLA::Vec2d> principal;
+        VertexAttributeVector<CGLA::Vec3d> min_dir;
+        VertexAttributeVector<CGLA::Vec3d> max_dir;
+
+        /// Vertices visited by the search for the neighbourhood of the dirty vertices.
+        VertexAttributeVector<unsigned int> visited;
+        unsigned int search;
+    };
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,167 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file gel_format.h
+ * @brief Layout of the native binary GEL mesh format and attribute descriptors for it.
+ *
+ * A .gel file is a snapshot of the connectivity kernel of a Manifold. All allocated entities
+ * are stored - also the unused ones - so IDs are the same after loading, and attribute vectors
+ * indexed by the IDs of the saved mesh remain valid. The file consists of
+ *
+ * - a header: the magic string "GELMESH", the format version, a byte order mark, the numbers of
+ *   allocated vertices, faces, and halfedges, and the number of attribute records.
+ * - the outgoing halfedge of each vertex and the last halfedge of each face.
+ * - next, prev, opp, vert, and face of each halfedge.
+ * - the active flags of vertices, faces, and halfedges packed into 64 bit words.
+ * - the vertex positions.
+ * - the attribute records, each a small header followed by the name and the raw data.
+ *
+ * All indices are 64 bit, and every section starts on an 8 byte boundary. Invalid IDs are stored as
+ * GEL_INVALID_INDEX whatever the width of the indices in the kernel, so files can be exchanged between
+ * builds with and without HMESH_COMPACT_KERNEL.
+ */
+
+#ifndef __HMESH_GELFORMAT_H__
+#define __HMESH_GELFORMAT_H__
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include "ConnectivityKernel.h"
+#include "AttributeVector.h"
+
+namespace HMesh
+{
+    /// Current version of the native binary mesh format.
+    const uint32_t GEL_FORMAT_VERSION = 1;
+
+    /// Written as is in the header. A file with a different byte order is rejected on load.
+    const uint32_t GEL_BYTE_ORDER_MARK = 0x01020304;
+
+    /// Value used in a .gel file for invalid IDs.
+    const uint64_t GEL_INVALID_INDEX = ~uint64_t(0);
+
+    /// Magic string at the beginning of every .gel file (including the terminating zero).
+    const char GEL_MAGIC[8] = {'G','E','L','M','E','S','H','\0'};
+
+    /// Fixed size header of a .gel file.
+    struct GELHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t no_vertices;
+        uint64_t no_faces;
+        uint64_t no_halfedges;
+        uint64_t no_attributes;
+    };
+
+    /// Header of an attribute record. It is followed by the name and the data, both padded to 8 bytes.
+    struct GELAttributeHeader
+    {
+        uint32_t kind;
+        uint32_t name_length;
+        uint64_t item_size;
+        uint64_t no_items;
+    };
+
+    /** A named attribute vector to be saved with or loaded along with a mesh in the .gel format.
+     The descriptor refers to the attribute vector which must outlive it. Only attribute vectors
+     of trivially copyable types (numbers, CGLA vectors, etc.) can be stored since the contents
+     are written as raw bytes. When loading, the attribute vector is filled if the file contains
+     an attribute of the same name, kind, and item size. */
+    class GELAttribute
+    {
+    public:
+        /// The type of entity which the attribute is associated with.
+        enum Kind {VERTEX = 0, FACE = 1, HALFEDGE = 2};
+
+        /// Describe a vertex attribute vector.
+        template<typename T>
+        GELAttribute(const std::string& _name, VertexAttributeVector<T>& av):
+        name(_name), kind(VERTEX), item_size(sizeof(T)) { bind<T, VertexID>(av); }
+
+        /// Describe a vertex attribute vector which can only be saved, since assign is not set.
+        template<typename T>
+        GELAttribute(const std::string& _name, const VertexAttributeVector<T>& av):
+        name(_name), kind(VERTEX), item_size(sizeof(T)) { bind_const<T, VertexID>(av); }
+
+        /// Describe a face attribute vector.
+        template<typename T>
+        GELAttribute(const std::string& _name, FaceAttributeVector<T>& av):
+        name(_name), kind(FACE), item_size(sizeof(T)) { bind<T, FaceID>(av); }
+
+        /// Describe a face attribute vector which can only be saved.
+        template<typename T>
+        GELAttribute(const std::string& _name, const FaceAttributeVector<T>& av):
+        name(_name), kind(FACE), item_size(sizeof(T)) { bind_const<T, FaceID>(av); }
+
+        /// Describe a halfedge attribute vector.
+        template<typename T>
+        GELAttribute(const std::string& _name, HalfEdgeAttributeVector<T>& av):
+        name(_name), kind(HALFEDGE), item_size(sizeof(T)) { bind<T, HalfEdgeID>(av); }
+
+        /// Describe a halfedge attribute vector which can only be saved.
+        template<typename T>
+        GELAttribute(const std::string& _name, const HalfEdgeAttributeVector<T>& av):
+        name(_name), kind(HALFEDGE), item_size(sizeof(T)) { bind_const<T, HalfEdgeID>(av); }
+
+        /** Describe an attribute of the given kind and item size. The functions size, data, and
+         assign must be set before the descriptor is used. */
+        GELAttribute(const std::string& _name, Kind _kind, size_t _item_size):
+        name(_name), kind(_kind), item_size(_item_size) {}
+
+        /// Name under which the attribute is stored.
+        std::string name;
+
+        /// Type of entity.
+        Kind kind;
+
+        /// Size in bytes of a single attribute value.
+        size_t item_size;
+
+        /// Number of attribute values in the attribute vector.
+        std::function<size_t()> size;
+
+        /// Raw pointer to the attribute values. Only valid if size() is non zero.
+        std::function<const char*()> data;
+
+        /** Replace the contents of the attribute vector with n values copied from src. Not set
+         for a descriptor of a const attribute vector. */
+        std::function<void(const char* src, size_t n)> assign;
+
+    private:
+        template<typename T, typename ID>
+        void bind_const(const AttributeVector<T, ID>& av)
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                          "Only trivially copyable attributes can be stored in the .gel format");
+            const AttributeVector<T, ID>* avp = &av;
+            size = [avp]() { return avp->size(); };
+            data = [avp]() { return reinterpret_cast<const char*>(&(*avp)[ID(0)]); };
+        }
+
+        template<typename T, typename ID>
+        void bind(AttributeVector<T, ID>& av)
+        {
+            bind_const<T, ID>(av);
+            AttributeVector<T, ID>* avp = &av;
+            assign = [avp](const char* src, size_t n) {
+                avp->clear();
+                if(n == 0)
+                    return;
+                // Growing through get keeps the default value of the attribute vector.
+                avp->get(ID(n-1));
+                memcpy(reinterpret_cast<char*>(&(*avp)[ID(0)]), src, n*sizeof(T));
+            };
+        }
+    };
+}
+
+#endif
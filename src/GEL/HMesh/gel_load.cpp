@@ -0,0 +1,200 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+#include "gel_load.h"
+#include "Manifold.h"
+#include "../Util/MappedFile.h"
+
+using namespace std;
+using namespace CGLA;
+
+namespace HMesh
+{
+    namespace
+    {
+        /// Sequential reader of the 8 byte aligned sections of a mapped file.
+        class SectionReader
+        {
+            const char* p;
+            const char* end;
+
+        public:
+            SectionReader(const char* _p, size_t size): p(_p), end(_p + size) {}
+
+            /** Returns a pointer to the next n bytes and skips past them and any padding.
+             Returns nullptr if the file is too short. */
+            const char* section(size_t n)
+            {
+                const size_t padded = n + (8 - n%8)%8;
+                if(padded < n || size_t(end-p) < padded)
+                    return nullptr;
+                const char* s = p;
+                p += padded;
+                return s;
+            }
+
+            template<typename T>
+            const T* array(size_t n)
+            {
+                if(n > size_t(-1)/sizeof(T))
+                    return nullptr;
+                return reinterpret_cast<const T*>(section(n*sizeof(T)));
+            }
+        };
+
+        inline bool valid_index(uint64_t i, size_t n)
+        {
+            return i < n || i == GEL_INVALID_INDEX;
+        }
+
+        template<typename T>
+        inline ItemID<T> to_id(uint64_t i)
+        {
+            return i == GEL_INVALID_INDEX ? ItemID<T>() : ItemID<T>(typename ItemID<T>::IndexType(i));
+        }
+
+        inline bool is_active(const uint64_t* words, size_t i)
+        {
+            return (words[i/64] >> (i%64)) & 1;
+        }
+    }
+
+    bool gel_load(const string& filename, Manifold& m, const vector<GELAttribute>& attribs)
+    {
+        Util::MappedFile file(filename);
+        if(!file.is_valid())
+            return false;
+        SectionReader reader(file.data(), file.size());
+
+        const GELHeader* header = reader.array<GELHeader>(1);
+        if(header == nullptr ||
+           memcmp(header->magic, GEL_MAGIC, sizeof(GEL_MAGIC)) != 0 ||
+           header->version != GEL_FORMAT_VERSION ||
+           header->byte_order != GEL_BYTE_ORDER_MARK)
+            return false;
+
+        const size_t nv = header->no_vertices;
+        const size_t nf = header->no_faces;
+        const size_t nh = header->no_halfedges;
+        // The kernel may have been compiled with 32 bit indices.
+        const uint64_t max_items = uint64_t(ItemID<Vertex>::INVALID_INDEX);
+        if(nv >= max_items || nf >= max_items || nh >= max_items)
+            return false;
+        const uint64_t* out = reader.array<uint64_t>(nv);
+        const uint64_t* last = reader.array<uint64_t>(nf);
+        const uint64_t* hrec = reader.array<uint64_t>(5*nh);
+        const uint64_t* v_active = reader.array<uint64_t>((nv+63)/64);
+        const uint64_t* f_active = reader.array<uint64_t>((nf+63)/64);
+        const uint64_t* h_active = reader.array<uint64_t>((nh+63)/64);
+        const Vec3d* pos = reader.array<Vec3d>(nv);
+        if(!(out && last && hrec && v_active && f_active && h_active && pos))
+            return false;
+
+        // Reject files with dangling references rather than produce a mesh that crashes later.
+        for(size_t i=0;i<nv;++i)
+            if(!valid_index(out[i], nh))
+                return false;
+        for(size_t i=0;i<nf;++i)
+            if(!valid_index(last[i], nh))
+                return false;
+        for(size_t i=0;i<nh;++i) {
+            const uint64_t* rec = hrec + 5*i;
+            if(!(valid_index(rec[0], nh) && valid_index(rec[1], nh) && valid_index(rec[2], nh) &&
+                 valid_index(rec[3], nv) && valid_index(rec[4], nf)))
+                return false;
+        }
+
+        // Locate the attribute records before touching the mesh, so that m is left alone
+        // if the file turns out to be truncated.
+        struct Record { const GELAttributeHeader* header; const char* name; const char* data; };
+        vector<Record> records;
+        for(uint64_t a=0;a<header->no_attributes;++a) {
+            Record r;
+            r.header = reader.array<GELAttributeHeader>(1);
+            if(r.header == nullptr)
+                return false;
+            r.name = reader.section(r.header->name_length);
+            if(r.header->item_size != 0 && r.header->no_items > size_t(-1)/r.header->item_size)
+                return false;
+            r.data = reader.section(r.header->no_items * r.header->item_size);
+            if(r.name == nullptr || r.data == nullptr)
+                return false;
+            records.push_back(r);
+        }
+
+        ConnectivityKernel& kernel = m.kernel;
+        m.clear();
+        kernel.reserve(nv, nf, nh);
+        for(size_t i=0;i<nv;++i)
+            kernel.add_vertex();
+        for(size_t i=0;i<nf;++i)
+            kernel.add_face();
+        for(size_t i=0;i<nh;++i)
+            kernel.add_halfedge();
+
+        for(size_t i=0;i<nv;++i)
+            kernel.set_out(VertexID(i), to_id<HalfEdge>(out[i]));
+        for(size_t i=0;i<nf;++i)
+            kernel.set_last(FaceID(i), to_id<HalfEdge>(last[i]));
+        for(size_t i=0;i<nh;++i) {
+            HalfEdgeID h(i);
+            const uint64_t* rec = hrec + 5*i;
+            kernel.set_next(h, to_id<HalfEdge>(rec[0]));
+            kernel.set_prev(h, to_id<HalfEdge>(rec[1]));
+            kernel.set_opp(h, to_id<HalfEdge>(rec[2]));
+            kernel.set_vert(h, to_id<Vertex>(rec[3]));
+            kernel.set_face(h, to_id<Face>(rec[4]));
+        }
+
+        for(size_t i=0;i<nv;++i)
+            if(!is_active(v_active, i))
+                kernel.remove_vertex(VertexID(i));
+        for(size_t i=0;i<nf;++i)
+            if(!is_active(f_active, i))
+                kernel.remove_face(FaceID(i));
+        for(size_t i=0;i<nh;++i)
+            if(!is_active(h_active, i))
+                kernel.remove_halfedge(HalfEdgeID(i));
+
+        if(nv>0) {
+            m.positions.get(VertexID(nv-1));
+            memcpy(reinterpret_cast<char*>(&m.positions[VertexID(0)]), pos, nv*sizeof(Vec3d));
+        }
+
+        vector<bool> claimed(records.size(), false);
+        for(const GELAttribute& a: attribs) {
+            // A descriptor of a const attribute vector cannot be loaded into.
+            if(!a.assign)
+                continue;
+            a.assign(nullptr, 0);
+            for(size_t i=0;i<records.size();++i) {
+                const Record& r = records[i];
+                if(r.header->kind == uint32_t(a.kind) && r.header->item_size == a.item_size &&
+                   a.name.compare(0, string::npos, r.name, r.header->name_length) == 0) {
+                    a.assign(r.data, r.header->no_items);
+                    claimed[i] = true;
+                    break;
+                }
+            }
+        }
+
+        // The remaining attributes become attribute layers of the mesh.
+        m.grow_attributes();
+        for(size_t i=0;i<records.size();++i) {
+            const Record& r = records[i];
+            if(!claimed[i] && r.header->kind <= GELAttribute::HALFEDGE)
+                m.attributes.load(string(r.name, r.header->name_length),
+                                  GELAttribute::Kind(r.header->kind),
+                                  r.header->item_size, r.data, r.header->no_items);
+        }
+        return true;
+    }
+
+    bool gel_load(const string& filename, Manifold& m)
+    {
+        return gel_load(filename, m, vector<GELAttribute>());
+    }
+}
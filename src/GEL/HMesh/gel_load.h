@@ -0,0 +1,36 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file gel_load.h
+ * @brief Load Manifold from the native binary GEL format.
+ */
+
+#ifndef __HMESH_GELLOAD__H__
+#define __HMESH_GELLOAD__H__
+
+#include <string>
+#include <vector>
+#include "gel_format.h"
+
+namespace HMesh
+{
+    class Manifold;
+
+    /** \brief Load a mesh saved with gel_save. The file is memory mapped and the connectivity
+     copied straight into the kernel, so no stitching takes place and all IDs are the same as in
+     the saved mesh. Any previous contents of m are discarded. The saved attributes become
+     attribute layers of m. Returns false if the file cannot be read, is not a .gel file, has a
+     different version or byte order, or is inconsistent. */
+    bool gel_load(const std::string&, Manifold& m);
+
+    /** \brief Load a mesh and the attribute vectors described by attribs. An attribute vector is
+     filled if the file contains an attribute with the same name, kind, and item size. Otherwise
+     it is cleared. Attributes in the file which are not described by attribs become attribute
+     layers of m. */
+    bool gel_load(const std::string&, Manifold& m, const std::vector<GELAttribute>& attribs);
+}
+#endif
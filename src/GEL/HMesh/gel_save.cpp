@@ -0,0 +1,140 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+#include <set>
+#include "gel_save.h"
+#include "Manifold.h"
+#include "../Util/Serialization.h"
+
+using namespace std;
+using namespace CGLA;
+
+namespace HMesh
+{
+    namespace
+    {
+        /// Write zero bytes until the number of bytes written, n, is a multiple of 8.
+        void pad(Serialization& ser, size_t n)
+        {
+            static const char zeros[8] = {0,0,0,0,0,0,0,0};
+            if(n%8)
+                ser.write(zeros, 8-n%8);
+        }
+
+        template<typename T>
+        inline uint64_t file_index(ItemID<T> id)
+        {
+            return id == ItemID<T>() ? GEL_INVALID_INDEX : uint64_t(id.index);
+        }
+
+        /// Pack the active flags of all allocated entities into 64 bit words.
+        template<typename T>
+        vector<uint64_t> pack_active(const ConnectivityKernel& kernel, size_t n)
+        {
+            vector<uint64_t> words((n+63)/64, 0);
+            for(size_t i=0;i<n;++i)
+                if(kernel.in_use(ItemID<T>(i)))
+                    words[i/64] |= uint64_t(1) << (i%64);
+            return words;
+        }
+
+        template<typename T>
+        void write_array(Serialization& ser, const vector<T>& v)
+        {
+            if(!v.empty())
+                ser.write(reinterpret_cast<const char*>(v.data()), v.size()*sizeof(T));
+        }
+    }
+
+    bool gel_save(const string& filename, const Manifold& m, const vector<GELAttribute>& extra_attribs)
+    {
+        vector<GELAttribute> attribs;
+        m.attributes.describe(attribs);
+        attribs.insert(attribs.end(), extra_attribs.begin(), extra_attribs.end());
+
+        set<pair<int, string>> names;
+        for(const GELAttribute& a: attribs)
+            if(!names.insert(make_pair(int(a.kind), a.name)).second)
+                return false;
+
+        Serialization ser(filename, ios_base::out | ios_base::trunc);
+        if(!ser.good())
+            return false;
+
+        const ConnectivityKernel& kernel = m.kernel;
+        const size_t nv = kernel.allocated_vertices();
+        const size_t nf = kernel.allocated_faces();
+        const size_t nh = kernel.allocated_halfedges();
+
+        GELHeader header;
+        memcpy(header.magic, GEL_MAGIC, sizeof(GEL_MAGIC));
+        header.version = GEL_FORMAT_VERSION;
+        header.byte_order = GEL_BYTE_ORDER_MARK;
+        header.no_vertices = nv;
+        header.no_faces = nf;
+        header.no_halfedges = nh;
+        header.no_attributes = attribs.size();
+        ser.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        vector<uint64_t> buf(nv);
+        for(size_t i=0;i<nv;++i)
+            buf[i] = file_index(kernel.out(VertexID(i)));
+        write_array(ser, buf);
+
+        buf.resize(nf);
+        for(size_t i=0;i<nf;++i)
+            buf[i] = file_index(kernel.last(FaceID(i)));
+        write_array(ser, buf);
+
+        buf.resize(5*nh);
+        for(size_t i=0;i<nh;++i) {
+            HalfEdgeID h(i);
+            uint64_t* rec = &buf[5*i];
+            rec[0] = file_index(kernel.next(h));
+            rec[1] = file_index(kernel.prev(h));
+            rec[2] = file_index(kernel.opp(h));
+            rec[3] = file_index(kernel.vert(h));
+            rec[4] = file_index(kernel.face(h));
+        }
+        write_array(ser, buf);
+        buf = vector<uint64_t>();
+
+        write_array(ser, pack_active<Vertex>(kernel, nv));
+        write_array(ser, pack_active<Face>(kernel, nf));
+        write_array(ser, pack_active<HalfEdge>(kernel, nh));
+
+        // The positions attribute vector may be shorter than the vertex kernel if some
+        // positions were never assigned.
+        const VertexAttributeVector<Vec3d>& pos = m.positions;
+        const size_t np = min(nv, pos.size());
+        if(np>0)
+            ser.write(reinterpret_cast<const char*>(&pos[VertexID(0)]), np*sizeof(Vec3d));
+        const Vec3d zero(0.0);
+        for(size_t i=np;i<nv;++i)
+            ser.write(reinterpret_cast<const char*>(&zero), sizeof(Vec3d));
+
+        for(const GELAttribute& a: attribs) {
+            GELAttributeHeader ah;
+            ah.kind = a.kind;
+            ah.name_length = uint32_t(a.name.size());
+            ah.item_size = a.item_size;
+            ah.no_items = a.size();
+            ser.write(reinterpret_cast<const char*>(&ah), sizeof(ah));
+            ser.write(a.name.data(), a.name.size());
+            pad(ser, a.name.size());
+            const size_t bytes = ah.no_items * ah.item_size;
+            if(bytes>0)
+                ser.write(a.data(), bytes);
+            pad(ser, bytes);
+        }
+        return ser.good();
+    }
+
+    bool gel_save(const string& filename, const Manifold& m)
+    {
+        return gel_save(filename, m, vector<GELAttribute>());
+    }
+}
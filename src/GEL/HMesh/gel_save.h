@@ -0,0 +1,34 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file gel_save.h
+ * @brief Save Manifold in the native binary GEL format.
+ */
+
+#ifndef __HMESH_GELSAVE__H__
+#define __HMESH_GELSAVE__H__
+
+#include <string>
+#include <vector>
+#include "gel_format.h"
+
+namespace HMesh
+{
+    class Manifold;
+
+    /** \brief Save a snapshot of the mesh in the native binary format (see gel_format.h).
+     The connectivity is stored exactly as it is in memory - including unused entities - so
+     the mesh can be loaded again without any rebuilding, and with the same IDs. The attribute
+     layers of the mesh (see Manifold::add_vertex_attribute) are saved too. */
+    bool gel_save(const std::string&, const Manifold& m);
+
+    /** \brief Save a snapshot of the mesh along with the attribute vectors described by attribs.
+     The names of the attributes must be unique for each kind of entity, also with respect to
+     the attribute layers of the mesh. */
+    bool gel_save(const std::string&, const Manifold& m, const std::vector<GELAttribute>& attribs);
+}
+#endif
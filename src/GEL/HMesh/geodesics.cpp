@@ -0,0 +1,220 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "geodesics.h"
+#include "ItemVector.h"
+#include "../Util/Parallel.h"
+
+using namespace std;
+using namespace CGLA;
+
+namespace HMesh
+{
+    namespace
+    {
+        /** The bit pattern of a non-negative double, read as an integer, has the same order as the
+         double itself. That lets the radix heap bucket distances by their highest differing bit. */
+        inline uint64_t key_of(double d)
+        {
+            uint64_t k;
+            memcpy(&k, &d, sizeof(k));
+            return k;
+        }
+
+        inline double dist_of(uint64_t k)
+        {
+            double d;
+            memcpy(&d, &k, sizeof(d));
+            return d;
+        }
+
+        /// Index of the bucket for key k when the last key popped was last.
+        inline int bucket_of(uint64_t k, uint64_t last)
+        {
+            return k == last ? 0 : highest_bit(k ^ last) + 1;
+        }
+
+        /** The distance at c through the triangle abc given the distances da and db at a and b.
+         The triangle is unfolded into the plane with a at the origin and b on the x-axis. The
+         front is then a circle around a virtual source s at distance da from a and db from b on
+         the other side of ab from c. The update is only valid if the straight line from s to c
+         passes through the edge ab. Otherwise DBL_MAX is returned, and the edges give the
+         distance. */
+        double triangle_update(const Vec3d& pa, double da, const Vec3d& pb, double db, const Vec3d& pc)
+        {
+            const Vec3d ab = pb - pa;
+            const Vec3d ac = pc - pa;
+            const double L = length(ab);
+            if(L == 0)
+                return DBL_MAX;
+            const double cx = dot(ac, ab) / L;
+            const double cy = length(cross(ab, ac)) / L;
+            const double sx = (da*da - db*db + L*L) / (2*L);
+            const double sy2 = da*da - sx*sx;
+            if(cy <= 0 || sy2 < 0)
+                return DBL_MAX;
+            const double sy = -sqrt(sy2);
+
+            // Where the line from s to c crosses the x-axis.
+            const double x = sx + (cx - sx) * (-sy) / (cy - sy);
+            if(x < 0 || x > L)
+                return DBL_MAX;
+
+            // Rounding must not let the front move backwards.
+            return max(sqrt(sqr(cx - sx) + sqr(cy - sy)), max(da, db));
+        }
+    }
+
+    GeodesicEngine::GeodesicEngine(const Manifold& _m, GeodesicMethod _method):
+    m(_m), method(_method), region(nullptr), nodes(_m.allocated_vertices(), Node()),
+    epoch(0), last_key(0), queue_size(0)
+    {}
+
+    void GeodesicEngine::push(double d, VertexID v)
+    {
+        const uint64_t k = key_of(d);
+        assert(k >= last_key);
+        buckets[bucket_of(k, last_key)].push_back(make_pair(k, v));
+        ++queue_size;
+    }
+
+    bool GeodesicEngine::pop(double& d, VertexID& v)
+    {
+        if(queue_size == 0)
+            return false;
+        if(buckets[0].empty()) {
+            // Move the least key of the first non-empty bucket to the front. All the keys of that
+            // bucket go to lower buckets relative to it, and every other key stays put.
+            int i = 1;
+            while(buckets[i].empty())
+                ++i;
+            uint64_t new_last = buckets[i][0].first;
+            for(const auto& item : buckets[i])
+                new_last = min(new_last, item.first);
+            last_key = new_last;
+            for(const auto& item : buckets[i])
+                buckets[bucket_of(item.first, last_key)].push_back(item);
+            buckets[i].clear();
+        }
+        d = dist_of(buckets[0].back().first);
+        v = buckets[0].back().second;
+        buckets[0].pop_back();
+        --queue_size;
+        return true;
+    }
+
+    void GeodesicEngine::relax(VertexID v, double d, VertexID from, VertexID src)
+    {
+        Node& n = nodes.unchecked(v);
+        if(n.epoch != epoch) {
+            if(region && !region->get(v))
+                return;
+            n.epoch = epoch;
+            n.dist = DBL_MAX;
+            n.frozen = false;
+        }
+        if(n.frozen || d >= n.dist)
+            return;
+        n.dist = d;
+        n.pred = from;
+        n.source = src;
+        push(d, v);
+    }
+
+    void GeodesicEngine::compute(VertexID source, double max_dist)
+    {
+        GeodesicQuery query;
+        query.sources.push_back(source);
+        query.max_dist = max_dist;
+        compute(query);
+    }
+
+    void GeodesicEngine::compute(const GeodesicQuery& query)
+    {
+        if(nodes.size() < m.allocated_vertices())
+            nodes.resize(m.allocated_vertices(), Node());
+
+        // Starting a new epoch invalidates every node at once. Only when the counter wraps around
+        // must the nodes be cleared.
+        if(++epoch == 0) {
+            for(size_t i = 0; i < nodes.size(); ++i)
+                nodes.unchecked(VertexID(i)).epoch = 0;
+            epoch = 1;
+        }
+        for(auto& b : buckets)
+            b.clear();
+        last_key = 0;
+        queue_size = 0;
+        order.clear();
+        region = query.region;
+
+        const double max_dist = query.max_dist;
+        for(size_t i = 0; i < query.sources.size(); ++i) {
+            const double d = i < query.source_dist.size() ? query.source_dist[i] : 0.0;
+            assert(d >= 0);
+            if(d <= max_dist)
+                relax(query.sources[i], d, InvalidVertexID, query.sources[i]);
+        }
+
+        const bool fast_marching = method == GEODESIC_FAST_MARCHING;
+        double d;
+        VertexID v;
+        while(pop(d, v)) {
+            Node& n = nodes.unchecked(v);
+            if(n.frozen || d != n.dist)
+                continue;
+            n.frozen = true;
+            order.push_back(v);
+            if(v == query.target)
+                break;
+
+            const Vec3d pv = m.pos(v);
+            const VertexID src = n.source;
+            for(Walker w = m.walker(v); !w.full_circle(); w = w.circulate_vertex_ccw()) {
+                const VertexID u = w.vertex();
+                const double du = d + length(m.pos(u) - pv);
+                if(du <= max_dist)
+                    relax(u, du, v, src);
+
+                // In the triangle v u x, one more vertex may be updated through the edge between
+                // v and whichever of u and x is already frozen.
+                if(!fast_marching || w.face() == InvalidFaceID || w.next().next().next().halfedge() != w.halfedge())
+                    continue;
+                const VertexID x = w.next().vertex();
+                const bool u_frozen = reached(u);
+                const bool x_frozen = reached(x);
+                if(u_frozen == x_frozen)
+                    continue;
+                const VertexID a = u_frozen ? u : x;
+                const VertexID c = u_frozen ? x : u;
+                const double dc = triangle_update(pv, d, m.pos(a), nodes.get(a).dist, m.pos(c));
+                if(dc <= max_dist)
+                    relax(c, dc, v, src);
+            }
+        }
+    }
+
+    void geodesic_batch(const Manifold& m, const vector<GeodesicQuery>& queries,
+                        const function<void(size_t, const GeodesicEngine&)>& f,
+                        GeodesicMethod method)
+    {
+        // The queries may differ a lot in cost, so each thread takes the next one when it is done.
+        atomic<size_t> next(0);
+        Util::parallel_tasks(Util::no_tasks(queries.size(), 1), [&](size_t) {
+            GeodesicEngine engine(m, method);
+            for(size_t i = next++; i < queries.size(); i = next++) {
+                engine.compute(queries[i]);
+                f(i, engine);
+            }
+        });
+    }
+}
@@ -0,0 +1,130 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file geodesics.h
+ * @brief Distance fields on meshes from one or more sources.
+ *
+ * GeodesicEngine computes the distance from a set of source vertices to the other vertices,
+ * either along the edges of the mesh or over the surface by fast marching. The engine keeps its
+ * buffers between computations and only touches the vertices that a computation reaches, so many
+ * small distance fields, e.g. for sampling or segmentation, cost time in proportion to their
+ * size rather than to the size of the mesh. Batches of computations run in parallel.
+ */
+
+#ifndef __HMESH_GEODESICS_H__
+#define __HMESH_GEODESICS_H__
+
+#include <cfloat>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Manifold.h"
+#include "AttributeVector.h"
+
+namespace HMesh
+{
+    /// How GeodesicEngine measures distance.
+    enum GeodesicMethod
+    {
+        GEODESIC_EDGE_GRAPH,    ///< Length of the shortest path along the edges (Dijkstra's algorithm).
+        GEODESIC_FAST_MARCHING  ///< Distance over the surface, approximated by fast marching on the triangles.
+    };
+
+    /// A distance computation. Only the sources are required.
+    struct GeodesicQuery
+    {
+        /// The vertices from which distance is measured.
+        std::vector<VertexID> sources;
+
+        /// Distance of each source, e.g. to offset the sources. All zero if empty.
+        std::vector<double> source_dist;
+
+        /// Vertices farther away than this are not reached.
+        double max_dist = DBL_MAX;
+
+        /// If valid, the computation stops as soon as the distance to this vertex is known.
+        VertexID target = InvalidVertexID;
+
+        /// If given, only vertices v with (*region)[v] nonzero are reached.
+        const VertexAttributeVector<int>* region = nullptr;
+    };
+
+    /** Computes distance fields on a mesh with buffers which are reused from one computation to
+     the next. Distances are only valid for the vertices reached by the last computation. The mesh
+     must not change while the engine is in use, except that vertices may be added. */
+    class GeodesicEngine
+    {
+    public:
+        GeodesicEngine(const Manifold& m, GeodesicMethod method = GEODESIC_EDGE_GRAPH);
+
+        /// Compute the distance field given by query.
+        void compute(const GeodesicQuery& query);
+
+        /// Compute the distance from source out to max_dist.
+        void compute(VertexID source, double max_dist = DBL_MAX);
+
+        /// Returns true if the last computation found the distance to v.
+        bool reached(VertexID v) const
+        {
+            return v.index < nodes.size() && nodes.get(v).epoch == epoch && nodes.get(v).frozen;
+        }
+
+        /// Distance to v, or DBL_MAX if v was not reached.
+        double dist(VertexID v) const { return reached(v) ? nodes.get(v).dist : DBL_MAX; }
+
+        /// The source nearest to v, or InvalidVertexID if v was not reached.
+        VertexID source(VertexID v) const { return reached(v) ? nodes.get(v).source : InvalidVertexID; }
+
+        /** The neighbour of v from which its distance was found, i.e. the previous vertex on the
+         shortest path along the edges. InvalidVertexID for sources and vertices not reached. */
+        VertexID pred(VertexID v) const { return reached(v) ? nodes.get(v).pred : InvalidVertexID; }
+
+        /// The vertices reached by the last computation in order of increasing distance.
+        const std::vector<VertexID>& reached_vertices() const { return order; }
+
+        GeodesicMethod get_method() const { return method; }
+
+    private:
+        struct Node
+        {
+            double dist = DBL_MAX;
+            VertexID pred;
+            VertexID source;
+            uint32_t epoch = 0;
+            bool frozen = false;
+        };
+
+        /// Give v the tentative distance d unless it already has a smaller one.
+        void relax(VertexID v, double d, VertexID from, VertexID source);
+
+        const Manifold& m;
+        GeodesicMethod method;
+        const VertexAttributeVector<int>* region;
+
+        /// A node is only valid if its epoch is that of the current computation.
+        VertexAttributeVector<Node> nodes;
+        uint32_t epoch;
+        std::vector<VertexID> order;
+
+        /// Radix heap of (distance, vertex) with one bucket per bit of the distance.
+        std::vector<std::pair<uint64_t, VertexID>> buckets[65];
+        uint64_t last_key;
+        size_t queue_size;
+
+        void push(double d, VertexID v);
+        bool pop(double& d, VertexID& v);
+    };
+
+    /** Run the queries in parallel. Every thread has its own engine, and f(i, engine) is called
+     with the engine holding the result of queries[i] right after it is computed. f is called
+     concurrently from several threads. The results do not depend on the number of threads. */
+    void geodesic_batch(const Manifold& m, const std::vector<GeodesicQuery>& queries,
+                        const std::function<void(size_t, const GeodesicEngine&)>& f,
+                        GeodesicMethod method = GEODESIC_EDGE_GRAPH);
+}
+
+#endif
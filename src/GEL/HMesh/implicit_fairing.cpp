@@ -0,0 +1,246 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <cmath>
+#include "implicit_fairing.h"
+#include "smooth.h"
+#include "../Util/Parallel.h"
+
+using namespace std;
+using namespace CGLA;
+
+namespace HMesh
+{
+    namespace
+    {
+        /// Rows per chunk in parallel loops over the rows of a matrix.
+        const size_t ROW_CHUNK_SIZE = 4096;
+
+        /** Returns the dot products of the three columns of a and b. The products are summed per
+         chunk of fixed size and the chunk sums are added in order, so the result does not depend
+         on the number of threads. */
+        Vec3d column_dots(const vector<Vec3d>& a, const vector<Vec3d>& b)
+        {
+            vector<Vec3d> partial((a.size() + ROW_CHUNK_SIZE - 1) / ROW_CHUNK_SIZE, Vec3d(0));
+            Util::parallel_for_chunks(a.size(), [&](size_t b_, size_t e) {
+                Vec3d sum(0);
+                for(size_t i = b_; i < e; ++i)
+                    sum += a[i] * b[i];
+                partial[b_ / ROW_CHUNK_SIZE] = sum;
+            }, ROW_CHUNK_SIZE);
+            Vec3d sum(0);
+            for(const Vec3d& p: partial)
+                sum += p;
+            return sum;
+        }
+
+        /// Call f(i) for every i in [0, n) in parallel.
+        template<typename Func>
+        void for_each_row_parallel(size_t n, const Func& f)
+        {
+            Util::parallel_for_chunks(n, [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i)
+                    f(i);
+            }, ROW_CHUNK_SIZE);
+        }
+    }
+
+    double SparseMatrix::get(size_t i, size_t j) const
+    {
+        double a = 0;
+        for(size_t k = row_start[i]; k < row_start[i+1]; ++k)
+            if(columns[k] == j)
+                a += values[k];
+        return a;
+    }
+
+    void SparseMatrix::multiply(const vector<Vec3d>& x, vector<Vec3d>& y) const
+    {
+        y.resize(rows());
+        for_each_row_parallel(rows(), [&](size_t i) {
+            Vec3d sum(0);
+            for(size_t k = row_start[i]; k < row_start[i+1]; ++k)
+                sum += values[k] * x[columns[k]];
+            y[i] = sum;
+        });
+    }
+
+    SparseMatrix laplacian_matrix(const Manifold& m, LaplacianWeights weights,
+                                  VertexAttributeVector<size_t>& index)
+    {
+        vector<VertexID> verts;
+        verts.reserve(m.no_vertices());
+        index.resize(m.allocated_vertices(), 0);
+        for(VertexID v: m.vertices()) {
+            index[v] = verts.size();
+            verts.push_back(v);
+        }
+        const size_t n = verts.size();
+
+        // Each row holds the diagonal followed by one entry per outgoing halfedge.
+        SparseMatrix L;
+        L.row_start.assign(n + 1, 0);
+        for_each_row_parallel(n, [&](size_t i) {
+            Walker w = m.walker(verts[i]);
+            L.row_start[i+1] = 1 + (w.halfedge() == InvalidHalfEdgeID ? 0 : valency(m, verts[i]));
+        });
+        for(size_t i = 0; i < n; ++i)
+            L.row_start[i+1] += L.row_start[i];
+        L.columns.resize(L.row_start[n]);
+        L.values.resize(L.row_start[n]);
+
+        for_each_row_parallel(n, [&](size_t i) {
+            size_t k = L.row_start[i];
+            const size_t diag = k++;
+            double w_sum = 0;
+            if(m.walker(verts[i]).halfedge() != InvalidHalfEdgeID)
+                circulate_vertex_ccw(m, verts[i], [&](Walker wv) {
+                    double w = 1.0;
+                    if(weights == COTANGENT_LAPLACIAN) {
+                        w = cot_weight(m, wv.halfedge());
+                        if(!(w > 0))
+                            w = 0;
+                    }
+                    L.columns[k] = index[wv.vertex()];
+                    L.values[k++] = -w;
+                    w_sum += w;
+                });
+            L.columns[diag] = i;
+            L.values[diag] = w_sum;
+        });
+        return L;
+    }
+
+    int pcg_solve(const SparseMatrix& A, const vector<Vec3d>& b, vector<Vec3d>& x,
+                  double tolerance, int max_iter)
+    {
+        const size_t n = A.rows();
+        x.resize(n, Vec3d(0));
+
+        vector<double> inv_diag(n);
+        for_each_row_parallel(n, [&](size_t i) {
+            const double d = A.get(i, i);
+            inv_diag[i] = d != 0 ? 1.0 / d : 1.0;
+        });
+
+        const Vec3d b_norm2 = column_dots(b, b);
+        const Vec3d threshold = sqr(tolerance) * b_norm2;
+        // A column of b which is zero has the solution zero.
+        for(int c = 0; c < 3; ++c)
+            if(b_norm2[c] == 0)
+                for_each_row_parallel(n, [&](size_t i) { x[i][c] = 0; });
+
+        vector<Vec3d> r, z(n), p(n), q;
+        A.multiply(x, r);
+        for_each_row_parallel(n, [&](size_t i) {
+            r[i] = b[i] - r[i];
+            z[i] = inv_diag[i] * r[i];
+            p[i] = z[i];
+        });
+        Vec3d rz = column_dots(r, z);
+        Vec3d r_norm2 = column_dots(r, r);
+
+        int iter = 0;
+        for(; iter < max_iter; ++iter) {
+            // Columns that have converged are left alone, so that they do not divide by zero.
+            bool active[3];
+            for(int c = 0; c < 3; ++c)
+                active[c] = r_norm2[c] > threshold[c];
+            if(!active[0] && !active[1] && !active[2])
+                break;
+
+            A.multiply(p, q);
+            const Vec3d pq = column_dots(p, q);
+            Vec3d alpha(0);
+            for(int c = 0; c < 3; ++c)
+                if(active[c] && pq[c] > 0)
+                    alpha[c] = rz[c] / pq[c];
+            for_each_row_parallel(n, [&](size_t i) {
+                x[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+                z[i] = inv_diag[i] * r[i];
+            });
+
+            const Vec3d rz_new = column_dots(r, z);
+            Vec3d beta(0);
+            for(int c = 0; c < 3; ++c)
+                if(active[c] && rz[c] > 0)
+                    beta[c] = rz_new[c] / rz[c];
+            for_each_row_parallel(n, [&](size_t i) {
+                p[i] = z[i] + beta * p[i];
+            });
+            rz = rz_new;
+            r_norm2 = column_dots(r, r);
+        }
+        return iter;
+    }
+
+    int ImplicitFairing::step(Manifold& m, double t)
+    {
+        VertexAttributeVector<size_t> index;
+        SparseMatrix A = laplacian_matrix(m, weights, index);
+        const size_t n = A.rows();
+
+        vector<VertexID> verts(n);
+        vector<Vec3d> pos(n);
+        vector<char> fixed(n);
+        for(VertexID v: m.vertices()) {
+            const size_t i = index[v];
+            verts[i] = v;
+            pos[i] = m.pos(v);
+            fixed[i] = boundary(m, v) || !(A.values[A.row_start[i]] > 0);
+        }
+
+        // Turn the Laplacian L into D + tL. The rows of fixed vertices become rows of the identity,
+        // and the terms of the free vertices that involve fixed vertices are moved to the right
+        // hand side, which keeps the matrix symmetric.
+        vector<Vec3d> b(n);
+        for_each_row_parallel(n, [&](size_t i) {
+            const size_t diag = A.row_start[i];
+            if(fixed[i]) {
+                for(size_t k = diag; k < A.row_start[i+1]; ++k)
+                    A.values[k] = 0;
+                A.values[diag] = 1;
+                b[i] = pos[i];
+                return;
+            }
+            b[i] = A.values[diag] * pos[i];
+            A.values[diag] *= 1 + t;
+            for(size_t k = diag + 1; k < A.row_start[i+1]; ++k) {
+                const size_t j = A.columns[k];
+                if(fixed[j]) {
+                    b[i] -= t * A.values[k] * pos[j];
+                    A.values[k] = 0;
+                }
+                else
+                    A.values[k] *= t;
+            }
+        });
+
+        vector<Vec3d> x = pos;
+        if(displacement.size() == n)
+            for_each_row_parallel(n, [&](size_t i) {
+                if(!fixed[i])
+                    x[i] += displacement[i];
+            });
+        const int iter = pcg_solve(A, b, x, tolerance, max_iter);
+
+        displacement.resize(n);
+        for_each_row_parallel(n, [&](size_t i) {
+            displacement[i] = x[i] - pos[i];
+            m.pos(verts[i]) = x[i];
+        });
+        return iter;
+    }
+
+    void implicit_fairing(Manifold& m, double t, int iter, LaplacianWeights weights)
+    {
+        ImplicitFairing fairing(weights);
+        for(int i = 0; i < iter; ++i)
+            fairing.step(m, t);
+    }
+}
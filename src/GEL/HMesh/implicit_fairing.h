@@ -0,0 +1,104 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file implicit_fairing.h
+ * @brief Sparse Laplacian matrices and implicit (backward Euler) fairing.
+ *
+ * Explicit smoothing such as laplacian_smooth moves each vertex a fraction of the way towards
+ * the average of its neighbours, so many passes are needed for a visible effect, and large steps
+ * are unstable. Implicit fairing instead solves the linear system
+ *
+ *     (D + t L) x' = D x
+ *
+ * where L is the Laplacian matrix of the mesh and D its diagonal. This is a backward Euler step
+ * of the diffusion equation, and it is stable for any t, so a single step with a large t has the
+ * effect of many explicit passes. The system is symmetric positive definite and is solved with a
+ * conjugate gradient method preconditioned with the diagonal.
+ */
+
+#ifndef __HMESH_IMPLICIT_FAIRING_H__
+#define __HMESH_IMPLICIT_FAIRING_H__
+
+#include <cstddef>
+#include <vector>
+#include "../CGLA/Vec3d.h"
+#include "Manifold.h"
+
+namespace HMesh
+{
+    /// The weights of the edges in a Laplacian matrix.
+    enum LaplacianWeights {UNIFORM_LAPLACIAN, COTANGENT_LAPLACIAN};
+
+    /** Square sparse matrix in compressed sparse row format. The entries of row i are
+     values[row_start[i]] ... values[row_start[i+1]-1], and their columns are stored in the same
+     positions of columns. */
+    struct SparseMatrix
+    {
+        std::vector<size_t> row_start = std::vector<size_t>(1, 0);
+        std::vector<size_t> columns;
+        std::vector<double> values;
+
+        /// Number of rows.
+        size_t rows() const { return row_start.size() - 1; }
+
+        /// Returns the entry in row i and column j. Zero if there is no such entry.
+        double get(size_t i, size_t j) const;
+
+        /// Compute y = Ax where A is this matrix. The rows are computed in parallel.
+        void multiply(const std::vector<CGLA::Vec3d>& x, std::vector<CGLA::Vec3d>& y) const;
+    };
+
+    /** Assemble the Laplacian matrix of m. Vertex v corresponds to row and column index[v], and
+     the vertices are numbered in the order of m.vertices(). The off diagonal entry of two
+     neighbouring vertices is minus the weight of their edge, and the diagonal entry of a vertex
+     is the sum of the weights of its edges, so the rows sum to zero and the matrix is symmetric.
+     With uniform weights every edge has weight one. Cotangent weights are computed with
+     cot_weight. A cotangent weight is negative if both angles opposite the edge are obtuse,
+     and such weights are set to zero, so that the matrix remains positive semidefinite. */
+    SparseMatrix laplacian_matrix(const Manifold& m, LaplacianWeights weights,
+                                  VertexAttributeVector<size_t>& index);
+
+    /** Solve Ax = b for the three columns of b at once with the conjugate gradient method
+     preconditioned with the diagonal of A. A must be symmetric positive definite. x holds the
+     initial guess, and the closer it is to the solution, the fewer iterations are needed. The
+     iteration stops when the residual of each column is less than tolerance times the norm of
+     that column of b, or after max_iter iterations. Returns the number of iterations. */
+    int pcg_solve(const SparseMatrix& A, const std::vector<CGLA::Vec3d>& b, std::vector<CGLA::Vec3d>& x,
+                  double tolerance = 1e-6, int max_iter = 1000);
+
+    /** Implicit fairing of a mesh. Boundary vertices and isolated vertices are kept fixed.
+     The fairing object remembers the displacement of the vertices in the last step, and as long
+     as the number of vertices is unchanged, the next step starts the solver from the current
+     positions plus that displacement. When fairing is applied once per frame to a mesh which
+     changes a little between frames, this warm start saves most of the iterations. */
+    class ImplicitFairing
+    {
+    public:
+        ImplicitFairing(LaplacianWeights _weights = COTANGENT_LAPLACIAN,
+                        double _tolerance = 1e-6, int _max_iter = 1000):
+        weights(_weights), tolerance(_tolerance), max_iter(_max_iter) {}
+
+        /** Take one backward Euler step of length t. A step of length t corresponds roughly to
+         t explicit steps of laplacian_smooth with weight one. The Laplacian is assembled from the
+         current positions. Returns the number of solver iterations. */
+        int step(Manifold& m, double t);
+
+        /// Forget the displacement of the last step, so that the next step starts from scratch.
+        void reset() { displacement.clear(); }
+
+    private:
+        LaplacianWeights weights;
+        double tolerance;
+        int max_iter;
+        std::vector<CGLA::Vec3d> displacement;
+    };
+
+    /// Take iter steps of implicit fairing of length t. See ImplicitFairing.
+    void implicit_fairing(Manifold& m, double t, int iter = 1, LaplacianWeights weights = COTANGENT_LAPLACIAN);
+}
+
+#endif
@@ -0,0 +1,407 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <vector>
+
+#include "isotropic_remesh.h"
+#include "AttributeVector.h"
+#include "mesh_optimization.h"
+#include "parallel_for.h"
+#include "triangulate.h"
+
+using namespace std;
+using namespace CGLA;
+
+namespace HMesh
+{
+    namespace
+    {
+        /// The point of the triangle abc closest to p. See Ericson, Real-Time Collision Detection, 5.1.5.
+        Vec3d closest_point_on_triangle(const Vec3d& p, const Vec3d& a, const Vec3d& b, const Vec3d& c)
+        {
+            const Vec3d ab = b - a;
+            const Vec3d ac = c - a;
+            const Vec3d ap = p - a;
+            const double d1 = dot(ab, ap);
+            const double d2 = dot(ac, ap);
+            if(d1 <= 0 && d2 <= 0)
+                return a;
+
+            const Vec3d bp = p - b;
+            const double d3 = dot(ab, bp);
+            const double d4 = dot(ac, bp);
+            if(d3 >= 0 && d4 <= d3)
+                return b;
+
+            const double vc = d1*d4 - d3*d2;
+            if(vc <= 0 && d1 >= 0 && d3 <= 0)
+                return a + (d1 / (d1 - d3)) * ab;
+
+            const Vec3d cp = p - c;
+            const double d5 = dot(ab, cp);
+            const double d6 = dot(ac, cp);
+            if(d6 >= 0 && d5 <= d6)
+                return c;
+
+            const double vb = d5*d2 - d1*d6;
+            if(vb <= 0 && d2 >= 0 && d6 <= 0)
+                return a + (d2 / (d2 - d6)) * ac;
+
+            const double va = d3*d6 - d5*d4;
+            if(va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+                return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+
+            const double denom = va + vb + vc;
+            if(denom <= 0)
+                return a;
+            return a + ab * (vb / denom) + ac * (vc / denom);
+        }
+
+        /// Square of the distance from p to the box from lo to hi. Zero if p is inside.
+        double sqr_dist_to_box(const Vec3d& p, const Vec3d& lo, const Vec3d& hi)
+        {
+            double d = 0;
+            for(int i = 0; i < 3; ++i)
+                d += sqr(max(0.0, max(lo[i] - p[i], p[i] - hi[i])));
+            return d;
+        }
+
+        /** A copy of the triangles of a mesh in a hierarchy of bounding boxes. The nodes are stored
+         in depth first order, so the left child of a node follows it, and a leaf holds at most four
+         triangles. The search for the closest point visits the nearer child first and skips a box
+         which is further away than the closest point found so far. Queries may be made from several
+         threads at once. */
+        class ReferenceSurface
+        {
+            struct Node
+            {
+                Vec3d lo, hi;
+                int first, count;   ///< The triangles of a leaf. count is zero for an interior node.
+                int right;          ///< Index of the right child of an interior node.
+            };
+
+            vector<Vec3d> pts;
+            vector<int> tris;
+            vector<int> order;
+            vector<Vec3d> centres;
+            vector<Node> nodes;
+
+            void build(int first, int count)
+            {
+                const int n = nodes.size();
+                nodes.push_back(Node());
+                Vec3d lo(DBL_MAX), hi(-DBL_MAX), c_lo(DBL_MAX), c_hi(-DBL_MAX);
+                for(int i = first; i < first + count; ++i) {
+                    const int* t = &tris[3*order[i]];
+                    for(int k = 0; k < 3; ++k) {
+                        lo = v_min(lo, pts[t[k]]);
+                        hi = v_max(hi, pts[t[k]]);
+                    }
+                    c_lo = v_min(c_lo, centres[order[i]]);
+                    c_hi = v_max(c_hi, centres[order[i]]);
+                }
+                nodes[n].lo = lo;
+                nodes[n].hi = hi;
+                nodes[n].first = first;
+                nodes[n].count = count;
+                if(count <= 4)
+                    return;
+
+                // Split at the median of the centres along the axis where they spread the most.
+                const Vec3d ext = c_hi - c_lo;
+                const int axis = ext[0] > ext[1] ? (ext[0] > ext[2] ? 0 : 2) : (ext[1] > ext[2] ? 1 : 2);
+                const int half = count / 2;
+                nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+                            [&](int a, int b) { return centres[a][axis] < centres[b][axis]; });
+                nodes[n].count = 0;
+                build(first, half);
+                nodes[n].right = nodes.size();
+                build(first + half, count - half);
+            }
+
+        public:
+            explicit ReferenceSurface(const Manifold& m)
+            {
+                VertexAttributeVector<int> idx(m.allocated_vertices(), -1);
+                for(auto v: m.vertices()) {
+                    idx[v] = pts.size();
+                    pts.push_back(m.pos(v));
+                }
+
+                // Faces with more than three sides are split into fans.
+                for(auto f: m.faces()) {
+                    Walker w = m.walker(f);
+                    const int i0 = idx[w.opp().vertex()];
+                    for(w = w.next(); w.next().halfedge() != m.walker(f).halfedge(); w = w.next())
+                        tris.insert(tris.end(), {i0, idx[w.opp().vertex()], idx[w.vertex()]});
+                }
+                const int no_tris = tris.size() / 3;
+                for(int t = 0; t < no_tris; ++t) {
+                    order.push_back(t);
+                    centres.push_back((pts[tris[3*t]] + pts[tris[3*t+1]] + pts[tris[3*t+2]]) / 3.0);
+                }
+                if(no_tris > 0)
+                    build(0, no_tris);
+            }
+
+            Vec3d closest_point(const Vec3d& p) const
+            {
+                if(nodes.empty())
+                    return p;
+                Vec3d best = p;
+                double best_sq_dist = DBL_MAX;
+                int stack[64];
+                int top = 0;
+                stack[top++] = 0;
+                while(top > 0) {
+                    const Node& node = nodes[stack[--top]];
+                    if(sqr_dist_to_box(p, node.lo, node.hi) >= best_sq_dist)
+                        continue;
+                    if(node.count > 0) {
+                        for(int i = node.first; i < node.first + node.count; ++i) {
+                            const int* t = &tris[3*order[i]];
+                            const Vec3d q = closest_point_on_triangle(p, pts[t[0]], pts[t[1]], pts[t[2]]);
+                            const double sq_dist = sqr_length(p - q);
+                            if(sq_dist < best_sq_dist) {
+                                best_sq_dist = sq_dist;
+                                best = q;
+                            }
+                        }
+                        continue;
+                    }
+                    const int left = &node - &nodes[0] + 1;
+                    const int right = node.right;
+                    const bool left_first = sqr_dist_to_box(p, nodes[left].lo, nodes[left].hi) <=
+                                            sqr_dist_to_box(p, nodes[right].lo, nodes[right].hi);
+                    stack[top++] = left_first ? right : left;
+                    stack[top++] = left_first ? left : right;
+                }
+                return best;
+            }
+        };
+
+        /** Is it allowed to collapse h, removing the vertex it leaves and moving the vertex it points
+         to to p? No edge may get longer than max_length, and no triangle may be turned over. */
+        bool collapse_keeps_shape(const Manifold& m, HalfEdgeID h, const Vec3d& p, double max_length)
+        {
+            Walker w0 = m.walker(h);
+            const VertexID ends[2] = {w0.opp().vertex(), w0.vertex()};
+            for(int i = 0; i < 2; ++i) {
+                const VertexID other = ends[1-i];
+                for(Walker w = m.walker(ends[i]); !w.full_circle(); w = w.circulate_vertex_ccw()) {
+                    const VertexID u = w.vertex();
+                    if(u == other)
+                        continue;
+                    if(length(m.pos(u) - p) > max_length)
+                        return false;
+                    const VertexID x = w.next().vertex();
+                    if(w.face() == InvalidFaceID || x == other)
+                        continue;
+                    const Vec3d& pv = m.pos(ends[i]);
+                    const Vec3d n_before = cross(m.pos(u) - pv, m.pos(x) - pv);
+                    const Vec3d n_after = cross(m.pos(u) - p, m.pos(x) - p);
+                    if(dot(n_before, n_after) <= 0)
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        /// Do the two triangles made by flipping h face the same way as the two triangles of h?
+        bool flip_keeps_shape(const Manifold& m, HalfEdgeID h)
+        {
+            Walker w = m.walker(h);
+            const Vec3d& a = m.pos(w.opp().vertex());
+            const Vec3d& b = m.pos(w.vertex());
+            const Vec3d& o0 = m.pos(w.next().vertex());
+            const Vec3d& o1 = m.pos(w.opp().next().vertex());
+            const Vec3d n = cross(b - a, o0 - a) + cross(a - b, o1 - b);
+            return dot(cross(o1 - a, o0 - a), n) > 0 && dot(cross(b - o1, o0 - o1), n) > 0;
+        }
+    }
+
+    void isotropic_remesh(Manifold& m, double target_length, int iterations)
+    {
+        assert(target_length > 0);
+        triangulate(m);
+        const ReferenceSurface ref(m);
+
+        const double max_length = 4.0/3.0 * target_length;
+        const double min_length = 4.0/5.0 * target_length;
+        // A vertex which has moved this far since its edges were queued has them queued again.
+        const double max_drift = 0.1 * target_length;
+        const ValencyEnergy valency_energy;
+
+        // The queue holds one halfedge of each edge which may be too long or too short.
+        HalfEdgeAttributeVector<int> queued(m.allocated_halfedges(), 0);
+        vector<HalfEdgeID> queue;
+        auto enqueue_edges = [&](VertexID v) {
+            for(Walker w = m.walker(v); !w.full_circle(); w = w.circulate_vertex_ccw())
+                if(!queued[w.halfedge()] && !queued[w.opp().halfedge()]) {
+                    queued[w.halfedge()] = 1;
+                    queue.push_back(w.halfedge());
+                }
+        };
+
+        // The vertices whose one-ring has changed since the last flip phase.
+        VertexAttributeVector<int> changed(m.allocated_vertices(), 0);
+        vector<VertexID> changed_vertices;
+        auto mark_changed = [&](VertexID v) {
+            if(!changed[v]) {
+                changed[v] = 1;
+                changed_vertices.push_back(v);
+            }
+        };
+
+        for(auto v: m.vertices()) {
+            enqueue_edges(v);
+            mark_changed(v);
+        }
+
+        VertexAttributeVector<double> drift(m.allocated_vertices(), 0.0);
+        vector<HalfEdgeID> short_edges, flips;
+        for(int iter = 0; iter < iterations; ++iter) {
+            // Split the long edges. The edges around a new vertex go to the back of the queue and
+            // are checked in turn, while the short edges are set aside for the collapses.
+            short_edges.clear();
+            for(size_t i = 0; i < queue.size(); ++i) {
+                const HalfEdgeID h = queue[i];
+                queued[h] = 0;
+                if(!m.in_use(h))
+                    continue;
+                const double l = length(m, h);
+                if(l < min_length)
+                    short_edges.push_back(h);
+                if(l <= max_length)
+                    continue;
+
+                Walker w = m.walker(h);
+                const FaceID f0 = w.face();
+                const FaceID f1 = w.opp().face();
+                const VertexID o0 = w.next().vertex();
+                const VertexID o1 = w.opp().next().vertex();
+                mark_changed(w.vertex());
+                mark_changed(w.opp().vertex());
+                const VertexID v = m.split_edge(h);
+                if(f0 != InvalidFaceID) {
+                    m.split_face_by_edge(f0, v, o0);
+                    mark_changed(o0);
+                }
+                if(f1 != InvalidFaceID) {
+                    m.split_face_by_edge(f1, v, o1);
+                    mark_changed(o1);
+                }
+                mark_changed(v);
+                enqueue_edges(v);
+            }
+            queue.clear();
+
+            // Collapse the short edges. A boundary vertex is never removed, and an interior edge
+            // between two boundary vertices is left alone, since collapsing it would join two
+            // holes or two parts of the same hole.
+            for(size_t i = 0; i < short_edges.size(); ++i) {
+                HalfEdgeID h = short_edges[i];
+                if(!m.in_use(h) || length(m, h) >= min_length)
+                    continue;
+                Walker w = m.walker(h);
+                const bool boundary_from = boundary(m, w.opp().vertex());
+                const bool boundary_to = boundary(m, w.vertex());
+                if(boundary_from && boundary_to)
+                    continue;
+                if(boundary_from)
+                    h = w.opp().halfedge();
+                w = m.walker(h);
+                const VertexID kept = w.vertex();
+                const Vec3d p = boundary_from || boundary_to ? m.pos(kept) : 0.5 * (m.pos(kept) + m.pos(w.opp().vertex()));
+                if(!collapse_keeps_shape(m, h, p, max_length) || !precond_collapse_edge(m, h))
+                    continue;
+
+                m.collapse_edge(h);
+                m.pos(kept) = p;
+                mark_changed(kept);
+                for(Walker wk = m.walker(kept); !wk.full_circle(); wk = wk.circulate_vertex_ccw()) {
+                    mark_changed(wk.vertex());
+                    if(length(m, wk.halfedge()) < min_length)
+                        short_edges.push_back(wk.halfedge());
+                }
+            }
+
+            // Flip edges around the changed vertices towards the ideal valency. A flip changes the
+            // valency of four vertices, so the other edges of the two triangles are tried again.
+            flips.clear();
+            for(VertexID v: changed_vertices)
+                if(m.in_use(v))
+                    circulate_vertex_ccw(m, v, [&](HalfEdgeID h) { flips.push_back(h); });
+            for(size_t i = 0; i < flips.size(); ++i) {
+                const HalfEdgeID h = flips[i];
+                if(!m.in_use(h) || boundary(m, h) || valency_energy.delta_energy(m, h) >= 0 ||
+                   !precond_flip_edge(m, h) || !flip_keeps_shape(m, h))
+                    continue;
+                m.flip_edge(h);
+                Walker w = m.walker(h);
+                for(const Walker& wf: {w.next(), w.prev(), w.opp().next(), w.opp().prev()}) {
+                    mark_changed(wf.vertex());
+                    flips.push_back(wf.halfedge());
+                }
+            }
+
+            // Move the interior vertices tangentially towards the centroid of their neighbours
+            // weighted by the areas around them, and project them onto the original surface.
+            VertexAttributeVector<double> vertex_area(m.allocated_vertices(), 0.0);
+            VertexAttributeVector<Vec3d> new_pos(m.allocated_vertices(), Vec3d(0));
+            for_each_vertex_parallel(m, [&](VertexID v) {
+                double a = 0;
+                for(Walker w = m.walker(v); !w.full_circle(); w = w.circulate_vertex_ccw())
+                    if(w.face() != InvalidFaceID)
+                        a += area(m, w.face());
+                vertex_area.unchecked(v) = a;
+            });
+            for_each_vertex_parallel(m, [&](VertexID v) {
+                Vec3d p = m.pos(v);
+                if(!boundary(m, v)) {
+                    Vec3d c(0);
+                    double weight_sum = 0;
+                    for(Walker w = m.walker(v); !w.full_circle(); w = w.circulate_vertex_ccw()) {
+                        const double a = vertex_area.unchecked(w.vertex());
+                        c += a * m.pos(w.vertex());
+                        weight_sum += a;
+                    }
+                    if(weight_sum > 0) {
+                        const Vec3d n = normal(m, v);
+                        Vec3d d = c / weight_sum - p;
+                        d -= n * dot(n, d);
+                        p = ref.closest_point(p + d);
+                    }
+                }
+                new_pos.unchecked(v) = p;
+            });
+            drift.resize(m.allocated_vertices(), 0.0);
+            for_each_vertex_parallel(m, [&](VertexID v) {
+                drift.unchecked(v) += length(new_pos.unchecked(v) - m.pos(v));
+                m.pos(v) = new_pos.unchecked(v);
+            });
+
+            // Queue the edges around the vertices which were changed or have moved far enough
+            // to make their edges too long or too short.
+            for(VertexID v: changed_vertices) {
+                changed[v] = 0;
+                drift[v] = 0;
+                if(m.in_use(v))
+                    enqueue_edges(v);
+            }
+            changed_vertices.clear();
+            for(auto v: m.vertices())
+                if(drift[v] > max_drift) {
+                    drift[v] = 0;
+                    enqueue_edges(v);
+                }
+        }
+        m.cleanup();
+    }
+}
@@ -0,0 +1,37 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file isotropic_remesh.h
+ * @brief Remeshing to triangles with edges of a given length.
+ */
+
+#ifndef __HMESH_ISOTROPIC_REMESH_H__
+#define __HMESH_ISOTROPIC_REMESH_H__
+
+#include "Manifold.h"
+
+namespace HMesh
+{
+    /** Remesh m so that its edges get close to target_length while the surface stays the same.
+     Each iteration splits edges longer than 4/3 of the target length, collapses edges shorter than
+     4/5 of it, flips edges towards valency six (four at the boundary), moves the vertices
+     tangentially towards the area weighted centroid of their neighbours, and finally projects
+     them onto the closest point of the original surface.
+
+     The edges that may need a split or a collapse are kept in a work queue from one phase to the
+     next. Only the edges around vertices which were changed, or which have moved a fair part of
+     the target length since their edges were last checked, are queued again, so the later
+     iterations do little work where the mesh has settled. The relaxation and the projection are
+     done in parallel. The closest points are found through a bounding box hierarchy of the
+     triangles of the original mesh.
+
+     Faces with more than three sides are triangulated first. The boundary vertices stay in place,
+     and boundary edges are split but never collapsed. The mesh is cleaned up at the end. */
+    void isotropic_remesh(Manifold& m, double target_length, int iterations=10);
+}
+
+#endif
@@ -14,6 +14,7 @@
 #include "x3d_load.h"
 #include "obj_load.h"
 #include "off_load.h"
+#include "gel_load.h"
 #include "cleanup.h"
 
 using namespace std;
@@ -39,6 +40,9 @@ namespace HMesh
         else if(file_name.substr(file_name.length()-4,file_name.length())==".off"){
             return off_load(file_name, mani);
         }
+        else if(file_name.substr(file_name.length()-4,file_name.length())==".gel"){
+            return gel_load(file_name, mani);
+        }
         return false;
     }
 }
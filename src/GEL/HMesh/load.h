@@ -20,7 +20,7 @@ namespace HMesh
 {
     class Manifold;
     
-    /// Load a geometry file. This could be a PLY, OBJ, X3D, or OFF file
+    /// Load a geometry file. This could be a PLY, OBJ, X3D, OFF, or native binary GEL file
     bool load(const std::string&, Manifold&);
     
 }
@@ -18,6 +18,7 @@
 #include "AttributeVector.h"
 #include "triangulate.h"
 #include "smooth.h"
+#include "../Util/Parallel.h"
 
 namespace HMesh
 {
@@ -128,6 +129,10 @@ namespace HMesh
     }
 	
 	
+	/** Random energy for randomize_mesh. It draws from gel_rand so that gel_srand makes the result
+	 repeatable, and gel_rand is not thread safe, so unlike the other energies it must not be used
+	 with priority_queue_optimization_parallel. It is only used by randomize_mesh, which runs the
+	 sequential simulated_annealing_optimization. */
 	class RandomEnergy: public EnergyFun
 	{
 	public:
@@ -172,7 +177,7 @@ namespace HMesh
 	}
 	
 	
-	void DihedralEnergy::compute_angles(const Manifold & m, HalfEdgeID h) const
+	DihedralEnergy::Angles DihedralEnergy::compute_angles(const Manifold & m, HalfEdgeID h) const
 	{
 		Walker w = m.walker(h);
 		
@@ -203,17 +208,19 @@ namespace HMesh
 		Vec3d fn1 = normalize(cross(vb-vc, vd-vc));
 		Vec3d fn2 = normalize(cross(vd-vc, va-vc));
 		
-		ab_12 = cos_ang(n1,n2);
-		ab_a1 = cos_ang(na,n1);
-		ab_b1 = cos_ang(nb,n1);
-		ab_2c = cos_ang(n2,nc);
-		ab_2d = cos_ang(n2,nd);
-		
-		aa_12 = cos_ang(fn1,fn2);
-		aa_b1 = cos_ang(nb,fn1);
-		aa_c1 = cos_ang(nc, fn1);
-		aa_2a = cos_ang(fn2, na);
-		aa_2d = cos_ang(fn2,nd);
+		Angles a;
+		a.ab_12 = cos_ang(n1,n2);
+		a.ab_a1 = cos_ang(na,n1);
+		a.ab_b1 = cos_ang(nb,n1);
+		a.ab_2c = cos_ang(n2,nc);
+		a.ab_2d = cos_ang(n2,nd);
+		
+		a.aa_12 = cos_ang(fn1,fn2);
+		a.aa_b1 = cos_ang(nb,fn1);
+		a.aa_c1 = cos_ang(nc, fn1);
+		a.aa_2a = cos_ang(fn2, na);
+		a.aa_2d = cos_ang(fn2,nd);
+		return a;
 	}
 	
 	double DihedralEnergy::energy(const Manifold& m, HalfEdgeID h) const
@@ -240,7 +247,7 @@ namespace HMesh
 	
 	double DihedralEnergy::delta_energy(const Manifold& m, HalfEdgeID h) const
 	{
-		compute_angles(m, h);
+		const Angles a = compute_angles(m, h);
 		
 		Walker w = m.walker(h);
 		
@@ -256,34 +263,34 @@ namespace HMesh
 		
 		if(use_alpha){
 			double before = 
-			edge_alpha_energy(va,vb,ab_12)
-			+edge_alpha_energy(va,vc,ab_a1)
-			+edge_alpha_energy(vc,vb,ab_b1)
-			+edge_alpha_energy(vd,vb,ab_2c)
-			+edge_alpha_energy(vd,va,ab_2d);
+			edge_alpha_energy(va,vb,a.ab_12)
+			+edge_alpha_energy(va,vc,a.ab_a1)
+			+edge_alpha_energy(vc,vb,a.ab_b1)
+			+edge_alpha_energy(vd,vb,a.ab_2c)
+			+edge_alpha_energy(vd,va,a.ab_2d);
 			
 			double after = 
-			edge_alpha_energy(vd,vc,aa_12)
-			+edge_alpha_energy(vb,vc,aa_b1)
-			+edge_alpha_energy(vd,vb,aa_c1)
-			+edge_alpha_energy(va,vc,aa_2a)
-			+edge_alpha_energy(vd,va,aa_2d);
+			edge_alpha_energy(vd,vc,a.aa_12)
+			+edge_alpha_energy(vb,vc,a.aa_b1)
+			+edge_alpha_energy(vd,vb,a.aa_c1)
+			+edge_alpha_energy(va,vc,a.aa_2a)
+			+edge_alpha_energy(vd,va,a.aa_2d);
 			
 			return (after-before);
 		}
 		double before = 
-		edge_c_energy(va,vb,ab_12)
-		+edge_c_energy(va,vc,ab_a1)
-		+edge_c_energy(vc,vb,ab_b1)
-		+edge_c_energy(vd,vb,ab_2c)
-		+edge_c_energy(vd,va,ab_2d);
+		edge_c_energy(va,vb,a.ab_12)
+		+edge_c_energy(va,vc,a.ab_a1)
+		+edge_c_energy(vc,vb,a.ab_b1)
+		+edge_c_energy(vd,vb,a.ab_2c)
+		+edge_c_energy(vd,va,a.ab_2d);
 		
 		double after = 
-		edge_c_energy(vd,vc,aa_12)
-		+edge_c_energy(vb,vc,aa_b1)
-		+edge_c_energy(vd,vb,aa_c1)
-		+edge_c_energy(va,vc,aa_2a)
-		+edge_c_energy(vd,va,aa_2d);
+		edge_c_energy(vd,vc,a.aa_12)
+		+edge_c_energy(vb,vc,a.aa_b1)
+		+edge_c_energy(vd,vb,a.aa_c1)
+		+edge_c_energy(va,vc,a.aa_2a)
+		+edge_c_energy(vd,va,a.aa_2d);
 		
 		return after-before;
 	}
@@ -329,6 +336,11 @@ namespace HMesh
         Vec3d vc_pos(m.pos(vc));
         Vec3d vd_pos(m.pos(vd));
 
+        // The rings are kept per thread, so the energy can be evaluated concurrently without
+        // allocating for every edge.
+        thread_local vector<Vec3d> va_ring_bef, va_ring_aft, vb_ring_bef, vb_ring_aft;
+        thread_local vector<Vec3d> vc_ring_bef, vc_ring_aft, vd_ring_bef, vd_ring_aft;
+
         for(Walker wv = m.walker(va); !wv.full_circle(); wv = wv.circulate_vertex_cw()){
             VertexID v = wv.vertex();
             Vec3d pos(m.pos(v));
@@ -594,6 +606,122 @@ namespace HMesh
 //		cout << endl;
 	}
 	
+    namespace
+    {
+        /// A flip considered in a round: the change in energy and the halfedge which is flipped.
+        typedef pair<double, HalfEdgeID> FlipCandidate;
+
+        /// The vertices of the two triangles sharing the edge of h.
+        void quad_vertices(const Manifold& m, HalfEdgeID h, VertexID verts[4])
+        {
+            Walker w = m.walker(h);
+            verts[0] = w.vertex();
+            verts[1] = w.next().vertex();
+            verts[2] = w.opp().vertex();
+            verts[3] = w.opp().next().vertex();
+        }
+    }
+
+    void priority_queue_optimization_parallel(Manifold& m, const EnergyFun& efun)
+    {
+        // As in priority_queue_optimization, a vertex takes part in a limited number of flips.
+        const int avgValence = 6;
+        VertexAttributeVector<int> flipCounter(m.allocated_vertices(), 0);
+        VertexAttributeVector<int> claimed(m.allocated_vertices(), 0);
+        HalfEdgeAttributeVector<int> listed(m.allocated_halfedges(), 0);
+        HalfEdgeAttributeVector<int> touched(m.allocated_halfedges(), 0);
+
+        // An edge is represented by its halfedge with the smaller ID. Flips do not change IDs.
+        auto edge = [&](HalfEdgeID h) {
+            HalfEdgeID ho = m.walker(h).opp().halfedge();
+            return h < ho ? h : ho;
+        };
+        vector<HalfEdgeID> edges;
+        for(HalfEdgeID h: m.halfedges())
+            if(h == edge(h) && !boundary(m, h))
+                edges.push_back(h);
+
+        // As in the serial version, the change in energy of an edge is only computed once for
+        // the candidates, and flips which were not chosen keep their computed change in energy.
+        vector<FlipCandidate> candidates, pending;
+        vector<HalfEdgeID> flips;
+        vector<int> valid;
+        for(int round = 1; !edges.empty() || !pending.empty(); ++round) {
+            // The energy is only read here, so the edges are evaluated concurrently.
+            candidates.resize(edges.size());
+            Util::parallel_for_chunks(edges.size(), [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i) {
+                    HalfEdgeID h = edges[i];
+                    double energy = DBL_MAX;
+                    if(precond_flip_edge(m, h)) {
+                        touched[h] = 1;
+                        if(flipCounter[m.walker(h).vertex()] < avgValence)
+                            energy = efun.delta_energy(m, h);
+                    }
+                    candidates[i] = FlipCandidate(energy, h);
+                }
+            }, 256);
+            candidates.erase(remove_if(candidates.begin(), candidates.end(),
+                                       [](const FlipCandidate& c) { return c.first >= -0.001; }),
+                             candidates.end());
+            candidates.insert(candidates.end(), pending.begin(), pending.end());
+            sort(candidates.begin(), candidates.end());
+
+            // Choose the best flips greedily such that no two share a vertex. Then neither can
+            // change the energy or the validity of the other. The cached changes in energy may
+            // be out of date, so the chosen flips are checked again, as in the serial version.
+            flips.clear();
+            pending.clear();
+            for(const FlipCandidate& c: candidates) {
+                VertexID verts[4];
+                quad_vertices(m, c.second, verts);
+                if(all_of(verts, verts+4, [&](VertexID v) { return claimed[v] != round; })) {
+                    for(VertexID v: verts)
+                        claimed[v] = round;
+                    flips.push_back(c.second);
+                }
+                else
+                    pending.push_back(c);
+            }
+
+            valid.resize(flips.size());
+            Util::parallel_for_chunks(flips.size(), [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i)
+                    valid[i] = precond_flip_edge(m, flips[i]) && efun.delta_energy(m, flips[i]) < -0.001;
+            }, 256);
+            size_t no_valid = 0;
+            for(size_t i = 0; i < flips.size(); ++i)
+                if(valid[i])
+                    flips[no_valid++] = flips[i];
+            flips.resize(no_valid);
+
+            // The flips touch disjoint parts of the mesh, so they are carried out concurrently.
+            Util::parallel_for_chunks(flips.size(), [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i) {
+                    flipCounter[m.walker(flips[i]).vertex()]++;
+                    m.flip_edge(flips[i]);
+                }
+            }, 256);
+
+            // The edges around the four vertices of each flip become candidates in the next
+            // round unless they have been evaluated already.
+            edges.clear();
+            for(HalfEdgeID h: flips) {
+                VertexID verts[4];
+                quad_vertices(m, h, verts);
+                for(VertexID v: verts)
+                    circulate_vertex_ccw(m, v, [&](HalfEdgeID hv) {
+                        HalfEdgeID e = edge(hv);
+                        if(!touched[e] && listed[e] != round && !boundary(m, e)) {
+                            listed[e] = round;
+                            edges.push_back(e);
+                        }
+                    });
+            }
+        }
+    }
+	
+	
 	void simulated_annealing_optimization(Manifold& m, const EnergyFun& efun, int max_iter)
 	{
 		gel_srand(0);
@@ -673,6 +801,12 @@ namespace HMesh
 			priority_queue_optimization(m, energy_fun);
 	}
 	
+	void minimize_dihedral_angle_parallel(Manifold& m, bool alpha, double gamma)
+	{
+		DihedralEnergy energy_fun(gamma, alpha);
+		priority_queue_optimization_parallel(m, energy_fun);
+	}
+	
 	void randomize_mesh(Manifold& m, int max_iter)
 	{
 		RandomEnergy energy_fun;
@@ -23,7 +23,9 @@ namespace HMesh
     //class Manifold;
     //class HalfEdgeID;
 
-    /// This class represents the energy of an edge. It is used in optimization schemes where edges are swapped (aka flipped). */
+    /** This class represents the energy of an edge. It is used in optimization schemes where edges are swapped (aka flipped).
+     The functions may be called concurrently from several threads as long as the mesh is not changed, so an energy
+     must not keep scratch space in mutable members. */
     class EnergyFun
     {
     public:
@@ -63,21 +65,23 @@ namespace HMesh
 			return pow(length(v1-v2)*(1-ca), 1.0f/gamma); 
 		}
 
-		void compute_angles(const HMesh::Manifold & m, HMesh::HalfEdgeID h) const;
-		
-
-
-		mutable double ab_12;
-		mutable double ab_a1;
-		mutable double ab_b1;
-		mutable double ab_2c;
-		mutable double ab_2d;
+		/// Cosines of the dihedral angles around an edge before (ab_) and after (aa_) it is flipped.
+		struct Angles
+		{
+			double ab_12;
+			double ab_a1;
+			double ab_b1;
+			double ab_2c;
+			double ab_2d;
+			
+			double aa_12;
+			double aa_b1;
+			double aa_c1;
+			double aa_2a;
+			double aa_2d;
+		};
 		
-		mutable double aa_12;
-		mutable double aa_b1;
-		mutable double aa_c1;
-		mutable double aa_2a;
-		mutable double aa_2d;
+		Angles compute_angles(const HMesh::Manifold & m, HMesh::HalfEdgeID h) const;
 		
 	public:
 		
@@ -90,22 +94,13 @@ namespace HMesh
 	
 		double min_angle(const HMesh::Manifold& m, HMesh::HalfEdgeID h) const
 		{
-			compute_angles(m, h);
-			return (std::min)((std::min)((std::min)((std::min)(aa_12, aa_b1), aa_c1), aa_2a), aa_2d);
+			const Angles a = compute_angles(m, h);
+			return (std::min)((std::min)((std::min)((std::min)(a.aa_12, a.aa_b1), a.aa_c1), a.aa_2a), a.aa_2d);
 		}		
 	};
 	
 	class CurvatureEnergy: public EnergyFun
 	{
-        mutable std::vector<CGLA::Vec3d> va_ring_bef;
-        mutable std::vector<CGLA::Vec3d> va_ring_aft;
-        mutable std::vector<CGLA::Vec3d> vb_ring_bef;
-        mutable std::vector<CGLA::Vec3d> vb_ring_aft;
-        mutable std::vector<CGLA::Vec3d> vc_ring_bef;
-        mutable std::vector<CGLA::Vec3d> vc_ring_aft;
-        mutable std::vector<CGLA::Vec3d> vd_ring_bef;
-        mutable std::vector<CGLA::Vec3d> vd_ring_aft;
-
 		double abs_mean_curv(const CGLA::Vec3d& v, const std::vector<CGLA::Vec3d>& ring) const;
 	public:
 		double delta_energy(const HMesh::Manifold& m, HMesh::HalfEdgeID h) const;
@@ -121,12 +116,23 @@ namespace HMesh
     /// Optimize in a greedy fashion.
     void priority_queue_optimization(Manifold& m, const EnergyFun& efun);
 
+    /** Optimize greedily in parallel. Instead of flipping one edge at a time, the optimization proceeds in rounds.
+     In each round, the change in energy is computed in parallel for the edges around the flips of the previous
+     round, a maximal set of the best flips which share no vertices is chosen, and these flips are carried out in
+     parallel. An energy must therefore only depend on the faces around the four vertices of the two triangles of
+     an edge, as all the energies above do. The result is close to, but not the same as, that of
+     priority_queue_optimization, and it does not depend on the number of threads. */
+    void priority_queue_optimization_parallel(Manifold& m, const EnergyFun& efun);
+
     /// Optimize with simulated annealing. Avoids getting trapped in local minima
     void simulated_annealing_optimization(Manifold& m, const EnergyFun& efun, int max_iter=10000);
 
     /// Minimize the angle between adjacent triangles. Almost the same as mean curvature minimization 
     void minimize_dihedral_angle(Manifold& m, int max_iter=10000, bool anneal=false, bool alpha=false, double gamma=4.0);
 
+    /// Minimize the angle between adjacent triangles using priority_queue_optimization_parallel.
+    void minimize_dihedral_angle_parallel(Manifold& m, bool alpha=false, double gamma=4.0);
+
     /// Minimizes mean curvature. This is really the same as dihedral angle optimization except that we weight by edge length 
     void minimize_curvature(Manifold& m, bool anneal=false);
 
@@ -139,7 +145,8 @@ namespace HMesh
     /// Tries to achieve valence 6 internally and 4 along edges.
     void optimize_valency(Manifold& m, bool anneal=false);
 
-    /// Make radom flips. Useful for generating synthetic test cases.
+    /** Make radom flips. Useful for generating synthetic test cases. The flips are drawn with gel_rand, so
+     gel_srand makes them repeatable, and the optimization runs on the calling thread only. */
     void randomize_mesh(Manifold& m, int max_iter);
 
     /// Perform many operations in order to equalize edge lengths.
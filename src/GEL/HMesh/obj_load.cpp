@@ -4,12 +4,16 @@
  * For license and list of authors, see ../../doc/intro.pdf
  * ----------------------------------------------------------------------- */
 
-#include <sstream>
-#include <fstream>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include "load.h"
 #include "obj_load.h"
 #include "Manifold.h"
-#include "cleanup.h"
+#include "../Util/MappedFile.h"
+#include "../Util/Parallel.h"
 
 using namespace std;
 using namespace CGLA;
@@ -17,78 +21,283 @@ using namespace CGLA;
 namespace HMesh
 {
     using std::string;
-    
-    void right_trim(std::string& str) {
-        while(isspace(str.back()))
-        str.pop_back();
-    }
-    
-    istream& get_multi_line(istream& is, string& buf) {
-        getline(is,buf);
-        right_trim(buf);
-        while(buf.back() == '\\') {
-            buf.pop_back();
-            string continuation;
-            getline(is, continuation);
-            right_trim(continuation);
-            buf += continuation;
-        }
-        return is;
-    }
-    
-    bool obj_load(const std::string& filename, Manifold& m, VertexAttributeVector<int>& orig_vertex_indices)
+
+    namespace
     {
-        ifstream obj_file(filename.data());
-        
-        if(obj_file)
+        /// Files smaller than this many bytes per thread are not worth splitting further.
+        const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+        inline bool is_space(char c) { return c==' ' || c=='\t' || c=='\r' || c=='\f' || c=='\v'; }
+        inline bool is_digit(char c) { return c>='0' && c<='9'; }
+
+        /// Powers of ten which are exactly representable as doubles.
+        const double EXACT_POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        /** Parse a double from [p, end). On success p is moved past the number. When the
+         decimal mantissa fits in 53 bits and the exponent is small, the result is a single
+         correctly rounded multiplication or division. Otherwise we fall back on strtod. */
+        bool parse_double(const char*& p, const char* end, double& x)
         {
-            string buf;
-            vector<Vec3d> vertices;
+            const char* s = p;
+            bool neg = false;
+            if(s<end && (*s=='-' || *s=='+'))
+                neg = (*s++ == '-');
+            uint64_t mantissa = 0;
+            int digits = 0, exp10 = 0;
+            bool any_digits = false;
+            for(;s<end && is_digit(*s); ++s, any_digits = true)
+                if(digits < 19) {
+                    mantissa = 10*mantissa + (*s-'0');
+                    if(mantissa) ++digits;
+                }
+                else ++exp10;
+            if(s<end && *s=='.')
+                for(++s;s<end && is_digit(*s); ++s, any_digits = true)
+                    if(digits < 19) {
+                        mantissa = 10*mantissa + (*s-'0');
+                        if(mantissa) ++digits;
+                        --exp10;
+                    }
+            if(any_digits && s<end && (*s=='e' || *s=='E')) {
+                const char* e = s+1;
+                bool eneg = false;
+                if(e<end && (*e=='-' || *e=='+'))
+                    eneg = (*e++ == '-');
+                if(e<end && is_digit(*e)) {
+                    int ev = 0;
+                    for(;e<end && is_digit(*e); ++e)
+                        ev = min(10*ev + (*e-'0'), 100000);
+                    exp10 += eneg ? -ev : ev;
+                    s = e;
+                }
+            }
+            if(any_digits && !(s<end && (*s=='x' || *s=='X'))
+               && mantissa < (uint64_t(1)<<53) && exp10 >= -22 && exp10 <= 22) {
+                double d = double(mantissa);
+                d = exp10 < 0 ? d / EXACT_POW10[-exp10] : d * EXACT_POW10[exp10];
+                x = neg ? -d : d;
+                p = s;
+                return true;
+            }
+
+            // Slow path: copy the token to terminate it and let strtod deal with it.
+            char buf[128];
+            size_t n = 0;
+            for(const char* t = p; t<end && !is_space(*t) && *t!='\n' && n<sizeof(buf)-1; ++t)
+                buf[n++] = *t;
+            buf[n] = 0;
+            char* stop;
+            x = strtod(buf, &stop);
+            if(stop == buf)
+                return false;
+            p += stop - buf;
+            return true;
+        }
+
+        /** Parse an integer in the way sscanf's %d would from the beginning of a token.
+         Values too large for an int are clamped to +/-INT_MAX. As indices they are out of
+         range, and build rejects them. */
+        inline bool parse_int(const char*& p, const char* end, int& x)
+        {
+            const char* s = p;
+            bool neg = false;
+            if(s<end && (*s=='-' || *s=='+'))
+                neg = (*s++ == '-');
+            if(!(s<end && is_digit(*s)))
+                return false;
+            long long v = 0;
+            for(;s<end && is_digit(*s); ++s)
+                v = min(10*v + (*s-'0'), (long long)(INT_MAX));
+            x = int(neg ? -v : v);
+            p = s;
+            return true;
+        }
+
+        /// Returns the end of the physical line starting at p, i.e. the position of '\n' or end.
+        inline const char* line_end(const char* p, const char* end)
+        {
+            const char* e = static_cast<const char*>(memchr(p, '\n', end-p));
+            return e ? e : end;
+        }
+
+        /// True if the line [b, e) ends with a backslash, possibly followed by white space.
+        inline bool is_continued(const char* b, const char* e)
+        {
+            while(e>b && is_space(e[-1]))
+                --e;
+            return e>b && e[-1]=='\\';
+        }
+
+        /// The records parsed from one chunk of the file.
+        struct OBJChunk
+        {
+            vector<double> vertices;
             vector<int> faces;
             vector<int> indices;
-            while(get_multi_line(obj_file,buf))
-            {
-                istringstream iss(move(buf));
-                string code;
-                if(iss>>code) {
-                    if(code == "v") {
-                        Vec3d v;
-                        iss >> v;
-                        vertices.push_back(v);
-                    }
-                    else if (code == "f") {
-                        string str;
-                        int ctr = 0;
-                        while(iss>>str) {
-                            int v,t,n;
-                            if(sscanf(str.c_str(), "%d/%d/%d", &v, &t, &n)==3 ||
-                               sscanf(str.c_str(), "%d//%d", &v, &n)==2 ||
-                               sscanf(str.c_str(), "%d/%d", &v, &t)==2 ||
-                               sscanf(str.c_str(), "%d", &v)==1) {
-                                indices.push_back(v>0?v-1:vertices.size()+v);
-                                ++ctr;
-                            }
+
+            /// Positions in indices which hold relative (negative) references to vertices
+            /// and must be offset by the number of vertices in preceding chunks.
+            vector<size_t> relative;
+        };
+
+        void parse_line(const char* p, const char* end, OBJChunk& chunk)
+        {
+            while(p<end && is_space(*p)) ++p;
+            // Only the records "v" and "f" are of interest, i.e. one letter followed by space.
+            if(p>=end || (p+1<end && !is_space(p[1])))
+                return;
+            if(*p == 'v') {
+                ++p;
+                double x[3] = {0,0,0};
+                for(int i=0;i<3;++i) {
+                    while(p<end && is_space(*p)) ++p;
+                    if(!parse_double(p, end, x[i]))
+                        break;
+                }
+                chunk.vertices.insert(chunk.vertices.end(), x, x+3);
+            }
+            else if(*p == 'f') {
+                ++p;
+                int ctr = 0;
+                const int no_vertices_so_far = int(chunk.vertices.size()/3);
+                while(true) {
+                    while(p<end && is_space(*p)) ++p;
+                    if(p>=end)
+                        break;
+                    int v;
+                    if(parse_int(p, end, v)) {
+                        if(v>0)
+                            chunk.indices.push_back(v-1);
+                        else {
+                            chunk.relative.push_back(chunk.indices.size());
+                            chunk.indices.push_back(no_vertices_so_far + v);
                         }
-                        faces.push_back(ctr);
+                        ++ctr;
                     }
+                    // skip texture and normal indices and whatever did not parse
+                    while(p<end && !is_space(*p)) ++p;
                 }
+                chunk.faces.push_back(ctr);
             }
-//            cout << "Loaded " << filename << " : " << vertices.size() << " vertices and "
-//            << faces.size() << " faces"<< endl;
-            m.clear();
-            
-            orig_vertex_indices = build(m, vertices.size(),
-                  reinterpret_cast<double*>(&vertices[0]),
-                  faces.size(),
-                  &faces[0],
-                  &indices[0]);
-            
-            return true;
         }
-        return false;
-        
+
+        /// Parse all lines in [p, end). The range must begin and end on logical line boundaries.
+        void parse_chunk(const char* p, const char* end, OBJChunk& chunk)
+        {
+            string buf;
+            while(p<end) {
+                const char* e = line_end(p, end);
+                if(!is_continued(p, e)) {
+                    parse_line(p, e, chunk);
+                    p = e+1;
+                    continue;
+                }
+                // A backslash continues the line. Trim every physical line, drop the backslash,
+                // and concatenate - precisely as the line based reader always did.
+                buf.clear();
+                while(true) {
+                    const char* t = e;
+                    while(t>p && is_space(t[-1])) --t;
+                    bool cont = t>p && t[-1]=='\\';
+                    buf.append(p, cont ? t-1 : t);
+                    p = e+1;
+                    if(!cont || p>=end)
+                        break;
+                    e = line_end(p, end);
+                }
+                parse_line(buf.data(), buf.data()+buf.size(), chunk);
+            }
+        }
+
+        /// Find the first logical line boundary at or after p.
+        const char* next_line_start(const char* begin, const char* p, const char* end)
+        {
+            if(p <= begin)
+                return begin;
+            // Back up to the start of the physical line containing p-1 and move forward.
+            const char* b = p-1;
+            while(b>begin && b[-1]!='\n') --b;
+            while(b<end) {
+                const char* e = line_end(b, end);
+                if(e>=end)
+                    return end;
+                if(!is_continued(b, e) && e+1>=p)
+                    return e+1;
+                b = e+1;
+            }
+            return end;
+        }
     }
-    
+
+    bool obj_load(const std::string& filename, std::vector<double>& vertices,
+                  std::vector<int>& faces, std::vector<int>& indices, int no_threads)
+    {
+        Util::MappedFile file(filename);
+        if(!file.is_valid())
+            return false;
+
+        const char* begin = file.data();
+        const char* end = begin + file.size();
+
+        if(no_threads <= 0)
+            no_threads = int(Util::no_threads());
+        size_t no_chunks = max(size_t(1), min(size_t(no_threads), file.size()/MIN_CHUNK_SIZE));
+
+        // Split on logical line boundaries so that no record straddles two chunks.
+        vector<const char*> bounds(no_chunks+1, end);
+        bounds[0] = begin;
+        for(size_t c=1;c<no_chunks;++c)
+            bounds[c] = next_line_start(begin, max(bounds[c-1], begin + c*(file.size()/no_chunks)), end);
+
+        vector<OBJChunk> chunks(no_chunks);
+        Util::parallel_tasks(no_chunks, [&](size_t c) {
+            parse_chunk(bounds[c], bounds[c+1], chunks[c]);
+        });
+
+        // Merge the chunks into the flat arrays. Relative indices depend on the number of
+        // vertices in the chunks before them, so they are fixed up while copying.
+        vector<size_t> v_off(no_chunks+1,0), f_off(no_chunks+1,0), i_off(no_chunks+1,0);
+        for(size_t c=0;c<no_chunks;++c) {
+            v_off[c+1] = v_off[c] + chunks[c].vertices.size();
+            f_off[c+1] = f_off[c] + chunks[c].faces.size();
+            i_off[c+1] = i_off[c] + chunks[c].indices.size();
+        }
+        vertices.resize(v_off[no_chunks]);
+        faces.resize(f_off[no_chunks]);
+        indices.resize(i_off[no_chunks]);
+        auto merge_chunk = [&](size_t c) {
+            OBJChunk& chunk = chunks[c];
+            copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin()+v_off[c]);
+            copy(chunk.faces.begin(), chunk.faces.end(), faces.begin()+f_off[c]);
+            int* idx = indices.data() + i_off[c];
+            copy(chunk.indices.begin(), chunk.indices.end(), idx);
+            for(size_t i: chunk.relative)
+                idx[i] += int(v_off[c]/3);
+            chunk = OBJChunk();
+        };
+        Util::parallel_tasks(no_chunks, merge_chunk);
+        return true;
+    }
+
+    bool obj_load(const std::string& filename, Manifold& m, VertexAttributeVector<int>& orig_vertex_indices)
+    {
+        vector<double> vertices;
+        vector<int> faces;
+        vector<int> indices;
+        if(!obj_load(filename, vertices, faces, indices))
+            return false;
+
+        m.clear();
+        orig_vertex_indices = build(m, vertices.size()/3,
+                                    vertices.data(),
+                                    faces.size(),
+                                    faces.data(),
+                                    indices.data());
+        // build gives an empty map if an index is out of range.
+        return orig_vertex_indices.size() > 0 || faces.empty();
+    }
+
     bool obj_load(const string& filename, Manifold& m) {
         VertexAttributeVector<int> orig_vertex_indices;
         return obj_load(filename, m, orig_vertex_indices);
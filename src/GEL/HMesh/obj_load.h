@@ -13,6 +13,7 @@
 #define __HMESH_OBJLOAD__H__
 
 #include <string>
+#include <vector>
 #include "Manifold.h"
 
 namespace HMesh
@@ -21,9 +22,20 @@ namespace HMesh
         The first argument is a string containing the file name (including path) 
      and the second is the Manifold into which the mesh is loaded. The third argument
      is an attribute vector containing the indices of the original
-    points.  */
+    points. Returns false if the file could not be opened or a face refers to a vertex which
+    does not exist, in which case m is left empty. */
      
     bool obj_load(const std::string&, Manifold& m, VertexAttributeVector<int>& orig_vertex_indices);
     bool obj_load(const std::string&, Manifold& m);
+
+    /** Parse the vertices and faces of a Wavefront OBJ file into the flat arrays taken by build.
+     vertices receives three coordinates per vertex, faces the number of corners of each face and
+     indices the zero based vertex indices of all corners. Negative (relative) indices and lines
+     continued with a backslash are supported. The file is memory mapped and split into no_threads
+     chunks on line boundaries (by default one per thread of the GEL thread pool) which are parsed
+     in parallel.
+     Returns false if the file could not be opened. */
+    bool obj_load(const std::string&, std::vector<double>& vertices, std::vector<int>& faces,
+                  std::vector<int>& indices, int no_threads = 0);
 }
 #endif
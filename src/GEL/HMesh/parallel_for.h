@@ -0,0 +1,112 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file parallel_for.h
+ * @brief Parallel loops over the vertices, faces, and halfedges of a Manifold.
+ *
+ * The loops run on the GEL thread pool (see Util/ThreadPool.h) whose size is set with
+ * Util::set_no_threads. The IDs are handed out in chunks with work stealing, so the loops
+ * balance well even when the work per entity varies.
+ *
+ * The function is called concurrently from several threads, so it must not modify the
+ * connectivity of the mesh, and it may only write to data belonging to the entity it is
+ * called for. Attribute vectors that are written must already hold a value for every
+ * allocated entity, since growing an attribute vector from several threads is a data race.
+ * The attribute layers of the Manifold always do, and their unchecked accessor may be used.
+ */
+
+#ifndef __HMESH_PARALLEL_FOR_H__
+#define __HMESH_PARALLEL_FOR_H__
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include "Manifold.h"
+#include "../Util/Parallel.h"
+
+namespace HMesh
+{
+    /** Default number of entities per chunk. Chunks are always a multiple of 64 entities, so
+     that the values written to attribute vectors by two threads do not share cache lines
+     except, possibly, at the ends of a chunk. */
+    const size_t PARALLEL_CHUNK_SIZE = 1024;
+
+    /// Call f(id) in parallel for every ID in use among the first n IDs of the kind given by ITEMID.
+    template<typename ITEMID, typename Func>
+    void for_each_id_parallel(const Manifold& m, size_t n, const Func& f, size_t chunk_size)
+    {
+        chunk_size = std::max(size_t(64), (chunk_size + 63) & ~size_t(63));
+        Util::parallel_for_chunks(n, [&](size_t b, size_t e) {
+            for(size_t i = b; i < e; ++i) {
+                ITEMID id{typename ITEMID::IndexType(i)};
+                if(m.in_use(id))
+                    f(id);
+            }
+        }, chunk_size);
+    }
+
+    /** Compute r(...r(r(init, f(id0)), f(id1))...) in parallel over the IDs in use among the
+     first n IDs of the kind given by ITEMID. init must be neutral with respect to r (e.g. zero
+     for addition). Each chunk is reduced by itself and the chunk results are combined in order,
+     so the result does not depend on the number of threads. */
+    template<typename ITEMID, typename T, typename Func, typename Reduce>
+    T reduce_ids_parallel(const Manifold& m, size_t n, const T& init, const Func& f, const Reduce& r,
+                          size_t chunk_size)
+    {
+        static_assert(!std::is_same<T, bool>::value, "Elements of std::vector<bool> cannot be written concurrently");
+        chunk_size = std::max(size_t(64), (chunk_size + 63) & ~size_t(63));
+        std::vector<T> partial((n + chunk_size - 1) / chunk_size, init);
+        Util::parallel_for_chunks(n, [&](size_t b, size_t e) {
+            T acc = init;
+            for(size_t i = b; i < e; ++i) {
+                ITEMID id{typename ITEMID::IndexType(i)};
+                if(m.in_use(id))
+                    acc = r(acc, f(id));
+            }
+            partial[b / chunk_size] = acc;
+        }, chunk_size);
+        T result = init;
+        for(const T& p: partial)
+            result = r(result, p);
+        return result;
+    }
+
+    /// Call f(v) for every vertex v of m in parallel.
+    template<typename Func>
+    void for_each_vertex_parallel(const Manifold& m, const Func& f, size_t chunk_size = PARALLEL_CHUNK_SIZE)
+    { for_each_id_parallel<VertexID>(m, m.allocated_vertices(), f, chunk_size); }
+
+    /// Call f(fid) for every face fid of m in parallel.
+    template<typename Func>
+    void for_each_face_parallel(const Manifold& m, const Func& f, size_t chunk_size = PARALLEL_CHUNK_SIZE)
+    { for_each_id_parallel<FaceID>(m, m.allocated_faces(), f, chunk_size); }
+
+    /// Call f(h) for every halfedge h of m in parallel.
+    template<typename Func>
+    void for_each_halfedge_parallel(const Manifold& m, const Func& f, size_t chunk_size = PARALLEL_CHUNK_SIZE)
+    { for_each_id_parallel<HalfEdgeID>(m, m.allocated_halfedges(), f, chunk_size); }
+
+    /// Reduce f(v) over all vertices v of m with r in parallel. See reduce_ids_parallel.
+    template<typename T, typename Func, typename Reduce>
+    T reduce_vertices_parallel(const Manifold& m, const T& init, const Func& f, const Reduce& r,
+                               size_t chunk_size = PARALLEL_CHUNK_SIZE)
+    { return reduce_ids_parallel<VertexID>(m, m.allocated_vertices(), init, f, r, chunk_size); }
+
+    /// Reduce f(fid) over all faces fid of m with r in parallel. See reduce_ids_parallel.
+    template<typename T, typename Func, typename Reduce>
+    T reduce_faces_parallel(const Manifold& m, const T& init, const Func& f, const Reduce& r,
+                            size_t chunk_size = PARALLEL_CHUNK_SIZE)
+    { return reduce_ids_parallel<FaceID>(m, m.allocated_faces(), init, f, r, chunk_size); }
+
+    /// Reduce f(h) over all halfedges h of m with r in parallel. See reduce_ids_parallel.
+    template<typename T, typename Func, typename Reduce>
+    T reduce_halfedges_parallel(const Manifold& m, const T& init, const Func& f, const Reduce& r,
+                                size_t chunk_size = PARALLEL_CHUNK_SIZE)
+    { return reduce_ids_parallel<HalfEdgeID>(m, m.allocated_halfedges(), init, f, r, chunk_size); }
+}
+
+#endif
@@ -4,39 +4,439 @@
  * For license and list of authors, see ../../doc/intro.pdf
  * ----------------------------------------------------------------------- */
 
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
 #include <vector>
 #include "ply_load.h"
 
-#include "../Geometry/ply_load.h"
-#include "../Geometry/TriMesh.h"
-
+#include "../Util/MappedFile.h"
 #include "Manifold.h"
 #include "load.h"
 
 namespace HMesh
 {
-    using std::string;
-    using Geometry::ply_load;
-    using Geometry::TriMesh;
+    using namespace std;
     using namespace CGLA;
-    bool ply_load(const string& filename, Manifold& m)
+
+    namespace
     {
-        TriMesh mesh;
-        if(Geometry::ply_load(filename, mesh))
-        {
-            std::vector<Vec3d> vertices_as_doubles(mesh.geometry.no_vertices());
-            for(auto idx=0;idx<mesh.geometry.no_vertices(); ++idx)
-                vertices_as_doubles[idx] = Vec3d(mesh.geometry.vertex(idx));
-            
-            std::vector<int> faces(mesh.geometry.no_faces(),3);
-
-            build(m, static_cast<size_t>(mesh.geometry.no_vertices()),
-                    reinterpret_cast<const double*>(&vertices_as_doubles[0]),
-                    static_cast<size_t>(mesh.geometry.no_faces()),
-                    static_cast<const int*>(&faces[0]),
-                    reinterpret_cast<const int*>(&mesh.geometry.face(0)));
+        enum PLYType {PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32,
+            PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID};
+
+        const size_t PLY_TYPE_SIZE[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+
+        PLYType ply_type(const string& name)
+        {
+            if(name == "char" || name == "int8") return PLY_INT8;
+            if(name == "uchar" || name == "uint8") return PLY_UINT8;
+            if(name == "short" || name == "int16") return PLY_INT16;
+            if(name == "ushort" || name == "uint16") return PLY_UINT16;
+            if(name == "int" || name == "int32") return PLY_INT32;
+            if(name == "uint" || name == "uint32") return PLY_UINT32;
+            if(name == "float" || name == "float32") return PLY_FLOAT32;
+            if(name == "double" || name == "float64") return PLY_FLOAT64;
+            return PLY_INVALID;
+        }
+
+        struct PLYProperty
+        {
+            string name;
+            PLYType type = PLY_INVALID;
+            bool is_list = false;
+            PLYType count_type = PLY_INVALID;
+            /// Byte offset in the record. Only meaningful if the element has fixed size.
+            size_t offset = 0;
+        };
+
+        struct PLYElement
+        {
+            string name;
+            size_t count = 0;
+            vector<PLYProperty> props;
+            bool fixed_size = true;
+            size_t record_size = 0;
+
+            int find(const string& prop_name) const
+            {
+                for(size_t i=0;i<props.size();++i)
+                    if(props[i].name == prop_name)
+                        return int(i);
+                return -1;
+            }
+        };
+
+        enum PLYFormat {PLY_ASCII, PLY_BINARY_LE, PLY_BINARY_BE};
+
+        bool parse_header(const char*& p, const char* end, PLYFormat& format, vector<PLYElement>& elements)
+        {
+            bool first = true;
+            while(p < end) {
+                const char* e = static_cast<const char*>(memchr(p, '\n', end-p));
+                if(!e) return false;
+                istringstream line(string(p, e));
+                p = e+1;
+                string keyword;
+                line >> keyword;
+                if(first) {
+                    if(keyword != "ply") return false;
+                    first = false;
+                }
+                else if(keyword == "format") {
+                    string f;
+                    line >> f;
+                    if(f == "ascii") format = PLY_ASCII;
+                    else if(f == "binary_little_endian") format = PLY_BINARY_LE;
+                    else if(f == "binary_big_endian") format = PLY_BINARY_BE;
+                    else return false;
+                }
+                else if(keyword == "element") {
+                    PLYElement elem;
+                    line >> elem.name >> elem.count;
+                    elements.push_back(elem);
+                }
+                else if(keyword == "property") {
+                    if(elements.empty()) return false;
+                    PLYElement& elem = elements.back();
+                    PLYProperty prop;
+                    string type;
+                    line >> type;
+                    if(type == "list") {
+                        string count_type, item_type;
+                        line >> count_type >> item_type;
+                        prop.is_list = true;
+                        prop.count_type = ply_type(count_type);
+                        prop.type = ply_type(item_type);
+                        if(prop.count_type == PLY_INVALID) return false;
+                        elem.fixed_size = false;
+                    }
+                    else {
+                        prop.type = ply_type(type);
+                        prop.offset = elem.record_size;
+                        elem.record_size += PLY_TYPE_SIZE[prop.type];
+                    }
+                    if(prop.type == PLY_INVALID) return false;
+                    line >> prop.name;
+                    elem.props.push_back(prop);
+                }
+                else if(keyword == "end_header")
+                    return true;
+            }
+            return false;
+        }
+
+        bool host_is_big_endian()
+        {
+            const uint16_t x = 1;
+            return *reinterpret_cast<const uint8_t*>(&x) == 0;
+        }
+
+        template<typename T>
+        inline T load(const char* p, bool swap)
+        {
+            T x;
+            if(swap) {
+                char b[sizeof(T)];
+                for(size_t i=0;i<sizeof(T);++i)
+                    b[i] = p[sizeof(T)-1-i];
+                memcpy(&x, b, sizeof(T));
+            }
+            else
+                memcpy(&x, p, sizeof(T));
+            return x;
+        }
+
+        inline double read_binary(PLYType t, const char* p, bool swap)
+        {
+            switch(t) {
+                case PLY_INT8: return load<int8_t>(p, swap);
+                case PLY_UINT8: return load<uint8_t>(p, swap);
+                case PLY_INT16: return load<int16_t>(p, swap);
+                case PLY_UINT16: return load<uint16_t>(p, swap);
+                case PLY_INT32: return load<int32_t>(p, swap);
+                case PLY_UINT32: return load<uint32_t>(p, swap);
+                case PLY_FLOAT32: return load<float>(p, swap);
+                case PLY_FLOAT64: return load<double>(p, swap);
+                default: return 0;
+            }
+        }
+
+        /** Reads the scalars of a PLY body one at a time regardless of format. Binary
+         elements of fixed size are not read through this class but directly from the map. */
+        class PLYReader
+        {
+            const char* p;
+            const char* end;
+            PLYFormat format;
+            bool swap;
+        public:
+            PLYReader(const char* _p, const char* _end, PLYFormat _format):
+            p(_p), end(_end), format(_format),
+            swap((_format == PLY_BINARY_BE) != host_is_big_endian()) {}
+
+            const char* pos() const { return p; }
+            void set_pos(const char* _p) { p = _p; }
+            bool swapped() const { return swap; }
+            bool binary() const { return format != PLY_ASCII; }
+
+            bool read(PLYType t, double& x)
+            {
+                if(binary()) {
+                    if(size_t(end-p) < PLY_TYPE_SIZE[t]) return false;
+                    x = read_binary(t, p, swap);
+                    p += PLY_TYPE_SIZE[t];
+                    return true;
+                }
+                while(p<end && isspace(static_cast<unsigned char>(*p))) ++p;
+                char buf[64];
+                size_t n = 0;
+                while(p<end && !isspace(static_cast<unsigned char>(*p)) && n<sizeof(buf)-1)
+                    buf[n++] = *p++;
+                buf[n] = 0;
+                char* stop;
+                x = strtod(buf, &stop);
+                return n > 0 && stop != buf;
+            }
+
+            bool skip(const PLYProperty& prop)
+            {
+                double x;
+                if(!prop.is_list)
+                    return read(prop.type, x);
+                if(!read(prop.count_type, x)) return false;
+                size_t n = size_t(x);
+                if(binary()) {
+                    if(size_t(end-p) < n*PLY_TYPE_SIZE[prop.type]) return false;
+                    p += n*PLY_TYPE_SIZE[prop.type];
+                    return true;
+                }
+                for(size_t i=0;i<n;++i)
+                    if(!read(prop.type, x)) return false;
+                return true;
+            }
+        };
+
+        /// The property names of the vertex element we know how to deal with.
+        const char* VERTEX_PROPS[] = {"x", "y", "z", "nx", "ny", "nz", "red", "green", "blue", "quality"};
+        const int NO_VERTEX_PROPS = 10;
+
+        /// The vertex data of a PLY file. Only the arrays of properties that are present are filled.
+        struct PLYVertexData
+        {
+            size_t count = 0;
+            vector<double> positions, normals, colors, quality;
+        };
+
+        /// Largest value of an integer type. Integer colors are divided by this.
+        double type_max(PLYType t)
+        {
+            switch(t) {
+                case PLY_INT8: return 127.0;
+                case PLY_UINT8: return 255.0;
+                case PLY_INT16: return 32767.0;
+                case PLY_UINT16: return 65535.0;
+                case PLY_INT32: return 2147483647.0;
+                case PLY_UINT32: return 4294967295.0;
+                default: return 1.0;
+            }
+        }
+
+        bool read_vertices(const PLYElement& elem, PLYReader& reader, PLYVertexData& data)
+        {
+            int slot[NO_VERTEX_PROPS];
+            for(int i=0;i<NO_VERTEX_PROPS;++i)
+                slot[i] = elem.find(VERTEX_PROPS[i]);
+            auto has = [&](int i0, int i1) {
+                for(int i=i0;i<i1;++i)
+                    if(slot[i] == -1 || elem.props[slot[i]].is_list) return false;
+                return true;
+            };
+            if(!has(0,3))
+                return false;
+            const size_t N = data.count = elem.count;
+            data.positions.resize(3*N);
+            if(has(3,6)) data.normals.resize(3*N);
+            if(has(6,9)) data.colors.resize(3*N);
+            if(has(9,10)) data.quality.resize(N);
+
+            // Where each property goes: destination array, stride and scale.
+            double* dst[NO_VERTEX_PROPS];
+            size_t stride[NO_VERTEX_PROPS];
+            double scale[NO_VERTEX_PROPS];
+            vector<double>* arrays[] = {&data.positions, &data.normals, &data.colors, &data.quality};
+            for(int i=0;i<NO_VERTEX_PROPS;++i) {
+                vector<double>& a = *arrays[min(i/3, 3)];
+                dst[i] = a.empty() ? nullptr : a.data() + (i<9 ? i%3 : 0);
+                stride[i] = i<9 ? 3 : 1;
+                scale[i] = (dst[i] && i>=6 && i<9) ? 1.0/type_max(elem.props[slot[i]].type) : 1.0;
+            }
+
+            if(reader.binary() && elem.fixed_size) {
+                // The records are contiguous and of fixed size, so each property is read
+                // straight from its offset in the mapped block.
+                const char* base = reader.pos();
+                reader.set_pos(base + N * elem.record_size);
+                bool swap = reader.swapped();
+                for(int i=0;i<NO_VERTEX_PROPS;++i)
+                    if(dst[i]) {
+                        PLYType t = elem.props[slot[i]].type;
+                        const char* src = base + elem.props[slot[i]].offset;
+                        double* d = dst[i];
+                        if(t == PLY_FLOAT32 && !swap)
+                            for(size_t r=0;r<N;++r, src += elem.record_size, d += stride[i]) {
+                                float x;
+                                memcpy(&x, src, 4);
+                                *d = x;
+                            }
+                        else
+                            for(size_t r=0;r<N;++r, src += elem.record_size, d += stride[i])
+                                *d = scale[i] * read_binary(t, src, swap);
+                    }
+                return true;
+            }
+
+            vector<int> prop_slot(elem.props.size(), -1);
+            for(int i=0;i<NO_VERTEX_PROPS;++i)
+                if(dst[i]) prop_slot[slot[i]] = i;
+            for(size_t r=0;r<N;++r)
+                for(size_t j=0;j<elem.props.size();++j) {
+                    int i = prop_slot[j];
+                    if(i != -1) {
+                        double x;
+                        if(!reader.read(elem.props[j].type, x)) return false;
+                        dst[i][r*stride[i]] = scale[i] * x;
+                    }
+                    else if(!reader.skip(elem.props[j]))
+                        return false;
+                }
+            return true;
+        }
+
+        bool read_faces(const PLYElement& elem, PLYReader& reader, const char* end,
+                        vector<int>& faces, vector<int>& indices)
+        {
+            int idx_prop = elem.find("vertex_indices");
+            if(idx_prop == -1)
+                idx_prop = elem.find("vertex_index");
+            if(idx_prop == -1 || !elem.props[idx_prop].is_list)
+                return false;
+            const PLYProperty& ip = elem.props[idx_prop];
+            // Copying the indices of a face is a single memcpy in the common binary case.
+            bool raw_ints = reader.binary() && !reader.swapped() &&
+                (ip.type == PLY_INT32 || ip.type == PLY_UINT32);
+
+            faces.reserve(faces.size() + elem.count);
+            indices.reserve(indices.size() + 3*elem.count);
+            for(size_t r=0;r<elem.count;++r)
+                for(size_t j=0;j<elem.props.size();++j) {
+                    if(int(j) != idx_prop) {
+                        if(!reader.skip(elem.props[j])) return false;
+                        continue;
+                    }
+                    double x;
+                    if(!reader.read(ip.count_type, x) || x < 0) return false;
+                    size_t n = size_t(x);
+                    faces.push_back(int(n));
+                    if(n == 0)
+                        continue;
+                    if(raw_ints && size_t(end-reader.pos()) / 4 < n) return false;
+                    size_t k = indices.size();
+                    indices.resize(k+n);
+                    if(raw_ints) {
+                        memcpy(indices.data()+k, reader.pos(), 4*n);
+                        reader.set_pos(reader.pos() + 4*n);
+                    }
+                    else
+                        for(size_t i=0;i<n;++i) {
+                            if(!reader.read(ip.type, x)) return false;
+                            indices[k+i] = int(x);
+                        }
+                }
             return true;
         }
-        return false;
+
+        bool ply_load_arrays(const string& filename, PLYVertexData& vertex_data,
+                             vector<int>& faces, vector<int>& indices)
+        {
+            Util::MappedFile file(filename);
+            if(!file.is_valid())
+                return false;
+            const char* p = file.data();
+            const char* end = p + file.size();
+
+            PLYFormat format = PLY_ASCII;
+            vector<PLYElement> elements;
+            if(!parse_header(p, end, format, elements))
+                return false;
+
+            PLYReader reader(p, end, format);
+            bool has_vertices = false;
+            for(const PLYElement& elem: elements) {
+                if(reader.binary() && elem.fixed_size &&
+                   size_t(end - reader.pos()) / max(size_t(1), elem.record_size) < elem.count)
+                    return false;
+                if(elem.name == "vertex") {
+                    if(!read_vertices(elem, reader, vertex_data))
+                        return false;
+                    has_vertices = true;
+                }
+                else if(elem.name == "face") {
+                    if(!read_faces(elem, reader, end, faces, indices))
+                        return false;
+                }
+                else if(reader.binary() && elem.fixed_size)
+                    reader.set_pos(reader.pos() + elem.count * elem.record_size);
+                else
+                    for(size_t r=0;r<elem.count;++r)
+                        for(const PLYProperty& prop: elem.props)
+                            if(!reader.skip(prop))
+                                return false;
+            }
+            return has_vertices;
+        }
+    }
+
+    bool ply_load(const string& filename, Manifold& m,
+                  VertexAttributeVector<Vec3d>& normals,
+                  VertexAttributeVector<Vec3f>& colors,
+                  VertexAttributeVector<float>& quality)
+    {
+        PLYVertexData data;
+        vector<int> faces, indices;
+        if(!ply_load_arrays(filename, data, faces, indices))
+            return false;
+
+        VertexAttributeVector<int> point_index = build(m, data.count, data.positions.data(),
+                                                       faces.size(), faces.data(), indices.data());
+        // build gives an empty map if an index is out of range.
+        if(point_index.size() == 0 && !faces.empty())
+            return false;
+
+        normals.clear();
+        colors.clear();
+        quality.clear();
+        if(!data.normals.empty()) normals.resize(m.allocated_vertices(), Vec3d(0));
+        if(!data.colors.empty()) colors.resize(m.allocated_vertices(), Vec3f(0));
+        if(!data.quality.empty()) quality.resize(m.allocated_vertices(), 0.0f);
+        for(auto v: m.vertices()) {
+            int i = point_index[v];
+            if(i < 0) continue;
+            if(!data.normals.empty())
+                normals[v] = Vec3d(data.normals[3*size_t(i)], data.normals[3*size_t(i)+1], data.normals[3*size_t(i)+2]);
+            if(!data.colors.empty())
+                colors[v] = Vec3f(data.colors[3*size_t(i)], data.colors[3*size_t(i)+1], data.colors[3*size_t(i)+2]);
+            if(!data.quality.empty())
+                quality[v] = data.quality[i];
+        }
+        return true;
+    }
+
+    bool ply_load(const string& filename, Manifold& m)
+    {
+        VertexAttributeVector<Vec3d> normals;
+        VertexAttributeVector<Vec3f> colors;
+        VertexAttributeVector<float> quality;
+        return ply_load(filename, m, normals, colors, quality);
     }
 }
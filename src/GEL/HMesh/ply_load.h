@@ -13,14 +13,24 @@
 #define __HMESH_PLYLOAD__H__
 
 #include <string>
+#include "../CGLA/Vec3f.h"
+#include "Manifold.h"
 
 namespace HMesh
 {
-    class Manifold;
-    /** Load an Wavefront OBJ file. This is just a simple frontend for the 
-    Geometry::obj_load function which loads OBJ files into triangle meshes. 
-    Consequently, quads are unfortunately converted to triangles when this
-    loader is used. */
+    /** Load a PLY file. Binary (little and big endian) as well as ASCII files are read
+     directly into the arrays passed to build, so polygonal faces are preserved. Only the
+     vertex positions and the face element's vertex_indices (or vertex_index) list are used.
+     Returns false if the file cannot be read or a face refers to a vertex which does not exist. */
     bool ply_load(const std::string&, Manifold& m);
+
+    /** Load a PLY file along with the per vertex properties that are commonly stored with
+     the positions. normals receives (nx, ny, nz), colors receives (red, green, blue) scaled
+     to [0,1] if stored as integers, and quality receives the quality property. Attribute
+     vectors for properties which are not in the file are left empty. */
+    bool ply_load(const std::string&, Manifold& m,
+                  VertexAttributeVector<CGLA::Vec3d>& normals,
+                  VertexAttributeVector<CGLA::Vec3f>& colors,
+                  VertexAttributeVector<float>& quality);
 }
-#endif
\ No newline at end of file
+#endif
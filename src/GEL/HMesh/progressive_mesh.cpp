@@ -0,0 +1,340 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include "progressive_mesh.h"
+
+using namespace std;
+using namespace CGLA;
+
+namespace HMesh
+{
+    namespace
+    {
+        /// Current version of the progressive mesh format.
+        const uint32_t PM_FORMAT_VERSION = 1;
+
+        /// Written as is in the header. A stream with a different byte order is rejected.
+        const uint32_t PM_BYTE_ORDER_MARK = 0x01020304;
+
+        /// Magic string at the beginning of every progressive mesh stream.
+        const char PM_MAGIC[8] = {'G','E','L','P','M','E','S','H'};
+
+        /// Faces and splits larger than this are taken to be signs of a corrupt stream.
+        const uint32_t PM_MAX_LIST = 1u << 20;
+
+        const uint32_t NO_INDEX = ~uint32_t(0);
+
+        struct PMHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            uint64_t no_vertices;
+            uint64_t no_faces;
+            uint64_t no_splits;
+        };
+
+        template<typename T>
+        void write_value(ostream& os, const T& x)
+        {
+            os.write(reinterpret_cast<const char*>(&x), sizeof(T));
+        }
+
+        template<typename T>
+        bool read_value(istream& is, T& x)
+        {
+            return bool(is.read(reinterpret_cast<char*>(&x), sizeof(T)));
+        }
+
+        void write_list(ostream& os, const vector<uint32_t>& v)
+        {
+            write_value(os, uint32_t(v.size()));
+            if(!v.empty())
+                os.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(uint32_t));
+        }
+
+        bool read_list(istream& is, vector<uint32_t>& v)
+        {
+            uint32_t n;
+            if(!read_value(is, n) || n > PM_MAX_LIST)
+                return false;
+            v.resize(n);
+            return n == 0 || bool(is.read(reinterpret_cast<char*>(v.data()), n * sizeof(uint32_t)));
+        }
+
+        /// Replace the corner at vertex a of f with b.
+        void replace_corner(PMFace& f, uint32_t a, uint32_t b)
+        {
+            auto c = find(f.begin(), f.end(), a);
+            assert(c != f.end());
+            if(c != f.end())
+                *c = b;
+        }
+
+        /// The vertices of f in counter clockwise order.
+        vector<VertexID> face_vertices(const Manifold& m, FaceID f)
+        {
+            vector<VertexID> verts;
+            circulate_face_ccw(m, f, [&](VertexID v) { verts.push_back(v); });
+            return verts;
+        }
+    }
+
+    void CollapseRecorder::collapse(const Manifold& m, HalfEdgeID h)
+    {
+        // The opposite vertex is removed, and h and its opposite are the edge.
+        Walker w = m.walker(h);
+        Record rec;
+        rec.vertex = w.vertex();
+        rec.removed = w.opp().vertex();
+        rec.vertex_pos = m.pos(rec.vertex);
+        rec.removed_pos = m.pos(rec.removed);
+        const FaceID f0 = w.face(), f1 = w.opp().face();
+        for(FaceID f: {f0, f1})
+            if(f != InvalidFaceID)
+                rec.edge_faces.push_back(make_pair(f, face_vertices(m, f)));
+        circulate_vertex_ccw(m, rec.removed, [&](FaceID f) {
+            if(f != InvalidFaceID && f != f0 && f != f1)
+                rec.moved_faces.push_back(f);
+        });
+        records.push_back(rec);
+    }
+
+    void CollapseRecorder::finish(const Manifold& m, ProgressiveMesh& pm) const
+    {
+        pm = ProgressiveMesh();
+        VertexAttributeVector<uint32_t> vindex(m.allocated_vertices(), NO_INDEX);
+        FaceAttributeVector<uint32_t> findex(m.allocated_faces(), NO_INDEX);
+        for(VertexID v: m.vertices()) {
+            vindex[v] = uint32_t(pm.base_positions.size());
+            pm.base_positions.push_back(m.pos(v));
+        }
+        for(FaceID f: m.faces()) {
+            findex[f] = uint32_t(pm.base_faces.size());
+            PMFace face;
+            for(VertexID v: face_vertices(m, f))
+                face.push_back(vindex[v]);
+            pm.base_faces.push_back(face);
+        }
+
+        // The splits undo the contractions in reverse order. Every vertex and face a contraction
+        // refers to exists before the corresponding split: either it is in the base mesh, or it
+        // was removed by a later contraction and is created by an earlier split.
+        uint32_t no_vertices = uint32_t(pm.base_positions.size());
+        uint32_t no_faces = uint32_t(pm.base_faces.size());
+        pm.splits.resize(records.size());
+        for(size_t k = 0; k < records.size(); ++k) {
+            const Record& rec = records[records.size() - 1 - k];
+            VertexSplit& split = pm.splits[k];
+            split.vertex = vindex[rec.vertex];
+            split.vertex_pos = rec.vertex_pos;
+            split.new_vertex_pos = rec.removed_pos;
+            vindex[rec.removed] = no_vertices++;
+
+            for(FaceID f: rec.moved_faces) {
+                assert(findex[f] != NO_INDEX);
+                split.moved_faces.push_back(findex[f]);
+            }
+            for(const auto& ef: rec.edge_faces) {
+                if(findex[ef.first] == NO_INDEX)
+                    findex[ef.first] = no_faces++;
+                PMFace face;
+                for(VertexID v: ef.second)
+                    face.push_back(vindex[v]);
+                split.edge_faces.push_back(make_pair(findex[ef.first], face));
+            }
+        }
+    }
+
+    ProgressiveMeshLOD::ProgressiveMeshLOD(const ProgressiveMesh& _pm):
+    pm(_pm), pos(_pm.base_positions), face_vec(_pm.base_faces)
+    {}
+
+    bool ProgressiveMeshLOD::fits(const VertexSplit& split) const
+    {
+        const size_t nv = pos.size() + 1;
+        size_t nf = face_vec.size();
+        if(split.vertex >= pos.size())
+            return false;
+        for(uint32_t f: split.moved_faces)
+            if(f >= face_vec.size() || find(face_vec[f].begin(), face_vec[f].end(), split.vertex) == face_vec[f].end())
+                return false;
+        for(const auto& ef: split.edge_faces) {
+            if(ef.first > nf)
+                return false;
+            if(ef.first == nf)
+                ++nf;
+            for(uint32_t v: ef.second)
+                if(v >= nv)
+                    return false;
+        }
+        return true;
+    }
+
+    bool ProgressiveMeshLOD::refine()
+    {
+        if(level() >= pm.splits.size() || !fits(pm.splits[level()]))
+            return false;
+        const VertexSplit& split = pm.splits[level()];
+        const uint32_t new_vertex = uint32_t(pos.size());
+        undo.push_back(Undo{uint32_t(face_vec.size()), pos[split.vertex]});
+        pos[split.vertex] = split.vertex_pos;
+        pos.push_back(split.new_vertex_pos);
+        for(uint32_t f: split.moved_faces)
+            replace_corner(face_vec[f], split.vertex, new_vertex);
+        for(const auto& ef: split.edge_faces) {
+            if(ef.first == face_vec.size())
+                face_vec.push_back(ef.second);
+            else
+                face_vec[ef.first] = ef.second;
+        }
+        return true;
+    }
+
+    bool ProgressiveMeshLOD::coarsen()
+    {
+        if(level() == 0)
+            return false;
+        const VertexSplit& split = pm.splits[level() - 1];
+        const uint32_t new_vertex = uint32_t(pos.size() - 1);
+        const Undo u = undo.back();
+        undo.pop_back();
+        // The created faces are at the end, and the replaced ones lose the corner again.
+        for(const auto& ef: split.edge_faces)
+            if(ef.first < u.no_faces) {
+                PMFace& f = face_vec[ef.first];
+                f.erase(remove(f.begin(), f.end(), new_vertex), f.end());
+            }
+        face_vec.resize(u.no_faces);
+        for(uint32_t f: split.moved_faces)
+            replace_corner(face_vec[f], new_vertex, split.vertex);
+        pos.pop_back();
+        pos[split.vertex] = u.vertex_pos;
+        return true;
+    }
+
+    void ProgressiveMeshLOD::set_level(size_t l)
+    {
+        while(level() < l && refine());
+        while(level() > l && coarsen());
+    }
+
+    void ProgressiveMeshLOD::build_manifold(Manifold& m) const
+    {
+        vector<int> faces, indices;
+        for(const PMFace& f: face_vec) {
+            faces.push_back(int(f.size()));
+            indices.insert(indices.end(), f.begin(), f.end());
+        }
+        m.clear();
+        build(m, pos.size(), pos.empty() ? nullptr : pos[0].get(), faces.size(),
+              faces.data(), indices.data());
+    }
+
+    bool write_progressive_mesh_base(ostream& os, const ProgressiveMesh& pm, uint64_t no_splits)
+    {
+        PMHeader header;
+        memcpy(header.magic, PM_MAGIC, sizeof(PM_MAGIC));
+        header.version = PM_FORMAT_VERSION;
+        header.byte_order = PM_BYTE_ORDER_MARK;
+        header.no_vertices = pm.base_positions.size();
+        header.no_faces = pm.base_faces.size();
+        header.no_splits = no_splits;
+        write_value(os, header);
+        if(!pm.base_positions.empty())
+            os.write(reinterpret_cast<const char*>(pm.base_positions.data()),
+                     pm.base_positions.size() * sizeof(Vec3d));
+        for(const PMFace& f: pm.base_faces)
+            write_list(os, f);
+        return os.good();
+    }
+
+    bool write_vertex_split(ostream& os, const VertexSplit& split)
+    {
+        write_value(os, split.vertex);
+        write_value(os, split.vertex_pos);
+        write_value(os, split.new_vertex_pos);
+        write_list(os, split.moved_faces);
+        write_value(os, uint32_t(split.edge_faces.size()));
+        for(const auto& ef: split.edge_faces) {
+            write_value(os, ef.first);
+            write_list(os, ef.second);
+        }
+        return os.good();
+    }
+
+    bool write_progressive_mesh(ostream& os, const ProgressiveMesh& pm)
+    {
+        if(!write_progressive_mesh_base(os, pm, pm.splits.size()))
+            return false;
+        for(const VertexSplit& split: pm.splits)
+            if(!write_vertex_split(os, split))
+                return false;
+        return true;
+    }
+
+    bool read_progressive_mesh_base(istream& is, ProgressiveMesh& pm, uint64_t& no_splits)
+    {
+        pm = ProgressiveMesh();
+        PMHeader header;
+        if(!read_value(is, header) || memcmp(header.magic, PM_MAGIC, sizeof(PM_MAGIC)) != 0 ||
+           header.version != PM_FORMAT_VERSION || header.byte_order != PM_BYTE_ORDER_MARK ||
+           header.no_vertices >= NO_INDEX || header.no_faces >= NO_INDEX)
+            return false;
+        no_splits = header.no_splits;
+
+        // The sizes come from the stream, so the vectors grow as the data is read rather than
+        // being allocated up front.
+        for(uint64_t i = 0; i < header.no_vertices; ++i) {
+            Vec3d p;
+            if(!read_value(is, p))
+                return false;
+            pm.base_positions.push_back(p);
+        }
+        for(uint64_t i = 0; i < header.no_faces; ++i) {
+            PMFace f;
+            if(!read_list(is, f))
+                return false;
+            for(uint32_t v: f)
+                if(v >= header.no_vertices)
+                    return false;
+            pm.base_faces.push_back(f);
+        }
+        return true;
+    }
+
+    bool read_vertex_split(istream& is, VertexSplit& split)
+    {
+        uint32_t no_edge_faces;
+        if(!read_value(is, split.vertex) || !read_value(is, split.vertex_pos) || !read_value(is, split.new_vertex_pos) ||
+           !read_list(is, split.moved_faces) || !read_value(is, no_edge_faces) || no_edge_faces > 2)
+            return false;
+        split.edge_faces.resize(no_edge_faces);
+        for(auto& ef: split.edge_faces)
+            if(!read_value(is, ef.first) || !read_list(is, ef.second))
+                return false;
+        return true;
+    }
+
+    bool read_progressive_mesh(istream& is, ProgressiveMesh& pm)
+    {
+        uint64_t no_splits;
+        if(!read_progressive_mesh_base(is, pm, no_splits))
+            return false;
+        for(uint64_t k = 0; k < no_splits; ++k) {
+            VertexSplit split;
+            if(!read_vertex_split(is, split))
+                return false;
+            pm.splits.push_back(split);
+        }
+        return true;
+    }
+}
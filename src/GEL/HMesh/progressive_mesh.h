@@ -0,0 +1,171 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file progressive_mesh.h
+ * @brief Progressive meshes: a coarse base mesh and a sequence of vertex splits.
+ *
+ * A simplification which contracts edges can record the contractions. Reversed, they form a
+ * sequence of vertex splits which refines the simplified mesh back into the original mesh one
+ * vertex at a time. Any level of detail in between is obtained by applying a prefix of the
+ * sequence to the base mesh, and a viewer can move between levels by applying or undoing
+ * individual splits. A progressive mesh is stored as a base mesh followed by the splits, so it
+ * can be streamed, and the mesh can be shown while the rest of the stream arrives.
+ *
+ * The vertices and faces of a progressive mesh are referred to by index. The base mesh has
+ * vertices 0 to B-1, and split k creates vertex B+k. The faces of the base mesh are likewise
+ * numbered first, and each split appends the faces it creates.
+ */
+
+#ifndef __HMESH_PROGRESSIVE_MESH_H__
+#define __HMESH_PROGRESSIVE_MESH_H__
+
+#include <cstdint>
+#include <iosfwd>
+#include <utility>
+#include <vector>
+#include "../CGLA/Vec3d.h"
+#include "Manifold.h"
+
+namespace HMesh
+{
+    /// A face given by the indices of its vertices in counter clockwise order.
+    typedef std::vector<uint32_t> PMFace;
+
+    /** The inverse of an edge contraction. The split creates a new vertex, and the faces which
+     surrounded the removed vertex are given back their corner at the new vertex. */
+    struct VertexSplit
+    {
+        uint32_t vertex = 0;                ///< Index of the vertex which is split.
+        CGLA::Vec3d vertex_pos;             ///< Position of the vertex after the split.
+        CGLA::Vec3d new_vertex_pos;         ///< Position of the new vertex.
+
+        /// Faces whose corner at the vertex moves to the new vertex.
+        std::vector<uint32_t> moved_faces;
+
+        /** The faces which contain the edge from the vertex to the new vertex after the split,
+         as pairs of face index and face. A triangle is created by the split, and its index is the
+         number of faces before it. A larger polygon has lost a corner in the contraction and
+         existed already, and the split replaces it. */
+        std::vector<std::pair<uint32_t, PMFace>> edge_faces;
+    };
+
+    /// The base mesh and the vertex splits that refine it into the original mesh.
+    struct ProgressiveMesh
+    {
+        std::vector<CGLA::Vec3d> base_positions;
+        std::vector<PMFace> base_faces;
+        std::vector<VertexSplit> splits;
+
+        /// Number of vertices when all splits are applied.
+        size_t max_vertices() const { return base_positions.size() + splits.size(); }
+    };
+
+    /** Records a sequence of edge contractions on a mesh in order to make a progressive mesh.
+     The contractions must be made with Manifold::collapse_edge without adding entities to the
+     mesh in between. The positions of vertices may change freely. */
+    class CollapseRecorder
+    {
+    public:
+        /// Record the contraction of h in m. Call this right before m.collapse_edge(h).
+        void collapse(const Manifold& m, HalfEdgeID h);
+
+        /// Number of contractions recorded.
+        size_t size() const { return records.size(); }
+
+        /** Make the progressive mesh whose base mesh is m, which must be the mesh after the last
+         contraction. The vertices and faces of the base mesh are numbered in the order of
+         m.vertices() and m.faces(). */
+        void finish(const Manifold& m, ProgressiveMesh& pm) const;
+
+    private:
+        struct Record
+        {
+            VertexID vertex, removed;
+            CGLA::Vec3d vertex_pos, removed_pos;
+            std::vector<FaceID> moved_faces;
+            std::vector<std::pair<FaceID, std::vector<VertexID>>> edge_faces;
+        };
+        std::vector<Record> records;
+    };
+
+    /** A level of detail of a progressive mesh, which is refined and coarsened one vertex split at
+     a time. The progressive mesh must outlive this object, but splits may be appended to it,
+     e.g. as they arrive from a stream. */
+    class ProgressiveMeshLOD
+    {
+    public:
+        /// Start at the base mesh of pm.
+        ProgressiveMeshLOD(const ProgressiveMesh& pm);
+
+        /// Number of splits applied to the base mesh.
+        size_t level() const { return undo.size(); }
+
+        /** Apply the next split. Returns false if all available splits are applied, or if the
+         next split refers to vertices or faces which do not exist, as it may if it was read from
+         a corrupt stream. */
+        bool refine();
+
+        /// Undo the last split. Returns false at the base mesh.
+        bool coarsen();
+
+        /// Refine or coarsen until level splits are applied or no more splits are available.
+        void set_level(size_t level);
+
+        /// Positions of the vertices indexed as in the progressive mesh.
+        const std::vector<CGLA::Vec3d>& positions() const { return pos; }
+
+        /// The faces indexed as in the progressive mesh.
+        const std::vector<PMFace>& faces() const { return face_vec; }
+
+        /// Build the current level of detail as a manifold.
+        void build_manifold(Manifold& m) const;
+
+    private:
+        /// Returns true if split can be applied to the current level of detail.
+        bool fits(const VertexSplit& split) const;
+
+        /// What an applied split changed and a vertex split does not store.
+        struct Undo
+        {
+            uint32_t no_faces;          ///< Number of faces before the split.
+            CGLA::Vec3d vertex_pos;     ///< Position of the split vertex before the split.
+        };
+
+        const ProgressiveMesh& pm;
+        std::vector<CGLA::Vec3d> pos;
+        std::vector<PMFace> face_vec;
+        std::vector<Undo> undo;
+    };
+
+    /** \brief Write a progressive mesh to a binary stream.
+     The stream consists of a header, the base mesh, and the vertex splits in order, so a reader
+     can use the splits as they arrive. Indices are 32 bit and positions are doubles. The header
+     holds the magic string "GELPMESH", the format version, a byte order mark, and the numbers of
+     base vertices, base faces, and splits as 64 bit integers. Returns false on error. */
+    bool write_progressive_mesh(std::ostream& os, const ProgressiveMesh& pm);
+
+    /** \brief Read a progressive mesh written by write_progressive_mesh.
+     If the stream ends early, pm holds the base mesh and the splits read so far, which is also a
+     progressive mesh, and false is returned. */
+    bool read_progressive_mesh(std::istream& is, ProgressiveMesh& pm);
+
+    /** Write the header and the base mesh of pm, announcing no_splits splits to follow. Together
+     with write_vertex_split, this makes it possible to write a progressive mesh bit by bit. */
+    bool write_progressive_mesh_base(std::ostream& os, const ProgressiveMesh& pm, uint64_t no_splits);
+
+    /// Write a single vertex split.
+    bool write_vertex_split(std::ostream& os, const VertexSplit& split);
+
+    /** Read the header and the base mesh into pm, clearing its splits, and return the number of
+     splits announced in no_splits. Returns false if the stream is not a progressive mesh. */
+    bool read_progressive_mesh_base(std::istream& is, ProgressiveMesh& pm, uint64_t& no_splits);
+
+    /// Read a single vertex split. Returns false if the stream ends or the split is malformed.
+    bool read_vertex_split(std::istream& is, VertexSplit& split);
+}
+
+#endif
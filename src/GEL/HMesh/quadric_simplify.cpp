@@ -6,14 +6,20 @@
 
 #include "quadric_simplify.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <climits>
 #include <queue>
 #include <iostream>
 #include "../CGLA/Vec3d.h"
 #include "../Geometry/QEM.h"
+#include "../Util/Timer.h"
 
 #include "Manifold.h"
 #include "AttributeVector.h"
 #include "smooth.h"
+#include "parallel_for.h"
+#include "progressive_mesh.h"
 
 
 namespace HMesh
@@ -24,6 +30,80 @@ namespace HMesh
     
     namespace
     {
+        /* Compute the quadric of a vertex from the planes of its faces. Boundary edges add a
+         plane orthogonal to the face, which keeps the boundary in place. */
+        QEM vertex_quadric(const Manifold& m, VertexID v)
+        {
+            Vec3d p(m.pos(v));
+            Vec3d vn(normal(m, v));
+            QEM q;
+            for(Walker w = m.walker(v); !w.full_circle(); w = w.circulate_vertex_cw()){
+                FaceID f = w.face();
+                if(f != InvalidFaceID){
+                    Vec3d n(normal(m, f));
+                    double a = area(m, f);
+                    q += QEM(p, n, a / 3.0);
+                }
+                if ((f == InvalidFaceID || w.opp().face() == InvalidFaceID ) && sqr_length(vn) > 0.0){
+                    Vec3d edge = Vec3d(m.pos(w.vertex())) - p;
+                    double edge_len = sqr_length(edge); 
+                    if(edge_len > 0.0){
+                        Vec3d n = cross(vn, edge);
+                        q += QEM(p, n, 2*edge_len);
+                    }
+                }
+            }
+            return q;
+        }
+
+        /* Compute the error associated with contraction of h, whose end points have the
+         combined quadric q, and the optimal position of the resulting vertex. */
+        float collapse_error(const Manifold& m, const QEM& q, HalfEdgeID h,
+                             double singular_thresh, bool choose_optimal_positions, Vec3d& opt_pos)
+        {
+            Walker w = m.walker(h);
+            VertexID hv = w.vertex();
+            VertexID hov = w.opp().vertex();
+            Vec3d opt_origin = Vec3d(m.pos(hv) + m.pos(hov)) * 0.5;
+            if(choose_optimal_positions)
+                opt_pos = q.opt_pos(singular_thresh,opt_origin);
+            else
+                opt_pos = Vec3d(m.pos(hv));
+            return q.error(opt_pos);
+        }
+
+        /* Check whether the contraction of h would flip faces around the vertex h points to.
+         This test is inspired by Garland's Ph.D. thesis. We try to detect whether flipped
+         triangles will occur by sort of ensuring that the new vertex is in the hull of the one
+         rings of the vertices at either end of the edge being contracted 
+         
+         I also had an additional check intended to ensure that poor valencies
+         would not be introduced, but it seemed to be unnecessary.
+         */
+        bool check_consistency(const Manifold& m, HalfEdgeID h, const Vec3d& opt_pos)
+        {
+            Walker w = m.walker(h);
+            VertexID v0 = w.vertex();
+            VertexID v1 = w.opp().vertex();
+            Vec3d p0(m.pos(v0));
+            
+            for(Walker w = m.walker(v0); !w.full_circle(); w = w.circulate_vertex_cw()){
+                if(w.vertex()!= v1 && w.next().vertex() != v1){
+                    Vec3d pa(m.pos(w.vertex()));
+                    Vec3d pb(m.pos(w.next().vertex()));
+                    
+                    Vec3d dir = normalize(pb - pa);
+                    
+                    Vec3d n = p0 - pa;
+                    n = n - dir * dot(dir,n);
+                    
+                    if(dot(n,opt_pos - pa) <= 0)
+                        return false;
+                }
+            }
+            return true;
+        }
+
         /* We create a record for each halfedge where we can keep its time
          stamp. If the time stamp on the halfedge record is bigger than
          the stamp on the simplification record, we cannot use the 
@@ -68,14 +148,13 @@ namespace HMesh
             SimplifyQueue sim_queue;
             double singular_thresh;
             bool choose_optimal_positions;
+            QuadricSimplifyStats stats;
+            CollapseRecorder* recorder;
             
             /* Compute the error associated with contraction of he and the
              optimal position of resulting vertex. */
             void push_simplify_rec(HalfEdgeID h);
             
-            /* Check whether the contraction is valid. See below for details*/
-            bool check_consistency(HalfEdgeID h, const Vec3d& opt_pos);
-            
             /* Update the time stamp of a halfedge. A halfedge and its opp edge
              may have different stamps. We choose a stamp that is greater
              than either and assign to both.*/
@@ -105,53 +184,14 @@ namespace HMesh
             m(_m), 
             collapse_mask(_collapse_mask),
             singular_thresh(_singular_thresh),
-            choose_optimal_positions(_choose_optimal_positions)
+            choose_optimal_positions(_choose_optimal_positions),
+            recorder(0)
             {}
             
-            /* Simplify doing at most max_work contractions */
-            void reduce(long int max_work);
+            /* Simplify removing at most max_work faces or until options say stop */
+            QuadricSimplifyStats reduce(long int max_work, const QuadricSimplifyOptions& options);
         };
         
-        bool QuadricSimplifier::check_consistency(HalfEdgeID h, const Vec3d& opt_pos)
-        {
-			Walker w = m.walker(h);
-            
-            
-            VertexID v0 = w.vertex();
-            VertexID v1 = w.opp().vertex();
-            Vec3d p0(m.pos(v0));
-            
-            /* This test is inspired by Garland's Ph.D. thesis. We try
-             to detect whether flipped triangles will occur by sort of
-             ensuring that the new vertex is in the hull of the one rings
-             of the vertices at either end of the edge being contracted 
-             
-             I also had an additional check intended to ensure that poor valencies
-             would not be introduced, but it seemed to be unnecessary.
-             
-             */
-            
-			for(Walker w = m.walker(v0); !w.full_circle(); w = w.circulate_vertex_cw()){
-                //ConstHalfEdgeHandle h = vc.halfedge();
-                
-                if(w.vertex()!= v1 && w.next().vertex() != v1){
-                    Vec3d pa(m.pos(w.vertex()));
-                    Vec3d pb(m.pos(w.next().vertex()));
-                    
-                    Vec3d dir = normalize(pb - pa);
-                    
-                    Vec3d n = p0 - pa;
-                    n = n - dir * dot(dir,n);
-                    
-                    if(dot(n,opt_pos - pa) <= 0)
-                        return false;
-                }
-            }
-            
-            return true;
-        }
-        
-        
         void QuadricSimplifier::push_simplify_rec(HalfEdgeID h)
         {
 			Walker w = m.walker(h);
@@ -160,25 +200,12 @@ namespace HMesh
                 
                 update_time_stamp(h);
                 
-                VertexID hv = w.vertex();
-                VertexID hov = w.opp().vertex();
-                
                 // Get QEM for both end points
-                const QEM& Q1 = qem_vec[hv];
-                const QEM& Q2 = qem_vec[hov];
-                
-                QEM q = Q1;
-                q += Q2;
+                QEM q = qem_vec[w.vertex()];
+                q += qem_vec[w.opp().vertex()];
                 
-                float err;
                 Vec3d opt_pos(0);
-                Vec3d opt_origin = Vec3d(m.pos(hv) + m.pos(hov)) * 0.5;
-                if(choose_optimal_positions)
-                    opt_pos = q.opt_pos(singular_thresh,opt_origin);
-                else
-                    opt_pos = Vec3d(m.pos(hv));
-                
-                err = q.error(opt_pos);
+                float err = collapse_error(m, q, h, singular_thresh, choose_optimal_positions, opt_pos);
                 
                 // Create SimplifyRec
                 SimplifyRec simplify_rec;
@@ -218,7 +245,7 @@ namespace HMesh
                 if(precond_collapse_edge(m, h)){      
                     // If our consistency checks pass, we are relatively
                     // sure that the contraction does not lead to a face flip.
-                    if(check_consistency(h, simplify_rec.opt_pos) && check_consistency(wo.halfedge(), simplify_rec.opt_pos)){
+                    if(check_consistency(m, h, simplify_rec.opt_pos) && check_consistency(m, wo.halfedge(), simplify_rec.opt_pos)){
                         //cout << simplify_rec.err << " " << &(*he->vert) << endl;
                         // Get QEM for both end points
                         const QEM& Q1 = qem_vec[n];
@@ -242,11 +269,15 @@ namespace HMesh
                         }
                         
                         // Do collapse
+                        if(recorder)
+                            recorder->collapse(m, h);
                         m.collapse_edge(h);
                         m.pos(n) = simplify_rec.opt_pos;
                         qem_vec[n] = q;
                         
                         update_onering_timestamp(n);
+                        ++stats.collapses;
+                        stats.max_error = max(stats.max_error, double(simplify_rec.err));
                         return 1;
                     }
                 }
@@ -256,18 +287,28 @@ namespace HMesh
                 // seen this simplify record less than 100 times, we try to
                 // increase the error and store the record again. Maybe some
                 // other contractions will make it more digestible later.
+                ++stats.rejected;
                 if(simplify_rec.visits < 100){
                     simplify_rec.err *= 1.01f;
                     ++simplify_rec.visits;
                     sim_queue.push(simplify_rec);
                 }
             }
+            else
+                ++stats.stale_records;
             
             return 0;
         }
         
-        void QuadricSimplifier::reduce(long int max_work)
+        QuadricSimplifyStats QuadricSimplifier::reduce(long int max_work, const QuadricSimplifyOptions& options)
         {
+            Util::Timer timer;
+            timer.start();
+            stats = QuadricSimplifyStats();
+            CollapseRecorder collapse_recorder;
+            if(options.progressive_mesh)
+                recorder = &collapse_recorder;
+            
             // Set t = 0 for all halfedges
             for(HalfEdgeIDIterator h = m.halfedges_begin(); h != m.halfedges_end(); ++h){
                 halfedge_vec[*h].h = *h;
@@ -275,28 +316,8 @@ namespace HMesh
 //            cout << "Computing quadrics" << endl;
             
             // For all vertices, compute quadric and store in qem_vec
-            for(VertexIDIterator v = m.vertices_begin(); v != m.vertices_end(); ++v){
-                Vec3d p(m.pos(*v));
-                Vec3d vn(normal(m, *v));
-                QEM q;
-				for(Walker w = m.walker(*v); !w.full_circle(); w = w.circulate_vertex_cw()){
-                    FaceID f = w.face();
-                    if(f != InvalidFaceID){
-                        Vec3d n(normal(m, f));
-                        double a = area(m, f);
-                        q += QEM(p, n, a / 3.0);
-                    }
-                    if ((f == InvalidFaceID || w.opp().face() == InvalidFaceID ) && sqr_length(vn) > 0.0){
-                        Vec3d edge = Vec3d(m.pos(w.vertex())) - p;
-                        double edge_len = sqr_length(edge); 
-                        if(edge_len > 0.0){
-                            Vec3d n = cross(vn, edge);
-                            q += QEM(p, n, 2*edge_len);
-                        }
-                    }
-                }
-                qem_vec[*v] = q;
-            }
+            for(VertexIDIterator v = m.vertices_begin(); v != m.vertices_end(); ++v)
+                qem_vec[*v] = vertex_quadric(m, *v);
 //            cout << "Pushing initial halfedges" << endl;
             
             for(HalfEdgeIDIterator h = m.halfedges_begin(); h != m.halfedges_end(); ++h){
@@ -305,41 +326,489 @@ namespace HMesh
             }
 //            cout << "Simplifying"<<endl;
             
-            int work = 0;
-            while(!sim_queue.empty() && work < max_work){
+            long int work = 0;
+            size_t popped = 0;
+            while(!sim_queue.empty() && work < max_work && m.no_faces() > options.target_faces){
+                // The records come in order of increasing error, so no later record is cheaper.
+                if(sim_queue.top().err > options.max_error)
+                    break;
+                // Reading the clock costs little compared to a batch of contractions.
+                if(options.time_limit > 0 && (++popped % 64) == 0 && timer.get_secs() > options.time_limit){
+                    stats.timed_out = true;
+                    break;
+                }
                 SimplifyRec simplify_record = sim_queue.top();
                 sim_queue.pop();
-                work += 2*collapse(simplify_record);
-//                if((sim_queue.size() % 10000) == 0){
-//                    cout << "error " << simplify_record.err << endl;
-//                }
-//                cout << "work = " << work << endl;
-//                cout << "sim Q size = " << sim_queue.size() << endl;
+                if(collapse(simplify_record)){
+                    work += 2;
+                    if(options.progress && options.progress_interval > 0 &&
+                       stats.collapses % options.progress_interval == 0){
+                        stats.seconds = timer.get_secs();
+                        if(!options.progress(stats)){
+                            stats.cancelled = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            if(recorder) {
+                recorder->finish(m, *options.progressive_mesh);
+                recorder = 0;
+            }
+            stats.seconds = timer.get_secs();
+            return stats;
+        }
+        
+        /* The record of a potential contraction of a halfedge in the parallel simplifier. The
+         two halfedges of an edge have a record each, but the flags are only used in the record
+         of the halfedge with the smaller ID, which represents the edge. */
+        struct CollapseRec
+        {
+            Vec3d opt_pos;      // optimal vertex position
+            float err;          // Error associated with contraction, FLT_MAX if not allowed
+            int visits;         // Number of times the contraction was found to be invalid
+            bool dirty;         // The records of the edge must be recomputed
+            bool listed;        // The edge is in the list of candidates
+            CollapseRec(): opt_pos(0), err(FLT_MAX), visits(0), dirty(false), listed(false) {}
+        };
+        
+        /* Simplifier which works in rounds. In each round, the records of the edges that were
+         affected by the previous round are recomputed in parallel. Then a maximal set of
+         contractions whose one rings do not overlap is chosen greedily from the cheapest ones in
+         order of increasing error. Since the contractions in the set are independent, none of
+         them can invalidate the checks of another, so they are checked for validity in parallel,
+         and the valid ones are carried out. */
+        class ParallelQuadricSimplifier
+        {
+            typedef VertexAttributeVector<QEM> QEMVec;
+            typedef HalfEdgeAttributeVector<CollapseRec> CollapseVec;
+            typedef VertexAttributeVector<int> CollapseMask;
+            typedef pair<float, HalfEdgeID> Candidate;
+            
+            /* The contractions considered in a round are the cheapest 1/BATCH_DIVISOR of all
+             the candidates, but at least MIN_BATCH of them. */
+            static const size_t BATCH_DIVISOR = 4;
+            static const size_t MIN_BATCH = 1024;
+            
+            /* The vertices are split into this many partitions of consecutive IDs when
+             contractions are selected. */
+            static const size_t NO_PARTITIONS = 256;
+            
+            Manifold& m;
+            QEMVec qem_vec;
+            CollapseVec collapse_vec;
+            CollapseMask collapse_mask;
+            VertexAttributeVector<unsigned int> claimed;
+            vector<HalfEdgeID> dirty_edges;
+            vector<Candidate> candidates;
+            unsigned int round;
+            double singular_thresh;
+            bool choose_optimal_positions;
+            CollapseRecorder* recorder;
+            
+            /* The halfedge which represents the edge of h. */
+            HalfEdgeID edge(HalfEdgeID h) const
+            {
+                HalfEdgeID ho = m.walker(h).opp().halfedge();
+                return h < ho ? h : ho;
+            }
+            
+            /* The cheaper of the two contractions of the edge e. */
+            Candidate cheapest(HalfEdgeID e) const
+            {
+                HalfEdgeID eo = m.walker(e).opp().halfedge();
+                return min(Candidate(collapse_vec[e].err, e), Candidate(collapse_vec[eo].err, eo));
+            }
+            
+            /* Mark the records of the edge of h for recomputation. */
+            void mark_dirty(HalfEdgeID h)
+            {
+                HalfEdgeID e = edge(h);
+                if(!collapse_vec[e].dirty) {
+                    collapse_vec[e].dirty = true;
+                    dirty_edges.push_back(e);
+                }
             }
-//            cout << endl;
+            
+            /* Recompute the records of both halfedges of the edge e. */
+            void update_edge(HalfEdgeID e);
+            
+            /* Recompute the dirty records and bring the list of candidates up to date. */
+            void update_candidates();
+            
+            /* Returns true if pred(v) holds for the end points of h and all vertices of their
+             one rings. These are the vertices whose neighbourhoods a contraction of h reads or
+             changes. */
+            template<typename Pred>
+            bool all_ring_vertices(HalfEdgeID h, const Pred& pred) const
+            {
+                Walker w = m.walker(h);
+                const VertexID ends[2] = {w.vertex(), w.opp().vertex()};
+                if(!pred(ends[0]) || !pred(ends[1]))
+                    return false;
+                for(VertexID v: ends)
+                    for(Walker wv = m.walker(v); !wv.full_circle(); wv = wv.circulate_vertex_cw())
+                        if(!pred(wv.vertex()))
+                            return false;
+                return true;
+            }
+            
+            /* Claim the vertices in the one rings of both end points of h for this round.
+             Returns false, and claims nothing, if any of them is already claimed. */
+            bool claim(HalfEdgeID h)
+            {
+                if(!all_ring_vertices(h, [&](VertexID v) { return claimed[v] != round; }))
+                    return false;
+                all_ring_vertices(h, [&](VertexID v) { claimed[v] = round; return true; });
+                return true;
+            }
+            
+            /* Select a maximal set of contractions with disjoint one rings among the N first
+             candidates, and return them in order of increasing error. */
+            void select_independent(size_t N, vector<Candidate>& selected);
+            
+            /* Contract h and mark the records around the resulting vertex dirty. */
+            void collapse(HalfEdgeID h);
+            
+        public:
+            
+            /* Create a simplifier for a manifold */
+            ParallelQuadricSimplifier(Manifold& _m, const VertexAttributeVector<int>& _collapse_mask,
+                                      double _singular_thresh, bool _choose_optimal_positions):
+            m(_m),
+            qem_vec(m.allocated_vertices(), QEM()),
+            collapse_vec(m.allocated_halfedges(), CollapseRec()),
+            collapse_mask(_collapse_mask),
+            claimed(m.allocated_vertices(), 0),
+            round(0),
+            singular_thresh(_singular_thresh),
+            choose_optimal_positions(_choose_optimal_positions),
+            recorder(0)
+            {
+                if(collapse_mask.size() < m.allocated_vertices())
+                    collapse_mask.resize(m.allocated_vertices(), 0);
+            }
+            
+            /* Simplify removing at most max_work faces or until options say stop */
+            QuadricSimplifyStats reduce(long int max_work, const QuadricSimplifyOptions& options);
+        };
+        
+        void ParallelQuadricSimplifier::update_edge(HalfEdgeID e)
+        {
+            // The two contractions have the same quadric, and with optimal positions they also
+            // have the same position and error, so the position is only computed once.
+            Walker w = m.walker(e);
+            HalfEdgeID eo = w.opp().halfedge();
+            CollapseRec& rec = collapse_vec.unchecked(e);
+            CollapseRec& rec_o = collapse_vec.unchecked(eo);
+            const CollapseMask& mask = collapse_mask;
+            const bool allowed = mask[w.opp().vertex()] == 0;
+            const bool allowed_o = mask[w.vertex()] == 0;
+            
+            QEM q = qem_vec[w.vertex()];
+            q += qem_vec[w.opp().vertex()];
+            if(allowed || (allowed_o && choose_optimal_positions))
+                rec.err = collapse_error(m, q, e, singular_thresh, choose_optimal_positions, rec.opt_pos);
+            if(allowed_o) {
+                if(choose_optimal_positions) {
+                    rec_o.opt_pos = rec.opt_pos;
+                    rec_o.err = rec.err;
+                }
+                else
+                    rec_o.err = collapse_error(m, q, eo, singular_thresh, choose_optimal_positions, rec_o.opt_pos);
+            }
+            if(!allowed)
+                rec.err = FLT_MAX;
+            if(!allowed_o)
+                rec_o.err = FLT_MAX;
+            rec.visits = rec_o.visits = 0;
+            rec.dirty = false;
+        }
+        
+        void ParallelQuadricSimplifier::update_candidates()
+        {
+            Util::parallel_for_chunks(dirty_edges.size(), [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i)
+                    update_edge(dirty_edges[i]);
+            }, 256);
+            
+            // The errors of listed edges may have changed, so their candidates are recomputed.
+            Util::parallel_for_chunks(candidates.size(), [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i) {
+                    HalfEdgeID h = candidates[i].second;
+                    candidates[i] = m.in_use(h) ? cheapest(edge(h)) : Candidate(FLT_MAX, h);
+                }
+            }, 4096);
+            for(HalfEdgeID e: dirty_edges)
+                if(!collapse_vec[e].listed) {
+                    collapse_vec[e].listed = true;
+                    candidates.push_back(cheapest(e));
+                }
+            dirty_edges.clear();
+            
+            // Drop the edges that are gone or cannot be contracted. They are listed again if
+            // they become dirty.
+            auto end = remove_if(candidates.begin(), candidates.end(), [&](const Candidate& c) {
+                if(c.first < FLT_MAX)
+                    return false;
+                if(m.in_use(c.second))
+                    collapse_vec[edge(c.second)].listed = false;
+                return true;
+            });
+            candidates.erase(end, candidates.end());
+        }
+        
+        void ParallelQuadricSimplifier::select_independent(size_t N, vector<Candidate>& selected)
+        {
+            // The contractions are chosen greedily in order of increasing error, picking each one
+            // whose one rings do not overlap those of a contraction already picked. To do this in
+            // parallel, the vertices are partitioned by ID, and the candidates whose one rings lie
+            // inside a partition are handled by a greedy pass per partition. These passes cannot
+            // interfere. The remaining candidates straddle partitions and are handled by a final
+            // greedy pass. Vertices with nearby IDs tend to be close on the surface, so most
+            // candidates lie inside a partition. The partitions do not depend on the number of
+            // threads, and neither does the result.
+            const size_t P = NO_PARTITIONS;
+            const size_t n = claimed.size();
+            auto partition = [&](VertexID v) { return size_t(v.index) * P / n; };
+            vector<uint32_t> part(N);
+            Util::parallel_for_chunks(N, [&](size_t b, size_t e) {
+                for(size_t i = b; i < e; ++i) {
+                    HalfEdgeID h = candidates[i].second;
+                    const size_t p = partition(m.walker(h).vertex());
+                    part[i] = all_ring_vertices(h, [&](VertexID v) { return partition(v) == p; }) ? p : P;
+                }
+            }, 1024);
+            
+            vector<size_t> start(P + 2, 0);
+            for(size_t i = 0; i < N; ++i)
+                ++start[part[i] + 1];
+            for(size_t p = 0; p <= P; ++p)
+                start[p + 1] += start[p];
+            vector<Candidate> sorted(N);
+            vector<size_t> fill(start.begin(), start.end() - 1);
+            for(size_t i = 0; i < N; ++i)
+                sorted[fill[part[i]]++] = candidates[i];
+            
+            vector<size_t> no_picked(P + 1, 0);
+            auto greedy = [&](size_t p) {
+                auto b = sorted.begin() + start[p], e = sorted.begin() + start[p + 1];
+                sort(b, e);
+                for(auto c = b; c != e; ++c)
+                    if(claim(c->second))
+                        *(b + no_picked[p]++) = *c;
+            };
+            Util::parallel_for_chunks(P, [&](size_t b, size_t e) {
+                for(size_t p = b; p < e; ++p)
+                    greedy(p);
+            }, 1);
+            greedy(P);
+            
+            selected.clear();
+            for(size_t p = 0; p <= P; ++p)
+                selected.insert(selected.end(), sorted.begin() + start[p], sorted.begin() + start[p] + no_picked[p]);
+            sort(selected.begin(), selected.end());
+        }
+        
+        void ParallelQuadricSimplifier::collapse(HalfEdgeID h)
+        {
+            Walker w = m.walker(h);
+            VertexID v = w.opp().vertex();
+            VertexID n = w.vertex();
+            
+            QEM q = qem_vec[n];
+            q += qem_vec[v];
+            
+            const Vec3d opt_pos = collapse_vec[h].opt_pos;
+            if(recorder)
+                recorder->collapse(m, h);
+            m.collapse_edge(h);
+            m.pos(n) = opt_pos;
+            qem_vec[n] = q;
+            
+            for(Walker wn = m.walker(n); !wn.full_circle(); wn = wn.circulate_vertex_cw())
+                mark_dirty(wn.halfedge());
+        }
+        
+        QuadricSimplifyStats ParallelQuadricSimplifier::reduce(long int max_work, const QuadricSimplifyOptions& options)
+        {
+            Util::Timer timer;
+            timer.start();
+            QuadricSimplifyStats stats;
+            CollapseRecorder collapse_recorder;
+            if(options.progressive_mesh)
+                recorder = &collapse_recorder;
+            
+            for_each_vertex_parallel(m, [&](VertexID v) {
+                qem_vec.unchecked(v) = vertex_quadric(m, v);
+            });
+            for(HalfEdgeID h: m.halfedges())
+                mark_dirty(h);
+            
+            vector<Candidate> selected;
+            vector<char> valid;
+            long int work = 0;
+            while(work < max_work && m.no_faces() > options.target_faces) {
+                if(options.time_limit > 0 && timer.get_secs() > options.time_limit) {
+                    stats.timed_out = true;
+                    break;
+                }
+                ++round;
+                update_candidates();
+                
+                // Only candidates within the error bound are considered.
+                auto cheap_end = candidates.end();
+                if(options.max_error < FLT_MAX)
+                    cheap_end = partition(candidates.begin(), candidates.end(), [&](const Candidate& c) {
+                        return c.first <= options.max_error; });
+                const size_t no_cheap = cheap_end - candidates.begin();
+                if(no_cheap == 0)
+                    break;
+                
+                const size_t N = min(no_cheap, max(size_t(MIN_BATCH), candidates.size() / BATCH_DIVISOR));
+                nth_element(candidates.begin(), candidates.begin() + (N-1), cheap_end);
+                
+                // Choose a maximal set of contractions with disjoint one rings among the cheapest.
+                // A contraction removes up to two faces, which bounds the number carried out.
+                select_independent(N, selected);
+                const size_t max_collapses = min((size_t(max_work - work) + 1) / 2,
+                                                 (m.no_faces() - options.target_faces + 1) / 2);
+                if(selected.size() > max_collapses)
+                    selected.resize(max_collapses);
+                
+                // The checks only read the mesh, and the contractions in the set do not affect
+                // each other, so all of them are checked in parallel before any is carried out.
+                valid.assign(selected.size(), 0);
+                Util::parallel_for_chunks(selected.size(), [&](size_t b, size_t e) {
+                    for(size_t i = b; i < e; ++i) {
+                        HalfEdgeID h = selected[i].second;
+                        const Vec3d& opt_pos = collapse_vec[h].opt_pos;
+                        valid[i] = precond_collapse_edge(m, h) &&
+                        check_consistency(m, h, opt_pos) &&
+                        check_consistency(m, m.walker(h).opp().halfedge(), opt_pos);
+                    }
+                }, 64);
+                
+                const size_t collapses_before = stats.collapses;
+                for(size_t i = 0; i < selected.size(); ++i) {
+                    HalfEdgeID h = selected[i].second;
+                    if(valid[i]) {
+                        collapse(h);
+                        work += 2;
+                        ++stats.collapses;
+                        stats.max_error = max(stats.max_error, double(selected[i].first));
+                    }
+                    else {
+                        // As in the sequential simplifier, an invalid contraction becomes a
+                        // little more expensive, and it is given up after 100 attempts.
+                        CollapseRec& rec = collapse_vec[h];
+                        rec.err = ++rec.visits < 100 ? rec.err * 1.01f : FLT_MAX;
+                        ++stats.rejected;
+                    }
+                }
+                
+                if(options.progress && options.progress_interval > 0 &&
+                   stats.collapses / options.progress_interval > collapses_before / options.progress_interval) {
+                    stats.seconds = timer.get_secs();
+                    if(!options.progress(stats)) {
+                        stats.cancelled = true;
+                        break;
+                    }
+                }
+            }
+            if(recorder) {
+                recorder->finish(m, *options.progressive_mesh);
+                recorder = 0;
+            }
+            stats.seconds = timer.get_secs();
+            return stats;
+        }
+    }
+    
+    namespace
+    {
+        /* The number of faces quadric_simplify removes when keeping keep_fraction of them. If
+         keep_fraction is zero and there is a mask, the number is unbounded. */
+        long int faces_to_remove(const Manifold& m, double keep_fraction, bool masked)
+        {
+            long int F = m.no_faces();
+            if(masked && keep_fraction == 0.0)
+                return INT_MAX;
+            return max(static_cast<long int>(0), F- static_cast<long int>(keep_fraction * F));
+        }
+        
+        QuadricSimplifyOptions simplify_options(double singular_thresh, bool choose_optimal_positions)
+        {
+            QuadricSimplifyOptions opts;
+            opts.singular_thresh = singular_thresh;
+            opts.choose_optimal_positions = choose_optimal_positions;
+            return opts;
+        }
+        
+        /* The rounds only pay off when the work is shared by several threads. On one thread
+         the sequential simplifier is faster, so the parallel entry points use it instead. */
+        bool use_rounds()
+        {
+            return Util::no_threads() > 1;
         }
     }
     
     void quadric_simplify(Manifold& m, double keep_fraction, double singular_thresh, bool choose_optimal_positions)
     {
         gel_srand(1210);
-        long int F = m.no_faces();
         VertexAttributeVector<int> mask(m.no_faces(), 0);
-        long int max_work = max(static_cast<long int>(0), F- static_cast<long int>(keep_fraction * F));
         QuadricSimplifier qsim(m, mask, singular_thresh, choose_optimal_positions);
-        qsim.reduce(max_work);
+        qsim.reduce(faces_to_remove(m, keep_fraction, false), simplify_options(singular_thresh, choose_optimal_positions));
         valid(m);
     }
     
     void quadric_simplify(Manifold& m, VertexAttributeVector<int> mask, double keep_fraction, double singular_thresh, bool choose_optimal_positions)
     {
         gel_srand(1210);
-        long int F = m.no_faces();
-        long int max_work = keep_fraction == 0.0 ? INT_MAX : max(static_cast<long int>(0),
-                                                                 F- static_cast<long int>(keep_fraction * F));
         QuadricSimplifier qsim(m, mask, singular_thresh, choose_optimal_positions);
-        qsim.reduce(max_work);
+        qsim.reduce(faces_to_remove(m, keep_fraction, true), simplify_options(singular_thresh, choose_optimal_positions));
+    }
+    
+    QuadricSimplifyStats quadric_simplify(Manifold& m, const QuadricSimplifyOptions& options)
+    {
+        VertexAttributeVector<int> mask(m.allocated_vertices(), 0);
+        return quadric_simplify(m, mask, options);
+    }
+    
+    QuadricSimplifyStats quadric_simplify(Manifold& m, VertexAttributeVector<int> mask, const QuadricSimplifyOptions& options)
+    {
+        QuadricSimplifier qsim(m, mask, options.singular_thresh, options.choose_optimal_positions);
+        return qsim.reduce(LONG_MAX, options);
+    }
+    
+    void quadric_simplify_parallel(Manifold& m, double keep_fraction, double singular_thresh, bool choose_optimal_positions)
+    {
+        if(!use_rounds())
+            return quadric_simplify(m, keep_fraction, singular_thresh, choose_optimal_positions);
+        VertexAttributeVector<int> mask(m.allocated_vertices(), 0);
+        ParallelQuadricSimplifier qsim(m, mask, singular_thresh, choose_optimal_positions);
+        qsim.reduce(faces_to_remove(m, keep_fraction, false), simplify_options(singular_thresh, choose_optimal_positions));
+    }
+    
+    void quadric_simplify_parallel(Manifold& m, VertexAttributeVector<int> mask, double keep_fraction, double singular_thresh, bool choose_optimal_positions)
+    {
+        if(!use_rounds())
+            return quadric_simplify(m, mask, keep_fraction, singular_thresh, choose_optimal_positions);
+        ParallelQuadricSimplifier qsim(m, mask, singular_thresh, choose_optimal_positions);
+        qsim.reduce(faces_to_remove(m, keep_fraction, true), simplify_options(singular_thresh, choose_optimal_positions));
     }
     
+    QuadricSimplifyStats quadric_simplify_parallel(Manifold& m, const QuadricSimplifyOptions& options)
+    {
+        VertexAttributeVector<int> mask(m.allocated_vertices(), 0);
+        return quadric_simplify_parallel(m, mask, options);
+    }
     
+    QuadricSimplifyStats quadric_simplify_parallel(Manifold& m, VertexAttributeVector<int> mask, const QuadricSimplifyOptions& options)
+    {
+        if(!use_rounds())
+            return quadric_simplify(m, mask, options);
+        ParallelQuadricSimplifier qsim(m, mask, options.singular_thresh, options.choose_optimal_positions);
+        return qsim.reduce(LONG_MAX, options);
+    }
 }
@@ -11,10 +11,59 @@
 #ifndef __HMESH_QUADRIC_SIMPLIFY__H
 #define __HMESH_QUADRIC_SIMPLIFY__H
 
+#include <functional>
+#include <limits>
 #include "Manifold.h"
 
 namespace HMesh
 {
+    struct ProgressiveMesh;
+
+    /// Statistics of a quadric simplification.
+    struct QuadricSimplifyStats
+    {
+        size_t collapses = 0;       ///< Number of edge contractions carried out.
+        size_t stale_records = 0;   ///< Number of records discarded because the edge had changed.
+        size_t rejected = 0;        ///< Number of times a contraction was found to be invalid.
+        double max_error = 0;       ///< Greatest quadric error of a contraction carried out.
+        double seconds = 0;         ///< Time spent so far.
+        bool timed_out = false;     ///< The simplification stopped because time ran out.
+        bool cancelled = false;     ///< The simplification was stopped by the progress callback.
+    };
+
+    /** Options for quadric simplification. The edges are contracted in order of increasing
+    quadric error until the first of the stopping criteria is met, or until no more edges can be
+    contracted. Hence, a single run can meet an error or face count budget which would otherwise
+    require repeated runs with different values of keep_fraction. */
+    struct QuadricSimplifyOptions
+    {
+        /** Stop when the mesh has no more than this many faces. A contraction removes up to two
+        triangles, so the mesh may end with one face less. */
+        size_t target_faces = 0;
+
+        /// Stop before the first contraction whose quadric error exceeds this value.
+        double max_error = std::numeric_limits<double>::infinity();
+
+        /// Stop when this many seconds have passed. Zero means no limit.
+        double time_limit = 0;
+
+        /// How small singular values we accept relative to the greatest. See quadric_simplify.
+        double singular_thresh = 0.0001;
+
+        /// If false, the vertices are a subset of the old vertices.
+        bool choose_optimal_positions = true;
+
+        /** Called with the statistics every progress_interval contractions. If it returns
+        false, the simplification is cancelled, leaving the mesh valid and simplified so far. */
+        std::function<bool(const QuadricSimplifyStats&)> progress;
+        size_t progress_interval = 10000;
+
+        /** If not null, the contractions are recorded, and this is set to the progressive mesh
+        whose base mesh is the simplified mesh, and whose vertex splits restore the original
+        mesh. See progressive_mesh.h. */
+        ProgressiveMesh* progressive_mesh = nullptr;
+    };
+
     /** \brief Garland Heckbert simplification in our own implementation. 
     keep_fraction is the fraction of vertices to retain. The singular_thresh defines how
     small singular values from the SVD we accept. It is relative to the greatest singular value. 
@@ -23,5 +72,29 @@ namespace HMesh
     void quadric_simplify(Manifold& m, double keep_fraction, double singular_thresh = 0.0001, bool choose_optimal_positions = true);
     void quadric_simplify(Manifold& m, VertexAttributeVector<int> mask, double keep_fraction, double singular_thresh = 0.0001, bool choose_optimal_positions = true);
 
+    /** \brief Garland Heckbert simplification which stops as given by options. Vertices v
+    with mask[v] nonzero are not removed. Returns the statistics of the simplification. */
+    QuadricSimplifyStats quadric_simplify(Manifold& m, const QuadricSimplifyOptions& options);
+    QuadricSimplifyStats quadric_simplify(Manifold& m, VertexAttributeVector<int> mask, const QuadricSimplifyOptions& options);
+
+    /** \brief Parallel Garland Heckbert simplification. The arguments are the same as for
+    quadric_simplify. Instead of contracting one edge at a time, the simplification proceeds in
+    rounds. In each round, the errors of the edges that changed are recomputed in parallel, a
+    maximal set of cheap contractions whose one rings do not overlap is chosen, and the
+    contractions in the set are checked for validity in parallel and carried out. The result is close to, but not
+    the same as, that of quadric_simplify, and it does not depend on the number of threads as long as
+    there are more than one. The rounds are slower than quadric_simplify on a single thread, so if
+    GEL uses only one thread (see Util::set_no_threads), quadric_simplify is called instead. */
+    void quadric_simplify_parallel(Manifold& m, double keep_fraction, double singular_thresh = 0.0001, bool choose_optimal_positions = true);
+    void quadric_simplify_parallel(Manifold& m, VertexAttributeVector<int> mask, double keep_fraction, double singular_thresh = 0.0001, bool choose_optimal_positions = true);
+
+    /** \brief Parallel Garland Heckbert simplification which stops as given by options. The
+    criteria are checked between rounds, and a round carries out no more contractions than
+    target_faces allows. The progress callback is called at the end of each round in which the
+    number of contractions passes a multiple of progress_interval. The records are kept up to date
+    rather than replaced, so stale_records is zero. On a single thread, this calls quadric_simplify. */
+    QuadricSimplifyStats quadric_simplify_parallel(Manifold& m, const QuadricSimplifyOptions& options);
+    QuadricSimplifyStats quadric_simplify_parallel(Manifold& m, VertexAttributeVector<int> mask, const QuadricSimplifyOptions& options);
+
 }
 #endif
\ No newline at end of file
@@ -22,11 +22,23 @@ namespace HMesh
     inline CGLA::Vec3d laplacian(const Manifold& m, VertexID v)
     {
         CGLA::Vec3d p(0);
-        int n = circulate_vertex_ccw(m, v, static_cast<std::function<void(VertexID)>>([&](VertexID v){ p += m.pos(v); }));
+        int n = circulate_vertex_ccw(m, v, [&](VertexID v){ p += m.pos(v); });
         return p / n - m.pos(v);
     }
     
+    /** The cotangent weight cot(a) + cot(b) of the edge of h, where a and b are the angles opposite
+     the edge in the two faces that share it. For a boundary edge, only the angle in the face which
+     exists counts. The weight is the same for h and its opposite halfedge. */
+    double cot_weight(const Manifold& m, HalfEdgeID h);
+
+    /// The Laplacian of v computed with cotangent weights.
     CGLA::Vec3d cot_laplacian(const Manifold& m, VertexID v);
+
+    /** Find the faces that share a vertex with f. f itself comes first, and the other faces follow in
+     the order they are met when circulating the vertices of f. nbrs is cleared first. The cost
+     depends only on the size of the neighbourhood, and the function can be called from several
+     threads at once. */
+    void face_neighbourhood(const Manifold& m, FaceID f, std::vector<FaceID>& nbrs);
     
     /// Simple laplacian smoothing with an optional weight.
     void laplacian_smooth(HMesh::Manifold& m, float t=1.0f, int iter=1);
@@ -7,16 +7,279 @@
 #include "dual.h"
 #include "subdivision.h"
 
+#include <cmath>
 #include <vector>
 #include "../CGLA/Vec3d.h"
 
 #include "Manifold.h"
 #include "AttributeVector.h"
+#include "parallel_for.h"
 
 namespace HMesh
 {
     using namespace std;
     using namespace CGLA;
+
+    namespace
+    {
+        const size_t UNUSED = size_t(-1);
+
+        /** The entities of a mesh numbered consecutively in the order of their IDs, and the
+         layout of the mesh that one level of subdivision turns it into. The refined mesh is laid
+         out entirely by arithmetic on these numbers:
+
+         - Vertex i is input vertex i. Then follows a vertex for each edge and, in a quad split, a
+           vertex for each face.
+         - Input halfedge k becomes two halfedges, h0 leaving the start of k and h1 arriving at its
+           end. If k has a face, two more halfedges between the edge vertex and the inside of the
+           face follow. The four (or two) halfedges of k start at hoff[k].
+         - Face j is the face at the corner where the j'th halfedge with a face ends. In a triangle
+           split, a middle face for each input face follows. */
+        struct SubdivisionLayout
+        {
+            vector<VertexID> vertices;
+            vector<FaceID> faces;
+            vector<HalfEdgeID> halfedges;
+
+            /// Dense number of each ID of the input, or UNUSED.
+            vector<size_t> vertex_no, face_no, halfedge_no;
+
+            /// Edge of each halfedge and, for each edge, the halfedge whose h1 leaves the edge vertex.
+            vector<size_t> edge, edge_halfedge;
+
+            /// First output halfedge of each input halfedge. hoff[H] is the number of output halfedges.
+            vector<size_t> hoff;
+
+            size_t V, E, F, H, corners;
+
+            SubdivisionLayout(const Manifold& m)
+            {
+                vertex_no.assign(m.allocated_vertices(), UNUSED);
+                face_no.assign(m.allocated_faces(), UNUSED);
+                halfedge_no.assign(m.allocated_halfedges(), UNUSED);
+                for(auto v: m.vertices()) {
+                    vertex_no[v.index] = vertices.size();
+                    vertices.push_back(v);
+                }
+                for(auto f: m.faces()) {
+                    face_no[f.index] = faces.size();
+                    faces.push_back(f);
+                }
+                for(auto h: m.halfedges()) {
+                    halfedge_no[h.index] = halfedges.size();
+                    halfedges.push_back(h);
+                }
+                V = vertices.size();
+                F = faces.size();
+                H = halfedges.size();
+
+                // An edge gets its number from its first halfedge. The edge vertex leaves along
+                // the boundary if there is one, as a boundary vertex must.
+                edge.assign(H, UNUSED);
+                hoff.assign(H+1, 0);
+                E = 0;
+                for(size_t k=0;k<H;++k) {
+                    Walker w = m.walker(halfedges[k]);
+                    if(edge[k] == UNUSED) {
+                        size_t o = halfedge_no[w.opp().halfedge().index];
+                        edge[k] = edge[o] = E++;
+                        edge_halfedge.push_back(w.face() == InvalidFaceID || w.opp().face() != InvalidFaceID ? k : o);
+                    }
+                    hoff[k+1] = hoff[k] + (w.face() == InvalidFaceID ? 2 : 4);
+                }
+                corners = (hoff[H] - 2*H) / 2;
+            }
+
+            size_t no(VertexID v) const { return vertex_no[v.index]; }
+            size_t no(FaceID f) const { return face_no[f.index]; }
+            size_t no(HalfEdgeID h) const { return halfedge_no[h.index]; }
+
+            /// Number of the face at the corner where halfedge k ends. k must have a face.
+            size_t corner_face(size_t k) const { return (hoff[k] - 2*k) / 2; }
+        };
+
+        /** Write the connectivity of one level of subdivision of m_in to kernel, which must be
+         empty. See SubdivisionLayout. */
+        void subdivide_connectivity(const Manifold& m_in, const SubdivisionLayout& L, bool triangles,
+                                    ConnectivityKernel& kernel)
+        {
+            const size_t no_vertices = L.V + L.E + (triangles ? 0 : L.F);
+            const size_t no_faces = L.corners + (triangles ? L.F : 0);
+            const size_t no_halfedges = L.hoff[L.H];
+            kernel.reserve(no_vertices, no_faces, no_halfedges);
+            for(size_t i=0;i<no_vertices;++i)
+                kernel.add_vertex();
+            for(size_t i=0;i<no_faces;++i)
+                kernel.add_face();
+            for(size_t i=0;i<no_halfedges;++i)
+                kernel.add_halfedge();
+
+            auto H0 = [&](size_t k) { return HalfEdgeID(L.hoff[k]); };
+            auto H1 = [&](size_t k) { return HalfEdgeID(L.hoff[k]+1); };
+            auto IN = [&](size_t k) { return HalfEdgeID(L.hoff[k]+2); };
+            auto OUT = [&](size_t k) { return HalfEdgeID(L.hoff[k]+3); };
+            auto edge_vertex = [&](size_t k) { return VertexID(L.V + L.edge[k]); };
+
+            // In a quad split, IN(k) runs from the edge vertex of k to the face vertex and OUT(k)
+            // back. The quad at the corner where k ends is H1(k), H0(next), IN(next), OUT(k).
+            // In a triangle split, IN(k) runs from the edge vertex of next(k) to that of k, so the
+            // corner triangle is H1(k), H0(next), IN(k). OUT(k) is its opposite in the middle face.
+            Util::parallel_for_chunks(L.H, [&](size_t b, size_t e) {
+                for(size_t k=b;k<e;++k) {
+                    Walker w = m_in.walker(L.halfedges[k]);
+                    const size_t n = L.no(w.next().halfedge());
+                    const size_t p = L.no(w.prev().halfedge());
+                    const size_t o = L.no(w.opp().halfedge());
+                    const bool interior = w.face() != InvalidFaceID;
+
+                    kernel.set_opp(H0(k), H1(o));
+                    kernel.set_opp(H1(k), H0(o));
+                    kernel.set_vert(H0(k), edge_vertex(k));
+                    kernel.set_vert(H1(k), VertexID(L.no(w.vertex())));
+                    kernel.set_prev(H0(k), H1(p));
+                    kernel.set_next(H1(k), H0(n));
+                    if(!interior) {
+                        kernel.set_next(H0(k), H1(k));
+                        kernel.set_prev(H1(k), H0(k));
+                        kernel.set_face(H0(k), InvalidFaceID);
+                        kernel.set_face(H1(k), InvalidFaceID);
+                        continue;
+                    }
+
+                    const FaceID corner(L.corner_face(k));
+                    kernel.set_face(H0(k), FaceID(L.corner_face(p)));
+                    kernel.set_face(H1(k), corner);
+                    kernel.set_last(corner, H1(k));
+                    kernel.set_opp(IN(k), OUT(k));
+                    kernel.set_opp(OUT(k), IN(k));
+                    if(triangles) {
+                        const FaceID middle(L.corners + L.no(w.face()));
+                        kernel.set_next(H0(k), IN(p));
+                        kernel.set_prev(H1(k), IN(k));
+                        kernel.set_vert(IN(k), edge_vertex(k));
+                        kernel.set_next(IN(k), H1(k));
+                        kernel.set_prev(IN(k), H0(n));
+                        kernel.set_face(IN(k), corner);
+                        kernel.set_vert(OUT(k), edge_vertex(n));
+                        kernel.set_next(OUT(k), OUT(n));
+                        kernel.set_prev(OUT(k), OUT(p));
+                        kernel.set_face(OUT(k), middle);
+                        if(w.halfedge() == m_in.walker(w.face()).halfedge())
+                            kernel.set_last(middle, OUT(k));
+                    }
+                    else {
+                        kernel.set_next(H0(k), IN(k));
+                        kernel.set_prev(H1(k), OUT(k));
+                        kernel.set_vert(IN(k), VertexID(L.V + L.E + L.no(w.face())));
+                        kernel.set_next(IN(k), OUT(p));
+                        kernel.set_prev(IN(k), H0(k));
+                        kernel.set_face(IN(k), FaceID(L.corner_face(p)));
+                        kernel.set_vert(OUT(k), edge_vertex(k));
+                        kernel.set_next(OUT(k), H1(k));
+                        kernel.set_prev(OUT(k), IN(n));
+                        kernel.set_face(OUT(k), corner);
+                        if(w.halfedge() == m_in.walker(w.face()).halfedge())
+                            kernel.set_out(VertexID(L.V + L.E + L.no(w.face())), OUT(k));
+                    }
+                }
+            }, 4096);
+
+            Util::parallel_for_chunks(L.V, [&](size_t b, size_t e) {
+                for(size_t i=b;i<e;++i) {
+                    HalfEdgeID h = m_in.walker(L.vertices[i]).halfedge();
+                    kernel.set_out(VertexID(i), h == InvalidHalfEdgeID ? h : H0(L.no(h)));
+                }
+            }, 4096);
+            for(size_t e=0;e<L.E;++e)
+                kernel.set_out(VertexID(L.V + e), H1(L.edge_halfedge[e]));
+        }
+
+        /// Sum of the positions of the vertices of face f and their number.
+        Vec3d face_sum(const Manifold& m, FaceID f, int& n)
+        {
+            Vec3d sum(0);
+            n = circulate_face_ccw(m, f, [&](VertexID v) { sum += m.pos(v); });
+            return sum;
+        }
+
+        /** Positions of the vertices of one level of subdivision of m_in. pos holds an entry for
+         each vertex of the refined mesh. */
+        void subdivide_positions(const Manifold& m_in, const SubdivisionLayout& L, Subd method,
+                                 VertexAttributeVector<Vec3d>& pos)
+        {
+            const bool triangles = method == TRI_SUBD || method == LOOP_SUBD;
+            const bool smooth = method == CC_SUBD || method == LOOP_SUBD;
+            const size_t face_base = L.V + L.E;
+
+            // Face vertices first, since Catmull-Clark needs them for the other vertices.
+            if(!triangles)
+                Util::parallel_for_chunks(L.F, [&](size_t b, size_t e) {
+                    for(size_t i=b;i<e;++i) {
+                        int n;
+                        Vec3d sum = face_sum(m_in, L.faces[i], n);
+                        pos.unchecked(VertexID(face_base + i)) = sum / n;
+                    }
+                }, 4096);
+
+            // The vertex of an edge. Loop uses the vertices opposite the edge in its two faces.
+            // If a face is not a triangle, the mean of its other vertices stands in.
+            auto opposite = [&](Walker w) {
+                if(w.next().next().next().halfedge() == w.halfedge())
+                    return m_in.pos(w.next().vertex());
+                int n;
+                Vec3d sum = face_sum(m_in, w.face(), n);
+                return (sum - m_in.pos(w.vertex()) - m_in.pos(w.opp().vertex())) / (n-2);
+            };
+            Util::parallel_for_chunks(L.E, [&](size_t b, size_t e) {
+                for(size_t i=b;i<e;++i) {
+                    Walker w = m_in.walker(L.halfedges[L.edge_halfedge[i]]);
+                    const Vec3d mid = 0.5 * (m_in.pos(w.vertex()) + m_in.pos(w.opp().vertex()));
+                    Vec3d& p = pos.unchecked(VertexID(L.V + i));
+                    if(!smooth || w.face() == InvalidFaceID || w.opp().face() == InvalidFaceID)
+                        p = mid;
+                    else if(method == CC_SUBD)
+                        p = 0.5 * mid + 0.25 * (pos.unchecked(VertexID(face_base + L.no(w.face()))) +
+                                                pos.unchecked(VertexID(face_base + L.no(w.opp().face()))));
+                    else
+                        p = 0.75 * mid + 0.125 * (opposite(w) + opposite(w.opp()));
+                }
+            }, 4096);
+
+            Util::parallel_for_chunks(L.V, [&](size_t b, size_t e) {
+                for(size_t i=b;i<e;++i) {
+                    const VertexID v = L.vertices[i];
+                    const Vec3d S = m_in.pos(v);
+                    Vec3d& p = pos.unchecked(VertexID(i));
+                    Walker w0 = m_in.walker(v);
+                    if(!smooth || w0.halfedge() == InvalidHalfEdgeID) {
+                        p = S;
+                        continue;
+                    }
+                    if(w0.face() == InvalidFaceID) {
+                        // A boundary vertex only depends on its neighbours along the boundary.
+                        p = 0.75 * S + 0.125 * (m_in.pos(w0.vertex()) + m_in.pos(w0.prev().opp().vertex()));
+                        continue;
+                    }
+                    Vec3d R(0), Q(0);
+                    int n = 0;
+                    for(Walker w = w0; !w.full_circle(); w = w.circulate_vertex_ccw(), ++n) {
+                        R += m_in.pos(w.vertex());
+                        if(method == CC_SUBD)
+                            Q += pos.unchecked(VertexID(face_base + L.no(w.face())));
+                    }
+                    if(method == CC_SUBD) {
+                        // (Q + 2R + (n-3)S)/n with Q the mean face vertex and R the mean edge midpoint
+                        R = 0.5 * (R / n + S);
+                        p = (Q / n + 2.0 * R + (n - 3.0) * S) / n;
+                    }
+                    else {
+                        const double beta = (5.0/8.0 - sqr(3.0/8.0 + 0.25 * cos(2.0 * M_PI / n))) / n;
+                        p = (1.0 - n * beta) * S + beta * R;
+                    }
+                }
+            }, 4096);
+        }
+    }
     
     void loop_split(Manifold& m_in, Manifold& m)
     {
@@ -61,48 +324,7 @@ namespace HMesh
     
     void cc_split(Manifold& m_in, Manifold& m_out)
     {
-        const int Invalid = -1;
-
-        vector<Vec3d> new_points;
-        new_points.reserve(m_in.no_vertices());
-
-        VertexAttributeVector<int> vtouched(m_in.allocated_vertices(), Invalid);
-        HalfEdgeAttributeVector<int> htouched(m_in.allocated_halfedges(), Invalid);
-
-        int npsize = 0;
-        for(VertexIDIterator v = m_in.vertices_begin(); v != m_in.vertices_end(); ++v){       
-            vtouched[*v] = npsize;
-            new_points.push_back(m_in.pos(*v));
-            ++npsize;
-        }
-
-        for(HalfEdgeIDIterator h = m_in.halfedges_begin(); h != m_in.halfedges_end(); ++h){
-            if(htouched[*h] != Invalid)
-                continue;
-
-            Walker w = m_in.walker(*h);
-            htouched[*h] = htouched[w.opp().halfedge()] = npsize;
-            new_points.push_back((m_in.pos(w.vertex()) + m_in.pos(w.opp().vertex())) * 0.5f);
-            ++npsize;
-
-        }
-        vector<int> indices;
-        vector<int> faces;
-
-        for(FaceIDIterator f = m_in.faces_begin(); f != m_in.faces_end(); ++f){           
-            for(Walker w = m_in.walker(*f); !w.full_circle(); w = w.circulate_face_cw()){
-                indices.push_back(npsize);
-                indices.push_back(htouched[w.halfedge()]);
-                indices.push_back(vtouched[w.vertex()]);
-                indices.push_back(htouched[w.next().halfedge()]);
-                faces.push_back(4);
-            }
-            new_points.push_back(centre(m_in, *f));
-            ++npsize;
-        }
-
-        m_out.clear();
-        build(m_out, npsize, reinterpret_cast<double*>(&new_points[0]), faces.size(), &faces[0], &indices[0]);
+        subdivide(m_in, m_out, QUAD_SUBD);
     }
     
     void root3_subdivide(Manifold& m_in, Manifold& m)
@@ -235,47 +457,48 @@ namespace HMesh
                 m.pos(*vid) /= vtouched[*vid];
     }
     
-    enum Subd {QUAD_SUBD, CC_SUBD, LOOP_SUBD, TRI_SUBD};
-    
     void subd_smooth(Subd subd_method, Manifold& m)
     {
-        VertexAttributeVector<Vec3d> new_vertices(Vec3d(0));
-        
-        for(auto f: m.faces())
-        {
-            circulate_face_ccw(m, f, [&](VertexID v0) {
-                double val = valency(m, v0);
-                double A,B;
-                
-                switch(subd_method)
-                {
-                    case QUAD_SUBD:
-                        A = 1.0 / (4.0 * val);
-                        B = 1.0 / (4.0 * val);
-                        break;
-                    case CC_SUBD:
-                        A = (1.0-3.0/val) * (1.0/val);
-                        B = sqr(1.0/val);
-                        break;
-                    case TRI_SUBD:
-                        A = 2.0 / (8.0 * val);
-                        B = 3.0 / (8.0 * val);
-                        break;
-                    case LOOP_SUBD:
-                        float w = 5.0/8.0 - sqr(3.0/8.0 + 0.25 * cos(2.0*M_PI/val));
-                        A = (1.0-2.0*w)/val;
-                        B = w/val;
-                        break;
-                }
+        // Every face moves each of its vertices towards its own vertices. The contributions are
+        // gathered per vertex so that the vertices can be done in parallel.
+        VertexAttributeVector<Vec3d> new_vertices(m.allocated_vertices(), Vec3d(0));
+        for_each_vertex_parallel(m, [&](VertexID v0) {
+            double val = valency(m, v0);
+            double A = 0, B = 0;
+            
+            switch(subd_method)
+            {
+                case QUAD_SUBD:
+                    A = 1.0 / (4.0 * val);
+                    B = 1.0 / (4.0 * val);
+                    break;
+                case CC_SUBD:
+                    A = (1.0-3.0/val) * (1.0/val);
+                    B = sqr(1.0/val);
+                    break;
+                case TRI_SUBD:
+                    A = 2.0 / (8.0 * val);
+                    B = 3.0 / (8.0 * val);
+                    break;
+                case LOOP_SUBD:
+                    float w = 5.0/8.0 - sqr(3.0/8.0 + 0.25 * cos(2.0*M_PI/val));
+                    A = (1.0-2.0*w)/val;
+                    B = w/val;
+                    break;
+            }
+            Vec3d p(0);
+            circulate_vertex_ccw(m, v0, [&](FaceID f) {
+                if(f == InvalidFaceID)
+                    return;
                 circulate_face_ccw(m, f, [&](VertexID v) {
                     if(v == v0)
-                        new_vertices[v0] += A * m.pos(v);
+                        p += A * m.pos(v);
                     else
-                        new_vertices[v0] += B * m.pos(v);
+                        p += B * m.pos(v);
                 });
-                
             });
-        }
+            new_vertices.unchecked(v0) = p;
+        });
         m.positions_attribute_vector() = new_vertices;
     }
 
@@ -289,5 +512,207 @@ namespace HMesh
         subd_smooth(LOOP_SUBD, m);
     }
 
+    void subdivide(const Manifold& m_in, Manifold& m_out, Subd method, int levels)
+    {
+        const bool triangles = method == TRI_SUBD || method == LOOP_SUBD;
+        if(levels <= 0) {
+            if(&m_out != &m_in)
+                m_out = m_in;
+            return;
+        }
+
+        // Each level reads the previous one, so at most two meshes are needed besides m_in.
+        // m_out is written directly by the last level unless it is also the input.
+        Manifold buffers[2];
+        const Manifold* src = &m_in;
+        for(int l=0;l<levels;++l) {
+            Manifold& dst = (l == levels-1 && &m_out != &m_in) ? m_out : buffers[l%2];
+            const SubdivisionLayout L(*src);
+            dst.clear();
+            subdivide_connectivity(*src, L, triangles, dst.kernel);
+            dst.positions.resize(dst.allocated_vertices(), Vec3d(0));
+            subdivide_positions(*src, L, method, dst.positions);
+            dst.grow_attributes();
+            if(src == &buffers[(l+1)%2])
+                buffers[(l+1)%2].clear();
+            src = &dst;
+        }
+        // When subdividing in place, only the kernel and the positions are taken from the buffer,
+        // so that m_out keeps its attribute layers, cleared, as it does when it is not the input.
+        if(src != &m_out) {
+            m_out.kernel = std::move(buffers[(levels-1)%2].kernel);
+            m_out.positions = std::move(buffers[(levels-1)%2].positions);
+            m_out.attributes.clear();
+            m_out.grow_attributes();
+        }
+    }
 
+    void subdivide_adaptive(Manifold& m, FaceAttributeVector<int>& selected, Subd method, int levels)
+    {
+        const bool triangles = method == TRI_SUBD || method == LOOP_SUBD;
+        const bool smooth = method == CC_SUBD || method == LOOP_SUBD;
+        auto is_triangle = [&](FaceID f) { return no_edges(m, f) == 3; };
+
+        for(int l=0;l<levels;++l) {
+            // An edge is split if one of its faces is selected. In a triangle split, the
+            // selection grows until no unselected triangle has more than one split edge.
+            selected.resize(m.allocated_faces(), 0);
+            auto edge_split = [&](Walker w) {
+                return (w.face() != InvalidFaceID && selected[w.face()]) ||
+                       (w.opp().face() != InvalidFaceID && selected[w.opp().face()]);
+            };
+            if(triangles) {
+                vector<FaceID> queue;
+                for(auto f: m.faces())
+                    if(selected[f])
+                        circulate_face_ccw(m, f, [&](FaceID g) { if(g != InvalidFaceID && !selected[g]) queue.push_back(g); });
+                while(!queue.empty()) {
+                    FaceID f = queue.back();
+                    queue.pop_back();
+                    if(selected[f] || !is_triangle(f))
+                        continue;
+                    int split = 0;
+                    circulate_face_ccw(m, f, [&](Walker& w) { split += edge_split(w); });
+                    if(split > 1) {
+                        selected[f] = 1;
+                        circulate_face_ccw(m, f, [&](FaceID g) { if(g != InvalidFaceID && !selected[g]) queue.push_back(g); });
+                    }
+                }
+            }
+
+            // The new positions are all found on the mesh before it is split. A vertex is
+            // smoothed only if all its faces are selected, and an edge only if both its faces are.
+            FaceAttributeVector<Vec3d> face_pos(m.allocated_faces(), Vec3d(0));
+            HalfEdgeAttributeVector<Vec3d> edge_pos(m.allocated_halfedges(), Vec3d(0));
+            VertexAttributeVector<Vec3d> vertex_pos(m.allocated_vertices(), Vec3d(0));
+            for_each_face_parallel(m, [&](FaceID f) {
+                if(selected.get(f)) {
+                    int n;
+                    const Vec3d sum = face_sum(m, f, n);
+                    face_pos.unchecked(f) = sum / n;
+                }
+            });
+            auto opposite = [&](Walker w) {
+                int n;
+                Vec3d sum = face_sum(m, w.face(), n);
+                return (sum - m.pos(w.vertex()) - m.pos(w.opp().vertex())) / (n-2);
+            };
+            for_each_halfedge_parallel(m, [&](HalfEdgeID h) {
+                Walker w = m.walker(h);
+                const Vec3d mid = 0.5 * (m.pos(w.vertex()) + m.pos(w.opp().vertex()));
+                const FaceID f0 = w.face(), f1 = w.opp().face();
+                if(smooth && f0 != InvalidFaceID && f1 != InvalidFaceID && selected.get(f0) && selected.get(f1)) {
+                    if(method == CC_SUBD)
+                        edge_pos.unchecked(h) = 0.5 * mid + 0.25 * (face_pos.get(f0) + face_pos.get(f1));
+                    else
+                        edge_pos.unchecked(h) = 0.75 * mid + 0.125 * (opposite(w) + opposite(w.opp()));
+                }
+                else
+                    edge_pos.unchecked(h) = mid;
+            });
+            for_each_vertex_parallel(m, [&](VertexID v) {
+                const Vec3d S = m.pos(v);
+                Vec3d& p = vertex_pos.unchecked(v);
+                p = S;
+                Walker w0 = m.walker(v);
+                if(!smooth || w0.halfedge() == InvalidHalfEdgeID)
+                    return;
+                bool all_selected = true;
+                bool is_boundary = false;
+                Vec3d R(0), Q(0);
+                int n = 0;
+                for(Walker w = w0; !w.full_circle(); w = w.circulate_vertex_ccw(), ++n) {
+                    R += m.pos(w.vertex());
+                    if(w.face() == InvalidFaceID)
+                        is_boundary = true;
+                    else {
+                        all_selected = all_selected && selected.get(w.face());
+                        Q += face_pos.get(w.face());
+                    }
+                }
+                if(!all_selected)
+                    return;
+                if(is_boundary)
+                    p = 0.75 * S + 0.125 * (m.pos(w0.vertex()) + m.pos(w0.prev().opp().vertex()));
+                else if(method == CC_SUBD)
+                    p = (Q / n + (R / n + S) + (n - 3.0) * S) / n;
+                else {
+                    const double beta = (5.0/8.0 - sqr(3.0/8.0 + 0.25 * cos(2.0 * M_PI / n))) / n;
+                    p = (1.0 - n * beta) * S + beta * R;
+                }
+            });
+
+            // Split the edges
+            VertexAttributeVector<int> is_new(m.allocated_vertices(), 0);
+            vector<HalfEdgeID> hedges;
+            for(auto h: m.halfedges()) {
+                Walker w = m.walker(h);
+                if(h < w.opp().halfedge() && edge_split(w))
+                    hedges.push_back(h);
+            }
+            for(auto h: hedges) {
+                const Vec3d p = edge_pos[h];
+                VertexID v = m.split_edge(h);
+                m.pos(v) = p;
+                is_new[v] = 1;
+            }
+
+            // Split the faces, and the triangles next to them in two.
+            vector<FaceID> faces;
+            for(auto f: m.faces())
+                faces.push_back(f);
+            for(auto f: faces) {
+                if(!selected[f]) {
+                    if(!triangles || no_edges(m, f) != 4)
+                        continue;
+                    // A triangle which got a new vertex has it joined to the opposite corner.
+                    int no_new = 0;
+                    Walker w = m.walker(f);
+                    circulate_face_ccw(m, f, [&](Walker& wf) {
+                        if(is_new[wf.vertex()]) {
+                            ++no_new;
+                            w = wf;
+                        }
+                    });
+                    if(no_new == 1)
+                        selected[m.split_face_by_edge(f, w.vertex(), w.next().next().vertex())] = 0;
+                    continue;
+                }
+                if(triangles) {
+                    // Cut off a triangle at each old corner as loop_split does.
+                    Walker w = m.walker(f);
+                    if(!is_new[w.vertex()])
+                        w = w.next();
+                    VertexID v1, orig_vert = w.vertex();
+                    w = w.next();
+                    FaceID g = f;
+                    do {
+                        VertexID v0 = w.opp().vertex();
+                        w = w.next();
+                        v1 = w.vertex();
+                        w = w.next();
+                        g = m.split_face_by_edge(g, v0, v1);
+                        selected[g] = 1;
+                    }
+                    while(v1 != orig_vert);
+                }
+                else {
+                    // Insert the face vertex and remove the spokes to the old corners.
+                    const Vec3d p = face_pos[f];
+                    VertexID c = m.split_face_by_vertex(f);
+                    m.pos(c) = p;
+                    is_new[c] = 1;
+                    vector<HalfEdgeID> spokes;
+                    circulate_vertex_ccw(m, c, [&](Walker& w) { if(!is_new[w.vertex()]) spokes.push_back(w.halfedge()); });
+                    for(auto h: spokes)
+                        m.merge_faces(m.walker(h).face(), h);
+                    circulate_vertex_ccw(m, c, [&](FaceID g) { selected[g] = 1; });
+                }
+            }
+
+            for(auto v: m.vertices())
+                if(!is_new[v])
+                    m.pos(v) = vertex_pos[v];
+        }
+    }
 }
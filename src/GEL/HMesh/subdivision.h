@@ -12,9 +12,16 @@
 #ifndef __HMESH_SUBDIVIDE_H__
 #define __HMESH_SUBDIVIDE_H__
 
+#include "Manifold.h"
+
 namespace HMesh
 {
-    class Manifold;
+    /** Subdivision methods. QUAD_SUBD and TRI_SUBD only split the faces, and the new vertices are
+     placed at the midpoints of the edges and the centres of the faces. CC_SUBD (Catmull-Clark)
+     splits like QUAD_SUBD and LOOP_SUBD like TRI_SUBD, but the vertices are then placed by the
+     rules of the scheme. Loop subdivision is meant for triangle meshes. */
+    enum Subd : int {QUAD_SUBD, CC_SUBD, LOOP_SUBD, TRI_SUBD};
+
     /** Perform a Catmull-Clark split, i.e. a split where each face is divided
     into new quadrilateral faces formed by connecting a corner with a
     point on each incident edge and a point at the centre of the face. */
@@ -31,6 +38,31 @@ namespace HMesh
     void cc_smooth(Manifold&);
 
     void loop_smooth(Manifold&);
+
+    /** Subdivide m_in levels times by the given method and store the result in m_out, which may
+     be m_in. In a quad split, every face with n sides becomes n quads around a new vertex at the
+     centre. In a triangle split, every face becomes a triangle at each corner and a face with n
+     sides (a triangle if the face is one) in the middle. Boundaries are kept as creases by the
+     smooth schemes.
+
+     The refined mesh is written directly: its connectivity follows from the numbering of the
+     entities of the coarse mesh, and both connectivity and positions are computed in parallel.
+     The vertices of m_in come first in m_out, in order, followed by a vertex for each edge and,
+     in a quad split, a vertex for each face. Attribute layers of m_out are cleared. */
+    void subdivide(const Manifold& m_in, Manifold& m_out, Subd method, int levels = 1);
+
+    /** Subdivide only the faces f of m with selected[f] nonzero, levels times. The faces which do
+     not share an edge with a selected face are not changed at all. An unselected face next to a
+     selected one gets a new vertex on each shared edge. In a triangle split, triangles which would
+     thus get two or more new vertices are selected too, and triangles with one are split in two,
+     so a triangle mesh stays a triangle mesh. In a quad split, the unselected faces keep the new
+     vertices as extra corners.
+
+     The smooth schemes move a vertex only if all its faces are selected, and an edge vertex only
+     gets the smooth rule if both faces of the edge are selected. Hence, the mesh outside the
+     selection keeps its shape. On return, selected marks the faces that the selected faces
+     were split into. */
+    void subdivide_adaptive(Manifold& m, FaceAttributeVector<int>& selected, Subd method, int levels = 1);
 }
 
 #endif
\ No newline at end of file
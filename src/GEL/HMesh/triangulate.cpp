@@ -6,12 +6,15 @@
 
 #include "triangulate.h"
 
+#include <algorithm>
 #include <queue>
+#include <tuple>
 #include <vector>
 #include <iterator>
 #include <cassert>
 
 #include "../CGLA/Vec3d.h"
+#include "../Util/Parallel.h"
 
 #include "Manifold.h"
 #include "AttributeVector.h"
@@ -114,17 +117,311 @@ namespace HMesh
         return work;
     }
 
+    namespace
+    {
+        /** Where the split of a face is written in the flat buffers. The corners of a face with n
+         sides are numbered from the start of its last halfedge, so that ring halfedge i runs from
+         corner i to corner i+1. A new edge c between corners a and b is stored as the pair (a, b),
+         and it adds two halfedges, 2c from a to b and 2c+1 back. The edges of the sub-faces are
+         given by codes: ring halfedge i has code i and new halfedge j has code n+j. */
+        struct FaceSplit
+        {
+            int* sizes;   ///< Number of sides of each sub-face. At most n-2 sub-faces.
+            int* codes;   ///< The edges of the sub-faces one after the other. At most 3n-6 codes.
+            int* chords;  ///< The corners of each new edge. At most n-3 edges.
+            int no_faces;
+            int no_codes;
+            int no_chords;
+
+            void add_face(const int* c, int n)
+            {
+                sizes[no_faces++] = n;
+                copy(c, c+n, codes + no_codes);
+                no_codes += n;
+            }
+
+            int add_chord(int a, int b)
+            {
+                chords[2*no_chords] = a;
+                chords[2*no_chords+1] = b;
+                return no_chords++;
+            }
+        };
+
+        /** Buffers for finding the triangulation of one face after another without allocating
+         memory for each face. The mesh is only read. */
+        class TriangulationWorkspace
+        {
+            vector<VertexID> verts;
+            vector<Vec3d> pts;
+            vector<int> prev, next, out, stamp;
+            vector<tuple<double, int, int>> heap;
+            vector<vector<pair<int,int>>> stack;
+            vector<tuple<double, int, int>> pairs;
+            vector<int> face;
+
+            /// Ear clipping with the candidate ears in a priority queue.
+            void clip_ears(const Manifold& m, FaceID f, FaceSplit& split)
+            {
+                const int N = verts.size();
+                const Vec3d norm = normal(m, f);
+                const double total_area = area(m, f);
+                const double ideal_ear_area = total_area / (N-2);
+
+                // The energy of an ear is that of clip_ear. Returns false if i is not an ear.
+                auto ear_energy = [&](int i, double& energy) {
+                    const int a = prev[i], b = next[i];
+                    if(verts[a] == verts[b] || connected(m, verts[a], verts[b]))
+                        return false;
+                    const Vec3d pp = pts[a] - pts[i];
+                    const Vec3d pn = pts[b] - pts[i];
+                    const Vec3d area_vec = cross(pn, pp);
+                    const double ear_area = 0.5 * length(area_vec);
+                    const double area_energy = 1.0-min(1.0,max(0.0,(ear_area-ideal_ear_area)/(total_area-ideal_ear_area)));
+                    energy = area_energy*dot(pn,pp)/(length(pp)*length(pn));
+                    return dot(norm, area_vec) > 0.0 && energy > -1.0;
+                };
+                auto push = [&](int i) {
+                    double energy;
+                    if(ear_energy(i, energy)) {
+                        heap.push_back(make_tuple(energy, -i, stamp[i]));
+                        push_heap(heap.begin(), heap.end());
+                    }
+                };
+
+                prev.resize(N);
+                next.resize(N);
+                out.resize(N);
+                stamp.assign(N, 0);
+                heap.clear();
+                for(int i=0;i<N;++i) {
+                    prev[i] = (i+N-1)%N;
+                    next[i] = (i+1)%N;
+                    out[i] = i;
+                }
+                for(int i=0;i<N;++i)
+                    push(i);
+
+                // Clipping an ear only changes the ears at its two neighbours. Entries of the queue
+                // whose stamp is out of date are skipped.
+                int remaining = N;
+                int start = 0;
+                while(remaining > 3 && !heap.empty()) {
+                    pop_heap(heap.begin(), heap.end());
+                    const int i = -get<1>(heap.back());
+                    const int s = get<2>(heap.back());
+                    heap.pop_back();
+                    if(s != stamp[i])
+                        continue;
+                    const int a = prev[i], b = next[i];
+                    const int c = split.add_chord(a, b);
+                    const int ear[3] = {out[a], out[i], N + 2*c + 1};
+                    split.add_face(ear, 3);
+                    out[a] = N + 2*c;
+                    next[a] = b;
+                    prev[b] = a;
+                    stamp[i] = -1;
+                    ++stamp[a];
+                    ++stamp[b];
+                    push(a);
+                    push(b);
+                    start = a;
+                    --remaining;
+                }
+                face.clear();
+                int i = start;
+                do {
+                    face.push_back(out[i]);
+                    i = next[i];
+                }
+                while(i != start);
+                split.add_face(face.data(), face.size());
+            }
+
+            /// Repeated splitting by the shortest edge which may be inserted.
+            void shortest_edges(const Manifold& m, FaceSplit& split)
+            {
+                const int N = verts.size();
+                stack.resize(1);
+                stack[0].clear();
+                for(int i=0;i<N;++i)
+                    stack[0].push_back(make_pair(i, i));
+                size_t top = 1;
+                while(top > 0) {
+                    vector<pair<int,int>> P;
+                    swap(P, stack[--top]);
+                    const int k = P.size();
+
+                    // The shortest edge between two corners which are neither neighbours nor
+                    // already connected.
+                    pairs.clear();
+                    if(k > 3)
+                        for(int i=0;i<k-2;++i)
+                            for(int j=i+2;j<k;++j)
+                                if(!(i == 0 && j == k-1))
+                                    pairs.push_back(make_tuple(sqr_length(pts[P[i].first] - pts[P[j].first]), i, j));
+                    sort(pairs.begin(), pairs.end());
+                    int bi = -1, bj = -1;
+                    for(const auto& pr: pairs) {
+                        const VertexID v0 = verts[P[get<1>(pr)].first], v1 = verts[P[get<2>(pr)].first];
+                        if(v0 != v1 && !connected(m, v0, v1)) {
+                            bi = get<1>(pr);
+                            bj = get<2>(pr);
+                            break;
+                        }
+                    }
+                    if(bi < 0) {
+                        face.clear();
+                        for(const auto& c: P)
+                            face.push_back(c.second);
+                        split.add_face(face.data(), face.size());
+                        swap(P, stack[top]);
+                        continue;
+                    }
+
+                    const int c = split.add_chord(P[bi].first, P[bj].first);
+                    if(stack.size() < top + 2)
+                        stack.resize(top + 2);
+                    vector<pair<int,int>>& A = stack[top];
+                    vector<pair<int,int>>& B = stack[top+1];
+                    A.assign(P.begin()+bi, P.begin()+bj);
+                    A.push_back(make_pair(P[bj].first, N + 2*c + 1));
+                    B.assign(P.begin()+bj, P.end());
+                    B.insert(B.end(), P.begin(), P.begin()+bi);
+                    B.push_back(make_pair(P[bi].first, N + 2*c));
+                    top += 2;
+                }
+            }
+
+        public:
+
+            /// Find the split of face f.
+            void find_split(const Manifold& m, FaceID f, TriangulationMethod policy, FaceSplit& split)
+            {
+                verts.clear();
+                pts.clear();
+                for(Walker w = m.walker(f); !w.full_circle(); w = w.next()) {
+                    verts.push_back(w.opp().vertex());
+                    pts.push_back(m.pos(w.opp().vertex()));
+                }
+                split.no_faces = split.no_codes = split.no_chords = 0;
+                if(policy == CLIP_EAR)
+                    clip_ears(m, f, split);
+                else
+                    shortest_edges(m, split);
+            }
+        };
+    }
+
     void triangulate(Manifold& m, TriangulationMethod policy)
     {
-        int work;
-        do{
-            // For every face.
-            work = 0;
-            for (auto f: m.faces()) {
-                work += triangulate(m, f, policy);
+        ConnectivityKernel& kernel = m.kernel;
+
+        vector<FaceID> faces;
+        vector<size_t> face_off(1, 0), chord_off(1, 0);
+        for(auto f: m.faces()) {
+            const int n = no_edges(m, f);
+            if(n > 3) {
+                faces.push_back(f);
+                face_off.push_back(face_off.back() + n-2);
+                chord_off.push_back(chord_off.back() + n-3);
+            }
+        }
+        const size_t F = faces.size();
+        if(F == 0)
+            return;
+
+        // Find the splits of all faces in parallel. A face with n sides gets n-2 slots for
+        // sub-faces, 3(n-2) slots for their edges and n-3 slots for new edges.
+        vector<int> sizes(face_off[F]), codes(3*face_off[F]), chords(2*chord_off[F]);
+        vector<FaceSplit> splits(F);
+        Util::parallel_for_chunks(F, [&](size_t b, size_t e) {
+            TriangulationWorkspace workspace;
+            for(size_t i=b;i<e;++i) {
+                FaceSplit& split = splits[i];
+                split.sizes = &sizes[face_off[i]];
+                split.codes = &codes[3*face_off[i]];
+                split.chords = &chords[2*chord_off[i]];
+                workspace.find_split(m, faces[i], policy, split);
+            }
+        }, 64);
+
+        // Corner numbers are only meaningful within a face, so the new edges are compared by
+        // their vertices. Faces that would add the same edge are left for later.
+        vector<tuple<VertexID, VertexID, size_t>> new_edges;
+        vector<int> defer(F, 0);
+        for(size_t i=0;i<F;++i) {
+            if(splits[i].no_chords == 0)
+                continue;
+            vector<VertexID> corner;
+            for(Walker w = m.walker(faces[i]); !w.full_circle(); w = w.next())
+                corner.push_back(w.opp().vertex());
+            for(int c=0;c<splits[i].no_chords;++c) {
+                VertexID v0 = corner[splits[i].chords[2*c]], v1 = corner[splits[i].chords[2*c+1]];
+                new_edges.push_back(make_tuple(min(v0, v1), max(v0, v1), i));
             }
         }
-        while(work);
+        sort(new_edges.begin(), new_edges.end());
+        for(size_t k=1;k<new_edges.size();++k)
+            if(get<0>(new_edges[k]) == get<0>(new_edges[k-1]) && get<1>(new_edges[k]) == get<1>(new_edges[k-1]))
+                defer[get<2>(new_edges[k])] = defer[get<2>(new_edges[k-1])] = 1;
+
+        // Create all new halfedges and faces, and then link them in parallel. Each face only
+        // touches its own halfedges, and the halfedges of the vertices are still valid since no
+        // halfedge goes away.
+        vector<HalfEdgeID> new_h(2*chord_off[F]);
+        vector<FaceID> new_f(face_off[F]);
+        for(size_t i=0;i<F;++i)
+            if(!defer[i]) {
+                for(int c=0;c<2*splits[i].no_chords;++c)
+                    new_h[2*chord_off[i] + c] = m.new_halfedge();
+                for(int t=1;t<splits[i].no_faces;++t)
+                    new_f[face_off[i] + t] = m.new_face();
+            }
+
+        Util::parallel_for_chunks(F, [&](size_t b, size_t e) {
+            vector<HalfEdgeID> ring;
+            vector<VertexID> corner;
+            for(size_t i=b;i<e;++i) {
+                const FaceSplit& split = splits[i];
+                if(defer[i] || split.no_faces < 2)
+                    continue;
+                ring.clear();
+                corner.clear();
+                for(Walker w = m.walker(faces[i]); !w.full_circle(); w = w.next()) {
+                    ring.push_back(w.halfedge());
+                    corner.push_back(w.opp().vertex());
+                }
+                const int N = ring.size();
+                auto halfedge = [&](int code) {
+                    return code < N ? ring[code] : new_h[2*chord_off[i] + code - N];
+                };
+                for(int c=0;c<split.no_chords;++c) {
+                    const HalfEdgeID h0 = halfedge(N + 2*c), h1 = halfedge(N + 2*c + 1);
+                    kernel.set_opp(h0, h1);
+                    kernel.set_opp(h1, h0);
+                    kernel.set_vert(h0, corner[split.chords[2*c+1]]);
+                    kernel.set_vert(h1, corner[split.chords[2*c]]);
+                }
+                const int* code = split.codes;
+                for(int t=0;t<split.no_faces;++t) {
+                    const FaceID f = t == 0 ? faces[i] : new_f[face_off[i] + t];
+                    const int n = split.sizes[t];
+                    for(int j=0;j<n;++j) {
+                        const HalfEdgeID h = halfedge(code[j]), hn = halfedge(code[(j+1)%n]);
+                        kernel.set_next(h, hn);
+                        kernel.set_prev(hn, h);
+                        kernel.set_face(h, f);
+                    }
+                    kernel.set_last(f, halfedge(code[0]));
+                    code += n;
+                }
+            }
+        }, 64);
+
+        for(size_t i=0;i<F;++i)
+            if(defer[i])
+                triangulate(m, faces[i], policy);
     }
 
 }
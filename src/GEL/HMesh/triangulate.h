@@ -16,13 +16,18 @@
 
 namespace HMesh
 {
-    enum TriangulationMethod { CLIP_EAR, SHORTEST_EDGE};
+    enum TriangulationMethod : int { CLIP_EAR, SHORTEST_EDGE};
     /** Triangulate by connected vertices on the face f.
      The policy indicates if we do ear clip or shortest edge triangulation.
      ear clip is safer, but shortest edge tends to never fail. */
     int triangulate(Manifold& m, FaceID f, TriangulationMethod policy = CLIP_EAR);
 
-    /// Triangulate by connectin
+    /** Triangulate all faces of m. The triangulation of each face is found in parallel without
+     changing the mesh, and then all faces are split at once. Ear clipping keeps the candidate
+     ears in a priority queue and only updates the two neighbours of a clipped ear, so a face with
+     n sides takes O(n log n) time. The ideal ear area used to rank the ears is that of the whole
+     face. The few faces whose new edges would coincide with an edge added to another face are
+     triangulated one at a time afterwards. */
     void triangulate(Manifold& m, TriangulationMethod policy = CLIP_EAR);
 }
 
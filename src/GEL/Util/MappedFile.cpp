@@ -0,0 +1,103 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+#include "MappedFile.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace Util
+{
+#ifdef WIN32
+    bool MappedFile::open(const std::string& filename)
+    {
+        close();
+        HANDLE fh = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if(fh == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER file_size;
+        if(!GetFileSizeEx(fh, &file_size)) {
+            CloseHandle(fh);
+            return false;
+        }
+        file_handle = fh;
+        sz = static_cast<size_t>(file_size.QuadPart);
+        valid = true;
+        if(sz == 0)
+            return true;
+        HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mh == NULL) {
+            close();
+            return false;
+        }
+        mapping_handle = mh;
+        ptr = static_cast<const char*>(MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0));
+        if(ptr == nullptr) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if(ptr)
+            UnmapViewOfFile(ptr);
+        if(mapping_handle)
+            CloseHandle(static_cast<HANDLE>(mapping_handle));
+        if(file_handle)
+            CloseHandle(static_cast<HANDLE>(file_handle));
+        ptr = nullptr;
+        mapping_handle = file_handle = nullptr;
+        sz = 0;
+        valid = false;
+    }
+#else
+    bool MappedFile::open(const std::string& filename)
+    {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat st;
+        if(fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        sz = static_cast<size_t>(st.st_size);
+        if(sz > 0) {
+            void* p = mmap(nullptr, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p == MAP_FAILED) {
+                ::close(fd);
+                sz = 0;
+                return false;
+            }
+            // The mapping stays valid after the descriptor is closed.
+            madvise(p, sz, MADV_SEQUENTIAL);
+            ptr = static_cast<const char*>(p);
+        }
+        ::close(fd);
+        valid = true;
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if(ptr)
+            munmap(const_cast<char*>(ptr), sz);
+        ptr = nullptr;
+        sz = 0;
+        valid = false;
+    }
+#endif
+}
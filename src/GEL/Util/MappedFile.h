@@ -0,0 +1,64 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file MappedFile.h
+ * @brief Read only memory mapping of a file.
+ */
+
+#ifndef __UTIL_MAPPEDFILE_H__
+#define __UTIL_MAPPEDFILE_H__
+
+#include <cstddef>
+#include <string>
+
+namespace Util
+{
+    /** A file mapped read only into memory. The file contents are available through data()
+     for as long as the object lives. Pages are only read from disk when touched, so this is
+     the cheapest way to get at the contents of a large file, and several threads can read
+     different parts of it at the same time. */
+    class MappedFile
+    {
+    public:
+        /// Construct without mapping a file.
+        MappedFile() {}
+
+        /// Map the file given by name. Use is_valid to check if this succeeded.
+        MappedFile(const std::string& filename) { open(filename); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() { close(); }
+
+        /// Map the file given by name, unmapping any previous file. Returns false on failure.
+        bool open(const std::string& filename);
+
+        /// Unmap the file.
+        void close();
+
+        /// Returns true if a file is mapped. An empty file is valid but has no data.
+        bool is_valid() const { return valid; }
+
+        /// Pointer to the first byte of the file.
+        const char* data() const { return ptr; }
+
+        /// Size of the file in bytes.
+        size_t size() const { return sz; }
+
+    private:
+        const char* ptr = nullptr;
+        size_t sz = 0;
+        bool valid = false;
+#ifdef WIN32
+        void* file_handle = nullptr;
+        void* mapping_handle = nullptr;
+#endif
+    };
+}
+
+#endif
@@ -0,0 +1,69 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file Parallel.h
+ * @brief Simple helpers for splitting work over threads.
+ */
+
+#ifndef __UTIL_PARALLEL_H__
+#define __UTIL_PARALLEL_H__
+
+#include <algorithm>
+#include <cstddef>
+#include "ThreadPool.h"
+
+namespace Util
+{
+    /// The number of threads that GEL uses for parallel work. See set_no_threads.
+    inline size_t no_threads()
+    {
+        return thread_pool().size();
+    }
+
+    /** Returns the number of tasks that n units of work should be split into, such that no task
+     gets less than min_units and there are no more tasks than threads. */
+    inline size_t no_tasks(size_t n, size_t min_units)
+    {
+        return std::max(size_t(1), std::min(no_threads(), n / std::max(size_t(1), min_units)));
+    }
+
+    /// First unit of task t when n units are split evenly into no_tasks tasks.
+    inline size_t task_begin(size_t t, size_t no_tasks, size_t n)
+    {
+        return n / no_tasks * t + std::min(t, n % no_tasks);
+    }
+
+    /** Call f(t) for every t in [0, no_tasks) on the threads of the GEL thread pool. Task 0 runs
+     on the calling thread. The function returns when all tasks are done. */
+    template<typename Func>
+    void parallel_tasks(size_t no_tasks, const Func& f)
+    {
+        thread_pool().run_tasks(no_tasks, [&f](size_t t) { f(t); });
+    }
+
+    /** Split [0, n) into contiguous ranges of roughly equal size, at most one per thread and
+     each with at least min_units unless n is smaller, and call f(begin, end) for each range
+     in parallel. */
+    template<typename Func>
+    void parallel_for_ranges(size_t n, const Func& f, size_t min_units = 1 << 16)
+    {
+        const size_t T = no_tasks(n, min_units);
+        parallel_tasks(T, [&](size_t t) {
+            f(task_begin(t, T, n), task_begin(t+1, T, n));
+        });
+    }
+
+    /** Call f(begin, end) for chunks of [0, n) of chunk_size units in parallel with work
+     stealing. Use this rather than parallel_for_ranges when the cost per unit varies. */
+    template<typename Func>
+    void parallel_for_chunks(size_t n, const Func& f, size_t chunk_size)
+    {
+        thread_pool().parallel_for(n, chunk_size, [&f](size_t b, size_t e) { f(b, e); });
+    }
+}
+
+#endif
@@ -22,6 +22,11 @@ public:
         fs.open(file_name, std::ios_base::binary | mode);
     }
     
+    /// Returns true if the file is open and no read or write has failed.
+    bool good() const {
+        return fs.good();
+    }
+
     void write(const char* blob, size_t len) {
         fs.write(blob, len);
     }
@@ -32,17 +37,20 @@ public:
     template<typename T>
     void write(const std::vector<T>& vec) {
         size_t len = vec.size();
-        char* ptr = reinterpret_cast<char*>(&vec[0]);
-        write(reinterpret_cast<char*>(&len), sizeof(size_t));
-        write(ptr,len * sizeof(T));
+        write(reinterpret_cast<const char*>(&len), sizeof(size_t));
+        if(len>0)
+            write(reinterpret_cast<const char*>(vec.data()), len * sizeof(T));
     }
 
     template<typename T>
     void read(std::vector<T>& vec) {
-        size_t len;
+        size_t len = 0;
         read(reinterpret_cast<char*>(&len), sizeof(size_t));
+        if(!fs.good())
+            return;
         vec.resize(len);
-        read(reinterpret_cast<char*>(&vec[0]), len*sizeot(T));
+        if(len>0)
+            read(reinterpret_cast<char*>(vec.data()), len*sizeof(T));
     }
 
 };
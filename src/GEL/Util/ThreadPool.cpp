@@ -0,0 +1,207 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace Util
+{
+    namespace
+    {
+        /// True on the threads of a pool while they do work, so that nested loops run serially.
+        thread_local bool inside_pool = false;
+
+        /** Range of chunks [begin, end) owned by one thread packed into a single word, so that
+         the owner and thieves can update it with one compare and swap. Each range sits on its
+         own cache line. */
+        struct alignas(64) ChunkRange
+        {
+            atomic<uint64_t> range;
+
+            static uint64_t pack(uint32_t b, uint32_t e) { return (uint64_t(b) << 32) | e; }
+            static uint32_t begin(uint64_t r) { return uint32_t(r >> 32); }
+            static uint32_t end(uint64_t r) { return uint32_t(r); }
+
+            /// Take the first chunk. Used by the owner.
+            bool pop_front(uint32_t& c)
+            {
+                uint64_t r = range.load(memory_order_relaxed);
+                while(begin(r) < end(r))
+                    if(range.compare_exchange_weak(r, pack(begin(r)+1, end(r)))) {
+                        c = begin(r);
+                        return true;
+                    }
+                return false;
+            }
+
+            /// Take the upper half of the chunks. Used by thieves.
+            bool steal_half(uint32_t& b, uint32_t& e)
+            {
+                uint64_t r = range.load(memory_order_relaxed);
+                while(begin(r) < end(r)) {
+                    const uint32_t mid = end(r) - (end(r) - begin(r) + 1) / 2;
+                    if(range.compare_exchange_weak(r, pack(begin(r), mid))) {
+                        b = mid;
+                        e = end(r);
+                        return true;
+                    }
+                }
+                return false;
+            }
+        };
+
+        /** The pool is owned by pool and replaced under pool_mutex. current_pool points to it,
+         so that thread_pool does not have to lock once the pool exists. */
+        unique_ptr<ThreadPool> pool;
+        atomic<ThreadPool*> current_pool(nullptr);
+        mutex pool_mutex;
+
+        size_t hardware_threads()
+        {
+            return max(1u, thread::hardware_concurrency());
+        }
+    }
+
+    ThreadPool::ThreadPool(size_t no_threads)
+    {
+        for(size_t i = 1; i < max(size_t(1), no_threads); ++i)
+            workers.push_back(thread(&ThreadPool::worker_loop, this, i));
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        work_cv.notify_all();
+        for(auto& t: workers)
+            t.join();
+    }
+
+    void ThreadPool::worker_loop(size_t index)
+    {
+        size_t seen = 0;
+        while(true) {
+            const function<void(size_t)>* f;
+            {
+                unique_lock<mutex> lock(m);
+                work_cv.wait(lock, [&]() { return stopping || generation != seen; });
+                if(stopping)
+                    return;
+                seen = generation;
+                if(index >= job_participants)
+                    continue;
+                f = job;
+            }
+            inside_pool = true;
+            (*f)(index);
+            inside_pool = false;
+            {
+                lock_guard<mutex> lock(m);
+                if(--pending == 0)
+                    done_cv.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::run_tasks(size_t no_tasks, const function<void(size_t)>& f)
+    {
+        if(no_tasks == 0)
+            return;
+        unique_lock<mutex> busy_lock(busy, try_to_lock);
+        if(no_tasks == 1 || workers.empty() || inside_pool || !busy_lock.owns_lock()) {
+            for(size_t t = 0; t < no_tasks; ++t)
+                f(t);
+            return;
+        }
+
+        const size_t P = min(no_tasks, size());
+        const function<void(size_t)> participant = [&](size_t p) {
+            for(size_t t = p; t < no_tasks; t += P)
+                f(t);
+        };
+        {
+            lock_guard<mutex> lock(m);
+            job = &participant;
+            job_participants = P;
+            pending = P - 1;
+            ++generation;
+        }
+        work_cv.notify_all();
+
+        inside_pool = true;
+        participant(0);
+        inside_pool = false;
+
+        unique_lock<mutex> lock(m);
+        done_cv.wait(lock, [&]() { return pending == 0; });
+        job = nullptr;
+    }
+
+    void ThreadPool::parallel_for(size_t n, size_t chunk_size, const function<void(size_t, size_t)>& f)
+    {
+        chunk_size = max(size_t(1), chunk_size);
+        // Chunk indices are 32 bit, so very long loops get larger chunks.
+        chunk_size = max(chunk_size, n / UINT32_MAX + 1);
+        const size_t no_chunks = (n + chunk_size - 1) / chunk_size;
+        const size_t P = min(no_chunks, size());
+        if(P <= 1 || inside_pool) {
+            // Keep the chunks, since callers may depend on them, e.g. to reduce per chunk.
+            for(size_t c = 0; c < no_chunks; ++c)
+                f(c * chunk_size, min(n, (c + 1) * chunk_size));
+            return;
+        }
+
+        vector<ChunkRange> ranges(P);
+        for(size_t p = 0; p < P; ++p)
+            ranges[p].range = ChunkRange::pack(uint32_t(no_chunks * p / P), uint32_t(no_chunks * (p+1) / P));
+
+        run_tasks(P, [&](size_t p) {
+            ChunkRange& own = ranges[p];
+            while(true) {
+                uint32_t c;
+                while(own.pop_front(c))
+                    f(size_t(c) * chunk_size, min(n, (size_t(c) + 1) * chunk_size));
+                // Out of work: look for a victim, starting with the next thread.
+                bool stolen = false;
+                for(size_t q = 1; q < P && !stolen; ++q) {
+                    uint32_t b, e;
+                    if(ranges[(p + q) % P].steal_half(b, e)) {
+                        own.range = ChunkRange::pack(b, e);
+                        stolen = true;
+                    }
+                }
+                if(!stolen)
+                    return;
+            }
+        });
+    }
+
+    ThreadPool& thread_pool()
+    {
+        if(ThreadPool* p = current_pool.load(memory_order_acquire))
+            return *p;
+        lock_guard<mutex> lock(pool_mutex);
+        if(!pool) {
+            pool.reset(new ThreadPool(hardware_threads()));
+            current_pool.store(pool.get(), memory_order_release);
+        }
+        return *pool;
+    }
+
+    void set_no_threads(size_t n)
+    {
+        lock_guard<mutex> lock(pool_mutex);
+        current_pool.store(nullptr, memory_order_release);
+        pool.reset(new ThreadPool(n == 0 ? hardware_threads() : n));
+        current_pool.store(pool.get(), memory_order_release);
+    }
+}
@@ -0,0 +1,79 @@
+/* ----------------------------------------------------------------------- *
+ * This file is part of GEL, http://www.imm.dtu.dk/GEL
+ * Copyright (C) the authors and DTU Informatics
+ * For license and list of authors, see ../../doc/intro.pdf
+ * ----------------------------------------------------------------------- */
+
+/**
+ * @file ThreadPool.h
+ * @brief A persistent pool of worker threads with a work stealing parallel loop.
+ */
+
+#ifndef __UTIL_THREADPOOL_H__
+#define __UTIL_THREADPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Util
+{
+    /** A pool of threads which are started once and then wait for work. The thread which hands
+     out work takes part in it, so a pool of n threads has n-1 workers. If work is handed out
+     while the pool is busy - from inside a parallel loop or from another thread - it is simply
+     done on the calling thread. */
+    class ThreadPool
+    {
+    public:
+        /// Create a pool with no_threads threads in all, including the calling thread.
+        explicit ThreadPool(size_t no_threads);
+
+        /// Stops and joins the workers.
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /// Number of threads including the calling thread.
+        size_t size() const { return workers.size() + 1; }
+
+        /** Call f(t) for every t in [0, no_tasks) and return when all calls are done. Task 0 runs
+         on the calling thread. If there are more tasks than threads, each thread runs several. */
+        void run_tasks(size_t no_tasks, const std::function<void(size_t)>& f);
+
+        /** Call f(begin, end) for chunks of [0, n) which are chunk_size long (except the last)
+         and return when all chunks are done. Each thread starts on its own contiguous share of
+         the chunks. A thread which runs out of work steals the upper half of the remaining
+         chunks of another thread, so uneven work is balanced without central coordination. */
+        void parallel_for(size_t n, size_t chunk_size, const std::function<void(size_t, size_t)>& f);
+
+    private:
+        void worker_loop(size_t index);
+
+        std::vector<std::thread> workers;
+        std::mutex busy;
+
+        std::mutex m;
+        std::condition_variable work_cv;
+        std::condition_variable done_cv;
+        const std::function<void(size_t)>* job = nullptr;
+        size_t job_participants = 0;
+        size_t generation = 0;
+        size_t pending = 0;
+        bool stopping = false;
+    };
+
+    /** The pool used by GEL for parallel work. It is created on first use with as many threads
+     as the hardware supports. */
+    ThreadPool& thread_pool();
+
+    /** Set the number of threads used by GEL for parallel work. Zero means as many as the
+     hardware supports. Must not be called while parallel work is going on. */
+    void set_no_threads(size_t n);
+}
+
+#endif
@@ -543,6 +543,13 @@ def x3d_save(fn, m):
     s = ct.c_char_p(fn.encode('utf-8'))
     lib_py_gel.x3d_save(s, m.obj)
 
+lib_py_gel.gel_save.argtypes = (ct.c_char_p, ct.c_void_p)
+def gel_save(fn, m):
+    """ Save Manifold to the native binary GEL format. This is a snapshot of the
+    mesh which can be loaded again quickly and without any rebuilding. """
+    s = ct.c_char_p(fn.encode('utf-8'))
+    lib_py_gel.gel_save(s, m.obj)
+
 lib_py_gel.obj_load.argtypes = (ct.c_char_p, ct.c_void_p)
 def obj_load(fn):
     """ Load Manifold from Wavefront obj file. """
@@ -579,6 +586,15 @@ def x3d_load(fn):
         return m
     return None
 
+lib_py_gel.gel_load.argtypes = (ct.c_char_p, ct.c_void_p)
+def gel_load(fn):
+    """ Load Manifold from the native binary GEL format. """
+    m = Manifold()
+    s = ct.c_char_p(fn.encode('utf-8'))
+    if lib_py_gel.gel_load(s, m.obj):
+        return m
+    return None
+
 lib_py_gel.remove_caps.argtypes = (ct.c_void_p, ct.c_float)
 def remove_caps(m, thresh=2.9):
     """ Remove caps from a manifold consisting of only triangles. A cap is a
@@ -52,6 +52,10 @@ bool x3d_load(char* fn, Manifold_ptr m_ptr) {
     return x3d_load(string(fn), *(reinterpret_cast<Manifold*>(m_ptr)));
 }
 
+bool gel_load(char* fn, Manifold_ptr m_ptr) {
+    return gel_load(string(fn), *(reinterpret_cast<Manifold*>(m_ptr)));
+}
+
 
 bool obj_save(char* fn, Manifold_ptr m_ptr) {
     return obj_save(string(fn), *(reinterpret_cast<Manifold*>(m_ptr)));
@@ -65,6 +69,10 @@ bool x3d_save(char* fn, Manifold_ptr m_ptr) {
     return x3d_save(string(fn), *(reinterpret_cast<Manifold*>(m_ptr)));
 }
 
+bool gel_save(char* fn, Manifold_ptr m_ptr) {
+    return gel_save(string(fn), *(reinterpret_cast<Manifold*>(m_ptr)));
+}
+
 
 void remove_caps(Manifold_ptr m_ptr, float thresh) {
     remove_caps(*(reinterpret_cast<Manifold*>(m_ptr)), thresh);
@@ -34,10 +34,12 @@ extern "C" {
     DLLEXPORT bool off_load(char*, Manifold_ptr m_ptr);
     DLLEXPORT bool ply_load(char*, Manifold_ptr m_ptr);
     DLLEXPORT bool x3d_load(char*, Manifold_ptr m_ptr);
+    DLLEXPORT bool gel_load(char*, Manifold_ptr m_ptr);
     
     DLLEXPORT bool obj_save(char*, Manifold_ptr m_ptr);
     DLLEXPORT bool off_save(char*, Manifold_ptr m_ptr);
     DLLEXPORT bool x3d_save(char*, Manifold_ptr m_ptr);
+    DLLEXPORT bool gel_save(char*, Manifold_ptr m_ptr);
 
         
     DLLEXPORT void remove_caps(Manifold_ptr m_ptr, float thresh);
@@ -0,0 +1,104 @@
+/**
+ Test of QEMT::opt_pos for QEM and QEMf on quadrics whose minimizer is known.
+
+ - Three planes through a point give a quadric of rank 3, which is minimized at the point.
+ - Two planes through a line give a quadric of rank 2. The point is the one on the line
+   closest to p0.
+ - Parallel planes give a quadric of rank 1. The point is p0 projected onto the plane midway
+   between them.
+ - Quadrics of rank 3 whose smaller eigenvalues are below the threshold are treated as rank 1
+   or rank 2.
+ - The zero quadric is minimized at p0.
+ - A quadric whose two smaller eigenvalues are too close to tell apart around the threshold
+   must fall back to the full eigensolution. The quadric is chosen so that the answer is the
+   same whichever of them is kept.
+ */
+
+#include <iostream>
+#include <string>
+#include <GEL/Geometry/QEM.h>
+#include "../test_util.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace Geometry;
+using namespace GELTest;
+
+namespace
+{
+    template<typename Q>
+    void test_opt_pos(const string& name, double tol)
+    {
+        const Vec3d P(0.3, -0.2, 0.5);
+        const Vec3d p0(-0.4, 0.7, 0.1);
+        const Vec3d n0 = normalize(Vec3d(1, 0.2, -0.1));
+        const Vec3d n1 = normalize(Vec3d(0.3, 1, 0.4));
+        const Vec3d n2 = normalize(Vec3d(-0.2, 0.5, 1));
+
+        // An orthonormal frame
+        const Vec3d e0 = n0;
+        const Vec3d e1 = normalize(cross(n0, n1));
+        const Vec3d e2 = cross(e0, e1);
+
+        // Rank 3
+        {
+            Q q = Q(P, n0) + Q(P, n1, 2.0) + Q(P, n2, 0.7);
+            check(length(q.opt_pos(0.001, p0) - P) < tol, name + ": rank 3");
+        }
+
+        // Rank 2
+        {
+            Q q = Q(P, n0) + Q(P, n1, 1.5);
+            const Vec3d d = normalize(cross(n0, n1));
+            const Vec3d x = P + d * dot(d, p0 - P);
+            check(length(q.opt_pos(0.001, p0) - x) < tol, name + ": rank 2");
+        }
+
+        // Rank 1, from two parallel planes 0.2 apart.
+        {
+            Q q = Q(P - 0.1*n2, n2) + Q(P + 0.1*n2, n2);
+            const Vec3d x = p0 - n2 * dot(n2, p0 - P);
+            check(length(q.opt_pos(0.001, p0) - x) < tol, name + ": rank 1");
+        }
+
+        // A quadric of rank 3 is treated as rank 1 when the threshold removes the two smaller
+        // eigenvalues.
+        {
+            Q q = Q(P, e0, 100.0) + Q(P, e1, 0.01) + Q(P, e2, 0.02);
+            const Vec3d x = p0 - e0 * dot(e0, p0 - P);
+            check(length(q.opt_pos(0.5, p0) - x) < tol, name + ": rank 3 treated as rank 1");
+        }
+
+        // ... and as rank 2 when it removes the smallest.
+        {
+            Q q = Q(P, e0, 1.0) + Q(P, e1, 0.8) + Q(P, e2, 0.01);
+            const Vec3d x = P + e2 * dot(e2, p0 - P);
+            check(length(q.opt_pos(0.5, p0) - x) < tol, name + ": rank 3 treated as rank 2");
+        }
+
+        // Rank 0
+        {
+            Q q;
+            check(length(q.opt_pos(0.5, p0) - p0) == 0, name + ": zero quadric");
+        }
+
+        // Eigenvalues 1, 0.5 + e, 0.5 - e with the threshold between the two smaller ones. The
+        // planes pass through P, and p0 agrees with P in the coordinates of the two smaller
+        // eigenvectors, so the point is P whichever eigenvalues are kept. The eigensolution is
+        // iterative, so the tolerance is that of the power method.
+        {
+            const double e = 5e-8;
+            Q q = Q(P, Vec3d(1, 0, 0)) + Q(P, Vec3d(0, 1, 0), 0.5 + e) + Q(P, Vec3d(0, 0, 1), 0.5 - e);
+            const Vec3d p1(p0[0], P[1], P[2]);
+            check(length(q.opt_pos(0.5, p1) - P) < 1e-3, name + ": close eigenvalues");
+        }
+    }
+}
+
+int main()
+{
+    test_opt_pos<QEM>("QEM", 1e-9);
+    test_opt_pos<QEMf>("QEMf", 1e-4);
+
+    return report();
+}
@@ -0,0 +1,119 @@
+/**
+ Test that attribute layers give new entities the default value when the IDs of removed entities
+ are reused.
+
+ - With ID reuse on, a vertex is removed and split_edge adds a vertex, a face, and halfedges in
+   the freed slots. Their values in the attribute layers must be the defaults, while the values
+   of all other entities are unchanged.
+ - triangulate must also reset the layers of the faces and halfedges it puts in freed slots.
+ - build must still work when the mesh has freed slots and reuse is on.
+ */
+
+#include <iostream>
+#include <GEL/HMesh/HMesh.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /// An N x N grid of quads.
+    void make_grid(Manifold& m, int N)
+    {
+        GELTest::make_grid(m, N, N, [](int i, int j) { return Vec3d(i, j, 0); }, true);
+    }
+
+    const int VDEF = -1, FDEF = -2, HDEF = -3;
+
+    /// Add layers whose value is the index plus one for every entity in use.
+    void add_layers(Manifold& m)
+    {
+        auto& vl = m.add_vertex_attribute<int>("v", VDEF);
+        auto& fl = m.add_face_attribute<int>("f", FDEF);
+        auto& hl = m.add_halfedge_attribute<int>("h", HDEF);
+        for(auto v: m.vertices()) vl[v] = int(v.get_index()) + 1;
+        for(auto f: m.faces()) fl[f] = int(f.get_index()) + 1;
+        for(auto h: m.halfedges()) hl[h] = int(h.get_index()) + 1;
+    }
+
+    /** True if every entity in use has the default value if it is not in the old mesh and
+     otherwise the value set by add_layers. */
+    bool layers_ok(Manifold& m, size_t nv, const VertexSet& old_v, const FaceSet& old_f,
+                   const HalfEdgeSet& old_h)
+    {
+        auto& vl = *m.vertex_attribute<int>("v");
+        auto& fl = *m.face_attribute<int>("f");
+        auto& hl = *m.halfedge_attribute<int>("h");
+        for(auto v: m.vertices())
+            if(vl[v] != (old_v.count(v) ? int(v.get_index()) + 1 : VDEF))
+                return false;
+        for(auto f: m.faces())
+            if(fl[f] != (old_f.count(f) ? int(f.get_index()) + 1 : FDEF))
+                return false;
+        for(auto h: m.halfedges())
+            if(hl[h] != (old_h.count(h) ? int(h.get_index()) + 1 : HDEF))
+                return false;
+        return m.allocated_vertices() == nv;
+    }
+}
+
+int main()
+{
+    {
+        Manifold m;
+        make_grid(m, 6);
+        m.set_id_reuse(true);
+        add_layers(m);
+        // Removing an interior vertex frees a vertex, four faces, and halfedges.
+        const VertexID removed(2*7+3);
+        m.remove_vertex(removed);
+        VertexSet old_v(m.vertices());
+        FaceSet old_f(m.faces());
+        HalfEdgeSet old_h(m.halfedges());
+        const size_t nv = m.allocated_vertices();
+
+        HalfEdgeID h = *m.halfedges().begin();
+        if(m.walker(h).face() == InvalidFaceID) h = m.walker(h).opp().halfedge();
+        VertexID v = m.split_edge(h);
+        check(v == removed, "split_edge reuses the vertex");
+        check(m.vertex_attribute<int>("v")->get(v) == VDEF, "reused vertex has the default value");
+        check(layers_ok(m, nv, old_v, old_f, old_h), "split_edge: layers of new and old entities");
+
+        const size_t nf = m.no_faces();
+        const FaceID f = m.split_face_by_edge(m.walker(h).face(), v, m.walker(h).next().vertex());
+        check(f != InvalidFaceID && m.no_faces() == nf + 1, "split_face_by_edge adds a face");
+        check(layers_ok(m, nv, old_v, old_f, old_h), "split_face_by_edge: layers of new and old entities");
+    }
+
+    {
+        Manifold m;
+        make_grid(m, 6);
+        m.set_id_reuse(true);
+        add_layers(m);
+        m.remove_face(FaceID(8));
+        m.remove_face(FaceID(9));
+        VertexSet old_v(m.vertices());
+        FaceSet old_f(m.faces());
+        HalfEdgeSet old_h(m.halfedges());
+        const size_t nf = m.allocated_faces();
+        triangulate(m);
+        check(m.allocated_faces() < nf + m.no_faces()/2, "triangulate reuses faces");
+        check(layers_ok(m, m.allocated_vertices(), old_v, old_f, old_h), "triangulate: layers of new and old entities");
+    }
+
+    {
+        Manifold m;
+        make_grid(m, 3);
+        m.set_id_reuse(true);
+        m.remove_face(FaceID(4));
+        const size_t n = m.no_faces();
+        make_grid(m, 3);
+        check(valid(m) && m.no_faces() == n + 9 && m.id_reuse(), "build with freed slots");
+    }
+
+    return report();
+}
@@ -0,0 +1,90 @@
+/**
+ Test of build.
+
+ - Two triangles sharing an edge give a valid mesh with one interior edge and the identity
+   mapping from vertices to points.
+ - Three triangles sharing an edge give a valid mesh in which the shared edge is reported as
+   non-manifold for both the single and the double precision points.
+ - A face size or an index out of range leaves the mesh untouched and gives an empty map.
+ */
+
+#include <iostream>
+#include <GEL/HMesh/HMesh.h>
+#include "../test_util.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /// True if every halfedge in hs goes between the points a and b.
+    bool between(const Manifold& m, const VertexAttributeVector<int>& point,
+                 const vector<HalfEdgeID>& hs, int a, int b)
+    {
+        for(auto h: hs) {
+            Walker w = m.walker(h);
+            int p = point[w.opp().vertex()], q = point[w.vertex()];
+            if(!((p == a && q == b) || (p == b && q == a)))
+                return false;
+        }
+        return true;
+    }
+
+    template<typename T>
+    void test_non_manifold(const string& what)
+    {
+        // Three triangles on the edge between the points 0 and 1.
+        const vector<T> pts = {0,0,0, 1,0,0, 0,1,0, 0,-1,0, 0,0,1};
+        const vector<int> faces = {3, 3, 3};
+        const vector<int> indices = {0,1,2, 1,0,3, 0,1,4};
+        Manifold m;
+        vector<HalfEdgeID> non_manifold;
+        VertexAttributeVector<int> point = build(m, pts.size()/3, pts.data(), faces.size(),
+                                                 faces.data(), indices.data(), non_manifold);
+        check(valid(m), what + ": valid");
+        check(m.no_faces() == 3, what + ": all faces built");
+        check(non_manifold.size() == 1, what + ": one halfedge reported");
+        check(between(m, point, non_manifold, 0, 1), what + ": reported halfedge on the shared edge");
+    }
+}
+
+int main()
+{
+    {
+        const vector<double> pts = {0,0,0, 1,0,0, 1,1,0, 0,1,0};
+        const vector<int> faces = {3, 3};
+        const vector<int> indices = {0,1,2, 0,2,3};
+        Manifold m;
+        vector<HalfEdgeID> non_manifold;
+        VertexAttributeVector<int> point = build(m, 4, pts.data(), faces.size(), faces.data(),
+                                                 indices.data(), non_manifold);
+        check(valid(m) && m.no_vertices() == 4 && m.no_halfedges() == 10, "two triangles: mesh");
+        check(non_manifold.empty(), "two triangles: no non-manifold halfedges");
+        bool identity = true;
+        for(auto v: m.vertices())
+            identity = identity && point[v] == int(v.get_index());
+        check(identity, "two triangles: vertex ids are point indices");
+    }
+
+    test_non_manifold<float>("non-manifold edge (float)");
+    test_non_manifold<double>("non-manifold edge (double)");
+
+    {
+        const vector<double> pts = {0,0,0, 1,0,0, 0,1,0};
+        Manifold m;
+        const vector<int> faces = {3};
+        for(const vector<int>& indices: {vector<int>{0,1,3}, vector<int>{0,-1,2}}) {
+            VertexAttributeVector<int> point = build(m, 3, pts.data(), 1, faces.data(), indices.data());
+            check(point.size() == 0 && m.allocated_vertices() == 0 && m.allocated_faces() == 0,
+                  "index out of range rejected");
+        }
+        const vector<int> bad_faces = {-3, 3};
+        const vector<int> indices = {0,1,2};
+        VertexAttributeVector<int> point = build(m, 3, pts.data(), 2, bad_faces.data(), indices.data());
+        check(point.size() == 0 && m.allocated_halfedges() == 0, "negative face size rejected");
+    }
+
+    return report();
+}
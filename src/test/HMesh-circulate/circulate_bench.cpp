@@ -0,0 +1,120 @@
+/**
+ Microbenchmark for the circulators. The same one ring computations - the umbrella Laplacian
+ of every vertex and the centroid of every face - are done with callbacks passed as std::function,
+ which is how the circulators used to work, with lambdas passed straight to the templated
+ circulators, and with hand written Walker loops. The results are checked against each other.
+ If no file is given, a triangulated grid is used.
+
+ Usage: circulate_bench [mesh file]
+ */
+
+#include <functional>
+#include <iostream>
+#include <GEL/CGLA/Vec3d.h>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Timer.h>
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace Util;
+using namespace GELTest;
+
+namespace
+{
+    void make_grid(Manifold& m, int N)
+    {
+        GELTest::make_grid(m, N-1, N-1, [&](int i, int j) { return Vec3d(i/double(N), j/double(N), 0.01*((i*j)%17)); });
+    }
+
+    /// Both passes accumulate into a single vector so that the compiler cannot drop any work.
+    Vec3d laplacian_std_function(const Manifold& m)
+    {
+        Vec3d sum(0.0);
+        for(auto v: m.vertices()) {
+            Vec3d l(0.0);
+            std::function<void(VertexID)> f = [&](VertexID vn) { l += m.pos(vn); };
+            int n = circulate_vertex_ccw(m, v, f);
+            sum += l/n - m.pos(v);
+        }
+        for(auto f: m.faces()) {
+            Vec3d c(0.0);
+            std::function<void(VertexID)> g = [&](VertexID vn) { c += m.pos(vn); };
+            int n = circulate_face_ccw(m, f, g);
+            sum += c/n;
+        }
+        return sum;
+    }
+
+    Vec3d laplacian_template(const Manifold& m)
+    {
+        Vec3d sum(0.0);
+        for(auto v: m.vertices()) {
+            Vec3d l(0.0);
+            int n = circulate_vertex_ccw(m, v, [&](VertexID vn) { l += m.pos(vn); });
+            sum += l/n - m.pos(v);
+        }
+        for(auto f: m.faces()) {
+            Vec3d c(0.0);
+            int n = circulate_face_ccw(m, f, [&](VertexID vn) { c += m.pos(vn); });
+            sum += c/n;
+        }
+        return sum;
+    }
+
+    Vec3d laplacian_walker(const Manifold& m)
+    {
+        Vec3d sum(0.0);
+        for(auto v: m.vertices()) {
+            Vec3d l(0.0);
+            Walker w = m.walker(v);
+            for(; !w.full_circle(); w = w.circulate_vertex_ccw())
+                l += m.pos(w.vertex());
+            sum += l/w.no_steps() - m.pos(v);
+        }
+        for(auto f: m.faces()) {
+            Vec3d c(0.0);
+            Walker w = m.walker(f);
+            for(; !w.full_circle(); w = w.circulate_face_ccw())
+                c += m.pos(w.vertex());
+            sum += c/w.no_steps();
+        }
+        return sum;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Manifold m;
+    if(argc > 1) {
+        if(!load(argv[1], m)) {
+            cout << "Could not load " << argv[1] << endl;
+            return 1;
+        }
+    }
+    else
+        make_grid(m, 1000);
+    cout << m.no_vertices() << " vertices, " << m.no_faces() << " faces" << endl;
+
+    const int ITERATIONS = 10;
+    Vec3d ref(0.0);
+    struct Variant { const char* name; Vec3d (*f)(const Manifold&); };
+    Variant variants[] = {
+        {"std::function", laplacian_std_function},
+        {"template", laplacian_template},
+        {"Walker loop", laplacian_walker}};
+    for(const Variant& var: variants) {
+        Timer t;
+        t.start();
+        Vec3d r(0.0);
+        for(int i=0;i<ITERATIONS;++i)
+            r = var.f(m);
+        double secs = t.get_secs() / ITERATIONS;
+        if(&var == variants)
+            ref = r;
+        cout << var.name << ": " << secs*1e3 << " ms per pass"
+             << (length(r - ref) > 1e-9 * (1.0 + length(ref)) ? "  MISMATCH" : "") << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ Test of stitch_mesh and stitch_more on triangle soups.
+
+ - A soup made from a closed sphere, with every triangle on its own vertices, must be stitched into
+   a valid closed mesh with the vertices of the sphere.
+ - The same must hold when the copies of a vertex are moved apart by less than the radius.
+ - stitch_more must also give a closed mesh.
+
+ Finally, the time of stitch_mesh is compared to that of clustering the vertices with a KDTree,
+ which is how stitch_mesh found the clusters before.
+
+ Usage: stitch_test [rings of the sphere used for timing (default 500)]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Geometry/KDTree.h>
+#include <GEL/Util/Timer.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /** A soup of the triangles of make_sphere with N rings. Each vertex of a triangle is moved
+     randomly by up to jitter along each axis. */
+    void make_sphere_soup(Manifold& m, int N, double jitter, size_t& no_sphere_vertices)
+    {
+        Manifold sphere;
+        make_sphere(sphere, N);
+        no_sphere_vertices = sphere.no_vertices();
+
+        mt19937 rng(1);
+        uniform_real_distribution<double> noise(-jitter, jitter);
+        vector<double> soup;
+        vector<int> faces, indices;
+        for(auto f: sphere.faces())
+            faces.push_back(circulate_face_ccw(sphere, f, [&](VertexID v) {
+                const Vec3d p = sphere.pos(v) + Vec3d(noise(rng), noise(rng), noise(rng));
+                indices.push_back(soup.size()/3);
+                soup.insert(soup.end(), {p[0], p[1], p[2]});
+            }));
+        build(m, soup.size()/3, soup.data(), faces.size(), faces.data(), indices.data());
+    }
+
+    /// Cluster the boundary vertices with a KDTree as stitch_mesh did before.
+    VertexAttributeVector<int> cluster_with_kdtree(const Manifold& m, double rad)
+    {
+        Geometry::KDTree<Vec3d, VertexID> vtree;
+        for(auto v : m.vertices())
+            if(boundary(m, v))
+                vtree.insert(m.pos(v), v);
+        vtree.build();
+
+        VertexAttributeVector<int> cluster_id(m.allocated_vertices(), -1);
+        int cluster_ctr = 0;
+        for(auto v: m.vertices())
+            if(boundary(m, v) && cluster_id[v] == -1) {
+                vector<Vec3d> keys;
+                vector<VertexID> vals;
+                int n = vtree.in_sphere(m.pos(v), rad, keys, vals);
+                for(int i=0;i<n;++i)
+                    cluster_id[vals[i]] = cluster_ctr;
+                ++cluster_ctr;
+            }
+        return cluster_id;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int N = argc > 1 ? atoi(argv[1]) : 500;
+
+    for(double jitter: {0.0, 1e-6}) {
+        Manifold m;
+        size_t no_sphere_vertices;
+        make_sphere_soup(m, 30, jitter, no_sphere_vertices);
+        const string what = jitter == 0 ? "exact soup" : "jittered soup";
+        int unstitched = stitch_mesh(m, 1e-5);
+        m.cleanup();
+        check(unstitched == 0, what + ": all edges stitched");
+        check(valid(m) && closed(m), what + ": valid and closed");
+        check(m.no_vertices() == no_sphere_vertices, what + ": vertices of the sphere");
+    }
+
+    {
+        Manifold m;
+        size_t no_sphere_vertices;
+        make_sphere_soup(m, 30, 1e-6, no_sphere_vertices);
+        stitch_more(m, 1e-5);
+        m.cleanup();
+        check(valid(m) && closed(m) && m.no_vertices() == no_sphere_vertices, "stitch_more");
+    }
+
+    // Time
+    Manifold soup;
+    size_t no_sphere_vertices;
+    make_sphere_soup(soup, N, 0.0, no_sphere_vertices);
+    const double rad = 1e-6;
+    Util::Timer tim;
+    Manifold m = soup;
+    tim.start();
+    stitch_mesh(m, rad);
+    const double t_grid = tim.get_secs();
+    m = soup;
+    tim.start();
+    VertexAttributeVector<int> cluster_id = cluster_with_kdtree(m, rad);
+    const double t_kdtree = tim.get_secs();
+    tim.start();
+    stitch_mesh(m, cluster_id);
+    const double t_kdtree_stitch = t_kdtree + tim.get_secs();
+    cout << "Stitching a soup of " << soup.no_faces() << " triangles: " << t_grid
+         << " s (grid), " << t_kdtree_stitch << " s (KDTree, of which " << t_kdtree
+         << " s clustering)" << endl;
+
+    return report();
+}
@@ -0,0 +1,125 @@
+/**
+ Test of the curvature cache. A bumpy torus is edited through the cache by moving vertices and
+ by flipping, collapsing and splitting edges. After every batch of edits, the curvatures in the
+ cache must equal those computed from scratch by mean_curvatures, gaussian_curvature_angle_defects
+ and curvature_paraboloids. The time of an update after a batch of edits is compared to the time
+ of computing the curvature of the whole mesh. On an open patch, curvature_paraboloids must give
+ zero on the boundary.
+
+ Usage: curvature_cache_test [torus size (default 300)]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Timer.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    const int SMOOTH_STEPS = 2;
+
+    void make_torus(Manifold& m, int N)
+    {
+        GELTest::make_torus(m, N, N, [](double u, double v) { return 0.3 + 0.01*sin(7*u)*cos(5*v); });
+    }
+
+    /// A patch of the paraboloid z = x^2 + y^2/2 over [-1/2, 1/2]^2 with N x N quads split into triangles.
+    void make_patch(Manifold& m, int N)
+    {
+        make_grid(m, N, N, [&](int i, int j) {
+            const double x = double(i)/N - 0.5, y = double(j)/N - 0.5;
+            return Vec3d(x, y, x*x + 0.5*y*y);
+        });
+    }
+
+    /// Returns the number of vertices where the cache differs from a computation from scratch.
+    int compare(const Manifold& m, CurvatureCache& cache)
+    {
+        VertexAttributeVector<double> mean(m.allocated_vertices(), 0), gauss(m.allocated_vertices(), 0);
+        VertexAttributeVector<Vec3d> min_dir(m.allocated_vertices(), Vec3d(0)), max_dir(m.allocated_vertices(), Vec3d(0));
+        VertexAttributeVector<Vec2d> curv(m.allocated_vertices(), Vec2d(0));
+        mean_curvatures(m, mean, SMOOTH_STEPS);
+        gaussian_curvature_angle_defects(m, gauss, SMOOTH_STEPS);
+        curvature_paraboloids(m, min_dir, max_dir, curv);
+        int differences = 0;
+        for(VertexID v: m.vertices())
+            if(cache.mean_curvature(v) != mean[v] || cache.gaussian_curvature(v) != gauss[v] ||
+               cache.principal_curvatures()[v] != curv[v] || cache.min_curvature_directions()[v] != min_dir[v] ||
+               cache.max_curvature_directions()[v] != max_dir[v])
+                ++differences;
+        return differences;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int N = argc > 1 ? atoi(argv[1]) : 300;
+    Manifold m;
+    make_torus(m, N);
+    cout << m.no_vertices() << " vertices" << endl;
+
+    // On an open mesh, curvature_paraboloids gives zero on the boundary and a fit elsewhere.
+    {
+        Manifold patch;
+        make_patch(patch, 10);
+        VertexAttributeVector<Vec3d> min_dir, max_dir;
+        VertexAttributeVector<Vec2d> curv;
+        curvature_paraboloids(patch, min_dir, max_dir, curv);
+        bool ok = true;
+        for(VertexID v: patch.vertices())
+            ok = ok && (boundary(patch, v) ? curv[v] == Vec2d(0) && min_dir[v] == Vec3d(0) && max_dir[v] == Vec3d(0)
+                                           : curv[v] != Vec2d(0));
+        check(ok, "curvature_paraboloids on an open patch");
+    }
+
+    Util::Timer t;
+    CurvatureCache cache(m, CurvatureCache::ALL, SMOOTH_STEPS);
+    t.start();
+    cache.update();
+    cout << "full computation: " << t.get_secs() << " s" << endl;
+
+    mt19937 rng(0);
+    double update_secs = 0;
+    for(int batch = 0; batch < 20; ++batch) {
+        for(int k = 0; k < 20; ++k) {
+            vector<VertexID> verts(m.vertices().begin(), m.vertices().end());
+            const VertexID v = verts[rng() % verts.size()];
+            const HalfEdgeID h = m.walker(v).halfedge();
+            switch(k % 4) {
+                case 0:
+                    cache.set_pos(v, m.pos(v) + Vec3d(0.001, -0.002, 0.001));
+                    break;
+                case 1:
+                    if(precond_flip_edge(m, h))
+                        cache.flip_edge(h);
+                    break;
+                case 2:
+                    if(precond_collapse_edge(m, h))
+                        cache.collapse_edge(h, true);
+                    break;
+                case 3:
+                    cache.split_edge(h);
+                    triangulate(m);
+                    circulate_vertex_ccw(m, v, [&](VertexID vn) {
+                        circulate_vertex_ccw(m, vn, [&](VertexID vnn) { cache.mark_dirty(vnn); });
+                    });
+                    break;
+            }
+        }
+        t.start();
+        cache.update();
+        update_secs += t.get_secs();
+        const int differences = compare(m, cache);
+        check(differences == 0, "batch " + to_string(batch) + ": " + to_string(differences) + " vertices differ");
+    }
+    cout << "average update after 20 edits: " << update_secs / 20 << " s" << endl;
+    return report();
+}
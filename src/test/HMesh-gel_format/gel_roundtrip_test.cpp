@@ -0,0 +1,123 @@
+/**
+ Round trip test of gel_save and gel_load.
+
+ A grid of quads gets three holes by removing faces and a vertex, so the mesh
+ has boundaries and unused entities when it is saved. It also has an attribute layer and an
+ attribute vector saved through a GELAttribute. After loading, the same entities must be in use,
+ the connectivity and positions of all used entities must be the same, and so must the
+ attributes. Finally, both meshes are cleaned up and must still be equal.
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <GEL/HMesh/HMesh.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /// An N x N grid of quads in the plane z=0 with a bump.
+    void make_grid(Manifold& m, int N)
+    {
+        GELTest::make_grid(m, N, N, [](int i, int j) { return Vec3d(i, j, 0.1*sin(double(i*j))); }, true);
+    }
+
+    /// True if a and b have the same entities in use with the same connectivity and positions.
+    bool same_mesh(const Manifold& a, const Manifold& b)
+    {
+        if(a.allocated_vertices() != b.allocated_vertices() ||
+           a.allocated_faces() != b.allocated_faces() ||
+           a.allocated_halfedges() != b.allocated_halfedges())
+            return false;
+        for(size_t i=0;i<a.allocated_vertices();++i) {
+            VertexID v(i);
+            if(a.in_use(v) != b.in_use(v))
+                return false;
+            if(a.in_use(v) && (a.pos(v) != b.pos(v) ||
+                               a.walker(v).halfedge() != b.walker(v).halfedge()))
+                return false;
+        }
+        for(size_t i=0;i<a.allocated_faces();++i) {
+            FaceID f(i);
+            if(a.in_use(f) != b.in_use(f))
+                return false;
+            if(a.in_use(f) && a.walker(f).halfedge() != b.walker(f).halfedge())
+                return false;
+        }
+        for(size_t i=0;i<a.allocated_halfedges();++i) {
+            HalfEdgeID h(i);
+            if(a.in_use(h) != b.in_use(h))
+                return false;
+            if(!a.in_use(h))
+                continue;
+            Walker wa = a.walker(h), wb = b.walker(h);
+            if(wa.next().halfedge() != wb.next().halfedge() ||
+               wa.prev().halfedge() != wb.prev().halfedge() ||
+               wa.opp().halfedge() != wb.opp().halfedge() ||
+               wa.vertex() != wb.vertex() || wa.face() != wb.face())
+                return false;
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    Manifold m;
+    make_grid(m, 12);
+    m.remove_face(FaceID(14));
+    m.remove_face(FaceID(15));
+    m.remove_face(FaceID(100));
+    m.remove_vertex(VertexID(5*13+8));
+    check(m.no_faces() < m.allocated_faces() && m.no_vertices() < m.allocated_vertices(),
+          "the saved mesh has unused entities");
+    check(valid(m), "the saved mesh is valid");
+
+    VertexAttributeVector<float>& height = m.add_vertex_attribute<float>("height", -1.0f);
+    for(auto v: m.vertices())
+        height[v] = float(m.pos(v)[2]);
+    FaceAttributeVector<int> label(m.allocated_faces(), 0);
+    for(auto f: m.faces())
+        label[f] = int(f.get_index()) * 3;
+
+    const string filename = "gel_roundtrip_test.gel";
+    check(gel_save(filename, m, {GELAttribute("label", label)}), "saved");
+
+    Manifold m2;
+    FaceAttributeVector<int> label2;
+    check(gel_load(filename, m2, {GELAttribute("label", label2)}), "loaded");
+    remove(filename.c_str());
+
+    check(same_mesh(m, m2), "same connectivity and positions");
+    check(valid(m2), "the loaded mesh is valid");
+    check(m2.no_vertices() == m.no_vertices() && m2.no_faces() == m.no_faces() &&
+          m2.no_halfedges() == m.no_halfedges(), "same number of entities");
+    size_t holes = 0;
+    HalfEdgeAttributeVector<int> seen(m2.allocated_halfedges(), 0);
+    for(auto h: m2.halfedges())
+        if(boundary(m2, h) && m2.walker(h).face() == InvalidFaceID && !seen[h]) {
+            for(Walker w = m2.walker(h); !w.full_circle(); w = w.next())
+                seen[w.halfedge()] = 1;
+            ++holes;
+        }
+    check(holes == 4, "three holes and the outer boundary");
+
+    const VertexAttributeVector<float>* height2 = m2.vertex_attribute<float>("height");
+    bool attributes_ok = height2 != nullptr;
+    for(auto v: m2.vertices())
+        attributes_ok = attributes_ok && (*height2)[v] == height[v];
+    for(auto f: m2.faces())
+        attributes_ok = attributes_ok && label2[f] == label[f];
+    check(attributes_ok, "attributes");
+
+    m.cleanup();
+    m2.cleanup();
+    check(same_mesh(m, m2), "same after cleanup");
+
+    return report();
+}
@@ -0,0 +1,159 @@
+/**
+ Test of the geodesic engine on a triangulated square in the plane.
+
+ - Along the edges, the engine must give the same distances as HMesh::Dijkstra.
+ - Several sources must give the least of their distances, and a radius or a target must not
+   change the distances found.
+ - Fast marching must be closer to the Euclidean distance than the edge graph is.
+ - A batch of queries run in parallel must give the same results as the queries run one by one.
+
+ Finally, the time of many small queries is compared to that of HMesh::Dijkstra.
+
+ Usage: geodesics_test [grid size (default 500)]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Timer.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /// A square with N x N vertices, split into triangles along alternating diagonals.
+    void make_grid(Manifold& m, int N)
+    {
+        GELTest::make_grid(m, N-1, N-1, [&](int i, int j) { return Vec3d(double(i)/(N-1), double(j)/(N-1), 0.0); },
+                           false, [](int i, int j) { return (i+j)%2 == 0; });
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    const int N = argc > 1 ? atoi(argv[1]) : 500;
+    Manifold m;
+    make_grid(m, N);
+    const VertexID centre(size_t(N/2*N + N/2));
+    const VertexID corner(size_t(0));
+
+    GeodesicEngine graph(m), fmm(m, GEODESIC_FAST_MARCHING);
+
+    // Edge graph against Dijkstra
+    DijkstraOutput dijkstra = Dijkstra(m, centre);
+    graph.compute(centre);
+    bool same = graph.reached_vertices().size() == m.no_vertices();
+    for(auto v : m.vertices())
+        same = same && abs(graph.dist(v) - dijkstra.dist[v]) < 1e-12;
+    check(same, "edge graph distances equal Dijkstra");
+
+    // Two sources, with and without a radius
+    vector<double> d_centre(m.allocated_vertices()), d_corner(m.allocated_vertices());
+    for(auto v : m.vertices())
+        d_centre[v.get_index()] = graph.dist(v);
+    graph.compute(corner);
+    for(auto v : m.vertices())
+        d_corner[v.get_index()] = graph.dist(v);
+
+    GeodesicQuery q;
+    q.sources = {centre, corner};
+    graph.compute(q);
+    same = true;
+    for(auto v : m.vertices()) {
+        double dc = d_centre[v.get_index()], dk = d_corner[v.get_index()];
+        same = same && graph.dist(v) == min(dc, dk);
+        if(dc != dk)
+            same = same && graph.source(v) == (dc < dk ? centre : corner);
+    }
+    check(same, "two sources give the nearer source and its distance");
+
+    q.max_dist = 0.2;
+    graph.compute(q);
+    same = true;
+    for(auto v : m.vertices()) {
+        double d = min(d_centre[v.get_index()], d_corner[v.get_index()]);
+        same = same && (d <= q.max_dist ? graph.dist(v) == d : !graph.reached(v));
+    }
+    check(same, "radius does not change the distances within it");
+
+    const VertexID target(size_t(N*N - 1));
+    graph.compute(centre);
+    const double full = graph.dist(target);
+    GeodesicQuery qt;
+    qt.sources = {centre};
+    qt.target = target;
+    graph.compute(qt);
+    check(graph.dist(target) == full, "target does not change its distance");
+
+    // Fast marching against the Euclidean distance
+    fmm.compute(centre);
+    double err_fmm = 0, err_graph = 0;
+    for(auto v : m.vertices()) {
+        double d = length(m.pos(v) - m.pos(centre));
+        err_fmm = max(err_fmm, abs(fmm.dist(v) - d));
+        err_graph = max(err_graph, abs(d_centre[v.get_index()] - d));
+    }
+    cout << "Max error, edge graph: " << err_graph << " fast marching: " << err_fmm << endl;
+    check(err_fmm < 0.5 * err_graph && err_fmm < 0.02, "fast marching is close to Euclidean distance");
+
+    // Batch against one by one
+    mt19937 rng(1);
+    vector<GeodesicQuery> queries(2000);
+    for(auto& query : queries) {
+        query.sources = {VertexID(size_t(rng() % (N*N))), VertexID(size_t(rng() % (N*N)))};
+        query.max_dist = 0.05;
+    }
+    vector<double> batch_sum(queries.size());
+    geodesic_batch(m, queries, [&](size_t i, const GeodesicEngine& e) {
+        double s = 0;
+        for(auto v : e.reached_vertices())
+            s += e.dist(v);
+        batch_sum[i] = s;
+    }, GEODESIC_FAST_MARCHING);
+    same = true;
+    for(size_t i = 0; i < queries.size(); ++i) {
+        fmm.compute(queries[i]);
+        double s = 0;
+        for(auto v : fmm.reached_vertices())
+            s += fmm.dist(v);
+        same = same && s == batch_sum[i];
+    }
+    check(same, "batch equals queries one by one");
+
+    // Time of small queries
+    Util::Timer tim;
+    tim.start();
+    for(int i = 0; i < 200; ++i)
+        Dijkstra(m, queries[i].sources[0]);
+    double t_dijkstra = tim.get_secs() / 200;
+    tim.start();
+    for(int i = 0; i < 200; ++i) {
+        GeodesicQuery qs;
+        qs.sources = {queries[i].sources[0]};
+        qs.max_dist = 0.05;
+        graph.compute(qs);
+    }
+    double t_engine = tim.get_secs() / 200;
+    cout << "Time per query, Dijkstra (whole mesh): " << t_dijkstra
+         << " s, engine (radius 0.05): " << t_engine << " s" << endl;
+
+    tim.start();
+    for(int i = 0; i < 20; ++i)
+        graph.compute(queries[i].sources[0]);
+    double t_graph = tim.get_secs() / 20;
+    tim.start();
+    for(int i = 0; i < 20; ++i)
+        fmm.compute(queries[i].sources[0]);
+    double t_fmm = tim.get_secs() / 20;
+    cout << "Time per query on the whole mesh, edge graph: " << t_graph
+         << " s, fast marching: " << t_fmm << " s" << endl;
+
+    return report();
+}
@@ -0,0 +1,124 @@
+/**
+ Test of pcg_solve and implicit fairing.
+
+ - A small symmetric positive definite system with a known solution must be solved.
+ - The system of a backward Euler step, I + tL with L the Laplacian matrix of a sphere, is solved
+   for a random right hand side, and the residual of each column must be below the tolerance
+   relative to that column of the right hand side.
+ - Implicit fairing of a sphere with radial noise must at least halve the deviation of the
+   vertices from a sphere, both with uniform and cotangent weights.
+ */
+
+#include <iostream>
+#include <random>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/HMesh/implicit_fairing.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /** Relative deviation of the vertices from a sphere: the standard deviation of the distance
+     to the centroid divided by its mean. */
+    double sphere_deviation(const Manifold& m)
+    {
+        Vec3d c(0);
+        for(auto v: m.vertices())
+            c += m.pos(v);
+        c /= m.no_vertices();
+        double sum = 0, sum_sqr = 0;
+        for(auto v: m.vertices()) {
+            double r = length(m.pos(v) - c);
+            sum += r;
+            sum_sqr += r*r;
+        }
+        const double mean = sum / m.no_vertices();
+        return sqrt(max(0.0, sum_sqr / m.no_vertices() - mean*mean)) / mean;
+    }
+
+    /// Largest ratio over the columns of the norm of the residual b - Ax to the norm of b.
+    double relative_residual(const SparseMatrix& A, const vector<Vec3d>& b, const vector<Vec3d>& x)
+    {
+        vector<Vec3d> Ax;
+        A.multiply(x, Ax);
+        Vec3d r2(0), b2(0);
+        for(size_t i=0;i<b.size();++i) {
+            const Vec3d r = b[i] - Ax[i];
+            r2 += r*r;
+            b2 += b[i]*b[i];
+        }
+        double worst = 0;
+        for(int k=0;k<3;++k)
+            worst = max(worst, sqrt(r2[k] / b2[k]));
+        return worst;
+    }
+}
+
+int main()
+{
+    // The tridiagonal matrix with 2 on the diagonal and -1 off it times (1, 2, 3) is (0, 0, 4).
+    {
+        SparseMatrix A;
+        A.columns = {0, 1, 0, 1, 2, 1, 2};
+        A.values = {2, -1, -1, 2, -1, -1, 2};
+        A.row_start = {0, 2, 5, 7};
+        vector<Vec3d> b = {Vec3d(0, 1, 0), Vec3d(0, 0, 0), Vec3d(4, 1, 0)};
+        vector<Vec3d> x(3, Vec3d(0));
+        pcg_solve(A, b, x, 1e-12, 100);
+        check(length(x[0] - Vec3d(1, 1, 0)) < 1e-9 && length(x[1] - Vec3d(2, 1, 0)) < 1e-9 &&
+              length(x[2] - Vec3d(3, 1, 0)) < 1e-9, "small system");
+    }
+
+    for(LaplacianWeights weights: {UNIFORM_LAPLACIAN, COTANGENT_LAPLACIAN}) {
+        const string name = weights == UNIFORM_LAPLACIAN ? "uniform" : "cotangent";
+        Manifold m;
+        make_sphere(m, 30);
+        VertexAttributeVector<size_t> index;
+        SparseMatrix A = laplacian_matrix(m, weights, index);
+        check(A.rows() == m.no_vertices(), name + ": size of the Laplacian matrix");
+        // I + tL
+        const double t = 2.0;
+        for(auto& a: A.values)
+            a *= t;
+        for(size_t i=0;i<A.rows();++i)
+            for(size_t k=A.row_start[i];k<A.row_start[i+1];++k)
+                if(A.columns[k] == i)
+                    A.values[k] += 1;
+
+        mt19937 rng(1);
+        uniform_real_distribution<double> u(-1, 1);
+        vector<Vec3d> b(A.rows());
+        for(auto& bi: b)
+            bi = Vec3d(u(rng), u(rng), u(rng));
+        for(double tolerance: {1e-4, 1e-8}) {
+            vector<Vec3d> x(A.rows(), Vec3d(0));
+            int iter = pcg_solve(A, b, x, tolerance, 1000);
+            double residual = relative_residual(A, b, x);
+            cout << name << ", tolerance " << tolerance << ": " << iter << " iterations, residual "
+                 << residual << endl;
+            check(iter < 1000 && residual < tolerance, name + ": residual below tolerance");
+        }
+    }
+
+    for(LaplacianWeights weights: {UNIFORM_LAPLACIAN, COTANGENT_LAPLACIAN}) {
+        const string name = weights == UNIFORM_LAPLACIAN ? "uniform" : "cotangent";
+        Manifold m;
+        make_sphere(m, 30);
+        mt19937 rng(2);
+        uniform_real_distribution<double> noise(-0.05, 0.05);
+        for(auto v: m.vertices())
+            m.pos(v) *= 1 + noise(rng);
+        const double before = sphere_deviation(m);
+        implicit_fairing(m, 1.0, 3, weights);
+        const double after = sphere_deviation(m);
+        cout << name << " fairing: deviation from a sphere " << before << " -> " << after << endl;
+        check(after < 0.5 * before, name + ": fairing brings the vertices closer to a sphere");
+    }
+
+    return report();
+}
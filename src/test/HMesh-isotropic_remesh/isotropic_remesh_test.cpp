@@ -0,0 +1,165 @@
+/**
+ Test of isotropic_remesh.
+
+ - A UV sphere, whose triangles are long and thin near the poles, is remeshed. The result must be
+   a valid triangle mesh whose vertices lie on the original surface, whose edges are mostly within
+   4/5 and 4/3 of the target length, and whose vertices mostly have valency five to seven.
+ - A flat square of thin triangles is remeshed. The vertices must stay in the plane, the boundary
+   must stay where it was, and the area must not change.
+
+ Finally, the time is compared to that of the chain of refine_edges, triangulate, remove_needles,
+ optimize_valency, TAL_smoothing and Implicit::push_to_surface followed by cleanup, which is how
+ remeshing was done before.
+
+ Usage: isotropic_remesh_test [rings of the sphere used for timing (default 400)]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Geometry/Implicit.h>
+#include <GEL/Util/Timer.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /// A unit square in the plane z=0 with N x 4N thin triangles.
+    void make_square(Manifold& m, int N)
+    {
+        make_grid(m, N, 4*N, [&](int i, int j) { return Vec3d(double(i)/N, double(j)/(4*N), 0.0); });
+    }
+
+    class UnitSphere: public Geometry::Implicit
+    {
+    public:
+        double eval(const Vec3d& p) const { return length(p) - 1; }
+        Vec3d grad(const Vec3d& p) const { return normalize(p); }
+    };
+
+    bool all_triangles(const Manifold& m)
+    {
+        for(auto f: m.faces())
+            if(no_edges(m, f) != 3)
+                return false;
+        return true;
+    }
+
+    /// Fraction of the edges whose length is within 4/5 and 4/3 of L.
+    double edges_in_range(const Manifold& m, double L)
+    {
+        size_t n = 0;
+        for(auto h: m.halfedges()) {
+            double l = length(m, h);
+            n += l >= 0.8*L && l <= 4.0/3.0*L;
+        }
+        return double(n) / m.no_halfedges();
+    }
+
+    /// Fraction of the interior vertices with valency five, six or seven.
+    double regular_vertices(const Manifold& m)
+    {
+        size_t n = 0, interior = 0;
+        for(auto v: m.vertices())
+            if(!boundary(m, v)) {
+                int k = valency(m, v);
+                n += k >= 5 && k <= 7;
+                ++interior;
+            }
+        return double(n) / interior;
+    }
+
+    double total_area(const Manifold& m)
+    {
+        double a = 0;
+        for(auto f: m.faces())
+            a += area(m, f);
+        return a;
+    }
+
+    void hand_rolled_remesh(Manifold& m, const Geometry::Implicit& imp, double L, int iterations)
+    {
+        for(int iter=0;iter<iterations;++iter) {
+            refine_edges(m, 4.0/3.0 * L);
+            triangulate(m);
+            remove_needles(m, 0.8 * L / median_edge_length(m));
+            optimize_valency(m);
+            TAL_smoothing(m, 1);
+            for(auto v: m.vertices())
+                imp.push_to_surface(m.pos(v));
+            m.cleanup();
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int N = argc > 1 ? atoi(argv[1]) : 400;
+
+    // Sphere
+    {
+        const int rings = 40;
+        Manifold m;
+        make_sphere(m, rings);
+        const double L = 0.05;
+        isotropic_remesh(m, L, 10);
+        check(valid(m) && all_triangles(m), "sphere: valid triangle mesh");
+
+        // The facets of the original are within this distance of the sphere.
+        const double chord_error = 1 - cos(M_PI / rings);
+        bool on_surface = true;
+        for(auto v: m.vertices())
+            on_surface = on_surface && length(m.pos(v)) <= 1 + 1e-9 && length(m.pos(v)) >= 1 - chord_error;
+        check(on_surface, "sphere: vertices on the original surface");
+        double in_range = edges_in_range(m, L), regular = regular_vertices(m);
+        cout << "Sphere: " << m.no_vertices() << " vertices, " << in_range << " of the edges in range, "
+             << regular << " of the vertices regular" << endl;
+        check(in_range > 0.85, "sphere: edge lengths");
+        check(regular > 0.85, "sphere: valencies");
+    }
+
+    // Square
+    {
+        Manifold square;
+        make_square(square, 10);
+        Manifold m = square;
+        isotropic_remesh(m, 0.03, 10);
+        check(valid(m) && all_triangles(m), "square: valid triangle mesh");
+        bool flat = true, boundary_kept = true;
+        for(auto v: m.vertices()) {
+            const Vec3d p = m.pos(v);
+            flat = flat && p[2] == 0;
+            if(boundary(m, v))
+                boundary_kept = boundary_kept && (p[0] == 0 || p[0] == 1 || p[1] == 0 || p[1] == 1);
+        }
+        check(flat, "square: vertices in the plane");
+        check(boundary_kept, "square: boundary in place");
+        check(abs(total_area(m) - 1) < 1e-9, "square: area");
+        check(edges_in_range(m, 0.03) > 0.85, "square: edge lengths");
+    }
+
+    // Time
+    Manifold big;
+    make_sphere(big, N);
+    const double L = 2 * M_PI / (2*N);
+    Util::Timer tim;
+    Manifold m = big;
+    tim.start();
+    isotropic_remesh(m, L, 10);
+    double t_remesh = tim.get_secs();
+    double in_range = edges_in_range(m, L);
+    m = big;
+    tim.start();
+    hand_rolled_remesh(m, UnitSphere(), L, 10);
+    double t_chain = tim.get_secs();
+    cout << "Ten iterations on a sphere with " << big.no_faces() << " faces: " << t_remesh
+         << " s (isotropic_remesh, " << in_range << " of the edges in range), " << t_chain
+         << " s (hand rolled, " << edges_in_range(m, L) << " of the edges in range)" << endl;
+
+    return report();
+}
@@ -0,0 +1,76 @@
+/**
+ Benchmark of dihedral angle minimization by edge flips. A smooth height field is triangulated
+ with diagonals in random directions, and the dihedral angles are minimized by the serial
+ priority queue optimization and by the parallel optimization with 1, 2, 4, ... threads up to
+ the number of hardware threads. The time and the energy of the result are reported. The result
+ of the parallel optimization must not depend on the number of threads, which is checked as well.
+
+ Usage: flip_bench [grid size (default 500, i.e. 500K faces)] [max threads]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Parallel.h>
+#include <GEL/Util/Timer.h>
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace Util;
+using namespace GELTest;
+
+namespace
+{
+    void make_random_grid(Manifold& m, int N)
+    {
+        mt19937 rng(0);
+        make_grid(m, N-1, N-1, [&](int i, int j) { return Vec3d(i/double(N), j/double(N), 0.1*sin(9.0*i/N)*cos(7.0*j/N)); },
+                  false, [&](int, int) { return rng() % 2 == 0; });
+    }
+
+    double total_energy(const Manifold& m)
+    {
+        DihedralEnergy efun;
+        double e = 0;
+        for(HalfEdgeID h: m.halfedges())
+            if(h < m.walker(h).opp().halfedge() && !boundary(m, h))
+                e += efun.energy(m, h);
+        return e;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int N = argc > 1 ? atoi(argv[1]) : 500;
+    const size_t max_threads = argc > 2 ? atoi(argv[2]) : max(1u, thread::hardware_concurrency());
+
+    Manifold m0;
+    make_random_grid(m0, N);
+    cout << m0.no_vertices() << " vertices, " << m0.no_faces() << " faces, energy: " << total_energy(m0) << endl;
+
+    Manifold m = m0;
+    Timer t;
+    t.start();
+    minimize_dihedral_angle(m);
+    const double t_serial = t.get_secs();
+    cout << "serial time: " << t_serial << " s energy: " << total_energy(m) << endl;
+
+    double ref = 0;
+    for(size_t threads = 1; threads <= max_threads; threads *= 2) {
+        set_no_threads(threads);
+        m = m0;
+        t.start();
+        minimize_dihedral_angle_parallel(m);
+        const double secs = t.get_secs();
+        const double e = total_energy(m);
+        if(threads == 1)
+            ref = e;
+        cout << "parallel threads: " << threads << " time: " << secs << " s energy: " << e
+             << " speedup: " << t_serial/secs << (e != ref ? "  RESULT DIFFERS" : "") << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ Throughput benchmark for the OBJ loader. The flat array parser is timed with one thread
+ and with all threads, and compared to a plain line by line istringstream/sscanf reader.
+ The results of the readers are checked against each other. If no file is given, a
+ large grid with quads, relative indices and continued lines is written and used. Finally,
+ a face with an index too large for an int must make loading into a Manifold fail.
+ 
+ Usage: obj_load_bench [file.obj]
+ */
+
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <GEL/HMesh/obj_load.h>
+#include <GEL/Util/Timer.h>
+
+using namespace std;
+using namespace HMesh;
+using namespace Util;
+
+namespace
+{
+    void write_grid(const string& filename, int N)
+    {
+        ofstream os(filename);
+        for(int i=0;i<N;++i)
+            for(int j=0;j<N;++j)
+                os << "v " << i/double(N) << " " << j/double(N) << " " << 0.01*((i*j)%17) << "\n";
+        os << "vn 0 0 1\n# some faces use relative indices\n";
+        for(int i=0;i<N-1;++i)
+            for(int j=0;j<N-1;++j) {
+                int a = i*N+j+1;
+                if((i+j)%7 == 0)
+                    os << "f " << a-N*N-1 << " " << a+N-N*N-1 << " \\\n  " << a+N+1-N*N-1 << " " << a+1-N*N-1 << "\n";
+                else
+                    os << "f " << a << "//1 " << a+N << "//1 " << a+N+1 << "//1 " << a+1 << "//1\n";
+            }
+    }
+
+    /// The straightforward way of reading OBJ which we use as reference.
+    void line_load(const string& filename, vector<double>& vertices, vector<int>& faces, vector<int>& indices)
+    {
+        ifstream is(filename);
+        string buf;
+        while(getline(is, buf)) {
+            while(!buf.empty() && isspace(buf.back())) buf.pop_back();
+            while(!buf.empty() && buf.back() == '\\') {
+                buf.pop_back();
+                string cont;
+                getline(is, cont);
+                while(!cont.empty() && isspace(cont.back())) cont.pop_back();
+                buf += cont;
+            }
+            istringstream iss(buf);
+            string code;
+            if(!(iss >> code)) continue;
+            if(code == "v") {
+                double x,y,z;
+                iss >> x >> y >> z;
+                vertices.insert(vertices.end(), {x,y,z});
+            }
+            else if(code == "f") {
+                string str;
+                int ctr = 0;
+                while(iss >> str) {
+                    int v;
+                    if(sscanf(str.c_str(), "%d", &v) == 1) {
+                        indices.push_back(v>0 ? v-1 : int(vertices.size()/3)+v);
+                        ++ctr;
+                    }
+                }
+                faces.push_back(ctr);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    string filename = "obj_load_bench.obj";
+    if(argc > 1)
+        filename = argv[1];
+    else {
+        cout << "Writing " << filename << endl;
+        write_grid(filename, 1500);
+    }
+    ifstream is(filename, ios::binary | ios::ate);
+    double mb = is.tellg() / double(1 << 20);
+    
+    vector<double> ref_vertices;
+    vector<int> ref_faces, ref_indices;
+    Timer t;
+    t.start();
+    line_load(filename, ref_vertices, ref_faces, ref_indices);
+    double secs = t.get_secs();
+    cout << "Line by line:  " << mb/secs << " MB/s" << endl;
+    
+    int no_threads = max(1u, thread::hardware_concurrency());
+    for(int n: {1, no_threads}) {
+        vector<double> vertices;
+        vector<int> faces, indices;
+        t.start();
+        obj_load(filename, vertices, faces, indices, n);
+        secs = t.get_secs();
+        cout << "obj_load (" << n << " threads): " << mb/secs << " MB/s" << endl;
+        if(vertices != ref_vertices || faces != ref_faces || indices != ref_indices) {
+            cout << "test failed: result differs from line by line reader" << endl;
+            return 1;
+        }
+    }
+    
+    Manifold m;
+    t.start();
+    obj_load(filename, m);
+    secs = t.get_secs();
+    cout << "Loading Manifold with " << m.no_faces() << " faces: " << mb/secs << " MB/s" << endl;
+    
+    // Indices beyond the range of int are clamped and then rejected by build.
+    {
+        ofstream os("obj_load_bench_bad.obj");
+        os << "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 99999999999999999999\n";
+    }
+    vector<double> vertices;
+    vector<int> faces, indices;
+    obj_load("obj_load_bench_bad.obj", vertices, faces, indices);
+    if(indices.size() != 3 || indices[2] != INT_MAX-1 || obj_load("obj_load_bench_bad.obj", m)) {
+        cout << "test failed: out of range index not rejected" << endl;
+        return 1;
+    }
+    cout << "Test passed" << endl;
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ Round trip test of ply_load.
+
+ A cube made of quads and a pyramid of triangles on top of it is written as an ASCII, a binary
+ little endian and a binary big endian PLY file. The face list also holds faces with no
+ vertices, including the last face. Each file is loaded, and the positions, the faces and the
+ vertex colors must be those written. Finally, a file with a face index out of range must fail
+ to load.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <GEL/HMesh/HMesh.h>
+#include "../test_util.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    struct Mesh
+    {
+        vector<Vec3f> points;
+        vector<Vec3i> colors;
+        vector<vector<int>> faces;
+    };
+
+    /// A box with an open top and a pyramid closing it, plus faces without vertices.
+    Mesh make_mesh()
+    {
+        Mesh mesh;
+        mesh.points = {Vec3f(0,0,0), Vec3f(1,0,0), Vec3f(1,1,0), Vec3f(0,1,0),
+                       Vec3f(0,0,1), Vec3f(1,0,1), Vec3f(1,1,1), Vec3f(0,1,1), Vec3f(0.5,0.5,1.5)};
+        for(size_t i=0;i<mesh.points.size();++i)
+            mesh.colors.push_back(Vec3i(int(i)*20, 255-int(i)*20, 7));
+        mesh.faces = {{0,3,2,1}, {}, {0,1,5,4}, {1,2,6,5}, {2,3,7,6}, {3,0,4,7},
+                      {4,5,8}, {5,6,8}, {}, {6,7,8}, {7,4,8}, {}};
+        return mesh;
+    }
+
+    template<typename T>
+    void put(ostream& os, T x, bool big_endian)
+    {
+        char b[sizeof(T)];
+        memcpy(b, &x, sizeof(T));
+        const uint16_t one = 1;
+        if(big_endian == (*reinterpret_cast<const uint8_t*>(&one) == 1))
+            reverse(b, b+sizeof(T));
+        os.write(b, sizeof(T));
+    }
+
+    void write_ply(const string& filename, const Mesh& mesh, const string& format)
+    {
+        ofstream os(filename, ios::binary);
+        os << "ply\nformat " << format << " 1.0\ncomment written by ply_load_test\n"
+           << "element vertex " << mesh.points.size() << "\n"
+           << "property float x\nproperty float y\nproperty float z\n"
+           << "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+           << "element face " << mesh.faces.size() << "\n"
+           << "property list uchar int vertex_indices\nend_header\n";
+        if(format == "ascii") {
+            for(size_t i=0;i<mesh.points.size();++i)
+                os << mesh.points[i][0] << " " << mesh.points[i][1] << " " << mesh.points[i][2] << " "
+                   << mesh.colors[i][0] << " " << mesh.colors[i][1] << " " << mesh.colors[i][2] << "\n";
+            for(const auto& f: mesh.faces) {
+                os << f.size();
+                for(int i: f)
+                    os << " " << i;
+                os << "\n";
+            }
+            return;
+        }
+        const bool big_endian = format == "binary_big_endian";
+        for(size_t i=0;i<mesh.points.size();++i) {
+            for(int j=0;j<3;++j)
+                put<float>(os, mesh.points[i][j], big_endian);
+            for(int j=0;j<3;++j)
+                put<uint8_t>(os, mesh.colors[i][j], big_endian);
+        }
+        for(const auto& f: mesh.faces) {
+            put<uint8_t>(os, f.size(), big_endian);
+            for(int i: f)
+                put<int32_t>(os, i, big_endian);
+        }
+    }
+
+    /// Compare m to mesh. All points are used and the mesh is manifold, so vertex IDs are point indices.
+    void compare(const Manifold& m, const VertexAttributeVector<Vec3f>& colors, const Mesh& mesh,
+                 const string& what)
+    {
+        bool points_ok = m.no_vertices() == mesh.points.size();
+        for(auto v: m.vertices())
+            points_ok = points_ok && v.get_index() < mesh.points.size() &&
+                Vec3f(m.pos(v)) == mesh.points[v.get_index()] &&
+                length(colors[v] - Vec3f(mesh.colors[v.get_index()]) / 255.0f) < 1e-6;
+        check(points_ok, what + ": positions and colors");
+
+        vector<vector<int>> faces;
+        for(auto f: m.faces()) {
+            vector<int> loop;
+            for(Walker w = m.walker(f); !w.full_circle(); w = w.next())
+                loop.push_back(int(w.vertex().get_index()));
+            faces.push_back(loop);
+        }
+        vector<vector<int>> expected;
+        for(const auto& f: mesh.faces)
+            if(!f.empty())
+                expected.push_back(f);
+        check(faces == expected, what + ": faces");
+        check(valid(m) && closed(m), what + ": valid and closed");
+    }
+}
+
+int main()
+{
+    const Mesh mesh = make_mesh();
+    for(string format: {"ascii", "binary_little_endian", "binary_big_endian"}) {
+        const string filename = "ply_load_test_" + format + ".ply";
+        write_ply(filename, mesh, format);
+        Manifold m;
+        VertexAttributeVector<Vec3d> normals;
+        VertexAttributeVector<Vec3f> colors;
+        VertexAttributeVector<float> quality;
+        check(ply_load(filename, m, normals, colors, quality), format + ": loaded");
+        check(normals.size() == 0 && quality.size() == 0, format + ": no normals and quality");
+        compare(m, colors, mesh, format);
+        remove(filename.c_str());
+    }
+
+    Mesh bad = mesh;
+    bad.faces[0][2] = int(mesh.points.size());
+    for(string format: {"ascii", "binary_little_endian"}) {
+        const string filename = "ply_load_test_bad.ply";
+        write_ply(filename, bad, format);
+        Manifold m;
+        check(!ply_load(filename, m) && m.no_faces() == 0, format + ": index out of range rejected");
+        remove(filename.c_str());
+    }
+
+    return report();
+}
@@ -0,0 +1,139 @@
+/**
+ Test of progressive meshes recorded by quadric simplification. A bumpy torus and a grid with a
+ boundary are simplified with and without the parallel simplifier. It is checked that
+ - the base mesh is the simplified mesh,
+ - applying all splits gives back the original mesh,
+ - undoing all splits gives back the base mesh,
+ - intermediate levels of detail are valid meshes,
+ - a progressive mesh survives being written and read, and a truncated stream gives a prefix.
+
+ Usage: progressive_mesh_test
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Parallel.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    void make_torus(Manifold& m, int N)
+    {
+        GELTest::make_torus(m, N, N, [](double u, double v) { return 0.3 + 0.01*sin(7*u)*cos(5*v); });
+    }
+
+    void make_grid(Manifold& m, int N)
+    {
+        GELTest::make_grid(m, N-1, N-1, [&](int i, int j) {
+            return Vec3d(i/double(N), j/double(N), 0.1*sin(9.0*i/N)*cos(7.0*j/N));
+        });
+    }
+
+    typedef vector<array<double, 3>> FaceKey;
+
+    /// The faces as lists of vertex positions starting from the smallest, sorted.
+    vector<FaceKey> face_keys(const vector<Vec3d>& pos, const vector<PMFace>& faces)
+    {
+        vector<FaceKey> keys;
+        for(const PMFace& f: faces) {
+            FaceKey key;
+            for(uint32_t v: f)
+                key.push_back({pos[v][0], pos[v][1], pos[v][2]});
+            rotate(key.begin(), min_element(key.begin(), key.end()), key.end());
+            keys.push_back(key);
+        }
+        sort(keys.begin(), keys.end());
+        return keys;
+    }
+
+    vector<FaceKey> face_keys(const Manifold& m)
+    {
+        vector<Vec3d> pos;
+        vector<PMFace> faces;
+        VertexAttributeVector<uint32_t> index;
+        for(VertexID v: m.vertices()) {
+            index[v] = uint32_t(pos.size());
+            pos.push_back(m.pos(v));
+        }
+        for(FaceID f: m.faces()) {
+            PMFace face;
+            circulate_face_ccw(m, f, [&](VertexID v) { face.push_back(index[v]); });
+            faces.push_back(face);
+        }
+        return face_keys(pos, faces);
+    }
+
+    void test(const string& name, const Manifold& original, bool parallel)
+    {
+        cout << name << (parallel ? " (parallel)" : "") << endl;
+        Manifold m = original;
+        ProgressiveMesh pm;
+        QuadricSimplifyOptions options;
+        options.target_faces = original.no_faces() / 50;
+        options.progressive_mesh = &pm;
+        QuadricSimplifyStats stats = parallel ? quadric_simplify_parallel(m, options) : quadric_simplify(m, options);
+        check(pm.splits.size() == stats.collapses, "one split per contraction");
+        check(pm.max_vertices() == original.no_vertices(), "number of vertices");
+
+        ProgressiveMeshLOD lod(pm);
+        check(face_keys(lod.positions(), lod.faces()) == face_keys(m), "base mesh is the simplified mesh");
+
+        lod.set_level(pm.splits.size() / 2);
+        Manifold mid;
+        lod.build_manifold(mid);
+        check(valid(mid) && mid.no_vertices() == lod.positions().size(), "intermediate level is valid");
+
+        lod.set_level(pm.splits.size());
+        check(lod.level() == pm.splits.size() && !lod.refine(), "all splits applied");
+        check(face_keys(lod.positions(), lod.faces()) == face_keys(original), "full level is the original mesh");
+
+        lod.set_level(0);
+        check(lod.positions() == pm.base_positions && lod.faces() == pm.base_faces, "coarsening gives the base mesh");
+
+        stringstream ss;
+        check(write_progressive_mesh(ss, pm), "write");
+        const string data = ss.str();
+        ProgressiveMesh pm2;
+        check(read_progressive_mesh(ss, pm2), "read");
+        ProgressiveMeshLOD lod2(pm2);
+        lod2.set_level(pm2.splits.size());
+        check(pm2.splits.size() == pm.splits.size() &&
+              face_keys(lod2.positions(), lod2.faces()) == face_keys(original), "read back");
+
+        stringstream truncated(data.substr(0, data.size() / 2));
+        ProgressiveMesh pm3;
+        check(!read_progressive_mesh(truncated, pm3), "truncated stream is reported");
+        ProgressiveMeshLOD lod3(pm3);
+        lod3.set_level(pm3.splits.size());
+        lod.set_level(pm3.splits.size());
+        check(pm3.splits.size() > 0 && lod3.faces() == lod.faces(), "truncated stream gives a prefix");
+
+        cout << "  " << original.no_faces() << " faces, base mesh " << pm.base_faces.size() << " faces, "
+             << pm.splits.size() << " splits, " << data.size() << " bytes" << endl;
+    }
+}
+
+int main()
+{
+    Manifold torus, grid;
+    make_torus(torus, 100);
+    make_grid(grid, 100);
+    // The parallel simplifier only works in rounds on more than one thread.
+    Util::set_no_threads(4);
+    for(bool parallel: {false, true}) {
+        test("torus", torus, parallel);
+        test("grid", grid, parallel);
+    }
+    Util::set_no_threads(0);
+    return report();
+}
@@ -0,0 +1,110 @@
+/**
+ Correctness test of quadric_simplify_parallel against quadric_simplify.
+
+ A closed bumpy torus and a grid with a boundary are simplified to a fraction of their faces by
+ both simplifiers, and with a target number of faces. The parallel simplifier is run on several
+ threads, so that it works in rounds rather than calling quadric_simplify. Both results must be
+ valid, closed if the input was, free of vertices of valency less than three, and have the same
+ number of boundary loops as the input. A contraction at the boundary removes only one face, so
+ the simplifiers may keep more than the fraction of faces, but the numbers of faces must agree
+ within ten percent. With a target, both must end at the target or one face below it.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Parallel.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /// A torus of N x N/2 quads split into triangles with some bumps.
+    void make_torus(Manifold& m, int N)
+    {
+        GELTest::make_torus(m, N, N/2, [](double u, double v) { return 0.4 * (1 + 0.1 * sin(5*u) * sin(3*v)); });
+    }
+
+    /// An N x N grid of triangles on a wavy height field.
+    void make_grid(Manifold& m, int N)
+    {
+        GELTest::make_grid(m, N, N, [&](int i, int j) {
+            return Vec3d(double(i)/N, double(j)/N, 0.05*sin(7.0*i/N)*cos(5.0*j/N));
+        });
+    }
+
+    int boundary_loops(const Manifold& m)
+    {
+        HalfEdgeAttributeVector<int> seen(m.allocated_halfedges(), 0);
+        int loops = 0;
+        for(auto h: m.halfedges())
+            if(m.walker(h).face() == InvalidFaceID && !seen[h]) {
+                for(Walker w = m.walker(h); !w.full_circle(); w = w.next())
+                    seen[w.halfedge()] = 1;
+                ++loops;
+            }
+        return loops;
+    }
+
+    /// The checks of manifoldness which a simplified mesh must pass.
+    void check_mesh(const Manifold& m, const Manifold& original, const string& what)
+    {
+        bool min_valency = true;
+        for(auto v: m.vertices())
+            min_valency = min_valency && valency(m, v) >= (boundary(m, v) ? 2 : 3);
+        check(valid(m), what + ": valid");
+        check(closed(m) == closed(original), what + ": closed if the input was");
+        check(min_valency, what + ": no vertices of too low valency");
+        check(boundary_loops(m) == boundary_loops(original), what + ": boundary loops");
+    }
+}
+
+int main()
+{
+    Util::set_no_threads(4);
+
+    Manifold torus, grid;
+    make_torus(torus, 200);
+    make_grid(grid, 120);
+    for(auto input: {make_pair("torus", &torus), make_pair("grid", &grid)}) {
+        const string name = input.first;
+        const Manifold& original = *input.second;
+
+        for(double keep: {0.5, 0.1, 0.02}) {
+            const string what = name + ", keep " + to_string(keep);
+            Manifold seq = original, par = original;
+            quadric_simplify(seq, keep);
+            quadric_simplify_parallel(par, keep);
+            check_mesh(seq, original, what + " (sequential)");
+            check_mesh(par, original, what + " (parallel)");
+            cout << what << ": " << seq.no_faces() << " faces (sequential), " << par.no_faces()
+                 << " faces (parallel)" << endl;
+            check(par.no_faces() + 1 >= keep * original.no_faces() && par.no_faces() < original.no_faces(),
+                  what + ": parallel keeps the fraction of faces");
+            check(abs(double(par.no_faces()) - double(seq.no_faces())) <= 0.1 * seq.no_faces(),
+                  what + ": numbers of faces agree");
+        }
+
+        QuadricSimplifyOptions options;
+        options.target_faces = original.no_faces() / 20;
+        Manifold seq = original, par = original;
+        quadric_simplify(seq, options);
+        quadric_simplify_parallel(par, options);
+        const string what = name + ", target " + to_string(options.target_faces);
+        check_mesh(seq, original, what + " (sequential)");
+        check_mesh(par, original, what + " (parallel)");
+        check(seq.no_faces() <= options.target_faces && seq.no_faces() + 1 >= options.target_faces,
+              what + ": sequential meets the target");
+        check(par.no_faces() <= options.target_faces && par.no_faces() + 1 >= options.target_faces,
+              what + ": parallel meets the target");
+    }
+    Util::set_no_threads(0);
+
+    return report();
+}
@@ -0,0 +1,103 @@
+/**
+ Benchmark for parallel quadric simplification. A bumpy torus is simplified to a given fraction
+ of its faces, first with quadric_simplify and then with quadric_simplify_parallel using 2, 4,
+ ... threads up to the number of hardware threads (with one thread, quadric_simplify_parallel
+ just calls quadric_simplify). The time, the speedup over quadric_simplify, the number of faces,
+ and the largest distance from a vertex to the original surface are reported. The result of the
+ parallel simplification must not depend on the number of threads, which is checked as well.
+
+ Usage: simplify_bench [torus resolution (default 2000, i.e. 2M faces)] [keep fraction (default 0.01)] [max threads]
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Parallel.h>
+#include <GEL/Util/Timer.h>
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace Util;
+using namespace GELTest;
+
+namespace
+{
+    // The major radius of make_torus and the mean radius of its tube.
+    const double R = 1.0, r = 0.4;
+
+    double tube_radius(double u, double v)
+    {
+        return r * (1 + 0.1 * sin(5*u) * sin(3*v));
+    }
+
+    void make_torus(Manifold& m, int N)
+    {
+        GELTest::make_torus(m, N, N/2, tube_radius);
+    }
+
+    double distance_to_torus(const Vec3d& p)
+    {
+        double u = atan2(p[1], p[0]);
+        Vec3d d = p - Vec3d(R*cos(u), R*sin(u), 0);
+        double v = atan2(d[2], sqrt(d[0]*d[0] + d[1]*d[1]));
+        return fabs(length(d) - tube_radius(u, v));
+    }
+
+    void report(const char* name, const Manifold& m, double secs)
+    {
+        double max_dist = 0;
+        for(auto v: m.vertices())
+            max_dist = max(max_dist, distance_to_torus(m.pos(v)));
+        cout << name << " time: " << secs << " s faces: " << m.no_faces() << " max distance: " << max_dist;
+    }
+
+    double checksum(const Manifold& m)
+    {
+        double s = 0;
+        for(auto v: m.vertices())
+            s += dot(m.pos(v), Vec3d(1, 2, 3));
+        return s;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int N = argc > 1 ? atoi(argv[1]) : 2000;
+    const double keep = argc > 2 ? atof(argv[2]) : 0.01;
+    const size_t max_threads = argc > 3 ? atoi(argv[3]) : max(1u, thread::hardware_concurrency());
+
+    Manifold m0;
+    make_torus(m0, N);
+    cout << m0.no_vertices() << " vertices, " << m0.no_faces() << " faces" << endl;
+
+    double t_seq = 0;
+    {
+        Manifold m = m0;
+        Timer t;
+        t.start();
+        quadric_simplify(m, keep);
+        t_seq = t.get_secs();
+        report("sequential", m, t_seq);
+        cout << endl;
+    }
+
+    double ref = 0;
+    for(size_t threads = 2; threads <= max(size_t(2), max_threads); threads *= 2) {
+        set_no_threads(threads);
+        Manifold m = m0;
+        Timer t;
+        t.start();
+        quadric_simplify_parallel(m, keep);
+        double secs = t.get_secs();
+        double sum = checksum(m);
+        if(threads == 2)
+            ref = sum;
+        report("parallel", m, secs);
+        cout << " threads: " << threads << " speedup: " << t_seq/secs << (sum != ref ? "  RESULT DIFFERS" : "") << endl;
+    }
+    return 0;
+}
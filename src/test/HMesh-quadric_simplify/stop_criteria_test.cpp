@@ -0,0 +1,123 @@
+/**
+ Test of the stopping criteria of quadric simplification with options, for both quadric_simplify
+ and quadric_simplify_parallel (on several threads, so that it works in rounds).
+
+ - target_faces: the mesh ends with the target number of faces or one less.
+ - max_error: no contraction has a greater error, and an unlimited run goes further.
+ - time_limit: a tiny limit stops the simplification early and sets timed_out.
+ - progress: the callback is called every progress_interval contractions, and returning false
+   cancels the simplification.
+ - stale records: the sequential simplifier skips records of edges that have changed, and the
+   parallel one has none.
+ In all cases, the mesh must be valid afterwards.
+ */
+
+#include <cmath>
+#include <iostream>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Parallel.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /// A torus of N x N/2 quads split into triangles with some bumps.
+    void make_torus(Manifold& m, int N)
+    {
+        GELTest::make_torus(m, N, N/2, [](double u, double v) { return 0.4 * (1 + 0.1 * sin(5*u) * sin(3*v)); });
+    }
+
+    QuadricSimplifyStats simplify(Manifold& m, const QuadricSimplifyOptions& options, bool parallel)
+    {
+        return parallel ? quadric_simplify_parallel(m, options) : quadric_simplify(m, options);
+    }
+}
+
+int main()
+{
+    Util::set_no_threads(4);
+    Manifold torus;
+    make_torus(torus, 160);
+
+    for(bool parallel: {false, true}) {
+        const string name = parallel ? "parallel" : "sequential";
+
+        // target_faces
+        {
+            Manifold m = torus;
+            QuadricSimplifyOptions options;
+            options.target_faces = 1001;
+            QuadricSimplifyStats stats = simplify(m, options, parallel);
+            check(valid(m), name + ", target_faces: valid");
+            check(m.no_faces() <= 1001 && m.no_faces() >= 1000, name + ", target_faces: number of faces");
+            check(stats.collapses == (torus.no_faces() - m.no_faces()) / 2, name + ", target_faces: collapses counted");
+            check(!stats.timed_out && !stats.cancelled, name + ", target_faces: no other criterion");
+        }
+
+        // max_error
+        {
+            Manifold m = torus;
+            QuadricSimplifyOptions options;
+            options.target_faces = 100;
+            QuadricSimplifyStats unlimited = simplify(m, options, parallel);
+            m = torus;
+            options.max_error = unlimited.max_error / 100;
+            QuadricSimplifyStats stats = simplify(m, options, parallel);
+            check(valid(m), name + ", max_error: valid");
+            check(stats.collapses > 0 && stats.max_error <= options.max_error, name + ", max_error: errors within bound");
+            check(stats.collapses < unlimited.collapses && m.no_faces() > 100, name + ", max_error: stops early");
+        }
+
+        // time_limit
+        {
+            Manifold m = torus;
+            QuadricSimplifyOptions options;
+            options.time_limit = 1e-9;
+            QuadricSimplifyStats stats = simplify(m, options, parallel);
+            check(valid(m), name + ", time_limit: valid");
+            check(stats.timed_out && m.no_faces() > torus.no_faces() / 2, name + ", time_limit: stops early");
+        }
+
+        // progress
+        {
+            Manifold m = torus;
+            QuadricSimplifyOptions options;
+            options.progress_interval = 100;
+            int calls = 0;
+            size_t last_collapses = 0;
+            bool increasing = true;
+            options.progress = [&](const QuadricSimplifyStats& s) {
+                increasing = increasing && s.collapses >= last_collapses + 100;
+                last_collapses = s.collapses;
+                return ++calls < 3;
+            };
+            QuadricSimplifyStats stats = simplify(m, options, parallel);
+            check(valid(m), name + ", progress: valid");
+            check(calls == 3 && increasing, name + ", progress: called every progress_interval contractions");
+            check(stats.cancelled && !stats.timed_out, name + ", progress: cancelled");
+            check(stats.collapses >= 300 && (parallel || stats.collapses == 300), name + ", progress: stops at once");
+            check(m.no_faces() == torus.no_faces() - 2 * stats.collapses, name + ", progress: faces removed");
+        }
+
+        // stale records
+        {
+            Manifold m = torus;
+            QuadricSimplifyOptions options;
+            options.target_faces = torus.no_faces() / 10;
+            QuadricSimplifyStats stats = simplify(m, options, parallel);
+            check(valid(m), name + ", stale records: valid");
+            if(parallel)
+                check(stats.stale_records == 0, name + ", stale records: none");
+            else
+                check(stats.stale_records > 0, name + ", stale records: skipped");
+        }
+    }
+    Util::set_no_threads(0);
+
+    return report();
+}
@@ -0,0 +1,78 @@
+/**
+ Scaling benchmark for the parallel smoothing functions. Taubin and anisotropic smoothing are
+ timed on a noisy grid with 1, 2, 4, ... threads up to the number of hardware threads, and the
+ speedup relative to one thread is reported. The results must not depend on the number of
+ threads, which is checked as well.
+
+ Usage: smooth_bench [grid size (default 1000, i.e. 1M vertices)] [max threads]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Parallel.h>
+#include <GEL/Util/Timer.h>
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace Util;
+using namespace GELTest;
+
+namespace
+{
+    void make_noisy_grid(Manifold& m, int N)
+    {
+        make_grid(m, N-1, N-1, [&](int i, int j) {
+            return Vec3d(i/double(N), j/double(N), 0.2/N * (((i*7919 + j*104729) % 101) / 100.0 - 0.5));
+        });
+    }
+
+    double checksum(const Manifold& m)
+    {
+        double s = 0;
+        for(auto v: m.vertices())
+            s += dot(m.pos(v), Vec3d(1, 2, 3));
+        return s;
+    }
+
+    template<typename Func>
+    void time_scaling(const char* name, const Manifold& m0, size_t max_threads, const Func& smooth)
+    {
+        double t1 = 0, ref = 0;
+        for(size_t threads = 1; threads <= max_threads; threads *= 2) {
+            set_no_threads(threads);
+            Manifold m = m0;
+            Timer t;
+            t.start();
+            smooth(m);
+            double secs = t.get_secs();
+            double sum = checksum(m);
+            if(threads == 1) {
+                t1 = secs;
+                ref = sum;
+            }
+            cout << name << " threads: " << threads << " time: " << secs << " s speedup: " << t1/secs
+                 << (sum != ref ? "  RESULT DIFFERS" : "") << endl;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int N = argc > 1 ? atoi(argv[1]) : 1000;
+    const size_t max_threads = argc > 2 ? atoi(argv[2]) : max(1u, thread::hardware_concurrency());
+
+    Manifold m;
+    make_noisy_grid(m, N);
+    cout << m.no_vertices() << " vertices, " << m.no_faces() << " faces" << endl;
+
+    time_scaling("taubin", m, max_threads, [](Manifold& m) { taubin_smooth(m, 10); });
+    time_scaling("anisotropic (bilateral)", m, max_threads, [](Manifold& m) {
+        anisotropic_smooth(m, 1, BILATERAL_NORMAL_SMOOTH); });
+    time_scaling("anisotropic (fvm)", m, max_threads, [](Manifold& m) {
+        anisotropic_smooth(m, 1, FVM_NORMAL_SMOOTH); });
+    return 0;
+}
@@ -0,0 +1,161 @@
+/**
+ Test of subdivide and subdivide_adaptive.
+
+ - A closed quad mesh (torus), an open triangle mesh (grid) and a closed triangle mesh are
+   subdivided by all methods over several levels. The results must be valid meshes with the
+   expected numbers of entities.
+ - One level of Catmull-Clark must place the vertices as cc_split followed by cc_smooth does.
+ - Subdividing in place must give the same mesh as subdividing into another, and in both cases
+   the output must keep its attribute layers with default values.
+ - Adaptive subdivision of part of the grid must give a valid triangle mesh which leaves the faces
+   far from the selection alone.
+
+ Finally, the time of subdividing a torus is compared to that of loop_split and loop_smooth.
+
+ Usage: subdivision_test [torus size (default 300)]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Timer.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /// A torus of N x N quads, or triangles if tri is true.
+    void make_torus(Manifold& m, int N, bool tri)
+    {
+        GELTest::make_torus(m, N, N, [](double, double) { return 0.3; }, !tri);
+    }
+
+    /// A square of N x N vertices in the plane split into triangles.
+    void make_grid(Manifold& m, int N)
+    {
+        GELTest::make_grid(m, N-1, N-1, [](int i, int j) { return Vec3d(i, j, 0); });
+    }
+
+    bool all_faces_have(const Manifold& m, int n)
+    {
+        for(auto f: m.faces())
+            if(no_edges(m, f) != n)
+                return false;
+        return true;
+    }
+
+    /// Subdivide m by all methods over three levels and check the counts.
+    void check_levels(const Manifold& m, const string& name)
+    {
+        const Subd methods[] = {QUAD_SUBD, CC_SUBD, TRI_SUBD, LOOP_SUBD};
+        for(Subd method: methods) {
+            const bool tri = method == TRI_SUBD || method == LOOP_SUBD;
+            Manifold m_prev = m, m_out;
+            for(int l=1;l<=3;++l) {
+                size_t corners = 0;
+                for(auto f: m_prev.faces())
+                    corners += no_edges(m_prev, f);
+                const size_t V = m_prev.no_vertices(), E = m_prev.no_halfedges()/2, F = m_prev.no_faces();
+
+                subdivide(m, m_out, method, l);
+                const string what = name + ", method " + to_string(int(method)) + ", level " + to_string(l);
+                check(valid(m_out), what + ": valid");
+                check(m_out.no_vertices() == V + E + (tri ? 0 : F), what + ": vertex count");
+                check(m_out.no_faces() == corners + (tri ? F : 0), what + ": face count");
+                check(m_out.no_halfedges() == 2*(2*E + corners), what + ": halfedge count");
+                if(tri == all_faces_have(m, 3))
+                    check(all_faces_have(m_out, tri ? 3 : 4), what + ": face sides");
+                m_prev = m_out;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int N = argc > 1 ? atoi(argv[1]) : 300;
+
+    Manifold quads, tris, grid;
+    make_torus(quads, 12, false);
+    make_torus(tris, 12, true);
+    make_grid(grid, 10);
+    check_levels(quads, "quad torus");
+    check_levels(tris, "triangle torus");
+    check_levels(grid, "grid");
+
+    // Catmull-Clark against cc_split and cc_smooth
+    {
+        Manifold a, b = quads;
+        subdivide(quads, a, CC_SUBD);
+        cc_split(b, b);
+        cc_smooth(b);
+        double err = 0;
+        for(auto v: a.vertices())
+            err = max(err, length(a.pos(v) - b.pos(v)));
+        check(a.no_vertices() == b.no_vertices() && err < 1e-12, "Catmull-Clark equals cc_split and cc_smooth");
+    }
+
+    // In place. The attribute layers of the output are kept and cleared either way.
+    {
+        Manifold a, b = tris;
+        a.add_vertex_attribute<int>("weight", 7);
+        b.add_vertex_attribute<int>("weight", 7)[*b.vertices().begin()] = 1;
+        subdivide(tris, a, LOOP_SUBD, 2);
+        subdivide(b, b, LOOP_SUBD, 2);
+        double err = 0;
+        for(auto v: a.vertices())
+            err = max(err, length(a.pos(v) - b.pos(v)));
+        check(a.no_vertices() == b.no_vertices() && err == 0, "subdividing in place gives the same result");
+        for(Manifold* m: {&a, &b}) {
+            const VertexAttributeVector<int>* weight = m->vertex_attribute<int>("weight");
+            bool cleared = weight && weight->size() >= m->allocated_vertices();
+            for(auto v: m->vertices())
+                cleared = cleared && (*weight)[v] == 7;
+            check(cleared, string(m == &a ? "separate" : "in place") + " output keeps its layers cleared");
+        }
+    }
+
+    // Adaptive subdivision of the faces near a corner of the grid
+    for(Subd method: {LOOP_SUBD, CC_SUBD}) {
+        Manifold m = grid;
+        FaceAttributeVector<int> selected(m.allocated_faces(), 0);
+        for(auto f: m.faces())
+            selected[f] = centre(m, f)[0] < 4 && centre(m, f)[1] < 4;
+        subdivide_adaptive(m, selected, method, 2);
+        check(valid(m), "adaptive subdivision is valid");
+        if(method == LOOP_SUBD)
+            check(all_faces_have(m, 3), "adaptive Loop subdivision gives triangles");
+        size_t far_faces = 0, far_faces_before = 0;
+        for(auto f: m.faces())
+            far_faces += centre(m, f)[0] > 6 || centre(m, f)[1] > 6;
+        for(auto f: grid.faces())
+            far_faces_before += centre(grid, f)[0] > 6 || centre(grid, f)[1] > 6;
+        check(far_faces == far_faces_before, "adaptive subdivision leaves far faces alone");
+        check(m.no_faces() > grid.no_faces(), "adaptive subdivision refines");
+    }
+
+    // Time
+    Manifold big;
+    make_torus(big, N, true);
+    Util::Timer tim;
+    Manifold out;
+    tim.start();
+    subdivide(big, out, LOOP_SUBD, 2);
+    double t_subdivide = tim.get_secs();
+    tim.start();
+    Manifold old = big;
+    for(int l=0;l<2;++l) {
+        loop_split(old, old);
+        loop_smooth(old);
+    }
+    double t_old = tim.get_secs();
+    cout << "Two levels of Loop subdivision of " << big.no_faces() << " faces: " << t_subdivide
+         << " s (subdivide), " << t_old << " s (loop_split and loop_smooth)" << endl;
+
+    return report();
+}
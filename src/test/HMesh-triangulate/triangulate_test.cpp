@@ -0,0 +1,129 @@
+/**
+ Test of triangulate on meshes with large polygons.
+
+ - Discs with many sides, star shaped (non-convex) polygons and a quad torus are triangulated by
+   both methods. The result must be a valid triangle mesh with the same vertices, n-2 triangles
+   for each face with n sides, no two edges between the same vertices and, for the flat
+   polygons, the same area.
+ - A pillow of two quads with the same four vertices must not get the same diagonal twice.
+
+ Finally, the time is compared to triangulating the faces one at a time.
+
+ Usage: triangulate_test [sides of the discs (default 2000)]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <GEL/HMesh/HMesh.h>
+#include <GEL/Util/Timer.h>
+#include "../test_util.h"
+#include "../test_meshes.h"
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+using namespace GELTest;
+
+namespace
+{
+    /** Flat polygons with n sides in a row. Every other polygon is a star, where the radius
+     alternates between 1 and 0.6. */
+    void make_polygons(Manifold& m, int no_polygons, int n)
+    {
+        vector<double> pts;
+        vector<int> faces, indices;
+        for(int k=0;k<no_polygons;++k) {
+            for(int i=0;i<n;++i) {
+                double a = 2*M_PI*i/n, r = (k%2 && i%2) ? 0.6 : 1.0;
+                indices.push_back(pts.size()/3);
+                pts.insert(pts.end(), {3.0*k + r*cos(a), r*sin(a), 0.0});
+            }
+            faces.push_back(n);
+        }
+        build(m, pts.size()/3, pts.data(), faces.size(), faces.data(), indices.data());
+    }
+
+    void make_torus(Manifold& m, int N)
+    {
+        GELTest::make_torus(m, N, N, [](double, double) { return 0.3; }, true);
+    }
+
+    double total_area(const Manifold& m)
+    {
+        double a = 0;
+        for(auto f: m.faces())
+            a += area(m, f);
+        return a;
+    }
+
+    bool no_multi_edges(const Manifold& m)
+    {
+        for(auto v: m.vertices()) {
+            set<VertexID> nbrs;
+            int n = circulate_vertex_ccw(m, v, [&](VertexID u) { nbrs.insert(u); });
+            if(int(nbrs.size()) != n)
+                return false;
+        }
+        return true;
+    }
+
+    void check_triangulation(const Manifold& m_in, TriangulationMethod method, const string& name, bool flat)
+    {
+        Manifold m = m_in;
+        size_t triangles = 0;
+        for(auto f: m.faces())
+            triangles += no_edges(m, f) - 2;
+        triangulate(m, method);
+        const string what = name + (method == CLIP_EAR ? ", ear clipping" : ", shortest edge");
+        check(valid(m), what + ": valid");
+        check(m.no_vertices() == m_in.no_vertices(), what + ": same vertices");
+        check(m.no_faces() == triangles, what + ": triangle count");
+        check(no_multi_edges(m), what + ": no multiple edges");
+        if(flat)
+            check(abs(total_area(m) - total_area(m_in)) < 1e-9 * total_area(m_in), what + ": area");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int n = argc > 1 ? atoi(argv[1]) : 2000;
+
+    Manifold polygons, torus;
+    make_polygons(polygons, 20, 200);
+    make_torus(torus, 50);
+    for(TriangulationMethod method: {CLIP_EAR, SHORTEST_EDGE}) {
+        check_triangulation(polygons, method, "polygons", true);
+        check_triangulation(torus, method, "torus", false);
+    }
+
+    // A pillow of two thin rhombi sharing all four vertices. Both sides prefer the short diagonal.
+    {
+        Manifold m;
+        vector<double> pts = {-1,0,0, 0,-0.2,0, 1,0,0, 0,0.2,0};
+        vector<int> faces = {4, 4};
+        vector<int> indices = {0,1,2,3, 3,2,1,0};
+        build(m, 4, pts.data(), 2, faces.data(), indices.data());
+        triangulate(m);
+        check(valid(m) && m.no_faces() == 4 && no_multi_edges(m), "pillow gets two different diagonals");
+    }
+
+    // Time
+    Manifold big;
+    make_polygons(big, 20, n);
+    Util::Timer tim;
+    Manifold m = big;
+    tim.start();
+    triangulate(m);
+    double t_batch = tim.get_secs();
+    m = big;
+    vector<FaceID> faces(m.faces().begin(), m.faces().end());
+    tim.start();
+    for(auto f: faces)
+        triangulate(m, f);
+    double t_serial = tim.get_secs();
+    cout << "Ear clipping of 20 polygons with " << n << " sides: " << t_batch
+         << " s (all faces), " << t_serial << " s (one face at a time)" << endl;
+
+    return report();
+}
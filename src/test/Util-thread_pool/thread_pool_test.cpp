@@ -0,0 +1,119 @@
+/**
+ Stress test of the GEL thread pool.
+
+ For pools of 1 to 16 threads, parallel_tasks, parallel_for_ranges, and parallel_for_chunks
+ must call the function for every index exactly once. The cost per index varies a lot, so the
+ chunks are stolen back and forth, and loops are also nested inside the tasks and chunks of
+ other loops, where they run on the calling thread.
+ */
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <GEL/Util/Parallel.h>
+#include "../test_util.h"
+
+using namespace std;
+using namespace Util;
+using namespace GELTest;
+
+namespace
+{
+    /// Counters for n indices.
+    struct Visits
+    {
+        Visits(size_t _n): n(_n), count(new atomic<int>[_n]) { for(size_t i=0;i<n;++i) count[i] = 0; }
+
+        void visit(size_t i) { if(i < n) ++count[i]; else ++out_of_range; }
+
+        bool exactly_once() const
+        {
+            for(size_t i=0;i<n;++i)
+                if(count[i] != 1)
+                    return false;
+            return out_of_range == 0;
+        }
+
+        size_t n;
+        unique_ptr<atomic<int>[]> count;
+        atomic<int> out_of_range{0};
+    };
+
+    /// Work whose cost grows steeply with i for a few indices and is tiny for the rest.
+    double uneven_work(size_t i)
+    {
+        const size_t k = (i % 97 == 0) ? 20000 : (i % 13 == 0 ? 500 : 1);
+        double x = 0;
+        for(size_t j=0;j<k;++j)
+            x += 1.0 / double(i + j + 1);
+        return x;
+    }
+
+    atomic<long> sink{0};
+}
+
+int main()
+{
+    for(size_t T=1;T<=16;++T) {
+        set_no_threads(T);
+        const string pool = " (" + to_string(T) + " threads)";
+        check(no_threads() == T, "pool size" + pool);
+
+        for(size_t n: {size_t(0), size_t(1), size_t(7), size_t(1000), size_t(100003)}) {
+            const string what = ", n=" + to_string(n) + pool;
+
+            Visits tasks(n);
+            parallel_tasks(n, [&](size_t t) { tasks.visit(t); });
+            check(tasks.exactly_once(), "parallel_tasks" + what);
+
+            Visits ranges(n);
+            parallel_for_ranges(n, [&](size_t b, size_t e) {
+                for(size_t i=b;i<e;++i)
+                    ranges.visit(i);
+            }, 100);
+            check(ranges.exactly_once(), "parallel_for_ranges" + what);
+
+            for(size_t chunk: {size_t(1), size_t(3), size_t(64), size_t(5000)}) {
+                Visits chunks(n);
+                atomic<int> bad_chunks{0};
+                parallel_for_chunks(n, [&](size_t b, size_t e) {
+                    if(!(b < e && e <= n && e - b <= chunk))
+                        ++bad_chunks;
+                    long x = 0;
+                    for(size_t i=b;i<e;++i) {
+                        chunks.visit(i);
+                        x += long(uneven_work(i));
+                    }
+                    sink += x;
+                }, chunk);
+                check(chunks.exactly_once() && bad_chunks == 0,
+                      "parallel_for_chunks, chunk=" + to_string(chunk) + what);
+            }
+        }
+
+        // Nested loops: an inner loop in every task and every chunk of an outer loop.
+        const size_t outer = 37, inner = 1001;
+        Visits nested_tasks(outer * inner);
+        parallel_tasks(outer, [&](size_t t) {
+            parallel_for_chunks(inner, [&](size_t b, size_t e) {
+                for(size_t i=b;i<e;++i)
+                    nested_tasks.visit(t * inner + i);
+            }, 16);
+        });
+        check(nested_tasks.exactly_once(), "chunks nested in tasks" + pool);
+
+        Visits nested_chunks(outer * inner);
+        parallel_for_chunks(outer, [&](size_t b, size_t e) {
+            for(size_t o=b;o<e;++o)
+                parallel_tasks(inner, [&](size_t t) {
+                    uneven_work(t);
+                    nested_chunks.visit(o * inner + t);
+                });
+        }, 1);
+        check(nested_chunks.exactly_once(), "tasks nested in chunks" + pool);
+    }
+    set_no_threads(0);
+
+    return report();
+}
@@ -0,0 +1,107 @@
+/**
+ @file test_meshes.h
+ Parametric meshes shared by the test programs and benchmarks.
+ */
+
+#ifndef __GEL_TEST_MESHES_H__
+#define __GEL_TEST_MESHES_H__
+
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <GEL/HMesh/Manifold.h>
+
+namespace GELTest
+{
+    /** A grid of NI x NJ cells with vertex (i, j) at pos(i, j), for 0 <= i <= NI and 0 <= j <= NJ.
+     The vertex (i, j) has the index i*(NJ+1) + j. Unless quads is set, each cell is split into two
+     triangles along the diagonal from (i, j) to (i+1, j+1), or along the other diagonal where
+     other_diagonal(i, j) is true. other_diagonal is called for the cells in the order of i and
+     then j. */
+    inline void make_grid(HMesh::Manifold& m, int NI, int NJ, const std::function<CGLA::Vec3d(int, int)>& pos,
+                          bool quads = false, const std::function<bool(int, int)>& other_diagonal = {})
+    {
+        std::vector<double> pts;
+        std::vector<int> faces, indices;
+        for(int i=0;i<=NI;++i)
+            for(int j=0;j<=NJ;++j) {
+                const CGLA::Vec3d p = pos(i, j);
+                pts.insert(pts.end(), {p[0], p[1], p[2]});
+            }
+        for(int i=0;i<NI;++i)
+            for(int j=0;j<NJ;++j) {
+                const int a = i*(NJ+1)+j, b = (i+1)*(NJ+1)+j, c = b+1, d = a+1;
+                if(quads) {
+                    faces.push_back(4);
+                    indices.insert(indices.end(), {a, b, c, d});
+                }
+                else {
+                    faces.insert(faces.end(), {3, 3});
+                    if(other_diagonal && other_diagonal(i, j))
+                        indices.insert(indices.end(), {a, b, d, b, c, d});
+                    else
+                        indices.insert(indices.end(), {a, b, c, a, c, d});
+                }
+            }
+        HMesh::build(m, pts.size()/3, pts.data(), faces.size(), faces.data(), indices.data());
+    }
+
+    /** A torus around the z-axis with major radius one and N x M vertices. Vertex (i, j) has the
+     index i*M + j and lies at the angle u = 2 pi i/N around the axis and v = 2 pi j/M around the
+     tube, whose radius there is r(u, v). Unless quads is set, each quad is split into two
+     triangles as in make_grid. */
+    inline void make_torus(HMesh::Manifold& m, int N, int M, const std::function<double(double, double)>& r,
+                           bool quads = false)
+    {
+        std::vector<double> pts;
+        std::vector<int> faces, indices;
+        for(int i=0;i<N;++i)
+            for(int j=0;j<M;++j) {
+                const double u = 2*M_PI*i/N, v = 2*M_PI*j/M, rr = r(u, v);
+                pts.insert(pts.end(), {(1+rr*cos(v))*cos(u), (1+rr*cos(v))*sin(u), rr*sin(v)});
+            }
+        for(int i=0;i<N;++i)
+            for(int j=0;j<M;++j) {
+                const int a = i*M+j, b = ((i+1)%N)*M+j, c = ((i+1)%N)*M+(j+1)%M, d = i*M+(j+1)%M;
+                if(quads) {
+                    faces.push_back(4);
+                    indices.insert(indices.end(), {a, b, c, d});
+                }
+                else {
+                    faces.insert(faces.end(), {3, 3});
+                    indices.insert(indices.end(), {a, b, c, a, c, d});
+                }
+            }
+        HMesh::build(m, pts.size()/3, pts.data(), faces.size(), faces.data(), indices.data());
+    }
+
+    /// A unit sphere with N rings of 2N triangles or quads split into triangles.
+    inline void make_sphere(HMesh::Manifold& m, int N)
+    {
+        const int M = 2*N;
+        std::vector<double> pts = {0, 0, 1};
+        for(int i=1;i<N;++i)
+            for(int j=0;j<M;++j) {
+                const double t = M_PI*i/N, p = 2*M_PI*j/M;
+                pts.insert(pts.end(), {sin(t)*cos(p), sin(t)*sin(p), cos(t)});
+            }
+        pts.insert(pts.end(), {0, 0, -1});
+        const int south = int(pts.size()/3) - 1;
+        auto ring = [&](int i, int j) { return 1 + (i-1)*M + (j%M); };
+
+        std::vector<int> faces, indices;
+        for(int j=0;j<M;++j) {
+            faces.insert(faces.end(), {3, 3});
+            indices.insert(indices.end(), {0, ring(1, j), ring(1, j+1), south, ring(N-1, j+1), ring(N-1, j)});
+        }
+        for(int i=1;i<N-1;++i)
+            for(int j=0;j<M;++j) {
+                faces.insert(faces.end(), {3, 3});
+                indices.insert(indices.end(), {ring(i, j), ring(i+1, j), ring(i+1, j+1),
+                                               ring(i, j), ring(i+1, j+1), ring(i, j+1)});
+            }
+        HMesh::build(m, pts.size()/3, pts.data(), faces.size(), faces.data(), indices.data());
+    }
+}
+
+#endif
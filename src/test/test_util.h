@@ -0,0 +1,35 @@
+/**
+ @file test_util.h
+ Checks shared by the test programs. A test calls check for each condition and ends main with
+ return report(), which prints OK or FAILED and gives the exit code.
+ */
+
+#ifndef __GEL_TEST_UTIL_H__
+#define __GEL_TEST_UTIL_H__
+
+#include <iostream>
+#include <string>
+
+namespace GELTest
+{
+    /// Number of failed checks.
+    inline int errors = 0;
+
+    /// Count and report a failure if ok is false.
+    inline void check(bool ok, const std::string& what)
+    {
+        if(!ok) {
+            std::cout << "FAILED: " << what << std::endl;
+            ++errors;
+        }
+    }
+
+    /// Print the outcome of the checks and return the exit code of the test.
+    inline int report()
+    {
+        std::cout << (errors ? "FAILED" : "OK") << std::endl;
+        return errors ? 1 : 0;
+    }
+}
+
+#endif